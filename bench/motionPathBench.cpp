@@ -0,0 +1,378 @@
+//
+//  motionPathBench.cpp
+//  MotionPath
+//
+//  Standalone timings of the path kernels that do not need a Maya session, printed as JSON.
+//  The DG bound paths (parent matrices, buffer paths, key caching) are timed by bench/motionPathBench.py in mayapy.
+//
+//  motionPath_bench [--paths N] [--frames M] [--iterations K] [--output file.json]
+//
+
+#include "TransformKernel.h"
+#include "PathLod.h"
+#include "ScreenHitIndex.h"
+#include "FrameLabelLayer.h"
+#include "PathGeometry.h"
+#include "StrokeGeometry.h"
+
+#include <maya/MMatrix.h>
+#include <maya/MVectorArray.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+    struct Settings
+    {
+        int paths;
+        int frames;
+        int iterations;
+        std::string output;
+    };
+
+    struct Result
+    {
+        std::string name;
+        long long items;            // work items per iteration, frames or labels or picks
+        std::vector<double> times;  // milliseconds per iteration
+    };
+
+    // keeps the optimizer from dropping a result nobody reads
+    volatile double sink = 0;
+
+    template <typename Function>
+    Result run(const std::string &name, const long long items, const int iterations, Function function)
+    {
+        Result result;
+        result.name = name;
+        result.items = items;
+
+        // one untimed run warms the caches and sizes the buffers
+        function();
+        for (int i = 0; i < iterations; ++i)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            function();
+            result.times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return result;
+    }
+
+    // a looping curve with some noise, one per path, the same seed every run
+    MVector pathPosition(const int path, const int frame)
+    {
+        double t = frame * 0.05 + path;
+        return MVector(std::cos(t) * (10 + path % 7), std::sin(t * 1.3) * 4 + frame * 0.01, std::sin(t) * (10 + path % 5));
+    }
+
+    // a parent spinning around y while it drifts, so no two matrices are alike
+    MMatrix parentMatrix(const int path, const int frame)
+    {
+        double angle = 0.01 * frame + 0.02 * path;
+        MMatrix m;
+        m[0][0] = std::cos(angle);
+        m[0][2] = -std::sin(angle);
+        m[2][0] = std::sin(angle);
+        m[2][2] = std::cos(angle);
+        m[3][0] = path * 2.0;
+        m[3][2] = frame * 0.02;
+        return m;
+    }
+
+    // a camera looking down -z from 60 units away, 1920 x 1080
+    pathLod::ScreenProjection benchProjection()
+    {
+        MMatrix view;
+        view[3][2] = -60.0;
+
+        MMatrix projection;
+        double f = 1.0 / std::tan(0.4);
+        projection[0][0] = f * 1080.0 / 1920.0;
+        projection[1][1] = f;
+        projection[2][2] = -1.0;
+        projection[2][3] = -1.0;
+        projection[3][2] = -0.2;
+        projection[3][3] = 0.0;
+
+        pathLod::ScreenProjection result;
+        result.viewProjection = view * projection;
+        result.width = 1920;
+        result.height = 1080;
+        return result;
+    }
+
+    Result benchTransformKernel(const Settings &settings)
+    {
+        transformKernel::PositionArray positions;
+        std::vector<MMatrix> matrices;
+        for (int p = 0; p < settings.paths; ++p)
+        {
+            for (int f = 0; f < settings.frames; ++f)
+            {
+                positions.push_back(pathPosition(p, f));
+                matrices.push_back(parentMatrix(p, f));
+            }
+        }
+
+        std::vector<const MMatrix*> matrixPointers(matrices.size());
+        for (size_t i = 0; i < matrices.size(); ++i)
+            matrixPointers[i] = &matrices[i];
+
+        MMatrix camera;
+        camera[3][2] = -60.0;
+        std::vector<MVector> out(positions.size());
+
+        return run("transformKernel.transformPositions", static_cast<long long>(positions.size()), settings.iterations, [&]()
+        {
+            transformKernel::transformPositions(positions, &matrixPointers[0], NULL, &camera, &out[0]);
+            sink = sink + out.back().x;
+        });
+    }
+
+    Result benchLodSimplify(const Settings &settings)
+    {
+        pathLod::ScreenProjection projection = benchProjection();
+
+        std::vector<std::vector<double> > xs(settings.paths), ys(settings.paths);
+        std::vector<std::vector<unsigned char> > visible(settings.paths);
+        for (int p = 0; p < settings.paths; ++p)
+        {
+            xs[p].resize(settings.frames);
+            ys[p].resize(settings.frames);
+            visible[p].resize(settings.frames);
+            for (int f = 0; f < settings.frames; ++f)
+                visible[p][f] = projection.project(MPoint(pathPosition(p, f)), xs[p][f], ys[p][f]) ? 1 : 0;
+        }
+
+        std::vector<unsigned char> keep;
+        return run("pathLod.simplify", static_cast<long long>(settings.paths) * settings.frames, settings.iterations, [&]()
+        {
+            for (int p = 0; p < settings.paths; ++p)
+            {
+                // every 12th frame stands in for a key
+                keep.assign(settings.frames, 0);
+                for (int f = 0; f < settings.frames; f += 12)
+                    keep[f] = 1;
+
+                pathLod::simplify(xs[p], ys[p], visible[p], 1.0, keep);
+                sink = sink + keep.back();
+            }
+        });
+    }
+
+    Result benchHitIndex(const Settings &settings)
+    {
+        pathLod::ScreenProjection projection = benchProjection();
+
+        std::vector<short> x, y;
+        for (int p = 0; p < settings.paths; ++p)
+        {
+            for (int f = 0; f < settings.frames; ++f)
+            {
+                double px, py;
+                if (!projection.project(MPoint(pathPosition(p, f)), px, py))
+                    continue;
+                x.push_back(static_cast<short>(px));
+                y.push_back(static_cast<short>(py));
+            }
+        }
+
+        const int picks = 1000;
+        ScreenHitIndex hitIndex;
+        MMatrix camera;
+        unsigned int generation = 0;
+
+        return run("screenHitIndex.buildAndPick", static_cast<long long>(x.size()) + picks, settings.iterations, [&]()
+        {
+            hitIndex.begin(++generation, camera, projection.width, projection.height, 7.5);
+            for (size_t i = 0; i < x.size(); ++i)
+                hitIndex.add(i % 12 == 0 ? ScreenHitIndex::kKey : ScreenHitIndex::kFrame, static_cast<int>(i / settings.frames), static_cast<int>(i), static_cast<double>(i % settings.frames), x[i], y[i]);
+            hitIndex.finalize();
+
+            ScreenHitIndex::Target target;
+            for (int i = 0; i < picks; ++i)
+            {
+                size_t sample = (static_cast<size_t>(i) * 7919) % std::max<size_t>(1, x.size());
+                if (!x.empty() && hitIndex.pick(x[sample], y[sample], 1u << ScreenHitIndex::kFrame, -1, 5.0, false, target))
+                    sink = sink + target.time;
+            }
+        });
+    }
+
+    Result benchFrameLabels(const Settings &settings)
+    {
+        pathLod::ScreenProjection projection = benchProjection();
+
+        std::vector<double> x, y, frames;
+        for (int p = 0; p < settings.paths; ++p)
+        {
+            for (int f = 0; f < settings.frames; f += 5)
+            {
+                double px, py;
+                if (!projection.project(MPoint(pathPosition(p, f)), px, py))
+                    continue;
+                x.push_back(px);
+                y.push_back(py + 5);
+                frames.push_back(f);
+            }
+        }
+
+        FrameLabelLayer layer;
+        unsigned int fontSize = FrameLabelLayer::fontPixelSize(1.0);
+
+        return run("frameLabelLayer.place", static_cast<long long>(x.size()), settings.iterations, [&]()
+        {
+            layer.begin(projection.width, projection.height);
+            int placed = 0;
+            for (size_t i = 0; i < x.size(); ++i)
+            {
+                const MString &text = layer.text(frames[i]);
+                if (layer.place(x[i], y[i], FrameLabelLayer::textWidth(text, fontSize), fontSize))
+                    ++placed;
+            }
+            sink = sink + placed;
+        });
+    }
+
+    // scrubbing one frame forwards per iteration, only the frame entering the window is rewritten
+    Result benchGeometrySlide(const Settings &settings)
+    {
+        std::vector<PathGeometry> geometries(settings.paths);
+        int window = std::min(settings.frames, 200);
+        int offset = 0;
+
+        return run("pathGeometry.slideWindow", static_cast<long long>(settings.paths) * window, settings.iterations, [&]()
+        {
+            ++offset;
+            for (int p = 0; p < settings.paths; ++p)
+            {
+                PathGeometry &geometry = geometries[p];
+                geometry.setLayout(offset, offset + window - 1, 1.0, MColor(1, 0, 0), false);
+                for (unsigned int s = 0; s < geometry.numSamples(); ++s)
+                    if (geometry.isSampleDirty(s))
+                        geometry.setSample(s, pathPosition(p, static_cast<int>(geometry.sampleTime(s))));
+                geometry.clearDirty();
+            }
+        });
+    }
+
+    // releasing a dense tablet stroke over the keys of every path, closest and spread modes
+    Result benchStrokeFit(const Settings &settings)
+    {
+        pathLod::ScreenProjection projection = benchProjection();
+
+        MVectorArray stroke;
+        for (int f = 0; f < settings.frames; ++f)
+        {
+            double x = 200 + 1500.0 * f / settings.frames;
+            stroke.append(MVector(x, 540 + 200 * std::sin(f * 0.02) + 3 * std::sin(f * 1.7), 0));
+        }
+
+        std::vector<MVector> keys;
+        for (int p = 0; p < settings.paths; ++p)
+        {
+            for (int f = 0; f < settings.frames; f += 10)
+            {
+                double x, y;
+                if (projection.project(MPoint(pathPosition(p, f)), x, y))
+                    keys.push_back(MVector(x, y, 0));
+            }
+        }
+
+        StrokeGeometry geometry;
+        return run("strokeGeometry.fitKeys", static_cast<long long>(keys.size()) * 2, settings.iterations, [&]()
+        {
+            geometry.set(stroke);
+            int count = static_cast<int>(keys.size());
+            for (int i = 0; i < count; ++i)
+            {
+                sink = sink + geometry.closestPoint(keys[i]).x;
+                sink = sink + geometry.spreadPoint(i, count).y;
+            }
+        });
+    }
+
+    void writeJson(FILE *file, const Settings &settings, const std::vector<Result> &results)
+    {
+        fprintf(file, "{\n  \"settings\": {\"paths\": %d, \"frames\": %d, \"iterations\": %d},\n  \"results\": [\n", settings.paths, settings.frames, settings.iterations);
+        for (size_t r = 0; r < results.size(); ++r)
+        {
+            const Result &result = results[r];
+            std::vector<double> sorted(result.times);
+            std::sort(sorted.begin(), sorted.end());
+
+            double total = 0;
+            for (size_t i = 0; i < sorted.size(); ++i)
+                total += sorted[i];
+            double mean = sorted.empty() ? 0 : total / sorted.size();
+            double median = sorted.empty() ? 0 : sorted[sorted.size() / 2];
+            double minimum = sorted.empty() ? 0 : sorted.front();
+            double maximum = sorted.empty() ? 0 : sorted.back();
+
+            fprintf(file, "    {\"name\": \"%s\", \"items\": %lld, \"meanMs\": %.6f, \"medianMs\": %.6f, \"minMs\": %.6f, \"maxMs\": %.6f, \"nsPerItem\": %.3f}%s\n",
+                    result.name.c_str(), result.items, mean, median, minimum, maximum,
+                    result.items > 0 ? median * 1e6 / result.items : 0.0, r + 1 < results.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+    }
+
+    bool parseArguments(int argc, char **argv, Settings &settings)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            bool hasValue = i + 1 < argc;
+            if (hasValue && std::strcmp(argv[i], "--paths") == 0)
+                settings.paths = std::atoi(argv[++i]);
+            else if (hasValue && std::strcmp(argv[i], "--frames") == 0)
+                settings.frames = std::atoi(argv[++i]);
+            else if (hasValue && std::strcmp(argv[i], "--iterations") == 0)
+                settings.iterations = std::atoi(argv[++i]);
+            else if (hasValue && std::strcmp(argv[i], "--output") == 0)
+                settings.output = argv[++i];
+            else
+                return false;
+        }
+        return settings.paths > 0 && settings.frames > 1 && settings.iterations > 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Settings settings;
+    settings.paths = 50;
+    settings.frames = 1000;
+    settings.iterations = 20;
+
+    if (!parseArguments(argc, argv, settings))
+    {
+        fprintf(stderr, "usage: motionPath_bench [--paths N] [--frames M] [--iterations K] [--output file.json]\n");
+        return 1;
+    }
+
+    std::vector<Result> results;
+    results.push_back(benchTransformKernel(settings));
+    results.push_back(benchLodSimplify(settings));
+    results.push_back(benchHitIndex(settings));
+    results.push_back(benchFrameLabels(settings));
+    results.push_back(benchGeometrySlide(settings));
+    results.push_back(benchStrokeFit(settings));
+
+    FILE *file = settings.output.empty() ? stdout : fopen(settings.output.c_str(), "w");
+    if (!file)
+    {
+        fprintf(stderr, "motionPath_bench: could not open %s\n", settings.output.c_str());
+        return 1;
+    }
+
+    writeJson(file, settings, results);
+    if (file != stdout)
+        fclose(file);
+    return 0;
+}
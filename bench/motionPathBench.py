@@ -0,0 +1,234 @@
+"""
+Headless benchmark of the DG bound motion path code, run with mayapy.
+
+Builds a synthetic scene of N controls x M frames, optionally under deep animated hierarchies, with
+constraints, offset pivots and weighted tangents. It then times the tcMotionPathCmd operations that drive
+cacheParentMatrixRange, createBufferPath and, through -prepareWorldData, the world space part of a draw
+with cacheKeyFrames, together with the plugin's own -queryStats counters. Nothing is drawn in batch mode,
+so the hit tests against a view are not covered here; the hit index itself is timed by motionPath_bench.
+With --bench-exe the Maya independent kernels of motionPath_bench are run too and merged into the same
+JSON summary.
+
+    mayapy bench/motionPathBench.py --plugin /path/to/motionPath.mll --controls 50 --frames 2000 \\
+        --depth 4 --constraints 0.2 --pivots --weighted --output sh010.json
+
+The plugin only registers its command outside the UI when TC_MOTIONPATH_HEADLESS is set, this script sets it.
+"""
+
+import argparse
+import json
+import math
+import os
+import platform
+import subprocess
+import sys
+import time
+
+
+def parse_args(argv):
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--plugin", required=True, help="path of the built motionPath plugin")
+    parser.add_argument("--controls", type=int, default=20, help="animated controls")
+    parser.add_argument("--frames", type=int, default=1000, help="frames of the playback range")
+    parser.add_argument("--key-step", type=int, default=10, help="frames between translate keys")
+    parser.add_argument("--depth", type=int, default=0, help="animated parents above every control")
+    parser.add_argument("--constraints", type=float, default=0.0, help="fraction of controls driven by a parent constraint")
+    parser.add_argument("--pivots", action="store_true", help="offset the rotate pivots and draw paths from pivots")
+    parser.add_argument("--weighted", action="store_true", help="use weighted tangents on the translate curves")
+    parser.add_argument("--iterations", type=int, default=5, help="timed runs of every step")
+    parser.add_argument("--bench-exe", help="motionPath_bench executable to run as well")
+    parser.add_argument("--output", help="JSON file, printed to stdout when omitted")
+    return parser.parse_args(argv)
+
+
+def build_scene(cmds, args):
+    """Returns the controls, every one with keyed translates and the requested hierarchy."""
+    cmds.file(new=True, force=True)
+    cmds.playbackOptions(minTime=1, maxTime=args.frames, animationStartTime=1, animationEndTime=args.frames)
+
+    controls = []
+    drivers = []
+    constrained_count = int(round(args.controls * args.constraints))
+
+    for c in range(args.controls):
+        parent = None
+        for d in range(args.depth):
+            node = cmds.createNode("transform", name="bench_parent_%d_%d" % (c, d), parent=parent)
+            # every level turns and drifts a little, so the parent matrices differ per frame
+            cmds.setKeyframe(node, attribute="rotateY", time=1, value=0)
+            cmds.setKeyframe(node, attribute="rotateY", time=args.frames, value=90 + 10 * d)
+            cmds.setKeyframe(node, attribute="translateX", time=1, value=0)
+            cmds.setKeyframe(node, attribute="translateX", time=args.frames, value=d + 1)
+            parent = node
+
+        control = cmds.createNode("transform", name="bench_control_%d" % c, parent=parent)
+        if args.pivots:
+            cmds.xform(control, rotatePivot=(1.5, 0.5, 0), scalePivot=(1.5, 0.5, 0))
+
+        if c < constrained_count:
+            driver = cmds.createNode("transform", name="bench_driver_%d" % c)
+            key_translates(cmds, driver, c, args)
+            cmds.parentConstraint(driver, control)
+            drivers.append(driver)
+        else:
+            key_translates(cmds, control, c, args)
+
+        controls.append(cmds.ls(control, long=True)[0])
+
+    return controls, drivers
+
+
+def key_translates(cmds, node, index, args):
+    for frame in range(1, args.frames + 1, args.key_step):
+        t = frame * 0.05 + index
+        cmds.setKeyframe(node, attribute="translateX", time=frame, value=10 * math.cos(t))
+        cmds.setKeyframe(node, attribute="translateY", time=frame, value=4 * math.sin(t * 1.3))
+        cmds.setKeyframe(node, attribute="translateZ", time=frame, value=10 * math.sin(t))
+
+    if args.weighted:
+        cmds.keyTangent(node, attribute=("translateX", "translateY", "translateZ"), weightedTangents=True)
+        cmds.keyTangent(node, attribute=("translateX", "translateY", "translateZ"), weightLock=False)
+
+
+def parse_stats(lines):
+    """'name key=value ...' strings of -queryStats to a dictionary, times stay as milliseconds."""
+    stats = {}
+    for line in lines or []:
+        parts = line.split()
+        if not parts:
+            continue
+        if len(parts) == 2 and "=" not in parts[1]:
+            stats[parts[0]] = int(parts[1])
+            continue
+
+        entry = {}
+        for part in parts[1:]:
+            key, _, value = part.partition("=")
+            entry[key] = float(value[:-2]) if value.endswith("ms") else int(value)
+        stats[parts[0]] = entry
+    return stats
+
+
+def time_step(cmds, name, iterations, setup, step):
+    """Runs setup untimed and step timed, resetting the plugin stats before every run."""
+    runs = []
+    stats = None
+    for _ in range(iterations):
+        if setup:
+            setup()
+        cmds.tcMotionPathCmd(resetStats=True)
+        start = time.perf_counter()
+        step()
+        runs.append((time.perf_counter() - start) * 1000.0)
+        stats = parse_stats(cmds.tcMotionPathCmd(queryStats=True))
+
+    runs.sort()
+    return {
+        "name": name,
+        "iterations": iterations,
+        "medianMs": runs[len(runs) // 2],
+        "minMs": runs[0],
+        "maxMs": runs[-1],
+        "stats": stats,
+    }
+
+
+def run_maya_steps(args):
+    os.environ["TC_MOTIONPATH_HEADLESS"] = "1"
+
+    import maya.standalone
+    maya.standalone.initialize(name="python")
+    import maya.cmds as cmds
+
+    cmds.loadPlugin(args.plugin)
+
+    scene_start = time.perf_counter()
+    controls, _ = build_scene(cmds, args)
+    scene_ms = (time.perf_counter() - scene_start) * 1000.0
+
+    cmds.tcMotionPathCmd(usePivots=args.pivots)
+    cmds.tcMotionPathCmd(framesBefore=args.frames, framesAfter=args.frames)
+
+    def disable():
+        cmds.tcMotionPathCmd(enable=False)
+        cmds.select(controls, replace=True)
+
+    def enable():
+        cmds.tcMotionPathCmd(enable=True)
+
+    steps = []
+
+    # building the paths of the selection caches the parent matrices and keys of the whole range
+    steps.append(time_step(cmds, "enablePaths", args.iterations, disable, enable))
+
+    def clear_buffer_paths():
+        cmds.tcMotionPathCmd(deleteAllBufferPaths=True)
+
+    steps.append(time_step(cmds, "addBufferPaths", args.iterations, clear_buffer_paths,
+                           lambda: cmds.tcMotionPathCmd(addBufferPaths=True)))
+
+    # a range change drops and refills the caches of every displayed path
+    ranges = [(1, args.frames), (1, max(2, args.frames // 2))]
+    state = {"index": 0}
+
+    def change_range():
+        state["index"] = 1 - state["index"]
+        cmds.tcMotionPathCmd(frameRange=ranges[state["index"]])
+
+    steps.append(time_step(cmds, "frameRange", args.iterations, None, change_range))
+
+    # what the first panel of a refresh computes, once with the keys rebuilt as after a curve edit and
+    # once from the warm caches the other panels and unchanged refreshes see
+    steps.append(time_step(cmds, "prepareWorldDataEdited", args.iterations, None,
+                           lambda: cmds.tcMotionPathCmd(prepareWorldData=True)))
+    steps.append(time_step(cmds, "prepareWorldDataCached", args.iterations, None,
+                           lambda: cmds.tcMotionPathCmd(prepareWorldData=False)))
+
+    cmds.tcMotionPathCmd(enable=False)
+    cmds.unloadPlugin(os.path.basename(args.plugin).split(".")[0], force=True)
+
+    return scene_ms, steps
+
+
+def run_kernels(args):
+    output = subprocess.check_output([args.bench_exe,
+                                      "--paths", str(args.controls),
+                                      "--frames", str(args.frames),
+                                      "--iterations", str(max(args.iterations, 5))])
+    return json.loads(output.decode("utf-8"))
+
+
+def main(argv):
+    args = parse_args(argv)
+
+    scene_ms, steps = run_maya_steps(args)
+    summary = {
+        "host": platform.node(),
+        "platform": platform.platform(),
+        "scene": {
+            "controls": args.controls,
+            "frames": args.frames,
+            "keyStep": args.key_step,
+            "depth": args.depth,
+            "constraints": args.constraints,
+            "pivots": args.pivots,
+            "weighted": args.weighted,
+            "buildMs": scene_ms,
+        },
+        "steps": steps,
+    }
+
+    if args.bench_exe:
+        summary["kernels"] = run_kernels(args)
+
+    text = json.dumps(summary, indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
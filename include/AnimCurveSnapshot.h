@@ -0,0 +1,63 @@
+//
+//  AnimCurveSnapshot.h
+//  MotionPath
+//
+//  Plugin owned copy of the anim curve driving a plug, evaluated without the Maya API.
+//
+
+#ifndef ANIMCURVESNAPSHOT_H
+#define ANIMCURVESNAPSHOT_H
+
+#include <maya/MPlug.h>
+#include <maya/MFnAnimCurve.h>
+
+#include <vector>
+
+// Keys, tangents and infinity modes of a time based anim curve copied out of Maya.
+// evaluate() touches no Maya object, so a whole window of frames can be sampled across threads.
+// The copy is compared with MFnAnimCurve::evaluate when it is captured; a curve it does not reproduce
+// (or a plug driven by anything else than an anim curve) leaves the snapshot invalid and the caller reads the plug.
+class AnimCurveSnapshot
+{
+    public:
+        AnimCurveSnapshot();
+
+        // false if the plug is not driven directly by a time based anim curve or the copy does not match Maya
+        bool capture(const MPlug &plug);
+        void clear();
+
+        bool isValid() const {return valid;}
+        bool isStatic() const {return valid && staticPlug;}
+        size_t memoryUsage() const {return keys.capacity() * sizeof(Key);}
+
+        // re-reads the value of an unconnected plug, true if it changed since the capture
+        bool updateStaticValue(const MPlug &plug);
+
+        // value at a time in ui units, thread safe
+        double evaluate(const double time) const;
+
+    private:
+        struct Key
+        {
+            double time, value;
+            double inX, inY;        // in tangent, ui unit frames and value per segment, pointing forward in time
+            double outX, outY;
+            bool outStep, outStepNext;
+        };
+
+        bool valid;
+        bool weighted;
+        bool staticPlug;
+        double staticValue;
+        MFnAnimCurve::InfinityType preInfinity, postInfinity;
+        std::vector<Key> keys;
+
+        double evaluateInRange(const double time) const;
+        double evaluateSegment(const unsigned int index, const double time) const;
+        double inSlope(const unsigned int index) const;
+        double outSlope(const unsigned int index) const;
+
+        bool matchesCurve(MFnAnimCurve &curve) const;
+};
+
+#endif
@@ -17,13 +17,21 @@
 #include <maya/MViewport2Renderer.h>
 #include <maya/M3dView.h>
 #include <maya/MString.h>
+#include <maya/MPointArray.h>
 
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <stdint.h>
 
 #include "GlobalSettings.h"
 #include "CameraCache.h"
+#include "PathGeometry.h"
+#include "PathBounds.h"
 
+// A frozen copy of a path, kept for comparison with the live ones.
+// Buffer paths never change after creation, so the range is stored as packed floats and the keys as a
+// sorted time index with their world positions already in draw ready arrays.
 class BufferPath
 {
     public:
@@ -31,25 +39,61 @@ class BufferPath
 
         void draw(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager = NULL, const MHWRender::MFrameContext* frameContext = NULL);
         void setSelected(bool value){selected = value;};
-        void setMinTime(double value){minTime = value;};
-        void setFrames(std::vector<MVector> value){frames=value;};
-        void setKeyFrames(std::map<double, MVector> value){keyFrames=value;};
-        const std::vector<MVector>* getFrames(){return &frames;};
+        void setMinTime(double value){minTime = value; geometry.markAllDirty(); rangeBounds.valid = false;};
+
+        // x, y, z of every frame from minTime on
+        void setFrames(std::vector<float> &&positions);
+        // sorted key times and the x, y, z of each key
+        void setKeyFrames(std::vector<double> &&times, std::vector<float> &&positions);
+
+        double getMinTime() const {return minTime;};
+        const std::vector<float> &getFramePositions() const {return framePositions;};
+        const std::vector<double> &getKeyTimes() const {return keyTimes;};
+        int getKeyCount() const {return static_cast<int>(keyTimes.size());};
+        MVector getKey(const int index) const {return MVector(keyPoints[index]);};
+
+        // hash of the curves and range the path was evaluated from, see MotionPath::getSourceHash
+        void setSourceHash(const uint64_t value){sourceHash = value;};
+        uint64_t getSourceHash() const {return sourceHash;};
+
+        int getFrameCount() const {return static_cast<int>(framePositions.size() / 3);};
+        MVector getFrame(const int index) const {return MVector(framePositions[3 * index], framePositions[3 * index + 1], framePositions[3 * index + 2]);};
 
         // Name support for object identification
         void setObjectName(const MString& name){objectName = name;};
         MString getObjectName() const {return objectName;};
+
+        // approximate bytes held, reported with the caches but never evicted
+        size_t memoryUsage() const;
     
     private:
         void drawFrames(const double startTime, const double endTime, const MColor &curveColor, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, M3dView &view, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
         void drawKeyFrames(const double startTime, const double endTime, const MColor &curveColor, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, M3dView &view, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
 
-        std::vector<MVector> frames;
-        std::map<double, MVector> keyFrames;
+        // frame at time, clamped to the stored range
+        MVector getFrameAtTime(const double time) const {return getFrame(std::max(0, std::min(static_cast<int>(time - minTime), getFrameCount() - 1)));};
+        // box of every stored frame and key, measured once after the frames change
+        const PathBounds::Box &getRangeBounds();
+
+        std::vector<float> framePositions;
+        std::vector<double> keyTimes;
+        MPointArray keyPoints;
+        
+        // keys inside the last drawn time window, only rebuilt when the window moves past a key
+        MPointArray windowKeyPoints;
+        size_t windowKeyBegin, windowKeyEnd;
+        
         bool selected;
         MColor black;
         double minTime;
+        uint64_t sourceHash;
         MString objectName;  // Store object name for identification   
+        PathGeometry geometry;
+
+        // world space frustum of the current draw, unset when culling is off
+        ViewFrustum drawFrustum;
+        std::vector<unsigned char> visibleChunks;
+        PathBounds::Box rangeBounds;
     
 };
 
@@ -14,8 +14,14 @@
 #include <maya/MFnCamera.h>
 #include <maya/MDagPath.h>
 #include <maya/MPlug.h>
+#include <maya/MDGContext.h>
+#include <maya/MTransformationMatrix.h>
 
 #include <map>
+#include <string>
+
+#include "FrameCache.h"
+#include "animCurveUtils.h"
 
 class CameraCache
 {
@@ -23,7 +29,8 @@ class CameraCache
         CameraCache();
         ~CameraCache(){}
     
-        std::map<double, MMatrix> matrixCache;
+        // inverse camera world matrices
+        FrameCache<MMatrix> matrixCache;
         //std::map<double, MMatrix> projMatrixCache;
         int portWidth;
         int portHeight;
@@ -35,15 +42,46 @@ class CameraCache
     
         void cacheCamera();
         void ensureMatricesAtTime(const double time, const bool force=false);
+        // slides the window with the current time, only the frames not cached yet are evaluated
         void checkRangeIsCached();
+        // called by the world matrix callback of every panel looking through this camera; a plain time change
+        // only slides the window, a static camera is evaluated once, false if the cached matrices are still right
+        bool worldMatrixChanged();
+        // curve edits away from the current frame do not move the camera now, the anim curve edited callback reports them
+        bool isDrivenByCurve(const MObject &curve);
+        void invalidate();
+    
+        // cache budget, see MotionPathManager::enforceCacheBudget
+        size_t memoryUsage() const {return matrixCache.memoryUsage();}
+        void setLastUsed(const unsigned int generation){lastUsedGeneration = generation;}
+        unsigned int getLastUsed() const {return lastUsedGeneration;}
+    
+        // manager frame sweep (see MotionPathManager::sweepFrames)
+        bool beginFrameSweep(double &start, double &end);
+        void sweepFrame(const double time, const MDGContext &context);
+        void endFrameSweep(){caching = false;}
+    
+        // idle cache warming, only frames inside the cache window are evaluated
+        bool warmFrame(const double time, const MDGContext &context);
     
     private:
         bool caching, initialized;
+        // every frame in [completeStart, completeEnd] is cached, a slide only looks at the frames outside of it
+        bool hasCompleteRange;
+        double completeStart, completeEnd;
+        unsigned int lastUsedGeneration;
         MPlug worldMatrixPlug;
         MPlug txPlug, tyPlug, tzPlug;
         MPlug rxPlug, ryPlug, rzPlug;
+        MPlug parentMatrixPlug;
+        MObject transformNode;
+    
+        // world matrix with the unkeyed transform values overlaid, nothing is written to the curves
+        MMatrix getLiveWorldMatrix(const double time, const MDGContext &context, const animCurveUtils::LiveValue *live, const MTransformationMatrix &liveTransform);
+        void getWindow(double &start, double &end);
 };
 
+// keyed by the camera full path name, panels looking through the same camera share its cache
 typedef std::map<std::string, CameraCache> CameraCacheMap;
 typedef std::map<std::string, CameraCache>::iterator CameraCacheMapIterator;
 
@@ -13,8 +13,11 @@
 #include "MotionPath.h"
 
 #include <maya/MVector.h>
+#include <maya/MVectorArray.h>
 #include <maya/M3dView.h>
 
+#include <vector>
+
 namespace contextUtils
 {
     bool worldCameraSpaceToWorldSpace(MVector &position, M3dView &view, const double time, const MMatrix &inverseCameraMatrix, MotionPathManager &mpManager);
@@ -22,20 +25,24 @@ namespace contextUtils
     
     MVector getWorldPositionFromProjPoint(const MVector &pointToMove, const double initialX, const double initialY, const double currentX, const double currentY, const M3dView &view, const MVector &cameraPosition);
     
-    int processCurveHits(M3dView &view, CameraCache *cachePtr, MotionPathManager &mpManager);
-    void processTangentHits(MotionPath* motionPathPtr, M3dView &view, CameraCache *cachePtr, int &selectedKeyId, int &selectedTangent);
-    void processKeyFrameHits(MotionPath* motionPathPtr, M3dView &view, CameraCache *cachePtr, MIntArray &selectedKeys);
-    bool processFramesHits(MotionPath* motionPathPtr, M3dView &view, CameraCache *cachePtr, double &time);
-    
+    // picking through the manager's screen space hit index, the same in Viewport 2.0 and the legacy viewport
 	int processCurveHits(const short mx, const short my, const MMatrix &cameraMatrix, M3dView &view, CameraCache *cachePtr, MotionPathManager &mpManager);
-	void processTangentHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, int &selectedKeyId, int &selectedTangent);
-	void processKeyFrameHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, MIntArray &selectedKeys);
-	bool processFramesHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, double &time);
+	void processTangentHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, int &selectedKeyId, int &selectedTangent, MotionPathManager &mpManager);
+	void processKeyFrameHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, MIntArray &selectedKeys, MotionPathManager &mpManager);
+	bool processFramesHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, double &time, MotionPathManager &mpManager);
 
     void refreshSelectionMethod(MEvent &event, MGlobal::ListAdjustment &listAdjustment);
     void drawMarqueeGL(short initialX, short initialY, short finalX, short finalY);
     void drawMarquee(MHWRender::MUIDrawManager& drawMgr, short initialX, short initialY, short finalX, short finalY);
     void applySelection(short initialX, short initialY, short finalX, short finalY, const MGlobal::ListAdjustment &listAdjustment);
+
+    // the lasso is drawn as a line strip of its points, from first on in the legacy viewport so a drag only adds its new segment
+    void drawLassoGL(const MVectorArray &points, const unsigned int first);
+    void drawLasso(MHWRender::MUIDrawManager& drawMgr, const MVectorArray &points);
+
+    // keys of every path inside the rectangle, or inside the lasso when it has three points or more, picked through the hit
+    // index and selected by listAdjustment. hits is scratch space kept by the caller. False when the region holds no key
+    bool applyKeySelection(short initialX, short initialY, short finalX, short finalY, const MVectorArray &lasso, const MGlobal::ListAdjustment &listAdjustment, M3dView &view, MotionPathManager &mpManager, std::vector<ScreenHitIndex::Target> &hits);
     
 }
 
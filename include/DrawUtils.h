@@ -11,11 +11,15 @@
 #include <maya/MMatrix.h>    // 矩阵 (MMatrix)
 #include <maya/MGlobal.h>
 #include <maya/MPoint.h>     // 点 (MPoint)
+#include <maya/MPointArray.h>
+#include <maya/MColorArray.h>
 
 #include <set>
 #include <vector>
 #include <map>
 
+#include "PathGeometry.h"
+
 // OpenGL headers（跨平台）
 #ifdef __APPLE__
     #include <OpenGL/gl.h>
@@ -25,9 +29,8 @@
 
 // 前向声明（与你工程中的真实定义对齐）
 class Keyframe;
+class KeyframeTable;
 class CameraCache;
-typedef std::map<double, Keyframe> KeyframeMap;
-typedef std::map<double, Keyframe>::iterator KeyframeMapIterator;
 
 /*
   说明：
@@ -59,11 +62,11 @@ namespace drawUtils
 
     // ============ 高级：关键帧相关 (keyframes) ============
     void drawKeyFrames(std::vector<Keyframe *> keys, const float size, const double colorMultiplier, const int portWidth, const int portHeight, const bool showRotationKeyframes);
-    void drawKeyFramePoints(KeyframeMap &keyframesCache, const float size, const double colorMultiplier, const int portWidth, const int portHeight, const bool showRotationKeyframes);
+    void drawKeyFramePoints(KeyframeTable &keyframesCache, const float size, const double colorMultiplier, const int portWidth, const int portHeight, const bool showRotationKeyframes);
 
     void convertWorldSpaceToCameraSpace(CameraCache* cachePtr, std::map<double, MPoint> &positions, std::map<double, MPoint> &screenSpacePositions);
 
-    void drawFrameLabel(double frame, const MVector &framePos, M3dView &view, const double sizeOffset, const MColor &color, const MMatrix &refMatrix);
+    void drawFrameLabel(const MString &label, const MVector &framePos, M3dView &view, const double sizeOffset, const MColor &color, const MMatrix &refMatrix);
 
     // ============ 内部辅助（performance-friendly） ============
     void drawStippledLineSegments(const MVector &origin, const MVector &target, float lineWidth, const MColor &color);
@@ -77,6 +80,15 @@ namespace drawUtils
 
     void drawLineArray(const std::vector<MVector> &vertices, float lineWidth, const MColor &color);
     void drawPointArray(const std::vector<MVector> &vertices, float size, const MColor &color);
+
+    // ============ 批量绘制 (client side vertex arrays) ============
+    // 旧视口里每个列表只有一次 glDrawArrays，和 VP2 的 mesh 调用一一对应
+    // lines 两个点一条线段，colors 每个点一个颜色
+    void drawLineList(const MPointArray &lines, const MColorArray &colors, float lineWidth);
+    void drawPointList(const MPointArray &points, const MColorArray &colors, float size);
+    void drawPointList(const MPointArray &points, float size, const MColor &color);
+    // PathGeometry 为 VP2 准备的同一份线段和帧点
+    void drawPackets(const PathGeometry::Packets &packets, float lineWidth, float pointSize);
 }
 
 #endif // DRAWUTILS_H
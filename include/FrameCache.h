@@ -0,0 +1,343 @@
+//
+//  FrameCache.h
+//  MotionPath
+//
+//  Dense per-frame cache used for parent matrices, draw positions and camera matrices.
+//
+
+#ifndef MOTIONPATH_FRAMECACHE_H
+#define MOTIONPATH_FRAMECACHE_H
+
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+// Frame-window cache backed by a ring buffer.
+// Whole frames are stored in a contiguous array indexed by (frame - windowStart), so a lookup is
+// a subtraction plus a validity check. Moving the window only invalidates the frames that left it.
+// Sub-frame times (path sampling with drawTimeInterval < 1, tangent deltas) are rare and live in a small side map.
+// Reading a missing time never inserts anything.
+template <typename T>
+class FrameCache
+{
+    public:
+        FrameCache(): windowStart(0), windowLength(0), head(0), count(0) {}
+
+        // moves the window to [start, end] keeping every frame that is still inside it
+        void setWindow(const double start, const double end);
+
+        bool contains(const double time) const {return find(time) != NULL;}
+        const T* find(const double time) const;
+        T* find(const double time);
+
+        // cached value or a default constructed T (identity for MMatrix, zero for MVector) on a miss
+        const T& get(const double time) const;
+
+        // stores the value, growing the window if the time falls outside of it
+        void set(const double time, const T &value);
+        void erase(const double time);
+        // every whole and sub-frame time in [start, end]
+        void eraseRange(const double start, const double end);
+        void clear();
+        // gives back the storage beyond the current window, growing for a wide range never shrinks on its own
+        void shrinkToFit();
+
+        // calls function(value) on every cached value, whole and sub-frame, in no particular order
+        template <typename Function>
+        void forEach(Function function);
+
+        size_t size() const {return count + fractional.size();}
+        bool empty() const {return size() == 0;}
+
+        // approximate bytes held, side map nodes included
+        size_t memoryUsage() const {return values.capacity() * sizeof(T) + valid.capacity() + fractional.size() * (sizeof(T) + sizeof(double) + 4 * sizeof(void*));}
+
+        int firstFrame() const {return windowStart;}
+        int lastFrame() const {return windowStart + windowLength - 1;}
+        bool hasWindow() const {return windowLength > 0;}
+
+    private:
+        std::vector<T> values;
+        std::vector<unsigned char> valid;
+        std::map<double, T> fractional;
+
+        int windowStart;
+        int windowLength;
+        size_t head;
+        size_t count;
+
+        static bool toFrame(const double time, int &frame);
+        bool inWindow(const int frame) const {return windowLength > 0 && frame >= windowStart && frame < windowStart + windowLength;}
+        size_t slot(const int frame) const;
+        void invalidateFrames(const int first, const int last);
+        void grow(const int start, const int end);
+        void moveWindow(const int start, const int end);
+};
+
+template <typename T>
+template <typename Function>
+void FrameCache<T>::forEach(Function function)
+{
+    for (size_t s = 0; s < values.size(); ++s)
+        if (valid[s])
+            function(values[s]);
+
+    for (typename std::map<double, T>::iterator it = fractional.begin(); it != fractional.end(); ++it)
+        function(it->second);
+}
+
+template <typename T>
+bool FrameCache<T>::toFrame(const double time, int &frame)
+{
+    double rounded = std::floor(time + 0.5);
+    if (std::fabs(time - rounded) > 1e-6)
+        return false;
+
+    frame = static_cast<int>(rounded);
+    return true;
+}
+
+template <typename T>
+size_t FrameCache<T>::slot(const int frame) const
+{
+    size_t index = head + static_cast<size_t>(frame - windowStart);
+    return index >= values.size() ? index - values.size() : index;
+}
+
+template <typename T>
+void FrameCache<T>::invalidateFrames(const int first, const int last)
+{
+    for (int f = first; f <= last; ++f)
+    {
+        size_t s = slot(f);
+        if (valid[s])
+        {
+            valid[s] = 0;
+            --count;
+        }
+    }
+}
+
+template <typename T>
+void FrameCache<T>::grow(const int start, const int end)
+{
+    int length = end - start + 1;
+    size_t capacity = values.size() * 2;
+    if (capacity < static_cast<size_t>(length))
+        capacity = static_cast<size_t>(length);
+    if (capacity < 64)
+        capacity = 64;
+
+    std::vector<T> newValues(capacity);
+    std::vector<unsigned char> newValid(capacity, 0);
+    size_t newCount = 0;
+
+    if (windowLength > 0)
+    {
+        int first = windowStart > start ? windowStart : start;
+        int last = lastFrame() < end ? lastFrame() : end;
+        for (int f = first; f <= last; ++f)
+        {
+            size_t s = slot(f);
+            if (valid[s])
+            {
+                newValues[f - start] = values[s];
+                newValid[f - start] = 1;
+                ++newCount;
+            }
+        }
+    }
+
+    values.swap(newValues);
+    valid.swap(newValid);
+    count = newCount;
+    head = 0;
+    windowStart = start;
+    windowLength = length;
+}
+
+template <typename T>
+void FrameCache<T>::moveWindow(const int start, const int end)
+{
+    int length = end - start + 1;
+    if (length > static_cast<int>(values.size()))
+    {
+        grow(start, end);
+        return;
+    }
+
+    if (windowLength > 0)
+    {
+        int oldEnd = lastFrame();
+        if (end < windowStart || start > oldEnd)
+            invalidateFrames(windowStart, oldEnd);
+        else
+        {
+            if (windowStart < start)
+                invalidateFrames(windowStart, start - 1);
+            if (oldEnd > end)
+                invalidateFrames(end + 1, oldEnd);
+        }
+
+        // keep the frame -> slot mapping, only the origin of the window moves
+        long long shifted = static_cast<long long>(head) + (start - windowStart);
+        long long capacity = static_cast<long long>(values.size());
+        shifted %= capacity;
+        if (shifted < 0)
+            shifted += capacity;
+        head = static_cast<size_t>(shifted);
+    }
+    else
+        head = 0;
+
+    windowStart = start;
+    windowLength = length;
+}
+
+template <typename T>
+void FrameCache<T>::setWindow(const double start, const double end)
+{
+    int first = static_cast<int>(std::floor(start < end ? start : end));
+    int last = static_cast<int>(std::ceil(start < end ? end : start));
+
+    moveWindow(first, last);
+
+    if (!fractional.empty())
+    {
+        fractional.erase(fractional.begin(), fractional.lower_bound(static_cast<double>(first)));
+        fractional.erase(fractional.upper_bound(static_cast<double>(last)), fractional.end());
+    }
+}
+
+template <typename T>
+const T* FrameCache<T>::find(const double time) const
+{
+    int frame;
+    if (!toFrame(time, frame))
+    {
+        typename std::map<double, T>::const_iterator it = fractional.find(time);
+        return it == fractional.end() ? NULL : &it->second;
+    }
+
+    if (!inWindow(frame))
+        return NULL;
+
+    size_t s = slot(frame);
+    return valid[s] ? &values[s] : NULL;
+}
+
+template <typename T>
+T* FrameCache<T>::find(const double time)
+{
+    return const_cast<T*>(static_cast<const FrameCache<T>*>(this)->find(time));
+}
+
+template <typename T>
+const T& FrameCache<T>::get(const double time) const
+{
+    static const T fallback = T();
+    const T* value = find(time);
+    return value ? *value : fallback;
+}
+
+template <typename T>
+void FrameCache<T>::set(const double time, const T &value)
+{
+    int frame;
+    bool wholeFrame = toFrame(time, frame);
+    int first = wholeFrame ? frame : static_cast<int>(std::floor(time));
+    int last = wholeFrame ? frame : static_cast<int>(std::ceil(time));
+
+    if (windowLength == 0)
+        moveWindow(first, last);
+    else if (first < windowStart || last > lastFrame())
+    {
+        int start = first < windowStart ? first : windowStart;
+        int end = last > lastFrame() ? last : lastFrame();
+        if (end - start + 1 > static_cast<int>(values.size()))
+            grow(start, end);
+        else
+            moveWindow(start, end);
+    }
+
+    if (!wholeFrame)
+    {
+        fractional[time] = value;
+        return;
+    }
+
+    size_t s = slot(frame);
+    values[s] = value;
+    if (!valid[s])
+    {
+        valid[s] = 1;
+        ++count;
+    }
+}
+
+template <typename T>
+void FrameCache<T>::erase(const double time)
+{
+    int frame;
+    if (!toFrame(time, frame))
+    {
+        fractional.erase(time);
+        return;
+    }
+
+    if (inWindow(frame))
+        invalidateFrames(frame, frame);
+}
+
+template <typename T>
+void FrameCache<T>::eraseRange(const double start, const double end)
+{
+    if (windowLength > 0)
+    {
+        double first = std::max(std::ceil(start), static_cast<double>(windowStart));
+        double last = std::min(std::floor(end), static_cast<double>(lastFrame()));
+        if (first <= last)
+            invalidateFrames(static_cast<int>(first), static_cast<int>(last));
+    }
+
+    if (!fractional.empty())
+        fractional.erase(fractional.lower_bound(start), fractional.upper_bound(end));
+}
+
+template <typename T>
+void FrameCache<T>::clear()
+{
+    std::fill(valid.begin(), valid.end(), 0);
+    fractional.clear();
+    count = 0;
+    head = 0;
+    windowLength = 0;
+}
+
+template <typename T>
+void FrameCache<T>::shrinkToFit()
+{
+    size_t capacity = windowLength > 0 ? std::max<size_t>(static_cast<size_t>(windowLength), 64) : 0;
+    if (values.size() <= capacity)
+        return;
+
+    std::vector<T> newValues(capacity);
+    std::vector<unsigned char> newValid(capacity, 0);
+    for (int f = windowStart; f < windowStart + windowLength; ++f)
+    {
+        size_t s = slot(f);
+        if (valid[s])
+        {
+            newValues[f - windowStart] = values[s];
+            newValid[f - windowStart] = 1;
+        }
+    }
+
+    values.swap(newValues);
+    valid.swap(newValid);
+    head = 0;
+}
+
+#endif
@@ -0,0 +1,55 @@
+//
+//  FrameLabelLayer.h
+//  MotionPath
+//
+//  Screen space layout of the frame and key number labels of every path for one view.
+//
+
+#ifndef FRAMELABELLAYER_H
+#define FRAMELABELLAYER_H
+
+#include <maya/MString.h>
+
+#include <map>
+#include <vector>
+
+// Labels are placed in draw order, a label whose rect overlaps one already placed is dropped.
+// Placed rects are kept in a uniform grid so each label only tests the few cells it covers.
+// The formatted number of a frame is built once and reused by every path and refresh.
+class FrameLabelLayer
+{
+    public:
+        FrameLabelLayer();
+
+        // forgets the labels placed in the previous draw of a view
+        void begin(const int width, const int height);
+
+        // reserves the rect of a label centred on x with its baseline on y
+        // false if it is outside the viewport or overlaps a label already placed
+        bool place(const double x, const double y, const double width, const double height);
+
+        const MString &text(const double frame);
+
+        // the font size used in Viewport 2.0 and the width estimated for a label drawn with it
+        static unsigned int fontPixelSize(const double sizeOffset);
+        static double textWidth(const MString &text, const unsigned int fontSize);
+
+    private:
+        struct Rect
+        {
+            double minX, minY, maxX, maxY;
+        };
+
+        int portWidth, portHeight;
+        int columns, rows;
+
+        std::vector<Rect> rects;
+        std::vector<std::vector<unsigned int> > cells;
+        std::vector<unsigned int> usedCells;
+
+        std::map<double, MString> texts;
+
+        void cellRange(const Rect &rect, int &minColumn, int &minRow, int &maxColumn, int &maxRow) const;
+};
+
+#endif
@@ -53,6 +53,16 @@ class GlobalSettings
         static bool alternatingFrames;
         static bool lockedModeInteractive;
         static bool usePivots;
+        static bool retainedGeometry;          // keep world space path vertices between VP2 refreshes
+        static double idleWarmBudget;          // milliseconds of cache warming per Maya idle event
+        static int cachePrefetchFrames;        // frames kept cached outside the display range, warmed in the scrub direction
+        static double pathPoolBudget;          // megabytes of caches kept for recently deselected paths
+        static double cacheMemoryBudget;       // megabytes of all path and camera caches together, 0 for no limit
+        static double pathLodTolerance;        // pixels a simplified path may deviate from the sampled one, 0 draws every sample
+        static bool declutterLabels;           // drop frame labels overlapping a label already drawn in the view
+        static bool frustumCulling;            // skip paths and path chunks outside the view before drawing them
+        static bool compiledHierarchy;         // compose parent matrices of plain keyed hierarchies without pulling the DG
+        static double maxRefreshRate;          // viewport refreshes per second requested by tools and callbacks, 0 for no limit
         static int strokeMode;
         static DrawMode motionPathDrawMode;
 
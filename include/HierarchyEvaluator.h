@@ -0,0 +1,82 @@
+//
+//  HierarchyEvaluator.h
+//  MotionPath
+//
+//  Parent matrix of an object composed from snapshots of its ancestors' channels, evaluated without the Maya API.
+//
+
+#ifndef HIERARCHYEVALUATOR_H
+#define HIERARCHYEVALUATOR_H
+
+#include "AnimCurveSnapshot.h"
+
+#include <maya/MObject.h>
+#include <maya/MPlug.h>
+#include <maya/MMatrix.h>
+#include <maya/MVector.h>
+#include <maya/MEulerRotation.h>
+
+#include <vector>
+
+// Every ancestor from the parent up to the world, with each channel that goes into its local matrix
+// copied as an AnimCurveSnapshot, plus the object's own rotate pivot and rotate pivot translate.
+// parentMatrix() touches no Maya object, so a whole window of frames can be composed across threads.
+// Only plain transforms and joints whose channels are unconnected or keyed directly are compiled; a
+// constraint, expression, driven key or any other input on an ancestor leaves the evaluator invalid,
+// and so does a composed matrix that does not match the parentMatrix plug at the check times.
+class HierarchyEvaluator
+{
+    public:
+        HierarchyEvaluator(): valid(false) {}
+
+        // checkTimes in ui units are compared with parentMatrixPlug pulled through the DG
+        bool capture(const MObject &object, const MPlug &parentMatrixPlug, const std::vector<double> &checkTimes);
+        void clear();
+
+        bool isValid() const {return valid;}
+        size_t memoryUsage() const;
+
+        // what getPMatrixAtTime returns, the pivots multiplied on the left when usePivots is set; thread safe
+        MMatrix parentMatrix(const double time, const bool usePivots) const;
+
+    private:
+        enum Channel
+        {
+            kTranslate = 0,
+            kRotate = 3,
+            kScale = 6,
+            kShear = 9,
+            kRotatePivot = 12,
+            kRotatePivotTranslate = 15,
+            kScalePivot = 18,
+            kScalePivotTranslate = 21,
+            kRotateAxis = 24,
+            kJointOrient = 27,
+            kInverseScale = 30,
+            kNumChannels = 33
+        };
+
+        struct Level
+        {
+            bool joint;
+            bool inheritsTransform;
+            bool compensateScale;           // joint segment scale compensate
+            bool inverseScaleFromParent;    // inverseScale connected to the scale of the next level, as joints are parented
+            bool hasOffsetParentMatrix;
+            MEulerRotation::RotationOrder rotateOrder;
+            MMatrix offsetParentMatrix;
+            std::vector<AnimCurveSnapshot> channels;
+
+            double value(const int channel, const int axis, const double time) const {return channels[channel + axis].evaluate(time);}
+            MVector vector(const int channel, const double time) const;
+        };
+
+        bool valid;
+        std::vector<Level> levels;              // levels[0] is the parent
+        AnimCurveSnapshot pivots[6];            // rotatePivot and rotatePivotTranslate of the object
+
+        bool captureLevel(const MObject &node, Level &level);
+        MMatrix localMatrix(const unsigned int index, const double time) const;
+};
+
+#endif
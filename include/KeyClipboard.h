@@ -29,13 +29,17 @@ public:
     // copy tangent info from curve for a specific key index and axis
     void copyKeyTangentStatus(MFnAnimCurve &curve, unsigned int keyId, const Keyframe::Axis axis);
 
-    // add a keyframe into three anim curves (x,y,z)
-    void addKeyFrame(MFnAnimCurve &cx, MFnAnimCurve &cy, MFnAnimCurve &cz,
-                     const MTime &time, const MVector &pos, const bool isBoundary, MAnimCurveChange *change);
+    bool hasKey(const Keyframe::Axis axis) const;
+    MFnAnimCurve::TangentType inTangentType(const Keyframe::Axis axis) const;
+    MFnAnimCurve::TangentType outTangentType(const Keyframe::Axis axis) const;
 
-    // set tangents for three anim curves (x,y,z)
+    // the world tangents of the key through the inverse parent matrix of a paste target, only reads the copy
+    void localTangents(const MMatrix &pMatrix, MVector &in, MVector &out, MVector &inWeighted, MVector &outWeighted) const;
+
+    // set tangents for three anim curves (x,y,z) from the local tangents of localTangents
     void setTangents(MFnAnimCurve &cx, MFnAnimCurve &cy, MFnAnimCurve &cz,
-                     const MMatrix &pMatrix, const MTime &time, const bool isBoundary,
+                     const MVector &in, const MVector &out, const MVector &inWeighted, const MVector &outWeighted,
+                     const MTime &time, const bool isBoundary,
                      const bool modifyInTangent, const bool modifyOutTangent,
                      const bool breakTangentsX, const bool breakTangentsY, const bool breakTangentsZ,
                      const bool xWasWeighted, const bool yWasWeighted, const bool zWasWeighted,
@@ -72,6 +76,15 @@ public:
     double wInX, wOutX, wInY, wOutY, wInZ, wOutZ;
 };
 
+// a clipboard key in the parent space of one paste target, see MotionPath::preparePaste
+struct PastedKey
+{
+    double time;
+    MVector position;
+    MVector in, out, inWeighted, outWeighted;
+    bool boundary;
+};
+
 class KeyClipboard
 {
 public:
@@ -74,7 +74,4 @@ public:
     bool selectedFromTool;
 };
 
-typedef std::map<double, Keyframe> KeyframeMap;
-typedef std::map<double, Keyframe>::iterator KeyframeMapIterator;
-
 #endif
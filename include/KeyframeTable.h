@@ -0,0 +1,94 @@
+//
+//  KeyframeTable.h
+//  MotionPath
+//
+//  The keys of a path in one time sorted table, looked up by time and by id.
+//
+
+#ifndef KEYFRAMETABLE_H
+#define KEYFRAMETABLE_H
+
+#include <maya/MVector.h>
+#include <maya/MDoubleArray.h>
+
+#include <vector>
+
+#include "Keyframe.h"
+
+// Parallel arrays in time order: the times the lookups binary search, the world positions the draw and
+// hit test loops read, and the Keyframe records with the key ids and tangents the edits need. The id of
+// a key is its index, so a lookup by id indexes the arrays directly.
+// The key selection is one bit per key. It is kept by time across a rebuild: clear() keeps the old times
+// and bits, and finalize() moves the bits over to the keys found again at the same times.
+class KeyframeTable
+{
+    public:
+        KeyframeTable(): building(false) {}
+
+        typedef std::vector<Keyframe>::iterator iterator;
+        typedef std::vector<Keyframe>::const_iterator const_iterator;
+
+        void clear();
+
+        size_t size() const {return keys.size();}
+        bool empty() const {return keys.empty();}
+
+        iterator begin() {return keys.begin();}
+        iterator end() {return keys.end();}
+        const_iterator begin() const {return keys.begin();}
+        const_iterator end() const {return keys.end();}
+
+        // the key at exactly time, end() when there is none
+        iterator find(const double time);
+        const_iterator find(const double time) const;
+        // -1 when there is no key at time
+        int indexOf(const double time) const;
+
+        Keyframe &at(const size_t index) {return keys[index];}
+        const Keyframe &at(const size_t index) const {return keys[index];}
+        // NULL when id is not a key of the table
+        Keyframe *findById(const int id);
+
+        // the key at time, inserted in time order when missing, used while the table is built.
+        // Inserting moves the keys after it, so a reference is only valid until the next insert
+        Keyframe &findOrInsert(const double time);
+
+        // packs the world positions once cacheKeyFrames computed them and carries the selection over
+        void finalize();
+
+        const std::vector<double> &getTimes() const {return times;}
+        const std::vector<MVector> &getWorldPositions() const {return worldPositions;}
+
+        // the selectedFromTool flag of the records follows the bits, it is what the key drawing reads
+        bool isSelected(const size_t index) const {return (selectedBits[index >> 6] >> (index & 63)) & 1;}
+        void select(const size_t index, const bool value);
+        // a time without a key stays pending until a rebuild finds a key there, or the selection is cleared
+        bool isTimeSelected(const double time) const;
+        void selectTime(const double time, const bool value);
+        void selectAll();
+        void invertSelection();
+        void deselectAll();
+
+        bool hasSelection() const;
+        // the first selected index from index on, size() when there is none
+        size_t nextSelected(const size_t index) const;
+        // selected times in time order, pending ones too
+        void getSelectedTimes(MDoubleArray &result) const;
+
+        size_t memoryUsage() const;
+
+    private:
+        std::vector<double> times;
+        std::vector<MVector> worldPositions;
+        std::vector<Keyframe> keys;
+
+        std::vector<unsigned long long> selectedBits;
+        std::vector<double> pendingTimes;
+
+        // selection of the table before clear(), until finalize() maps it to the new keys
+        bool building;
+        std::vector<double> staleTimes;
+        std::vector<unsigned long long> staleBits;
+};
+
+#endif
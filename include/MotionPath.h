@@ -19,6 +19,8 @@
 #include <maya/MFnDagNode.h>
 #include <maya/MFnMatrixData.h>
 #include <maya/MStringArray.h>
+#include <maya/MVectorArray.h>
+#include <maya/MDoubleArray.h>
 #include <maya/M3dView.h>
 #include <maya/MQuaternion.h>
 #include <maya/MDagMessage.h>
@@ -26,12 +28,22 @@
 #include <maya/MViewport2Renderer.h>
 
 #include <Keyframe.h>
+#include <KeyframeTable.h>
 #include <DrawUtils.h>
 #include <BufferPath.h>
 #include "KeyClipboard.h"
 #include "CameraCache.h"
+#include "FrameCache.h"
+#include "animCurveUtils.h"
+#include "PathGeometry.h"
+#include "PathLod.h"
+#include "PathBounds.h"
+#include "ScreenHitIndex.h"
+#include "AnimCurveSnapshot.h"
+#include "HierarchyEvaluator.h"
 
 #include <map>
+#include <chrono>
 
 class MotionPath
 {
@@ -41,20 +53,35 @@ class MotionPath
     
         MObject& object(){return thisObject;};
     
-        bool isCacheDone(){return this->cacheDone;};
         void setTimeRange(double startTime, double endTime);
         void setDisplayTimeRange(double start, double end);
-        void growParentAndPivotMatrixCache(double time, double expansion);
         void draw(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager = NULL, const MHWRender::MFrameContext* frameContext = NULL);
     
+        // draw() in three stages so the manager can build several paths at once:
+        // prepareDraw queries Maya on the main thread, buildDrawGeometry is pure math and thread safe per path,
+        // submitDraw hands the result to the draw manager on the main thread
+        bool prepareDraw(CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager = NULL);
+        void buildDrawGeometry();
+        // prepareDraw in two parts: the world space data once per refresh, shared by every panel it is drawn in,
+        // and what depends on the camera of the panel, false in camera space without a camera cache
+        void prepareWorldData();
+        bool prepareView(CameraCache* cachePtr);
+        // an edit or callback touched the world space data since prepareWorldData, so it has to run again
+        bool hasWorldChanges() const;
+        void submitDraw(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager = NULL, const MHWRender::MFrameContext* frameContext = NULL);
+    
         bool isConstrained(){return constrained;};
     
-        void selectKeyAtTime(const double time){selectedKeyTimes.insert(time);};
-        void deselectAllKeys(){selectedKeyTimes.clear();};
-        void deselectKeyAtTime(const double time){if (isKeyAtTimeSelected(time)) selectedKeyTimes.erase(time);};
-        void selectAllKeys();
-        void invertKeysSelection();
-        bool isKeyAtTimeSelected(const double time){return selectedKeyTimes.find(time)!=selectedKeyTimes.end();};
+        void selectKeyAtTime(const double time){keyframesCache.selectTime(time, true);};
+        void deselectAllKeys(){keyframesCache.deselectAll();};
+        void deselectKeyAtTime(const double time){keyframesCache.selectTime(time, false);};
+        void selectAllKeys(){keyframesCache.selectAll();};
+        void invertKeysSelection(){keyframesCache.invertSelection();};
+        bool isKeyAtTimeSelected(const double time){return keyframesCache.isTimeSelected(time);};
+        // ids as stored in the hit index, the index of the key in the table
+        void selectKeyWithId(const int id, const bool value){if (keyframesCache.findById(id)) keyframesCache.select(id, value);};
+        bool isKeyWithIdSelected(const int id){return keyframesCache.findById(id) && keyframesCache.isSelected(id);};
+        bool hasSelectedKeys() const {return keyframesCache.hasSelection();};
         MDoubleArray getSelectedKeys();
         MDoubleArray getKeys();
     
@@ -63,12 +90,7 @@ class MotionPath
     
         //void drawWorldSpace(M3dView &view, CameraCache* cachePtr, const bool selecting);
         //void drawCameraSpace(M3dView &view, CameraCache* cachePtr, const bool selecting);
-        void drawPath(M3dView &view, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, const bool selecting, MHWRender::MUIDrawManager* drawManager = NULL, const MHWRender::MFrameContext* frameContext = NULL);
-    
-        void drawCurvesForSelection(M3dView &view, CameraCache* cachePtr);
-        void drawTangentsForSelection(M3dView &view, CameraCache *cachePtr);
-        void drawKeysForSelection(M3dView &view, CameraCache* cachePtr);
-        void drawFramesForSelection(M3dView &view, CameraCache* cachePtr);
+        void drawPath(M3dView &view, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, MHWRender::MUIDrawManager* drawManager = NULL, const MHWRender::MFrameContext* frameContext = NULL);
     
         void getTangentHandleWorldPosition(const double keyTime, const Keyframe::Tangent &tangentName, MVector &tangentWorldPosition);
         void getKeyWorldPosition(const double keyTime, MVector &keyWorldPosition);
@@ -76,8 +98,17 @@ class MotionPath
         void deleteKeyFrameWithId(const int id, MAnimCurveChange *change);
         void addKeyFrameAtTime(const double time, MAnimCurveChange *change, MVector *position=NULL, bool useCache=true);
         void deleteKeyFrameAtTime(const double time, MAnimCurveChange *change, const bool useCache=true);
-    
-        void offsetWorldPosition(const MVector &offset, const double time, MAnimCurveChange *change);
+
+        // bulk versions for committed strokes: one function set and one addKeys per curve instead of one per key,
+        // the local positions come from the cached parent matrices. Existing keys at the times are overwritten
+        void addKeyFramesAtTimes(const MDoubleArray &times, const MVectorArray &worldPositions, MAnimCurveChange *change);
+        void deleteKeyFramesAtTimes(const MDoubleArray &times, MAnimCurveChange *change);
+    
+        // batched drag edit: moves every selected key by one world space offset (camera space when cachePtr is given)
+        // the keys are changed without undo records, commitKeyEdits records each of them once, from its value before the drag
+        // the commit is seen by animCurveEditedCallback once the edits are cleared, so the path is rebuilt once on release
+        void offsetSelectedKeys(const MVector &offset, CameraCache *cachePtr);
+        void commitKeyEdits(MAnimCurveChange *change);
         void setFrameWorldPosition(const MVector &position, const double time, MAnimCurveChange *change);
         void setTangentWorldPosition(const MVector &position, const double time, Keyframe::Tangent tangentId, const MMatrix &toWorldMatrix, MAnimCurveChange *change);
         void rotateTangentWorldPositionAroundAxis(const double angle, const MVector &axis, const double stretch, const double time, Keyframe::Tangent tangentId, MAnimCurveChange *change);
@@ -96,29 +127,78 @@ class MotionPath
     
         void clearParentMatrixCache();
         void cacheParentMatrixRange();
+        void cacheParentMatrixRange(double startFrame, double endFrame);
     
         void setIsDrawing(const bool value){isDrawing = value;};
         void setEndrawingTime(const double value){endDrawingTime = value;};
     
         BufferPath createBufferPath();
+        // hash of the translate curves, the frame range and the parent matrix at both ends, stored in path caches
+        uint64_t getSourceHash();
     
         static bool hasAnimationLayers(const MObject &object);
     
         void storeSelectedKeysInClipboard();
-        void pasteKeys(const double time, const bool offset);
+
+        // a paste onto this path, see MotionPathManager::pasteKeys
+        struct PasteTarget
+        {
+            double time;
+            bool offset;
+            MVector offsetPosition;     // world position of the path at time, where an offset paste starts
+            std::vector<PastedKey> keys;
+        };
+        // main thread: reads the DG and fills the parent matrix cache for every pasted key
+        void cachePasteMatrices(PasteTarget &target);
+        // only reads the caches and the clipboard, safe to run for many targets at once
+        void preparePaste(PasteTarget &target) const;
+        // writes the prepared keys one curve at a time into the undo recording started by the caller
+        void commitPaste(const PasteTarget &target);
     
         static MVector multPosByParentMatrix(const MVector &vec, const MMatrix &mat);
     
         static MMatrix getMatrixFromPlug(const MPlug &matrixPlug, const MTime &t);
+        static MMatrix getMatrixFromPlug(const MPlug &matrixPlug, const MDGContext &context);
+    
+        // manager frame sweep: one MDGContext per frame shared by every path and camera
+        bool beginFrameSweep(double &start, double &end);
+        void sweepFrame(const double time, const MDGContext &context);
+        void endFrameSweep(){positionsSwept = true;};
+    
+        // idle cache warming (see MotionPathManager::warmCaches), false if the frame was already cached or is out of range
+        bool warmFrame(const double time, const MDGContext &context);
+    
+        // curve edits invalidate the keyframe cache and the retained positions, driven by the manager's anim curve edited callback
+        void setKeyframesDirty(){keyframesDirty = true; positionsDirty = true;};
+        // a scoped curve edit: only the positions in [start, end] are sampled again, the rest of the path is reused
+        void invalidatePositions(const double start, const double end);
+        bool isEditingKeys() const {return !keyEdits.empty();}
+        bool usesAnimCurve(const MObject &curve);
     
         void addWorldMatrixCallback();
         void removeWorldMartrixCallback();
     
         bool getWorldSpaceCallbackCalled();
-        void setWorldSpaceCallbackCalled(const bool value, const MObject &tempAncestorNode);
+        // every call with true adds the ancestor to the ones changed since the last draw, false forgets them all
+        void setWorldSpaceCallbackCalled(const bool value, const MObject &ancestorNode);
+
+		KeyframeTable *keyFramesCachePtr() { return &keyframesCache; }
+
+		// approximate bytes held by the caches, used to bound the manager's pool of deselected paths
+		size_t cacheMemoryUsage() const;
 
-		KeyframeMap *keyFramesCachePtr() { return &keyframesCache; }
-		void getFramePositions(std::vector<std::pair<int, MVector>> &vec);
+		// cache budget (see MotionPathManager::enforceCacheBudget): the draw generation the path was last drawn in
+		// and how many frames the cached window is away from a time, 0 when the time is inside it
+		void setLastUsed(const unsigned int generation){lastUsedGeneration = generation;}
+		unsigned int getLastUsed() const {return lastUsedGeneration;}
+		double cacheDistance(const double time) const;
+		// gives back the storage the caches grew beyond their windows
+		void shrinkCaches();
+		// drops the frames prefetched on both sides of the display range
+		void trimCachesToDisplayRange();
+
+		// projects the keys, tangent handles and frames computed by the last draw into the hit index
+		void addHitTargets(ScreenHitIndex &hitIndex, const int pathId, M3dView &view, CameraCache *cachePtr, const MMatrix &currentCameraMatrix);
 
     private:
     
@@ -126,19 +206,18 @@ class MotionPath
         MPlug txPlug, tyPlug, tzPlug, rxPlug, ryPlug, rzPlug;
         double startTime, endTime;
         double displayStartTime, displayEndTime;
-        double startTimeCached, endTimeCached;
         double colorMultiplier;
         bool constrained;
         bool selectedFromTool;
         MPlug pMatrixPlug;
-        std::map<double, MMatrix> pMatrixCache;
-        bool cacheDone;
+        FrameCache<MMatrix> pMatrixCache;
         bool worldSpaceCallbackCalled;
-        KeyframeMap keyframesCache;
+        KeyframeTable keyframesCache;
     
         MCallbackId worldMatrixCallbackId;
     
-        MObject tempAncestorNode;
+        // ancestors moved since the last draw, several callbacks of one tick are handled by a single update
+        MObjectArray changedAncestors;
     
         std::map<double, MPoint> frameScreenSpacePositions;
     
@@ -148,15 +227,89 @@ class MotionPath
     
         bool isWeighted;
     
-        std::set<double> selectedKeyTimes;
-    
         bool isDrawing;
         double endDrawingTime;
     
+        // range of frames known to be in pMatrixCache
+        double cachedRangeStart, cachedRangeEnd;
+        bool pMatrixCacheValid;
+        unsigned int lastUsedGeneration;
+    
+        std::chrono::steady_clock::time_point lastInteractionTime;
+    
+        // local positions, kept between draws until one of the curves is edited
+        FrameCache<MVector> drawPositionCache;
+        bool positionsSwept;
+        bool positionsDirty;
+    
+        // world space vertices reused by VP2 while nothing they depend on changed
+        PathGeometry pathGeometry;
+        bool liveValuesDrawn;
+    
+        // decided by prepareDraw for the current refresh
+        MMatrix preparedCameraMatrix;
+        MColor drawColor;
+        double drawInterval;
+        bool retainedDraw;
+        void prepareDrawCaches();
+        void updateKeyframes(CameraCache* cachePtr, const MMatrix &currentCameraMatrix);
+    
+        // frustum culling of the view being drawn, world space only: visibleChunks follows the chunks of
+        // the retained geometry, or of drawBounds for paths drawn without it
+        ViewFrustum drawFrustum;
+        std::vector<unsigned char> visibleChunks;
+        bool chunksCulled;
+        bool pathCulled;
+        PathBounds drawBounds;
+        bool cullAgainstView(const PathBounds &bounds);
+        bool isRangeInView(const double fromTime, const double toTime) const;
+    
+        // state keyframesCache was built with, reused by draw() while nothing changed
+        bool keyframesDirty;
+        bool keyframesCachedWithRotation;
+        bool keyframesCachedWhileDrawing;
+        MObjectArray animCurveObjects;
+    
+        // copies of the translate curves, sampled across threads until one of them is edited
+        AnimCurveSnapshot snapshotX, snapshotY, snapshotZ;
+        bool snapshotsDirty;
+        bool snapshotsValid() const {return snapshotX.isValid() && snapshotY.isValid() && snapshotZ.isValid();}
+        void updateSnapshots();
+        void samplePositionsFromSnapshots(const double startTime, const double endTime);
+    
+        // ancestors compiled for the parent matrix, recaptured whenever the parent matrix cache is dropped
+        HierarchyEvaluator hierarchy;
+        bool hierarchyDirty;
+        bool hierarchyValid();
+        void cacheCompiledParentMatrices(const double startTime, const double endTime);
+    
+        // keys moved by the current batched edit with their values before it, keyed by time
+        struct KeyEdit
+        {
+            int keyId[3];
+            double originalValue[3];
+        };
+        std::map<double, KeyEdit> keyEdits;
+    
+        void cachePositionsForDraw(double startTime, double endTime);
+        MVector getCachedPos(double time);
+    
+        // unkeyed current values overlaid on the sampled positions
+        animCurveUtils::LiveValue liveX, liveY, liveZ;
+        void updateLiveValues();
+        MVector getLiveOffset(const double time) const;
+        bool shouldDrawDetails();
+    
         void ensureParentAndPivotMatrixAtTime(const double time);
+        // positions of the given frames in world space, or camera space when that draw mode is active
+        // samples the LOD simplification must keep: keys, labelled frames and, with alternating colors, whole frames
+        void getPinnedSamples(const std::vector<double> &times, std::vector<unsigned char> &pinned);
+        bool getDrawSpacePositions(const std::vector<double> &times, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, std::vector<MVector> &positions);
         MMatrix getPMatrixAtTime(const MTime &evalTime);
+        MMatrix getPMatrixAtTime(const MDGContext &context);
         MMatrix getPivotMatrix(const MTime &evalTime);
         MVector getVectorFromPlugs(const MTime &evalTime, const MPlug &x, const MPlug &y, const MPlug &z);
+        MVector getVectorFromPlugs(const MDGContext &context, const MPlug &x, const MPlug &y, const MPlug &z);
     
         bool isCurveTypeAnimatable(MFnAnimCurve::AnimCurveType type);
         bool isConstrained(const MFnDagNode &dagNodeFn);
@@ -200,7 +353,9 @@ class MotionPath
         void expandeBufferPathKeyFrames(MFnAnimCurve &curve, std::map<double, MVector> &keyFrames);
     
         static void worldMatrixChangedCallback(MObject& transformNode, MDagMessage::MatrixModifiedFlags& modified, void* data);
-        void cacheParentMatrixRangeForWorldCallback(MObject &transformNode);
+        void cacheParentMatrixRangeForWorldCallback(const MObjectArray &transformNodes);
+        void updateParentMatricesForAncestors();
+        bool applyStaticAncestorDelta();
 
 };
 
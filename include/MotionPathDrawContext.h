@@ -5,6 +5,7 @@
 
 #include "MotionPathManager.h"
 #include "MotionPath.h"
+#include "StrokeGeometry.h"
 
 #include <maya/MFn.h>
 #include <maya/MPxNode.h>
@@ -65,14 +66,10 @@ private:
 
     int getStrokeDirection(MVector directionalVector, const MDoubleArray &keys, const int selectedIndex);
     MVector getkeyScreenPosition(const double index);
-    MVector getClosestPointOnPolyLine(const MVector &q);
-    MVector getSpreadPointOnPolyLine(const int i, const int pointSize, const double strokeLenght, const std::vector<double> &segmentLenghts);
 
     // Preview drawing helpers
     void drawPreviewPath();
     void drawPreviewKeyframes();
-    MVector samplePointOnPath(double t, const MVectorArray &points, double totalLength);
-    double calculatePathLength(const MVectorArray &points);
     
     MotionPath* selectedMotionPathPtr;
     DrawMode currentMode;
@@ -80,6 +77,7 @@ private:
     MGlobal::ListAdjustment listAdjustment;
     
     MVectorArray strokePoints;
+    StrokeGeometry strokeGeometry;
     
     M3dView activeView;
     bool fsDrawn;
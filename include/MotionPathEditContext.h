@@ -6,6 +6,8 @@
 #include "MotionPathEditContextMenuWidget.h"
 #include "MotionPathManager.h"
 #include "MotionPath.h"
+#include "StrokeGeometry.h"
+#include "ScreenHitIndex.h"
 
 #include <maya/MFn.h>
 #include <maya/MPxNode.h>
@@ -19,6 +21,8 @@
 #include <maya/MMatrix.h>
 #include <maya/MDagPath.h>
 #include <maya/MAnimControl.h>
+#include <maya/MVectorArray.h>
+#include <maya/MDoubleArray.h>
 #include <maya/MUIDrawManager.h>
 #include <maya/MFrameContext.h>
 
@@ -42,6 +46,12 @@ class MotionPathEditContext: public MPxContext
 				kTangentEditMode = 2,
                 kShiftKeyMode = 3};
 
+        // with Caps Lock on the tool draws new keys (kDraw) or fits existing keys to a stroke (kStroke)
+        enum DrawMode{
+                kDrawNone = 0,
+                kDraw = 1,
+                kStroke = 2};
+
 		MotionPathEditContext();
 		~MotionPathEditContext();
 
@@ -66,6 +76,18 @@ class MotionPathEditContext: public MPxContext
         void doDragCommon(MEvent &event, const bool old);
         void doReleaseCommon(MEvent &event, const bool old);
 
+        bool isCapsLockOn() const;
+        bool handleDrawModePress(MEvent &event, const bool old);
+        bool handleDrawModeDrag(MEvent &event, const bool old);
+        bool handleDrawModeRelease(MEvent &event, const bool old);
+
+        static void initializeCircleVertices();
+        void drawPreviewPath();
+        void drawPreviewKeyframes();
+
+        MVector getkeyScreenPosition(const double time);
+        int getStrokeDirection(MVector directionalVector, const MDoubleArray &keys, const int selectedIndex);
+
 		MotionPath* selectedMotionPathPtr;
         EditMode currentMode;
     
@@ -90,10 +112,33 @@ class MotionPathEditContext: public MPxContext
     
         M3dView activeView;
         bool fsDrawn;
+
+        // screen points of a middle mouse drag on empty space, empty for a marquee
+        MVectorArray lassoPoints;
+        // keys in the marquee or lasso, kept between releases so a large region does not allocate again
+        std::vector<ScreenHitIndex::Target> regionHits;
     
         MMatrix inverseCameraMatrix;
     
         ContextMenuWidget*	ctxMenuWidget;
+
+        // Caps Lock is read once on press and kept for the whole drag
+        bool capsLockCached;
+        bool capsLockValid;
+
+        DrawMode drawMode;
+        MVectorArray drawStrokePoints;
+        StrokeGeometry strokeGeometry;
+        int drawSelectedKeyId;
+        double drawSelectedTime;
+        MVector drawKeyWorldPosition;
+        double drawMaxTime;
+        double drawSteppedTime;
+        clock_t drawInitialClock;
+
+        // unit circle of the preview key markers, shared by every context
+        static std::vector<MPoint> circleVertices;
+        static bool circleVerticesInitialized;
 };
 
 #endif
@@ -11,8 +11,12 @@
 
 #include "MotionPathEditContext.h"
 #include "MotionPath.h"
+#include "ScreenHitIndex.h"
+#include "FrameLabelLayer.h"
+#include "RefreshCoordinator.h"
 
 #include <time.h>
+#include <chrono>
 
 #include <maya/MGlobal.h>
 #include <maya/MUiMessage.h>
@@ -32,6 +36,7 @@
 #include <maya/MAnimControl.h>
 #include <maya/MStringArray.h>
 #include <maya/MObjectArray.h>
+#include <maya/MObjectHandle.h>
 #include <maya/MFnDagNode.h>
 #include <maya/MFnCamera.h>
 #include <maya/MCommandMessage.h>
@@ -42,6 +47,10 @@
 
 #include <vector>
 #include <map>
+#include <list>
+#include <set>
+#include <memory>
+#include <string>
 
 struct RegisteredPanel
 {
@@ -69,13 +78,19 @@ public:
     MStringArray getSelectionList();
     void refreshDisplayTimeRange();
     void setTimeRange(const double start, const double end);
-    bool expandParentMatrixAndPivotCache(const double currentTimeValue);
+    
+    // warms the path and camera caches around the current time on Maya idle events, a few milliseconds at a time
+    void scheduleCacheWarming(const double currentTimeValue);
+    void stopCacheWarming();
     MotionPath* getMotionPathPtr(const int id);
     int getMotionPathsCount(){return pathArray.size();};
-    void drawCurvesForSelection(M3dView &view, CameraCache *cachePtr);
 
     void addBufferPaths();
     void deleteAllBufferPaths();
+    
+    // buffer paths to and from a path cache file, loaded paths are appended
+    bool saveBufferPaths(const MString &fileName, MString &error);
+    bool loadBufferPaths(const MString &fileName, MString &error);
     void deleteBufferPathAtIndex(const int index);
     void setSelectStateForBufferPathAtIndex(const int index, const bool value);
     
@@ -83,7 +98,15 @@ public:
     MAnimCurveChange* getAnimCurveChangePtr(){return this->animCurveChangePtr;};
     void startDGUndoRecording();
     MDGModifier* getDGModifierPtr(){return this->dgModifierPtr;};
+    RefreshCoordinator* getRefreshCoordinatorPtr(){return &refreshCoordinator;};
     void stopDGAndAnimUndoRecording();
+    
+    // batched drag edit of the selected keys of every path, see MotionPath::offsetSelectedKeys
+    void offsetSelectedKeys(const MVector &offset, CameraCache *cachePtr);
+    void commitKeyEdits();
+
+    // pastes the clipboard onto every displayed path, prepared in parallel and written as one undo record
+    void pasteKeys(const double time, const bool offset);
 
     BufferPath* getBufferPathAtIndex(int index);
     int getBufferPathCount() const {return static_cast<int>(bufferPathArray.size());};
@@ -96,16 +119,43 @@ public:
     
     void clearParentMatrixCaches();
     
+    // drops the least recently deselected paths until the pool fits GlobalSettings::pathPoolBudget
+    void trimPathPool();
+    
+    // keeps the path, pool and camera caches within GlobalSettings::cacheMemoryBudget, the caches idle the
+    // longest and furthest from the current frame go first, the display range of the selected paths last
+    void enforceCacheBudget();
+    // one line for the total and one per path, pooled path, camera and buffer path, in bytes
+    void queryCacheMemory(MStringArray &result);
+    
     CameraCache *getCameraCachePtrFromView(M3dView &view);
     
+    // projected keys, tangents and frames of every path for the view, rebuilt at most once per draw
+    ScreenHitIndex *getHitIndex(M3dView &view);
+    
+    // frame labels placed so far in the view being drawn
+    FrameLabelLayer *getLabelLayerPtr() {return &labelLayer;};
+    
     void refreshCameraCallbackForPanel(const MString &panelName, MDagPath &camera);
     void createCameraCacheForCamera(const MDagPath &camera);
     
     void cacheCameras();
     
+    // evaluates every missing frame of all paths and cameras with a single MDGContext per frame
+    void sweepFrames();
+    
     void createMotionPathWorldCallback();
     void destroyMotionPathWorldCallback();
 
+    // the panels of one refresh share the world space data of the paths, computed for the first of them;
+    // the refresh ends on the next idle event, at a time or selection change, at a change the manager hears
+    // about or when a panel is drawn again. Call it for every panel before drawBufferPaths and drawPaths
+    void beginRefreshTick(const MString &panelName);
+    void invalidateRefreshTick(){tickOpen = false;};
+    // what beginRefreshTick runs for the first panel, without a panel; keysEdited rebuilds the keyframes and
+    // positions as after a curve edit. Also used by tcMotionPathCmd -prepareWorldData in batch mode
+    void prepareWorldData(const bool keysEdited = false);
+    
 	void drawBufferPaths(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager = NULL, const MHWRender::MFrameContext* frameContext = NULL);
 	void drawPaths(M3dView view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager = NULL, const MHWRender::MFrameContext* frameContext = NULL);
     
@@ -113,18 +163,72 @@ public:
     //void createCameraCachesAndCameraCallbacks();
     
 private:
-    bool cacheDone;
     MCallbackIdArray cbIDs;
     RegisteredPanelArray registeredPanels;
     MObjectArray selectionObjects;
-    std::vector<MotionPath> pathArray;
+    // paths are heap allocated so their world matrix callbacks keep a stable pointer and a reselected path keeps its caches
+    std::vector<std::unique_ptr<MotionPath> > pathArray;
+    
+    // recently deselected paths, most recently used first
+    struct PooledPath
+    {
+        MObjectHandle handle;
+        std::unique_ptr<MotionPath> path;
+    };
+    std::list<PooledPath> pathPool;
+    std::unique_ptr<MotionPath> takePooledPath(const MObject &object);
+    
+    // something enforceCacheBudget can give back, scored by refreshes since it was last drawn plus frames from the current one
+    struct EvictionCandidate
+    {
+        double score;
+        std::list<PooledPath>::iterator pooled;
+        CameraCache *camera;
+        MotionPath *path;
+        
+        bool operator<(const EvictionCandidate &other) const {return score > other.score;}
+    };
     std::vector<BufferPath> bufferPathArray;
     MAnimCurveChange* animCurveChangePtr;
     MDGModifier *dgModifierPtr;
     CameraCacheMap cameraCache;
+    RefreshCoordinator refreshCoordinator;
+    
+    unsigned int drawGeneration;
+    std::map<std::string, ScreenHitIndex> hitIndices;
+    FrameLabelLayer labelLayer;
     
     std::vector<MDoubleArray> previousKeySelection;
     
+    // idle cache warming state, frames are visited by distance from warmCenter, the scrub direction first
+    MCallbackId idleCallbackId;
+    bool warming;
+    double warmCenter;
+    double lastWarmTime;
+    int warmDirection;
+    int warmDistance;
+    bool warmCaches();
+    
+    // playback and scrub tracking: frames per time change, smoothed, and when the time last changed
+    double scrubStep;
+    double scrubTime;
+    std::chrono::steady_clock::time_point lastTimeChange;
+    unsigned int prefetchGeneration;
+    void trackScrub(const double time);
+    
+    // the refresh the world space data was prepared for, see beginRefreshTick
+    bool tickOpen;
+    double tickTime;
+    unsigned int tickGeneration;
+    std::set<std::string> tickPanels;
+    MCallbackId tickIdleCallbackId;
+    bool tickIdleCallbackSet;
+    void endRefreshTick();
+    static void tickIdleCallback(void *data);
+    // evaluates the frames the next time changes bring in at the leading edge of the display range, on the
+    // idle event that ends a refresh (tickIdleCallback), so the next draw only slides the cache windows over them
+    void prefetchLeadingEdge();
+    
     int isMObjectContained(const MObject &obj, const MObjectArray &a);
     
     void getDagPath(const MString &name, MDagPath &dp);
@@ -138,7 +242,9 @@ private:
     void setupViewport(const MString &panelName);
     
     static void timeChangeEvent(MTime &currentTime,  void* data);
+    static void idleCallback(void *data);
     static void commandEvent(const MString &message, MCommandMessage::MessageType messageType, void *data);
+    static void animCurveEditedCallback(MObjectArray &editedCurves, void *data);
     static void viewPostRenderCallback(const MString& panelName, void* data);
     static void viewDestroyCallback(const MString& panelName, void* data);
     static void autoKeyframeCallback(bool state, void* data);
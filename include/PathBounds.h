@@ -0,0 +1,82 @@
+//
+//  PathBounds.h
+//  MotionPath
+//
+//  Per chunk bounding boxes of a sampled path and the view frustum they are culled against.
+//
+
+#ifndef PATHBOUNDS_H
+#define PATHBOUNDS_H
+
+#include <maya/MPoint.h>
+#include <maya/MPointArray.h>
+#include <maya/MVector.h>
+#include <maya/MMatrix.h>
+
+#include <vector>
+
+// Axis aligned boxes of a sampled path, one per chunk of kChunkSize samples and one around all of them.
+// A chunk also holds the first sample of the next one, so the segment joining two chunks is inside both.
+// Only the chunks with a rewritten sample are measured again, culling a path costs a few box tests.
+class PathBounds
+{
+    public:
+        static const unsigned int kChunkSize = 64;
+
+        struct Box
+        {
+            Box(): valid(false) {}
+
+            MPoint min, max;
+            bool valid;
+
+            void expand(const MPoint &point);
+            void expand(const Box &box);
+        };
+
+        PathBounds(): numSamples(0), dirtyCount(0) {}
+
+        // every chunk dirty
+        void resize(const unsigned int samples);
+        void markDirty(const unsigned int sample);
+        void markAllDirty();
+        // measures the dirty chunks again
+        void update(const MPointArray &samples);
+        // every chunk from positions, for paths without retained geometry
+        void build(const std::vector<MVector> &positions);
+
+        unsigned int numChunks() const {return static_cast<unsigned int>(chunks.size());}
+        const Box &chunk(const unsigned int index) const {return chunks[index];}
+        const Box &bounds() const {return total;}
+        static unsigned int chunkOf(const unsigned int sample) {return sample / kChunkSize;}
+
+    private:
+        unsigned int numSamples;
+        std::vector<Box> chunks;
+        std::vector<unsigned char> chunkDirty;
+        unsigned int dirtyCount;
+        Box total;
+};
+
+// The six clip planes of a world to clip matrix, points are row vectors as in MPoint * MMatrix.
+// The near plane is taken as -w <= z, which also holds for the 0 <= z range of Direct3D, so nothing visible is culled.
+class ViewFrustum
+{
+    public:
+        ViewFrustum();
+
+        void set(const MMatrix &viewProjection);
+        bool isSet() const {return hasPlanes;}
+
+        bool intersects(const PathBounds::Box &box) const;
+        bool intersects(const MPoint &a, const MPoint &b) const;
+
+        // visible[i] for every chunk of bounds, false when no chunk is visible
+        bool cull(const PathBounds &bounds, std::vector<unsigned char> &visible) const;
+
+    private:
+        double planes[6][4];
+        bool hasPlanes;
+};
+
+#endif
@@ -0,0 +1,54 @@
+//
+//  PathCacheFile.h
+//  MotionPath
+//
+//  Binary file of buffer paths, so reference paths survive a scene reopen and can be shared.
+//
+
+#ifndef PATHCACHEFILE_H
+#define PATHCACHEFILE_H
+
+#include <maya/MString.h>
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+#include "BufferPath.h"
+
+// Layout, native byte order, every block starts on 8 bytes:
+//   FileHeader
+//   per path: PathHeader, name, frameCount * 3 floats, keyCount doubles, keyCount * 3 floats
+// Loading reads the blocks in order with buffered reads, the counts are checked against the file size before
+// anything is allocated and the key times have to be ascending and within the frames of their path.
+namespace pathCacheFile
+{
+    const uint32_t VERSION = 1;
+
+    struct FileHeader
+    {
+        char magic[8];              // "TCMPATH" and a terminating zero
+        uint32_t version;
+        uint32_t pathCount;
+    };
+
+    struct PathHeader
+    {
+        double minTime;
+        uint32_t frameCount;
+        uint32_t keyCount;
+        uint64_t sourceHash;        // hash of what the path was evaluated from, 0 if unknown
+        uint32_t nameLength;
+        uint32_t reserved;
+    };
+
+    // FNV-1a, seed with the previous result to hash several blocks
+    uint64_t hash(const void *data, const size_t size, const uint64_t seed = 14695981039346656037ULL);
+
+    bool write(const MString &fileName, const std::vector<BufferPath> &paths, MString &error);
+
+    // appends the paths of the file, nothing is appended if the file is not valid
+    bool read(const MString &fileName, std::vector<BufferPath> &paths, MString &error);
+}
+
+#endif
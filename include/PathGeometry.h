@@ -0,0 +1,123 @@
+//
+//  PathGeometry.h
+//  MotionPath
+//
+//  World space path vertices retained between viewport refreshes.
+//
+
+#ifndef PATHGEOMETRY_H
+#define PATHGEOMETRY_H
+
+#include <maya/MPointArray.h>
+#include <maya/MColorArray.h>
+#include <maya/MColor.h>
+#include <maya/MVector.h>
+#include <maya/MViewport2Renderer.h>
+
+#include <vector>
+#include <map>
+#include <string>
+
+#include "PathLod.h"
+#include "PathBounds.h"
+
+// Vertices of one path in world space, kept between refreshes.
+// They are submitted to the draw manager as 3D primitives, so the view transform happens on the GPU and
+// orbiting the camera never rebuilds them. Only the samples reported dirty by the caches are rewritten,
+// sliding the time window keeps every sample that is still inside it.
+class PathGeometry
+{
+    public:
+        PathGeometry();
+
+        // samples the path at start, start + interval, ... up to end
+        void setLayout(const double start, const double end, const double interval, const MColor &color, const bool alternating);
+
+        void markDirty(const double time);
+        void markAllDirty();
+        void markRangeDirty(const double rangeStart, const double rangeEnd);
+        bool needsUpdate() const {return dirtyCount > 0;}
+
+        unsigned int numSamples() const {return samples.length();}
+        double sampleTime(const unsigned int index) const {return start + index * interval;}
+        bool isSampleDirty(const unsigned int index) const {return sampleDirty[index] != 0;}
+        void setSample(const unsigned int index, const MVector &worldPosition);
+        void clearDirty();
+
+        // what a draw submits: one line list with a color per vertex and one point list, the retained arrays
+        // themselves or copies of the chunks in view. The VP2 draw manager and the legacy GL viewport
+        // (drawUtils::drawPackets) are both fed from them
+        struct Packets
+        {
+            Packets(): linePoints(NULL), lineColors(NULL), framePoints(NULL) {}
+
+            const MPointArray *linePoints;
+            const MColorArray *lineColors;
+            const MPointArray *framePoints;
+            MColor frameColor;
+
+            // storage of the copies when only part of the path is in view
+            MPointArray visibleLines, visibleFrames;
+            MColorArray visibleColors;
+        };
+
+        // visibleChunks, from ViewFrustum::cull over getBounds(), leaves out the chunks outside the view
+        void getPackets(const bool showPath, const std::vector<unsigned char> *visibleChunks, Packets &packets) const;
+        void draw(const bool showPath, const float lineWidth, const float pointSize, MHWRender::MUIDrawManager* drawManager, const std::vector<unsigned char> *visibleChunks = NULL) const;
+
+        // the line through only the samples pathLod::simplify keeps for the view, pinned[i] marks samples that
+        // must stay; every frame marker is kept, the frame spacing is what the path shows. The result is cached
+        // per view until its projection, the samples or the pinned ones change, views not drawn since the
+        // samples last changed are dropped
+        void getSimplifiedPackets(const std::string &viewName, const pathLod::ScreenProjection &projection, const double tolerance, const std::vector<unsigned char> &pinned,
+                                  const bool showPath, Packets &packets);
+        void drawSimplified(const std::string &viewName, const pathLod::ScreenProjection &projection, const double tolerance, const std::vector<unsigned char> &pinned,
+                            const bool showPath, const float lineWidth, const float pointSize, MHWRender::MUIDrawManager* drawManager);
+
+        // boxes of the samples, measured again by clearDirty for the chunks that were written
+        const PathBounds &getBounds() const {return bounds;}
+
+        // approximate bytes held by the vertex arrays
+        size_t memoryUsage() const;
+
+    private:
+        double start, end, interval;
+        MColor color;
+        bool alternating;
+        bool hasLayout;
+
+        std::vector<unsigned char> sampleDirty;
+        unsigned int dirtyCount;
+
+        MPointArray samples;
+        MPointArray framePoints;    // samples drawn as frame markers, the last one only if it lands on the end
+        MPointArray linePoints;     // one pair per segment
+        MColorArray lineColors;
+
+        // bumped whenever a sample, the layout or the colors change
+        unsigned int version;
+
+        PathBounds bounds;
+
+        struct SimplifiedView
+        {
+            SimplifiedView(): tolerance(-1.0), version(0) {}
+
+            pathLod::ScreenProjection projection;
+            double tolerance;
+            unsigned int version;
+            std::vector<unsigned char> pinned;
+            MPointArray linePoints;
+            MColorArray lineColors;
+        };
+        std::map<std::string, SimplifiedView> simplifiedViews;
+        void simplify(SimplifiedView &simplified) const;
+
+        static void submit(const Packets &packets, const float lineWidth, const float pointSize, MHWRender::MUIDrawManager* drawManager);
+
+        bool sampleIndex(const double time, unsigned int &index) const;
+        void writeSample(const unsigned int index, const MPoint &position);
+        void updateColors();
+};
+
+#endif
@@ -0,0 +1,42 @@
+//
+//  PathLod.h
+//  MotionPath
+//
+//  Screen space simplification of the sampled path polyline.
+//
+
+#ifndef PATHLOD_H
+#define PATHLOD_H
+
+#include <maya/MMatrix.h>
+#include <maya/MPoint.h>
+#include <maya/M3dView.h>
+#include <maya/MViewport2Renderer.h>
+
+#include <vector>
+
+namespace pathLod
+{
+	// world to pixel mapping of one view
+	struct ScreenProjection
+	{
+		ScreenProjection(): width(0), height(0) {}
+
+		MMatrix viewProjection;
+		int width, height;
+
+		// false for points behind the camera
+		bool project(const MPoint &point, double &x, double &y) const;
+		bool operator==(const ScreenProjection &other) const {return width == other.width && height == other.height && viewProjection == other.viewProjection;}
+	};
+
+	// from the frame context in Viewport 2.0, from the view matrices in the legacy viewport
+	bool getScreenProjection(M3dView &view, const MHWRender::MFrameContext* frameContext, ScreenProjection &projection);
+
+	// Douglas-Peucker in pixels over the projected points: on return keep[i] is set for every point the
+	// polyline needs to stay within tolerance pixels of the full one. Points already set in keep (keys, the current
+	// frame, labelled frames) and points that could not be projected are never dropped, the polyline is split at them.
+	void simplify(const std::vector<double> &x, const std::vector<double> &y, const std::vector<unsigned char> &visible, const double tolerance, std::vector<unsigned char> &keep);
+}
+
+#endif
@@ -0,0 +1,73 @@
+//
+//  PathStats.h
+//  MotionPath
+//
+//  Timers and counters of the caching and drawing hot paths, queried with tcMotionPathCmd -queryStats.
+//
+
+#ifndef PATHSTATS_H
+#define PATHSTATS_H
+
+#include <maya/MStringArray.h>
+
+#include <chrono>
+
+// Sections are timed from the main thread only, counters may be bumped from the parallel loops.
+// Everything measured between two RefreshScope ends is one refresh, every viewport draw is one.
+namespace pathStats
+{
+    enum Section
+    {
+        kAddUIDrawables = 0,
+        kDrawFrames,
+        kDrawFrameLabels,
+        kCacheParentMatrixRange,
+        kCachePositionsForDraw,
+        kCacheKeyFrames,
+        kCacheCamera,
+        kSweepFrames,               // the per frame DG sweep of every path and camera
+        kHitTest,
+        kPrefetchLeadingEdge,       // frames entering the display range next, evaluated after a refresh
+        kPrepareWorldData,          // the world space data of every path, once per refresh for all the panels
+        kNumSections
+    };
+
+    enum Counter
+    {
+        kPositionCacheHits = 0,
+        kPositionCacheMisses,
+        kPositionEvaluations,       // DG reads of the translate plugs while caching or sweeping a range
+        kParentMatrixCacheHits,
+        kParentMatrixCacheMisses,
+        kPrefetchedFrames,          // frames filled ahead of the playback or scrub by the prefetch
+        kSharedPanelDraws,          // panel draws that reused the world space data of the refresh
+        kNumCounters
+    };
+
+    class ScopedTimer
+    {
+        public:
+            ScopedTimer(const Section section);
+            ~ScopedTimer();
+
+        private:
+            Section section;
+            std::chrono::steady_clock::time_point start;
+    };
+
+    // closes the refresh when it goes out of scope, declare it before the timers of the draw
+    class RefreshScope
+    {
+        public:
+            RefreshScope() {}
+            ~RefreshScope();
+    };
+
+    void count(const Counter counter, const unsigned int amount = 1);
+
+    // one line per section and counter: total calls and time, the last refresh and the slowest refresh
+    void query(MStringArray &result);
+    void reset();
+}
+
+#endif
@@ -0,0 +1,45 @@
+//
+//  RefreshCoordinator.h
+//  MotionPath
+//
+//  Viewport refresh requests coalesced to the display rate.
+//
+
+#ifndef REFRESHCOORDINATOR_H
+#define REFRESHCOORDINATOR_H
+
+#include <maya/MMessage.h>
+
+#include <chrono>
+
+// Tools and callbacks ask for a refresh instead of calling M3dView::refresh or queueing MEL refresh commands.
+// Requests closer than one display frame (GlobalSettings::maxRefreshRate) are merged into a single refresh,
+// run on the first Maya idle event after the frame has passed.
+class RefreshCoordinator
+{
+    public:
+        RefreshCoordinator();
+        ~RefreshCoordinator();
+
+        // tool events: refreshes right away if the last refresh is at least a display frame old
+        void refresh(const bool allViews, const bool force);
+        // DG and message callbacks can't redraw from inside the callback, the refresh always waits for idle
+        void refreshOnIdle(const bool allViews, const bool force = false);
+
+        // drops a pending refresh
+        void cancel();
+
+    private:
+        std::chrono::steady_clock::time_point lastRefresh;
+        bool pending;
+        bool pendingAllViews;
+        bool pendingForce;
+        MCallbackId idleCallbackId;
+
+        bool frameElapsed() const;
+        void schedule(const bool allViews, const bool force);
+        void refreshNow(const bool allViews, const bool force);
+        static void idleCallback(void *data);
+};
+
+#endif
@@ -0,0 +1,81 @@
+//
+//  ScreenHitIndex.h
+//  MotionPath
+//
+//  Uniform screen space grid of the projected keys, tangent handles and frames used for picking.
+//
+
+#ifndef SCREENHITINDEX_H
+#define SCREENHITINDEX_H
+
+#include <maya/MMatrix.h>
+#include <maya/MVectorArray.h>
+
+#include <vector>
+
+// Projected pick targets of every path for one view.
+// The index is filled once after a draw from the positions the draw already computed, then each
+// click only looks at the 3x3 cells around the cursor instead of projecting every key and frame again.
+class ScreenHitIndex
+{
+    public:
+        enum TargetType
+        {
+            kKey = 0,
+            kInTangent,
+            kOutTangent,
+            kFrame,
+            kNumTargetTypes
+        };
+
+        struct Target
+        {
+            short x, y;
+            TargetType type;
+            int pathId;
+            int id;         // key id, unused for frames
+            double time;
+        };
+
+        ScreenHitIndex();
+
+        // true if the targets were built after the given draw for the same camera and viewport size
+        bool isValid(const unsigned int drawGeneration, const MMatrix &cameraMatrix, const int portWidth, const int portHeight) const;
+
+        void begin(const unsigned int drawGeneration, const MMatrix &cameraMatrix, const int portWidth, const int portHeight, const double maxRadius);
+        void add(const TargetType type, const int pathId, const int id, const double time, const short x, const short y);
+        void finalize();
+
+        // closest targets by time among the types in typeMask (1 << TargetType) within radius, pathId -1 matches every path
+        // latest picks the target with the highest time, otherwise the lowest (ties go to the lowest TargetType)
+        bool pick(const short mx, const short my, const unsigned int typeMask, const int pathId, const double radius, const bool latest, Target &result) const;
+
+        // lowest path id with any target under the cursor, radii are indexed by TargetType
+        int pickPath(const short mx, const short my, const double *radii) const;
+
+        // targets of the types in typeMask inside the rectangle, or inside the closed lasso (x and y of its points),
+        // appended to result. Only the cells under the region are visited, so a marquee costs the keys inside it
+        void collectInRect(const short x0, const short y0, const short x1, const short y1, const unsigned int typeMask, std::vector<Target> &result) const;
+        void collectInLasso(const MVectorArray &lasso, const unsigned int typeMask, std::vector<Target> &result) const;
+
+    private:
+        unsigned int drawGeneration;
+        MMatrix cameraMatrix;
+        int portWidth, portHeight;
+        bool built;
+
+        int cellSize;
+        int columns, rows;
+        std::vector<Target> targets;
+        std::vector<unsigned int> cellStart;    // targets of cell c are cellTargets[cellStart[c] .. cellStart[c + 1]]
+        std::vector<unsigned int> cellTargets;
+
+        bool cellOf(const short x, const short y, int &column, int &row) const;
+
+        template <typename Visitor>
+        void visitNeighbours(const short mx, const short my, Visitor &visitor) const;
+        template <typename Visitor>
+        void visitRect(const int minX, const int minY, const int maxX, const int maxY, Visitor &visitor) const;
+};
+
+#endif
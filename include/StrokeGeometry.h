@@ -0,0 +1,52 @@
+//
+//  StrokeGeometry.h
+//  MotionPath
+//
+//  Arc length and closest point queries on a screen space stroke, shared by the draw and edit contexts.
+//
+
+#ifndef STROKEGEOMETRY_H
+#define STROKEGEOMETRY_H
+
+#include <maya/MVector.h>
+#include <maya/MVectorArray.h>
+
+#include <vector>
+
+// A polyline in pixels, only x and y are used. set() builds a cumulative length table, so a point at a
+// given distance is a binary search, and a uniform grid of the segments, so the closest point only looks
+// at the segments in the cells around the query instead of the whole stroke.
+class StrokeGeometry
+{
+    public:
+        StrokeGeometry(): cellSize(1), columns(0), rows(0) {}
+
+        void set(const MVectorArray &strokePoints);
+        void clear();
+
+        unsigned int numPoints() const {return static_cast<unsigned int>(points.size());}
+        double length() const {return lengths.empty() ? 0 : lengths.back();}
+
+        // the point distance pixels along the stroke, clamped to its ends
+        MVector pointAtLength(const double distance) const;
+        // t from 0 at the first point to 1 at the last
+        MVector pointAtParameter(const double t) const {return pointAtLength(t * length());}
+        // key i of count spread at equal distances, the first key of the stroke is not part of count
+        MVector spreadPoint(const int i, const int count) const;
+
+        MVector closestPoint(const MVector &q) const;
+
+    private:
+        void closestOnSegment(const unsigned int segment, const MVector &q, double &bestDistance, unsigned int &bestSegment, double &bestT) const;
+
+        std::vector<MVector> points;
+        std::vector<double> lengths;            // lengths[i] is the distance along the stroke to points[i]
+
+        // segments by cell, a segment is listed in every cell its box touches
+        double minX, minY, cellSize;
+        int columns, rows;
+        std::vector<unsigned int> cellStart;    // columns * rows + 1 offsets into cellSegments
+        std::vector<unsigned int> cellSegments;
+};
+
+#endif
@@ -0,0 +1,36 @@
+//
+//  TransformKernel.h
+//  MotionPath
+//
+//  Batch transform of path samples into world or camera space.
+//
+
+#ifndef TRANSFORMKERNEL_H
+#define TRANSFORMKERNEL_H
+
+#include <maya/MMatrix.h>
+#include <maya/MVector.h>
+
+#include <vector>
+#include <cstddef>
+
+namespace transformKernel
+{
+	// sample positions stored as separate x, y, z arrays so the kernel reads them with contiguous loads
+	struct PositionArray
+	{
+		std::vector<double> x, y, z;
+
+		void reserve(const size_t count){x.reserve(count); y.reserve(count); z.reserve(count);}
+		void push_back(const MVector &p){x.push_back(p.x); y.push_back(p.y); z.push_back(p.z);}
+		size_t size() const {return x.size();}
+		void clear(){x.clear(); y.clear(); z.clear();}
+	};
+
+	// out[i] = positions[i] * *firstMatrices[i] * *secondMatrices[i] * *sharedMatrix
+	// secondMatrices and sharedMatrix can be NULL. Every matrix is treated as affine (the last column is ignored),
+	// which holds for the parent, pivot and camera matrices the paths are drawn with.
+	void transformPositions(const PositionArray &positions, const MMatrix *const *firstMatrices, const MMatrix *const *secondMatrices, const MMatrix *sharedMatrix, MVector *out);
+}
+
+#endif
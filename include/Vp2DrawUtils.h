@@ -9,8 +9,10 @@
 #include <maya/MViewport2Renderer.h>
 
 #include <set>
+#include <vector>
 
 #include <Keyframe.h>
+#include <KeyframeTable.h>
 #include <CameraCache.h>
 
 namespace VP2DrawUtils
@@ -25,11 +27,18 @@ namespace VP2DrawUtils
 
 	void drawPointWithColor(const MVector &point, float size, const MColor &color, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
 
-	void drawKeyFramePoints(KeyframeMap &keyframesCache, const float size, const double colorMultiplier, const int portWidth, const int portHeight, const bool showRotationKeyframes, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
+	// batched submission, one mesh2d call per path: segment i goes from points[i] to points[i + 1] and uses segmentColors[i]
+	void drawLineStrip(const std::vector<MVector> &points, const std::vector<MColor> &segmentColors, float lineWidth, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
+
+	// batched round points, one mesh2d call of screen space discs as wide as drawPoint draws them
+	void drawPointList(const std::vector<MVector> &points, float size, const MColor &color, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
+
+	void drawKeyFramePoints(KeyframeTable &keyframesCache, const float size, const double colorMultiplier, const int portWidth, const int portHeight, const bool showRotationKeyframes, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
 
 	void drawKeyFrames(std::vector<Keyframe *> keys, const float size, const double colorMultiplier, const int portWidth, const int portHeight, const bool showRotationKeyframes, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
 
 	void convertWorldSpaceToCameraSpace(CameraCache* cachePtr, std::map<double, MPoint> &positions, std::map<double, MPoint> &screenSpacePositions, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
 
-	void drawFrameLabel(double frame, const MVector &framePos, M3dView &view, const double sizeOffset, const MColor &color, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext);
+	// label already formatted and projected, viewY is its baseline
+	void drawFrameLabel(const MString &label, const double viewX, const double viewY, const double sizeOffset, const MColor &color, MHWRender::MUIDrawManager* drawManager);
 }
\ No newline at end of file
@@ -14,11 +14,32 @@
 
 namespace animCurveUtils
 {
+    // Unkeyed value sitting on an animated plug at the current time.
+    // Drawing overlays it on the curve instead of keying it temporarily: the offset is full at the
+    // current time and fades out linearly towards the neighbouring keys, so the scene graph is never written.
+    struct LiveValue
+    {
+        LiveValue(): active(false), time(0.0), offset(0.0), prevKeyTime(0.0), nextKeyTime(0.0), hasPrevKey(false), hasNextKey(false) {}
+        
+        bool active;
+        double time;
+        double offset;
+        double prevKeyTime, nextKeyTime;
+        bool hasPrevKey, hasNextKey;
+        
+        double offsetAtTime(const double t) const;
+    };
+    
+    bool getLiveValue(const MPlug &plug, const MTime &currentTime, LiveValue &live);
     
     void restoreCurve(MFnAnimCurve &curve, const MTime &currentTime, const double oldValue, const int newKeyId, const int oldKeyId);
     
     bool updateCurve(const MPlug &plug, MFnAnimCurve &curve, const MTime &currentTime, double &oldValue, double &newValue, int &newKeyId, int &oldKeyId);
     
+    // the transform and every ancestor up to the world have no keyed or driven transform attributes,
+    // so its world matrix is the same on every frame
+    bool isStaticUpToWorld(const MObject &transform);
+    
 }
 
 
@@ -0,0 +1,298 @@
+//
+//  AnimCurveSnapshot.cpp
+//  MotionPath
+//
+//  Plugin owned copy of the anim curve driving a plug, evaluated without the Maya API.
+//
+
+#include "AnimCurveSnapshot.h"
+
+#include <maya/MTime.h>
+#include <maya/MPlugArray.h>
+
+#include <cmath>
+#include <algorithm>
+
+#define SNAPSHOT_TOLERANCE 1e-4
+#define SNAPSHOT_MAX_CHECKS 64
+
+AnimCurveSnapshot::AnimCurveSnapshot()
+{
+    clear();
+}
+
+void AnimCurveSnapshot::clear()
+{
+    valid = false;
+    weighted = false;
+    staticPlug = false;
+    staticValue = 0.0;
+    preInfinity = MFnAnimCurve::kConstant;
+    postInfinity = MFnAnimCurve::kConstant;
+    keys.clear();
+}
+
+bool AnimCurveSnapshot::capture(const MPlug &plug)
+{
+    clear();
+
+    MPlugArray sources;
+    if (!plug.connectedTo(sources, true, false) || sources.length() == 0)
+    {
+        // nothing drives the plug, the value never changes over time
+        staticPlug = true;
+        staticValue = plug.asDouble();
+        valid = true;
+        return true;
+    }
+
+    // only a curve connected straight to the plug, blend nodes, unit conversions, layers or expressions are read from the plug
+    MObject curveNode = sources[0].node();
+    if (!curveNode.hasFn(MFn::kAnimCurve))
+        return false;
+
+    MStatus status;
+    MFnAnimCurve curve(curveNode, &status);
+    if (status != MS::kSuccess)
+        return false;
+
+    MFnAnimCurve::AnimCurveType type = curve.animCurveType();
+    if (type != MFnAnimCurve::kAnimCurveTL && type != MFnAnimCurve::kAnimCurveTA && type != MFnAnimCurve::kAnimCurveTU)
+        return false;
+
+    // driven keys or a retimed input
+    MPlug inputPlug = curve.findPlug("input", false);
+    if (!inputPlug.isNull() && inputPlug.isConnected())
+        return false;
+
+    unsigned int numKeys = curve.numKeys();
+    if (numKeys == 0)
+        return false;
+
+    weighted = curve.isWeighted();
+    preInfinity = curve.preInfinityType();
+    postInfinity = curve.postInfinityType();
+
+    // tangents come in seconds, keys are stored in ui units
+    double framesPerSecond = MTime(1.0, MTime::kSeconds).as(MTime::uiUnit());
+
+    keys.resize(numKeys);
+    for (unsigned int i = 0; i < numKeys; ++i)
+    {
+        Key &k = keys[i];
+        k.time = curve.time(i).as(MTime::uiUnit());
+        k.value = curve.value(i);
+
+        float x, y;
+        curve.getTangent(i, x, y, true);
+        k.inX = x * framesPerSecond;
+        k.inY = y;
+
+        curve.getTangent(i, x, y, false);
+        k.outX = x * framesPerSecond;
+        k.outY = y;
+
+        MFnAnimCurve::TangentType outType = curve.outTangentType(i);
+        k.outStep = outType == MFnAnimCurve::kTangentStep;
+        k.outStepNext = outType == MFnAnimCurve::kTangentStepNext;
+    }
+
+    valid = matchesCurve(curve);
+    if (!valid)
+        keys.clear();
+
+    return valid;
+}
+
+bool AnimCurveSnapshot::updateStaticValue(const MPlug &plug)
+{
+    double value = plug.asDouble();
+    if (value == staticValue)
+        return false;
+
+    staticValue = value;
+    return true;
+}
+
+bool AnimCurveSnapshot::matchesCurve(MFnAnimCurve &curve) const
+{
+    unsigned int numSegments = static_cast<unsigned int>(keys.size()) - 1;
+    unsigned int stride = std::max(1u, numSegments / SNAPSHOT_MAX_CHECKS);
+
+    std::vector<double> times;
+    for (unsigned int i = 0; i < numSegments; i += stride)
+    {
+        double t0 = keys[i].time;
+        double t1 = keys[i + 1].time;
+        times.push_back(t0 + (t1 - t0) * 0.25);
+        times.push_back(t0 + (t1 - t0) * 0.5);
+        times.push_back(t0 + (t1 - t0) * 0.75);
+    }
+
+    // both infinities, one and a half curve lengths away so cycles and oscillations get checked too
+    double range = std::max(1.0, keys.back().time - keys.front().time);
+    times.push_back(keys.front().time - range * 1.5);
+    times.push_back(keys.back().time + range * 1.5);
+
+    for (unsigned int i = 0; i < times.size(); ++i)
+    {
+        double expected;
+        if (curve.evaluate(MTime(times[i], MTime::uiUnit()), expected) != MS::kSuccess)
+            return false;
+
+        double difference = std::fabs(evaluate(times[i]) - expected);
+        if (difference > SNAPSHOT_TOLERANCE * std::max(1.0, std::fabs(expected)))
+            return false;
+    }
+
+    return true;
+}
+
+double AnimCurveSnapshot::inSlope(const unsigned int index) const
+{
+    const Key &k = keys[index];
+    return std::fabs(k.inX) > 1e-12 ? k.inY / k.inX : 0.0;
+}
+
+double AnimCurveSnapshot::outSlope(const unsigned int index) const
+{
+    const Key &k = keys[index];
+    return std::fabs(k.outX) > 1e-12 ? k.outY / k.outX : 0.0;
+}
+
+double AnimCurveSnapshot::evaluate(const double time) const
+{
+    if (staticPlug)
+        return staticValue;
+
+    const Key &first = keys.front();
+    const Key &last = keys.back();
+    if (keys.size() == 1 || (time >= first.time && time <= last.time))
+    {
+        if (keys.size() == 1)
+        {
+            if (time < first.time && preInfinity == MFnAnimCurve::kLinear)
+                return first.value + inSlope(0) * (time - first.time);
+            if (time > first.time && postInfinity == MFnAnimCurve::kLinear)
+                return first.value + outSlope(0) * (time - first.time);
+            return first.value;
+        }
+
+        return evaluateInRange(time);
+    }
+
+    bool before = time < first.time;
+    MFnAnimCurve::InfinityType infinity = before ? preInfinity : postInfinity;
+    double range = last.time - first.time;
+
+    switch (infinity)
+    {
+        case MFnAnimCurve::kLinear:
+            if (before)
+                return first.value + inSlope(0) * (time - first.time);
+            return last.value + outSlope(static_cast<unsigned int>(keys.size()) - 1) * (time - last.time);
+
+        case MFnAnimCurve::kCycle:
+        case MFnAnimCurve::kCycleRelative:
+        case MFnAnimCurve::kOscillate:
+        {
+            double cycles = std::floor((time - first.time) / range);
+            double local = time - first.time - cycles * range;
+
+            if (infinity == MFnAnimCurve::kOscillate)
+            {
+                if (std::fmod(std::fabs(cycles), 2.0) == 1.0)
+                    local = range - local;
+                return evaluateInRange(first.time + local);
+            }
+
+            double value = evaluateInRange(first.time + local);
+            if (infinity == MFnAnimCurve::kCycleRelative)
+                value += cycles * (last.value - first.value);
+            return value;
+        }
+
+        default:
+            return before ? first.value : last.value;
+    }
+}
+
+double AnimCurveSnapshot::evaluateInRange(const double time) const
+{
+    // last key at or before time
+    unsigned int lo = 0, hi = static_cast<unsigned int>(keys.size()) - 1;
+    if (time >= keys[hi].time)
+        return keys[hi].value;
+
+    while (hi - lo > 1)
+    {
+        unsigned int mid = (lo + hi) / 2;
+        if (keys[mid].time <= time)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return evaluateSegment(lo, time);
+}
+
+double AnimCurveSnapshot::evaluateSegment(const unsigned int index, const double time) const
+{
+    const Key &k0 = keys[index];
+    const Key &k1 = keys[index + 1];
+
+    if (k0.outStep)
+        return k0.value;
+    if (k0.outStepNext)
+        return k1.value;
+
+    double dt = k1.time - k0.time;
+    if (dt <= 0.0)
+        return k1.value;
+
+    if (!weighted)
+    {
+        // unweighted tangents only give a slope: cubic hermite
+        double s = (time - k0.time) / dt;
+        double s2 = s * s;
+        double s3 = s2 * s;
+        double h00 = 2 * s3 - 3 * s2 + 1;
+        double h10 = s3 - 2 * s2 + s;
+        double h01 = -2 * s3 + 3 * s2;
+        double h11 = s3 - s2;
+        return h00 * k0.value + h10 * dt * outSlope(index) + h01 * k1.value + h11 * dt * inSlope(index + 1);
+    }
+
+    // weighted tangents: bezier in (time, value) with the control points a third of the tangent away from the keys
+    double x1 = k0.outX / 3.0, y1 = k0.outY / 3.0;
+    double x2 = k1.inX / 3.0, y2 = k1.inY / 3.0;
+
+    // keep the curve a function of time
+    if (x1 > dt) {y1 *= dt / x1; x1 = dt;}
+    if (x2 > dt) {y2 *= dt / x2; x2 = dt;}
+    if (x1 < 0) x1 = 0;
+    if (x2 < 0) x2 = 0;
+
+    double px0 = k0.time, px1 = k0.time + x1, px2 = k1.time - x2, px3 = k1.time;
+    double py0 = k0.value, py1 = k0.value + y1, py2 = k1.value - y2, py3 = k1.value;
+
+    // x(s) is monotonic, solve x(s) = time with newton steps guarded by bisection
+    double lo = 0.0, hi = 1.0, s = (time - k0.time) / dt;
+    for (int iteration = 0; iteration < 32; ++iteration)
+    {
+        double u = 1.0 - s;
+        double x = u * u * u * px0 + 3 * u * u * s * px1 + 3 * u * s * s * px2 + s * s * s * px3;
+        double error = x - time;
+        if (std::fabs(error) < 1e-9)
+            break;
+
+        if (error > 0) hi = s; else lo = s;
+
+        double dx = 3 * u * u * (px1 - px0) + 6 * u * s * (px2 - px1) + 3 * s * s * (px3 - px2);
+        double next = std::fabs(dx) > 1e-12 ? s - error / dx : 0.5 * (lo + hi);
+        s = (next <= lo || next >= hi) ? 0.5 * (lo + hi) : next;
+    }
+
+    double u = 1.0 - s;
+    return u * u * u * py0 + 3 * u * u * s * py1 + 3 * u * s * s * py2 + s * s * s * py3;
+}
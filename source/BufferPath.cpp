@@ -10,76 +10,163 @@
 #include "GlobalSettings.h"
 #include "DrawUtils.h"
 #include "Vp2DrawUtils.h"
+#include "TransformKernel.h"
+#include "PathLod.h"
+
+#include <algorithm>
 
 BufferPath::BufferPath()
 {
     black = MColor(0,0,0);
     selected = false;
+    minTime = 0;
+    sourceHash = 0;
+    windowKeyBegin = 0;
+    windowKeyEnd = 0;
+}
+
+void BufferPath::setFrames(std::vector<float> &&positions)
+{
+    framePositions = std::move(positions);
+    geometry.markAllDirty();
+    rangeBounds.valid = false;
+}
+
+size_t BufferPath::memoryUsage() const
+{
+    return framePositions.capacity() * sizeof(float) + keyTimes.capacity() * sizeof(double) +
+           (keyPoints.length() + windowKeyPoints.length()) * sizeof(MPoint) + geometry.memoryUsage();
+}
+
+void BufferPath::setKeyFrames(std::vector<double> &&times, std::vector<float> &&positions)
+{
+    keyTimes = std::move(times);
+
+    keyPoints.setLength(static_cast<unsigned int>(keyTimes.size()));
+    for (unsigned int i = 0; i < keyPoints.length(); ++i)
+        keyPoints.set(i, positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+
+    windowKeyPoints.clear();
+    windowKeyBegin = 0;
+    windowKeyEnd = 0;
+    rangeBounds.valid = false;
+}
+
+const PathBounds::Box &BufferPath::getRangeBounds()
+{
+    if (rangeBounds.valid)
+        return rangeBounds;
+
+    for (int i = 0; i < getFrameCount(); ++i)
+        rangeBounds.expand(MPoint(getFrame(i)));
+    for (unsigned int i = 0; i < keyPoints.length(); ++i)
+        rangeBounds.expand(keyPoints[i]);
+    return rangeBounds;
 }
 
 void BufferPath::drawFrames(const double startTime, const double endTime, const MColor &curveColor, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, M3dView &view, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
-    int frameSize = frames.size();
+    int frameSize = getFrameCount();
 
-    if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
+    // buffer paths never change, in world space the retained vertices are only rewritten when the window moves
+    if (drawManager && GlobalSettings::retainedGeometry && GlobalSettings::motionPathDrawMode == GlobalSettings::kWorldSpace)
     {
-        if (!cachePtr) return;
-        cachePtr->ensureMatricesAtTime(startTime);
+        double first = std::max(startTime, minTime);
+        double last = std::min(endTime, minTime + frameSize - 1);
+        if (last <= first)
+            return;
+
+        geometry.setLayout(first, last, 1.0, curveColor, false);
+        if (geometry.needsUpdate())
+        {
+            for (unsigned int s = 0; s < geometry.numSamples(); ++s)
+            {
+                if (!geometry.isSampleDirty(s))
+                    continue;
+
+                geometry.setSample(s, getFrameAtTime(geometry.sampleTime(s)));
+            }
+            geometry.clearDirty();
+        }
+
+        // the chunks of the window outside the view are left out of the retained vertices
+        const std::vector<unsigned char> *visible = NULL;
+        if (drawFrustum.isSet())
+        {
+            if (!drawFrustum.cull(geometry.getBounds(), visibleChunks))
+                return;
+            visible = &visibleChunks;
+        }
+
+        geometry.draw(GlobalSettings::showPath, GlobalSettings::pathSize, GlobalSettings::frameSize, drawManager, visible);
+        return;
     }
 
-    // Performance optimization: Collect vertices for batch drawing
-    std::vector<MVector> lineVertices;
+    bool cameraSpace = GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace;
+    if (cameraSpace && !cachePtr)
+        return;
+
+    double first = std::max(startTime, minTime);
+    double last = std::min(endTime, minTime + frameSize - 1);
+    if (last <= first)
+        return;
+
+    // the frames are consecutive, so the point list is also the line strip of the path
     std::vector<MVector> pointVertices;
+    pointVertices.reserve(static_cast<size_t>(last - first) + 2);
 
-    if (GlobalSettings::showPath)
-        lineVertices.reserve(static_cast<size_t>((endTime - startTime + 1) * 2));
-    pointVertices.reserve(static_cast<size_t>(endTime - startTime + 2));
+    if (cameraSpace)
+    {
+        // batch transform: every camera matrix is cached before taking pointers into the cache
+        std::vector<double> times;
+        for (double t = first; t <= last; t += 1.0)
+        {
+            cachePtr->ensureMatricesAtTime(t);
+            times.push_back(t);
+        }
 
-	for(double i = startTime + 1; i <= endTime; i += 1.0)
-	{
-        if (i <= minTime || i >= minTime + frameSize)
-            continue;
+        transformKernel::PositionArray positions;
+        positions.reserve(times.size());
+        std::vector<const MMatrix*> cameraMatrices(times.size());
+        for (size_t i = 0; i < times.size(); ++i)
+        {
+            positions.push_back(getFrameAtTime(times[i]));
+            cameraMatrices[i] = &cachePtr->matrixCache.get(times[i]);
+        }
 
-        int index = static_cast<int>(i - minTime);
+        pointVertices.resize(times.size());
+        transformKernel::transformPositions(positions, &cameraMatrices[0], NULL, &currentCameraMatrix, &pointVertices[0]);
+    }
+    else
+    {
+        for (double t = first; t <= last; t += 1.0)
+            pointVertices.push_back(getFrameAtTime(t));
+    }
 
-        MVector pos1 = frames[index];
-        MVector pos2 = frames[index-1];
-        if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
+    // Performance optimization: Collect vertices for batch drawing
+    std::vector<MVector> lineVertices;
+    if (GlobalSettings::showPath && !drawManager)
+    {
+        // Batch lines for legacy OpenGL
+        lineVertices.reserve(pointVertices.size() * 2);
+        for (size_t i = 1; i < pointVertices.size(); ++i)
         {
-            cachePtr->ensureMatricesAtTime(i);
-            pos1 = MPoint(pos1) * cachePtr->matrixCache[i] * currentCameraMatrix;
-            pos2 = MPoint(pos2) * cachePtr->matrixCache[i-1] * currentCameraMatrix;
+            lineVertices.push_back(pointVertices[i - 1]);
+            lineVertices.push_back(pointVertices[i]);
         }
+    }
 
-		if (GlobalSettings::showPath)
-		{
-            // For VP2, still draw individually (VP2 has its own batching)
-			if (drawManager)
-				VP2DrawUtils::drawLineWithColor(pos1, pos2, GlobalSettings::pathSize, curveColor, currentCameraMatrix, drawManager, frameContext);
-			else
-            {
-                // Batch lines for legacy OpenGL
-                lineVertices.push_back(pos2);
-                lineVertices.push_back(pos1);
-            }
-		}
+    if (drawManager)
+    {
+        if (GlobalSettings::showPath && pointVertices.size() > 1)
+        {
+            std::vector<MColor> segmentColors(pointVertices.size() - 1, curveColor);
+            VP2DrawUtils::drawLineStrip(pointVertices, segmentColors, GlobalSettings::pathSize, currentCameraMatrix, drawManager, frameContext);
+        }
 
-		if (drawManager)
-			VP2DrawUtils::drawPointWithColor(pos2, GlobalSettings::frameSize, curveColor, currentCameraMatrix, drawManager, frameContext);
-		else
-            pointVertices.push_back(pos2);
-
-        if (i == endTime || i == minTime + frameSize - 1)
-		{
-			if (drawManager)
-				VP2DrawUtils::drawPointWithColor(pos1, GlobalSettings::frameSize, curveColor, currentCameraMatrix, drawManager, frameContext);
-			else
-                pointVertices.push_back(pos1);
-		}
-	}
-
-    // Batch draw for legacy OpenGL
-    if (!drawManager)
+        VP2DrawUtils::drawPointList(pointVertices, GlobalSettings::frameSize, curveColor, currentCameraMatrix, drawManager, frameContext);
+    }
+    else
     {
         if (GlobalSettings::showPath && !lineVertices.empty())
             drawUtils::drawLineArray(lineVertices, GlobalSettings::pathSize, curveColor);
@@ -91,25 +178,51 @@ void BufferPath::drawFrames(const double startTime, const double endTime, const
 
 void BufferPath::drawKeyFrames(const double startTime, const double endTime, const MColor &curveColor, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, M3dView &view, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
-    for(BPKeyframeIterator keyIt = keyFrames.begin(); keyIt != keyFrames.end(); ++keyIt)
+    size_t begin = std::lower_bound(keyTimes.begin(), keyTimes.end(), startTime) - keyTimes.begin();
+    size_t end = std::upper_bound(keyTimes.begin() + begin, keyTimes.end(), endTime) - keyTimes.begin();
+    if (begin == end)
+        return;
+
+    // in world space the key points go to the draw manager as they are, the GPU does the view transform
+    if (drawManager && GlobalSettings::retainedGeometry && GlobalSettings::motionPathDrawMode == GlobalSettings::kWorldSpace)
     {
-        double time = keyIt->first;
-        if (time >= startTime && time <= endTime)
+        if (begin != windowKeyBegin || end != windowKeyEnd)
         {
-            MVector pos = keyIt->second;
-            if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
-            {
-                if (!cachePtr) continue;
-                cachePtr->ensureMatricesAtTime(time);
-                pos = MPoint(pos) * cachePtr->matrixCache[time] * currentCameraMatrix;
-            }
-            
-			if (drawManager)
-				VP2DrawUtils::drawPointWithColor(pos, GlobalSettings::frameSize, curveColor, GlobalSettings::cameraMatrix, drawManager, frameContext);
-			else
-				drawUtils::drawPointWithColor(pos, GlobalSettings::frameSize * 1.5, curveColor);
+            windowKeyPoints.setLength(static_cast<unsigned int>(end - begin));
+            for (size_t i = begin; i < end; ++i)
+                windowKeyPoints[static_cast<unsigned int>(i - begin)] = keyPoints[static_cast<unsigned int>(i)];
+
+            windowKeyBegin = begin;
+            windowKeyEnd = end;
         }
+
+        drawManager->setColor(curveColor);
+        drawManager->setPointSize(GlobalSettings::frameSize);
+        drawManager->mesh(MHWRender::MUIDrawManager::kPoints, windowKeyPoints);
+        return;
     }
+
+    bool cameraSpace = GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace;
+    if (cameraSpace && !cachePtr)
+        return;
+
+    std::vector<MVector> points;
+    points.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i)
+    {
+        MPoint pos = keyPoints[static_cast<unsigned int>(i)];
+        if (cameraSpace)
+        {
+            cachePtr->ensureMatricesAtTime(keyTimes[i]);
+            pos = pos * cachePtr->matrixCache.get(keyTimes[i]) * currentCameraMatrix;
+        }
+        points.push_back(pos);
+    }
+
+    if (drawManager)
+        VP2DrawUtils::drawPointList(points, GlobalSettings::frameSize, curveColor, GlobalSettings::cameraMatrix, drawManager, frameContext);
+    else
+        drawUtils::drawPointArray(points, GlobalSettings::frameSize * 1.5, curveColor);
 }
 
 void BufferPath::draw(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
@@ -136,7 +249,19 @@ void BufferPath::draw(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawMa
         if (!cachePtr) return;
         double currentTime = MAnimControl::currentTime().as(MTime::uiUnit());
         cachePtr->ensureMatricesAtTime(currentTime);
-        currentCameraMatrix = cachePtr->matrixCache[currentTime].inverse();
+        currentCameraMatrix = cachePtr->matrixCache.get(currentTime).inverse();
+    }
+
+    // a buffer path outside the view is skipped whole, its stored range never moves
+    drawFrustum = ViewFrustum();
+    if (GlobalSettings::frustumCulling && GlobalSettings::motionPathDrawMode == GlobalSettings::kWorldSpace)
+    {
+        pathLod::ScreenProjection projection;
+        if (pathLod::getScreenProjection(view, frameContext, projection))
+            drawFrustum.set(projection.viewProjection);
+
+        if (drawFrustum.isSet() && !drawFrustum.intersects(getRangeBounds()))
+            return;
     }
     
     drawFrames(startTime, endTime, curveColor, cachePtr, GlobalSettings::cameraMatrix, view, drawManager, frameContext);
@@ -144,20 +269,20 @@ void BufferPath::draw(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawMa
         drawKeyFrames(startTime, endTime, curveColor, cachePtr, GlobalSettings::cameraMatrix, view, drawManager, frameContext);
     
     //draw current frame
-    if (currentTime >= minTime && currentTime <= minTime + frames.size())
+    if (currentTime >= minTime && currentTime <= minTime + getFrameCount())
     {
         MColor currentColor = GlobalSettings::currentFrameColor * 0.8;
         currentColor.a = 0.7;
         
 		int numFrame = static_cast<int>(currentTime) - static_cast<int>(minTime);
-		if (numFrame < 0 || numFrame > frames.size() - 1)
+		if (numFrame < 0 || numFrame > getFrameCount() - 1)
 			return;
 
-        MVector pos = frames[static_cast<int>(currentTime) - static_cast<int>(minTime)];
+        MVector pos = getFrame(numFrame);
         if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
         {
             cachePtr->ensureMatricesAtTime(currentTime);
-            pos = MPoint(pos) * cachePtr->matrixCache[currentTime] * currentCameraMatrix;
+            pos = MPoint(pos) * cachePtr->matrixCache.get(currentTime) * currentCameraMatrix;
         }
         
 		if (drawManager)
@@ -10,10 +10,16 @@
 #include <maya/MFnMatrixData.h>
 #include <maya/MGlobal.h>
 #include <maya/MDagPath.h>
+#include <maya/MFnTransform.h>
+#include <maya/MEulerRotation.h>
+#include <maya/MPlugArray.h>
+
+#include <cmath>
 
 #include "CameraCache.h"
 #include "GlobalSettings.h"
 #include "animCurveUtils.h"
+#include "PathStats.h"
 
 
 
@@ -21,6 +27,9 @@ CameraCache::CameraCache()
 {
     caching = false;
     initialized = false;
+    hasCompleteRange = false;
+    completeStart = completeEnd = 0;
+    lastUsedGeneration = 0;
 }
 
 void CameraCache::initialize(const MObject &camera)
@@ -32,6 +41,7 @@ void CameraCache::initialize(const MObject &camera)
 
     caching = false;
     initialized = true;
+    hasCompleteRange = false;
 
     MDagPath dagPath;
     MDagPath::getAPathTo(camera, dagPath);
@@ -45,18 +55,31 @@ void CameraCache::initialize(const MObject &camera)
     rxPlug = transformFn.findPlug("rotateX", false);
     ryPlug = transformFn.findPlug("rotateY", false);
     rzPlug = transformFn.findPlug("rotateZ", false);
+    
+    transformNode = dagPath.node();
+    MPlug parentMatrixPlugs = transformFn.findPlug("parentMatrix", false);
+    parentMatrixPlugs.evaluateNumElements();
+    parentMatrixPlug = parentMatrixPlugs[0];
 }
 
 
-void CameraCache::cacheCamera()
+void CameraCache::getWindow(double &start, double &end)
 {
     double currentFrame = MAnimControl::currentTime().as(MTime::uiUnit());
     
-    double startFrame = currentFrame - GlobalSettings::framesBack;
-    double endFrame = currentFrame + GlobalSettings::framesFront;
+    start = currentFrame - GlobalSettings::framesBack;
+    end = currentFrame + GlobalSettings::framesFront;
+    
+    if(start < GlobalSettings::startTime)	start = GlobalSettings::startTime;
+	if(end > GlobalSettings::endTime) 	end = GlobalSettings::endTime;
+}
+
+void CameraCache::cacheCamera()
+{
+    pathStats::ScopedTimer timer(pathStats::kCacheCamera);
     
-    if(startFrame < GlobalSettings::startTime)	startFrame = GlobalSettings::startTime;
-	if(endFrame > GlobalSettings::endTime) 	endFrame = GlobalSettings::endTime;
+    double startFrame, endFrame;
+    getWindow(startFrame, endFrame);
     
     if (worldMatrixPlug.isNull())
         return;
@@ -65,126 +88,234 @@ void CameraCache::cacheCamera()
     
     MTime currentTime = MAnimControl::currentTime();
     
-    MStatus xStatus, yStatus, zStatus, rotxStatus, rotyStatus, rotzStatus;
-    MFnAnimCurve curveX(txPlug, &xStatus);
-	MFnAnimCurve curveY(tyPlug, &yStatus);
-	MFnAnimCurve curveZ(tzPlug, &zStatus);
-    MFnAnimCurve curveRotX(rxPlug, &rotxStatus);
-	MFnAnimCurve curveRotY(ryPlug, &rotyStatus);
-	MFnAnimCurve curveRotZ(rzPlug, &rotzStatus);
-    
-    double newXValue, newYValue, newZValue, newRotXValue, newRotYValue, newRotZValue;
-    double oldXValue, oldYValue, oldZValue, oldRotXValue, oldRotYValue, oldRotZValue;
-    int newKeyX, newKeyY, newKeyZ, newKeyRotX, newKeyRotY, newKeyRotZ;
-    int oldKeyX, oldKeyY, oldKeyZ, oldKeyRotX, oldKeyRotY, oldKeyRotZ;
-	bool xUpdated = (xStatus == MS::kSuccess), yUpdated = (yStatus == MS::kSuccess), zUpdated = (zStatus == MS::kSuccess);
-	bool rotxUpdated = (rotxStatus == MS::kSuccess), rotyUpdated = (rotyStatus == MS::kSuccess), rotzUpdated = (rotzStatus == MS::kSuccess);
-    if (xStatus != MS::kNotFound)
-        xUpdated = animCurveUtils::updateCurve(txPlug, curveX, currentTime, oldXValue, newXValue, newKeyX, oldKeyX);
-    if (yStatus != MS::kNotFound)
-        yUpdated = animCurveUtils::updateCurve(tyPlug, curveY, currentTime, oldYValue, newYValue, newKeyY, oldKeyY);
-    if (zStatus != MS::kNotFound)
-        zUpdated = animCurveUtils::updateCurve(tzPlug, curveZ, currentTime, oldZValue, newZValue, newKeyZ, oldKeyZ);
-    if (rotxStatus != MS::kNotFound)
-        rotxUpdated = animCurveUtils::updateCurve(rxPlug, curveRotX, currentTime, oldRotXValue, newRotXValue, newKeyRotX, oldKeyRotX);
-    if (rotyStatus != MS::kNotFound)
-        rotyUpdated = animCurveUtils::updateCurve(ryPlug, curveRotY, currentTime, oldRotYValue, newRotYValue, newKeyRotY, oldKeyRotY);
-    if (rotzStatus != MS::kNotFound)
-        rotzUpdated = animCurveUtils::updateCurve(rzPlug, curveRotZ, currentTime, oldRotZValue, newRotZValue, newKeyRotZ, oldKeyRotZ);
+    //values the user moved the camera to without keying them are overlaid in memory
+    MPlug plugs[6] = {txPlug, tyPlug, tzPlug, rxPlug, ryPlug, rzPlug};
+    animCurveUtils::LiveValue live[6];
+    bool hasLiveValues = false;
+    for (int c = 0; c < 6; ++c)
+    {
+        if (animCurveUtils::getLiveValue(plugs[c], currentTime, live[c]))
+            hasLiveValues = true;
+    }
+    
+    MTransformationMatrix liveTransform;
+    if (hasLiveValues)
+        liveTransform = MFnTransform(transformNode).transformation();
     
     matrixCache.clear();
+    matrixCache.setWindow(startFrame, endFrame);
     
     for (double i = startFrame; i <= endFrame; ++i)
     {
         MTime evalTime(i, MTime::uiUnit());
         MDGContext context(evalTime);
         
+        if (hasLiveValues)
+        {
+            matrixCache.set(i, getLiveWorldMatrix(i, context, live, liveTransform).inverse());
+            continue;
+        }
+        
         MObject val;
         worldMatrixPlug.getValue(val, context);
-        matrixCache[i] = MFnMatrixData(val).matrix().inverse();
-    }
-    
-    //restoring the previous values if a keyframe was not actually set by the user
-    if (xUpdated && xStatus != MS::kNotFound)
-    {
-        animCurveUtils::restoreCurve(curveX, currentTime, oldXValue, newKeyX, oldKeyX);
-        txPlug.setValue(newXValue);
-    }
-    if (yUpdated && yStatus != MS::kNotFound)
-    {
-        animCurveUtils::restoreCurve(curveY, currentTime, oldYValue, newKeyY, oldKeyY);
-        tyPlug.setValue(newYValue);
-    }
-    if (zUpdated && zStatus != MS::kNotFound )
-    {
-        animCurveUtils::restoreCurve(curveZ, currentTime, oldZValue, newKeyZ, oldKeyZ);
-        tzPlug.setValue(newZValue);
-    }
-    
-    if (rotxUpdated && rotxStatus != MS::kNotFound)
-    {
-        animCurveUtils::restoreCurve(curveRotX, currentTime, oldRotXValue, newKeyRotX, oldKeyRotX);
-        rxPlug.setValue(newRotXValue);
-    }
-    if (rotyUpdated && rotyStatus != MS::kNotFound)
-    {
-        animCurveUtils::restoreCurve(curveRotY, currentTime, oldRotYValue, newKeyRotY, oldKeyRotY);
-        ryPlug.setValue(newRotYValue);
-    }
-    if (rotzUpdated && rotzStatus != MS::kNotFound )
-    {
-        animCurveUtils::restoreCurve(curveRotZ, currentTime, oldRotZValue, newKeyRotZ, oldKeyRotZ);
-        rzPlug.setValue(newRotZValue);
+        matrixCache.set(i, MFnMatrixData(val).matrix().inverse());
     }
     
+    hasCompleteRange = true;
+    completeStart = startFrame;
+    completeEnd = endFrame;
     caching = false;
 }
 
 void CameraCache::checkRangeIsCached()
 {
-    double currentFrame = MAnimControl::currentTime().as(MTime::uiUnit());
-    
-    double startFrame = currentFrame - GlobalSettings::framesBack;
-    double endFrame = currentFrame + GlobalSettings::framesFront;
-    
-    if(startFrame < GlobalSettings::startTime)	startFrame = GlobalSettings::startTime;
-	if(endFrame > GlobalSettings::endTime) 	endFrame = GlobalSettings::endTime;
+    double startFrame, endFrame;
+    getWindow(startFrame, endFrame);
     
     if (worldMatrixPlug.isNull())
         return;
     
+    if (hasCompleteRange && startFrame >= completeStart && endFrame <= completeEnd)
+        return;
+    
     caching = true;
 
+    // sliding the window keeps every frame we already have, only the new frames get evaluated
+    matrixCache.setWindow(startFrame - GlobalSettings::cachePrefetchFrames, endFrame + GlobalSettings::cachePrefetchFrames);
+
     for (double i = startFrame; i <= endFrame; ++i)
     {
-        if (matrixCache.find(i) == matrixCache.end())
+        if (hasCompleteRange && i >= completeStart && i <= completeEnd)
+        {
+            i = completeEnd;
+            continue;
+        }
+        
+        if (!matrixCache.contains(i))
         {
             MTime evalTime(i, MTime::uiUnit());
             MDGContext context(evalTime);
             
             MObject val;
             worldMatrixPlug.getValue(val, context);
-            matrixCache[i] = MFnMatrixData(val).matrix().inverse();
+            matrixCache.set(i, MFnMatrixData(val).matrix().inverse());
         }
     }
+    
+    hasCompleteRange = startFrame <= endFrame;
+    completeStart = startFrame;
+    completeEnd = endFrame;
     caching = false;
 }
 
+bool CameraCache::worldMatrixChanged()
+{
+    if (worldMatrixPlug.isNull())
+        return false;
+    
+    pathStats::ScopedTimer timer(pathStats::kCacheCamera);
+    
+    MObject val;
+    worldMatrixPlug.getValue(val);
+    MMatrix inverseMatrix = MFnMatrixData(val).matrix().inverse();
+    
+    // an animated camera reports a change on every time change, the matrices it already has are still right
+    double currentFrame = MAnimControl::currentTime().as(MTime::uiUnit());
+    const MMatrix *cached = matrixCache.find(currentFrame);
+    if (cached && cached->isEquivalent(inverseMatrix, 1e-9))
+    {
+        checkRangeIsCached();
+        return false;
+    }
+    
+    if (!animCurveUtils::isStaticUpToWorld(transformNode))
+    {
+        cacheCamera();
+        return true;
+    }
+    
+    // nothing drives the camera: the matrix just read is the one of every frame
+    double startFrame, endFrame;
+    getWindow(startFrame, endFrame);
+    
+    caching = true;
+    matrixCache.clear();
+    matrixCache.setWindow(startFrame, endFrame);
+    for (double i = startFrame; i <= endFrame; ++i)
+        matrixCache.set(i, inverseMatrix);
+    
+    hasCompleteRange = startFrame <= endFrame;
+    completeStart = startFrame;
+    completeEnd = endFrame;
+    caching = false;
+    return true;
+}
+
+bool CameraCache::beginFrameSweep(double &start, double &end)
+{
+    if (!initialized || worldMatrixPlug.isNull())
+        return false;
+    
+    double currentFrame = MAnimControl::currentTime().as(MTime::uiUnit());
+    if (currentFrame != std::floor(currentFrame))
+        return false;
+    
+    start = currentFrame - GlobalSettings::framesBack;
+    end = currentFrame + GlobalSettings::framesFront;
+    
+    if(start < GlobalSettings::startTime)	start = GlobalSettings::startTime;
+	if(end > GlobalSettings::endTime) 	end = GlobalSettings::endTime;
+    
+    if (start > end)
+        return false;
+    
+    caching = true;
+    matrixCache.setWindow(start - GlobalSettings::cachePrefetchFrames, end + GlobalSettings::cachePrefetchFrames);
+    return true;
+}
+
+void CameraCache::sweepFrame(const double time, const MDGContext &context)
+{
+    if (time < matrixCache.firstFrame() || time > matrixCache.lastFrame() || matrixCache.contains(time))
+        return;
+    
+    MObject val;
+    worldMatrixPlug.getValue(val, context);
+    matrixCache.set(time, MFnMatrixData(val).matrix().inverse());
+}
+
+bool CameraCache::warmFrame(const double time, const MDGContext &context)
+{
+    if (!initialized || worldMatrixPlug.isNull() || !matrixCache.hasWindow())
+        return false;
+    if (time < matrixCache.firstFrame() || time > matrixCache.lastFrame() || matrixCache.contains(time))
+        return false;
+    
+    MObject val;
+    worldMatrixPlug.getValue(val, context);
+    matrixCache.set(time, MFnMatrixData(val).matrix().inverse());
+    return true;
+}
+
+bool CameraCache::isDrivenByCurve(const MObject &curve)
+{
+    if (!initialized || transformNode.isNull())
+        return false;
+    
+    MPlug output = MFnDependencyNode(curve).findPlug("output", false);
+    MPlugArray destinations;
+    output.connectedTo(destinations, false, true);
+    
+    MDagPath dagPath;
+    MDagPath::getAPathTo(transformNode, dagPath);
+    for (unsigned int i = 0; i < destinations.length(); ++i)
+    {
+        MObject node = destinations[i].node();
+        for (MDagPath p = dagPath; p.length() > 0; p.pop())
+            if (p.node() == node)
+                return true;
+    }
+    return false;
+}
+
+void CameraCache::invalidate()
+{
+    matrixCache.clear();
+    matrixCache.shrinkToFit();
+    hasCompleteRange = false;
+}
+
+MMatrix CameraCache::getLiveWorldMatrix(const double time, const MDGContext &context, const animCurveUtils::LiveValue *live, const MTransformationMatrix &liveTransform)
+{
+    MPlug plugs[6] = {txPlug, tyPlug, tzPlug, rxPlug, ryPlug, rzPlug};
+    double values[6];
+    for (int c = 0; c < 6; ++c)
+        values[c] = plugs[c].asDouble(context) + live[c].offsetAtTime(time);
+    
+    //pivots, scale and rotate order come from the live transform, only translate and rotate are animated here
+    MTransformationMatrix local(liveTransform);
+    local.setTranslation(MVector(values[0], values[1], values[2]), MSpace::kTransform);
+    MEulerRotation::RotationOrder order = (MEulerRotation::RotationOrder) (local.rotationOrder() - MTransformationMatrix::kXYZ);
+    local.rotateTo(MEulerRotation(values[3], values[4], values[5], order));
+    
+    MObject val;
+    parentMatrixPlug.getValue(val, context);
+    return local.asMatrix() * MFnMatrixData(val).matrix();
+}
+
 void CameraCache::ensureMatricesAtTime(const double time, const bool force)
 {
-    if (matrixCache.find(time) == matrixCache.end() || force)
+    if (force || !matrixCache.contains(time))
     {        
         if (worldMatrixPlug.isNull())
             return;
         
-        std::string name = worldMatrixPlug.name().asChar();
-        
         MTime evalTime(time, MTime::uiUnit());
         
         MDGContext context(evalTime);
         
         MObject val;
         worldMatrixPlug.getValue(val, context);
-        matrixCache[time] = MFnMatrixData(val).matrix().inverse();
+        matrixCache.set(time, MFnMatrixData(val).matrix().inverse());
     }
 }
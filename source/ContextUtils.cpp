@@ -8,6 +8,7 @@
 
 #include "ContextUtils.h"
 #include "Keyframe.h"
+#include "PathStats.h"
 
 #include <maya/MPoint.h>
 #include <maya/MIntArray.h>
@@ -18,7 +19,7 @@ bool contextUtils::worldCameraSpaceToWorldSpace(MVector &position, M3dView &view
     if (!cachePtr)
         return false;
     cachePtr->ensureMatricesAtTime(time);
-    position = position * inverseCameraMatrix * cachePtr->matrixCache[time].inverse();
+    position = position * inverseCameraMatrix * cachePtr->matrixCache.get(time).inverse();
     return true;
 }
 
@@ -28,7 +29,7 @@ bool contextUtils::worldCameraSpaceToWorldSpace(MPoint &position, M3dView &view,
     if (!cachePtr)
         return false;
     cachePtr->ensureMatricesAtTime(time);
-    position = position * inverseCameraMatrix * cachePtr->matrixCache[time].inverse();
+    position = position * inverseCameraMatrix * cachePtr->matrixCache.get(time).inverse();
     return true;
 }
 
@@ -48,197 +49,83 @@ MVector contextUtils::getWorldPositionFromProjPoint(const MVector &pointToMove,
     return (endPoint - startPoint) + pointToMove;
 }
 
-int contextUtils::processCurveHits(M3dView &view, CameraCache *cachePtr, MotionPathManager &mpManager)
+namespace
 {
-    GLuint glSelectionBuffer[256];
-    view.beginSelect(glSelectionBuffer, 256);
-    view.initNames();
-    
-    mpManager.drawCurvesForSelection(view, cachePtr);
-    
-    GLint hits = view.endSelect();
-    if (hits == 0)  return -1;
-    
-	GLuint* ptr = (GLuint *) glSelectionBuffer;
-    ptr += (hits - 1) * 4 + 3;
-	return *ptr;
+    // pick radii in pixels, keys are drawn 1.5 times bigger than frames and tangent handles
+    double keyPickRadius(){return GlobalSettings::frameSize * 1.5 / 2;}
+    double framePickRadius(){return GlobalSettings::frameSize / 2;}
+
+    int getPathId(const MotionPath *motionPathPtr, MotionPathManager &mpManager)
+    {
+        for (int i = 0; i < mpManager.getMotionPathsCount(); ++i)
+            if (mpManager.getMotionPathPtr(i) == motionPathPtr)
+                return i;
+        return -1;
+    }
 }
 
 int contextUtils::processCurveHits(const short mx, const short my, const MMatrix &cameraMatrix, M3dView &view, CameraCache *cachePtr, MotionPathManager &mpManager)
 {
-	for (unsigned int i = 0; i < mpManager.getMotionPathsCount(); ++i)
-	{
-		MotionPath* mpPtr = mpManager.getMotionPathPtr(i);
-		if (!mpPtr)
-			continue;
-
-		std::vector<std::pair<int, MVector>> vec;
-		
-		MIntArray keys;
-		contextUtils::processKeyFrameHits(mx, my, mpPtr, view, cameraMatrix, cachePtr, keys);
-		if (keys.length() > 0)
-			return i;
-
-		int selectedKeyId, selectedTangent;
-		contextUtils::processTangentHits(mx, my, mpPtr, view, cameraMatrix, cachePtr, selectedKeyId, selectedTangent);
-		if (selectedTangent != -1)
-			return i;
-
-		double time;
-		if (contextUtils::processFramesHits(mx, my, mpPtr, view, cameraMatrix, cachePtr, time))
-			return i;
-	}
-	return -1;
+	pathStats::ScopedTimer timer(pathStats::kHitTest);
+
+	ScreenHitIndex *hitIndex = mpManager.getHitIndex(view);
+
+	double radii[ScreenHitIndex::kNumTargetTypes];
+	radii[ScreenHitIndex::kKey] = keyPickRadius();
+	radii[ScreenHitIndex::kInTangent] = framePickRadius();
+	radii[ScreenHitIndex::kOutTangent] = framePickRadius();
+	radii[ScreenHitIndex::kFrame] = framePickRadius();
+
+	return hitIndex->pickPath(mx, my, radii);
 }
 
-void contextUtils::processKeyFrameHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, MIntArray &selectedKeys)
+void contextUtils::processKeyFrameHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, MIntArray &selectedKeys, MotionPathManager &mpManager)
 {
-	KeyframeMap *km = motionPathPtr->keyFramesCachePtr();
-	int key = -1;
-
-	double kfs = GlobalSettings::frameSize * 1.5 / 2;
-	kfs = kfs * kfs;
-	for (KeyframeMapIterator it = km->begin(); it != km->end(); ++it)
-	{
-		Keyframe &k = it->second;
-		short x, y;
-		view.worldToView(k.worldPosition, x, y);
-
-		double distance = (mx - x) * (mx - x) + (my - y) * (my - y);
-		if (distance < kfs)
-			key = it->second.id;
-	}
-
-	if (key != -1)
-		selectedKeys.append(key);
+	pathStats::ScopedTimer timer(pathStats::kHitTest);
+
+	int pathId = getPathId(motionPathPtr, mpManager);
+	if (pathId == -1)
+		return;
+
+	// the last key in time under the cursor wins
+	ScreenHitIndex::Target target;
+	if (mpManager.getHitIndex(view)->pick(mx, my, 1u << ScreenHitIndex::kKey, pathId, keyPickRadius(), true, target))
+		selectedKeys.append(target.id);
 }
 
-void contextUtils::processTangentHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, int &selectedKeyId, int &selectedTangent)
+void contextUtils::processTangentHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, int &selectedKeyId, int &selectedTangent, MotionPathManager &mpManager)
 {
-	KeyframeMap *km = motionPathPtr->keyFramesCachePtr();
-
-	double tfs = GlobalSettings::frameSize / 2;
-	tfs = tfs * tfs;
+	pathStats::ScopedTimer timer(pathStats::kHitTest);
 
 	selectedTangent = -1;
 
-	for (KeyframeMapIterator it = km->begin(); it != km->end(); ++it)
-	{
-		Keyframe &k = it->second;
-		short x, y;
-		view.worldToView(k.inTangentWorldFromCurve, x, y);
-
-		double distance = (mx - x) * (mx - x) + (my - y) * (my - y);
-		if  (distance < tfs)
-		{
-			selectedKeyId = k.id;
-			selectedTangent = (int)Keyframe::kInTangent;
-			return;
-		}
-
-		view.worldToView(k.outTangentWorldFromCurve, x, y);
-		distance = (mx - x) * (mx - x) + (my - y) * (my - y);
-		if (distance < tfs)
-		{
-			selectedKeyId = k.id;
-			selectedTangent = (int)Keyframe::kOutTangent;
-			return;
-		}
-	}
-}
+	int pathId = getPathId(motionPathPtr, mpManager);
+	if (pathId == -1)
+		return;
 
-bool contextUtils::processFramesHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, double &time)
-{
-	double fs = GlobalSettings::frameSize / 2;
-	fs = fs * fs;
-
-	std::vector<std::pair<int, MVector>> vec;
-	motionPathPtr->getFramePositions(vec);
-	for (unsigned int i = 0; i < vec.size(); ++i)
-	{
-		MVector& pos = vec[i].second;
-
-		short x, y;
-		view.worldToView(MPoint(pos.x, pos.y, pos.z), x, y);
-
-		double distance = (mx - x) * (mx - x) + (my - y) * (my - y);
-		if (distance < fs)
-		{
-			time = vec[i].first;
-			return true;
-		}
-	}
-
-	return false;
-}
+	// the first key in time wins, its in tangent before its out tangent
+	ScreenHitIndex::Target target;
+	unsigned int typeMask = (1u << ScreenHitIndex::kInTangent) | (1u << ScreenHitIndex::kOutTangent);
+	if (!mpManager.getHitIndex(view)->pick(mx, my, typeMask, pathId, framePickRadius(), false, target))
+		return;
 
-void contextUtils::processTangentHits(MotionPath* motionPathPtr, M3dView &view, CameraCache *cachePtr, int &selectedKeyId, int &selectedTangent)
-{
-    GLuint glSelectionBuffer[256];
-    GLint hits;
-    
-    view.beginSelect(glSelectionBuffer, 256);
-    view.initNames();
-    motionPathPtr->drawTangentsForSelection(view, cachePtr);
-    
-    hits = view.endSelect();
-    
-    if (hits == 0)
-    {
-        selectedTangent = -1;
-        return;
-    }
-    
-	GLuint* ptr = (GLuint *) glSelectionBuffer;
-    ptr += (hits - 1) * 5 + 3;
-    selectedKeyId = *ptr;
-    ++ptr;
-    selectedTangent = *ptr;
+	selectedKeyId = target.id;
+	selectedTangent = target.type == ScreenHitIndex::kInTangent ? (int)Keyframe::kInTangent : (int)Keyframe::kOutTangent;
 }
 
-void contextUtils::processKeyFrameHits(MotionPath* motionPathPtr, M3dView &view, CameraCache *cachePtr, MIntArray &selectedKeys)
+bool contextUtils::processFramesHits(const short mx, const short my, MotionPath* motionPathPtr, M3dView &view, const MMatrix &cameraMatrix, CameraCache *cachePtr, double &time, MotionPathManager &mpManager)
 {
-    GLuint glSelectionBuffer[256];
-    GLint hits;
-    
-    view.beginSelect(glSelectionBuffer, 256);
-    view.initNames();
-    motionPathPtr->drawKeysForSelection(view, cachePtr);
-    hits = view.endSelect();
-    
-    if (hits == 0)
-        return;
-    
-    GLuint* ptr = (GLuint *) glSelectionBuffer;
-    ptr += (hits - 1) * 4 + 1;
-    GLuint minZ = *ptr;
-    ptr += 2;
-    selectedKeys.append(*ptr);
-    
-    for (int i = 0; i < hits - 1; ++i)
-    {
-        if (minZ == glSelectionBuffer[i * 4 + 1])
-            selectedKeys.append(glSelectionBuffer[i * 4 + 3]);
-    }
-}
+	pathStats::ScopedTimer timer(pathStats::kHitTest);
 
-bool contextUtils::processFramesHits(MotionPath* motionPathPtr, M3dView &view, CameraCache *cachePtr, double &time)
-{
-    GLuint glSelectionBuffer[256];
-    GLint hits;
-    
-    view.beginSelect(glSelectionBuffer, 256);
-    view.initNames();
-    motionPathPtr->drawFramesForSelection(view, cachePtr);
-    
-    hits = view.endSelect();
-    
-    if (hits == 0)
-        return false;
-    
-    GLuint* ptr = (GLuint *) glSelectionBuffer;
-    ptr += (hits - 1) * 4 + 3;
-    time = *ptr;
+	int pathId = getPathId(motionPathPtr, mpManager);
+	if (pathId == -1)
+		return false;
+
+	ScreenHitIndex::Target target;
+	if (!mpManager.getHitIndex(view)->pick(mx, my, 1u << ScreenHitIndex::kFrame, pathId, framePickRadius(), false, target))
+		return false;
+
+	time = target.time;
 	return true;
 }
 
@@ -307,6 +194,79 @@ void contextUtils::applySelection(short initialX, short initialY, short finalX,
     MGlobal::executeCommand(cmd, true, true);
 }
 
+void contextUtils::drawLassoGL(const MVectorArray &points, const unsigned int first)
+{
+    if (first + 1 >= points.length())
+        return;
+
+    glBegin( GL_LINE_STRIP );
+    for (unsigned int i = first; i < points.length(); ++i)
+        glVertex2i( static_cast<int>(points[i].x), static_cast<int>(points[i].y) );
+    glEnd();
+}
+
+void contextUtils::drawLasso(MHWRender::MUIDrawManager& drawMgr, const MVectorArray &points)
+{
+    if (points.length() < 2)
+        return;
+
+    drawMgr.beginDrawable();
+
+    // closed, the way the region is tested on release
+    for (unsigned int i = 1; i < points.length(); ++i)
+        drawMgr.line2d( MPoint(points[i - 1].x, points[i - 1].y), MPoint(points[i].x, points[i].y) );
+    unsigned int last = points.length() - 1;
+    drawMgr.line2d( MPoint(points[last].x, points[last].y), MPoint(points[0].x, points[0].y) );
+
+    drawMgr.endDrawable();
+}
+
+bool contextUtils::applyKeySelection(short initialX, short initialY, short finalX, short finalY, const MVectorArray &lasso, const MGlobal::ListAdjustment &listAdjustment, M3dView &view, MotionPathManager &mpManager, std::vector<ScreenHitIndex::Target> &hits)
+{
+    pathStats::ScopedTimer timer(pathStats::kHitTest);
+
+    hits.clear();
+    bool useLasso = lasso.length() >= 3;
+    if (!useLasso && abs(initialX - finalX) < 2 && abs(initialY - finalY) < 2)
+        return false;
+
+    ScreenHitIndex *hitIndex = mpManager.getHitIndex(view);
+    if (useLasso)
+        hitIndex->collectInLasso(lasso, 1u << ScreenHitIndex::kKey, hits);
+    else
+        hitIndex->collectInRect(initialX, initialY, finalX, finalY, 1u << ScreenHitIndex::kKey, hits);
+
+    if (hits.empty())
+        return false;
+
+    mpManager.storePreviousKeySelection();
+
+    if (listAdjustment == MGlobal::kReplaceList)
+    {
+        for (int i = 0; i < mpManager.getMotionPathsCount(); ++i)
+            mpManager.getMotionPathPtr(i)->deselectAllKeys();
+    }
+
+    // the key ids of the index are the indices of the key tables, every hit sets or clears one bit
+    for (size_t i = 0; i < hits.size(); ++i)
+    {
+        MotionPath *motionPathPtr = mpManager.getMotionPathPtr(hits[i].pathId);
+        if (!motionPathPtr)
+            continue;
+
+        bool value = true;
+        if (listAdjustment == MGlobal::kRemoveFromList)
+            value = false;
+        else if (listAdjustment == MGlobal::kXORWithList)
+            value = !motionPathPtr->isKeyWithIdSelected(hits[i].id);
+
+        motionPathPtr->selectKeyWithId(hits[i].id, value);
+    }
+
+    MGlobal::executeCommand("tcMotionPathCmd -keySelectionChanged", true, true);
+    return true;
+}
+
 void contextUtils::refreshSelectionMethod(MEvent &event, MGlobal::ListAdjustment &listAdjustment)
 {
     if (event.isModifierShift() || event.isModifierControl() ) {
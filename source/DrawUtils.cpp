@@ -8,6 +8,7 @@
 
 // 你的工程里需要包含这些实现所依赖的类定义（Keyframe, CameraCache, GlobalSettings）
 #include "Keyframe.h"
+#include "KeyframeTable.h"
 #include "CameraCache.h"
 #include "GlobalSettings.h"
 
@@ -15,6 +16,72 @@
 #define M_PI 3.14159265358979323846
 #endif
 
+namespace
+{
+    // 交给 GL 的数组用紧凑的 double/float，MPointArray 和 MColorArray 不保证内存布局
+    // 只在主线程绘制时使用，复用同一块内存
+    std::vector<double> vertexScratch;
+    std::vector<float> colorScratch;
+
+    void packVertices(const MPointArray &points)
+    {
+        vertexScratch.resize(3 * points.length());
+        for (unsigned int i = 0; i < points.length(); ++i)
+        {
+            const MPoint &p = points[i];
+            vertexScratch[3 * i] = p.x;
+            vertexScratch[3 * i + 1] = p.y;
+            vertexScratch[3 * i + 2] = p.z;
+        }
+    }
+
+    void packVertices(const std::vector<MVector> &vertices)
+    {
+        vertexScratch.resize(3 * vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            vertexScratch[3 * i] = vertices[i].x;
+            vertexScratch[3 * i + 1] = vertices[i].y;
+            vertexScratch[3 * i + 2] = vertices[i].z;
+        }
+    }
+
+    void packColors(const MColorArray &colors)
+    {
+        colorScratch.resize(4 * colors.length());
+        for (unsigned int i = 0; i < colors.length(); ++i)
+        {
+            const MColor &c = colors[i];
+            colorScratch[4 * i] = c.r;
+            colorScratch[4 * i + 1] = c.g;
+            colorScratch[4 * i + 2] = c.b;
+            colorScratch[4 * i + 3] = c.a;
+        }
+    }
+
+    // vertexScratch 里的顶点一次画完，withColors 时每个顶点带 colorScratch 里的颜色
+    void drawScratch(const GLenum mode, const bool withColors)
+    {
+        GLsizei count = static_cast<GLsizei>(vertexScratch.size() / 3);
+        if (count == 0)
+            return;
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_DOUBLE, 0, &vertexScratch[0]);
+        if (withColors)
+        {
+            glEnableClientState(GL_COLOR_ARRAY);
+            glColorPointer(4, GL_FLOAT, 0, &colorScratch[0]);
+        }
+
+        glDrawArrays(mode, 0, count);
+
+        if (withColors)
+            glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+}
+
 namespace drawUtils
 {
     // 矩阵向量乘法（column-major / OpenGL 风格兼容）
@@ -175,11 +242,8 @@ namespace drawUtils
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        glBegin(GL_LINE_STRIP);
-        for (size_t i = 0; i < vertices.size(); ++i) {
-            glVertex3d(vertices[i].x, vertices[i].y, vertices[i].z);
-        }
-        glEnd();
+        packVertices(vertices);
+        drawScratch(GL_LINE_STRIP, false);
     }
 
     void drawPointArray(const std::vector<MVector> &vertices, float size, const MColor &color)
@@ -192,11 +256,57 @@ namespace drawUtils
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glEnable(GL_POINT_SMOOTH);
 
-        glBegin(GL_POINTS);
-        for (size_t i = 0; i < vertices.size(); ++i) {
-            glVertex3d(vertices[i].x, vertices[i].y, vertices[i].z);
-        }
-        glEnd();
+        packVertices(vertices);
+        drawScratch(GL_POINTS, false);
+    }
+
+    void drawLineList(const MPointArray &lines, const MColorArray &colors, float lineWidth)
+    {
+        if (lines.length() < 2 || colors.length() != lines.length()) return;
+
+        glLineWidth(lineWidth);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        packVertices(lines);
+        packColors(colors);
+        drawScratch(GL_LINES, true);
+    }
+
+    void drawPointList(const MPointArray &points, const MColorArray &colors, float size)
+    {
+        if (points.length() == 0 || colors.length() != points.length()) return;
+
+        glPointSize(size);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_POINT_SMOOTH);
+
+        packVertices(points);
+        packColors(colors);
+        drawScratch(GL_POINTS, true);
+    }
+
+    void drawPointList(const MPointArray &points, float size, const MColor &color)
+    {
+        if (points.length() == 0) return;
+
+        glPointSize(size);
+        glColor4d(color.r, color.g, color.b, color.a);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_POINT_SMOOTH);
+
+        packVertices(points);
+        drawScratch(GL_POINTS, false);
+    }
+
+    void drawPackets(const PathGeometry::Packets &packets, float lineWidth, float pointSize)
+    {
+        if (packets.linePoints && packets.lineColors)
+            drawLineList(*packets.linePoints, *packets.lineColors, lineWidth);
+        if (packets.framePoints)
+            drawPointList(*packets.framePoints, pointSize, packets.frameColor);
     }
 
     void drawTriangleFan(const MVector &center, float radius, const std::vector<MColor> &sectorColors, int segments)
@@ -307,7 +417,23 @@ namespace drawUtils
         }
         glEnd();
 
-        // Second pass: Draw selected keyframes or colored triangles
+        // Second pass: gather the selected keyframes, the colored triangles and the rotation indicators,
+        // each drawn afterwards with a single vertex array
+        MPointArray triangles, selected, rotationLines;
+        MColorArray triangleColors, rotationColors;
+
+        // the sections before the first axis change keep the color set last, as glColor did before
+        MColor color(0.0, 0.0, 0.0, 1.0);
+
+        double lineWidth = size / 5.0;
+        if (lineWidth < 1.0) lineWidth = 1.0;
+        double unit = size * GlobalSettings::BLACK_BACKGROUND_FACTOR / 2.0;
+
+        float x1s[3] = {-unit * 0.8f, unit * 1.5f,  unit * -1.5f};
+        float y1s[3] = {unit * 1.2f,   unit * 0.1f,  unit * 0.1f};
+        float x2s[3] = {unit * 0.8f,   unit * 0.7f,  unit * -0.7f};
+        float y2s[3] = {unit * 1.2f,   unit * -1.2f, unit * -1.2f};
+
         for (size_t ki = 0; ki < keys.size(); ++ki)
         {
             Keyframe* key = keys[ki];
@@ -325,27 +451,8 @@ namespace drawUtils
 
             if (key->selectedFromTool)
             {
-                // Visual enhancement: Multi-layer selected keyframe
-                // Outer glow for better visibility
-                glPointSize(size * 1.4f);
-                glColor4d(1.0, 1.0, 0.0, 0.5); // Yellow glow
-                glBegin(GL_POINTS);
-                glVertex3d(key->projPosition.x, convertY, 0.0);
-                glEnd();
-
-                // Middle ring
-                glPointSize(size * 1.15f);
-                glColor4d(1.0, 0.8, 0.0, 0.8); // Orange ring
-                glBegin(GL_POINTS);
-                glVertex3d(key->projPosition.x, convertY, 0.0);
-                glEnd();
-
-                // Bright white center
-                glPointSize(size);
-                glColor4d(1.0, 1.0, 1.0, 1.0);
-                glBegin(GL_POINTS);
-                glVertex3d(key->projPosition.x, convertY, 0.0);
-                glEnd();
+                selected.append(MPoint(key->projPosition.x, convertY, 0.0));
+                color = MColor(1.0, 1.0, 1.0, 1.0);
             }
             else
             {
@@ -358,20 +465,18 @@ namespace drawUtils
                     combinedAxis = rAxis;
                 }
 
-                // Draw colored triangle fan
+                // Colored triangle fan
                 int nSections = 12;
                 int axisCount = static_cast<int>(combinedAxis.size());
                 if (axisCount < 1) axisCount = 1; // Safety: prevent division by zero
 
                 int step = nSections / axisCount;
                 int currentStep = 0;
-                MColor color;
                 double angleAdd = (2.0 * M_PI) / nSections;
                 double angle = -M_PI / 2.0;
                 float x = 0.0f;
                 float y = size / 2.0f;
 
-                glBegin(GL_TRIANGLES);
                 for (int i = 0; i <= nSections; ++i)
                 {
                     if ((i / step) > currentStep)
@@ -381,53 +486,49 @@ namespace drawUtils
                             currentStep = 0;
                         Keyframe::getColorForAxis(combinedAxis[currentStep], color);
                         color *= colorMultiplier;
-                        glColor4d(color.r, color.g, color.b, color.a);
                     }
 
-                    glVertex3d(key->projPosition.x, convertY, 0.0);
-                    glVertex3d(key->projPosition.x + x, convertY + y, 0.0);
+                    triangles.append(MPoint(key->projPosition.x, convertY, 0.0));
+                    triangles.append(MPoint(key->projPosition.x + x, convertY + y, 0.0));
 
                     angle += angleAdd;
                     x = size * 0.5f * static_cast<float>(sin(angle));
                     y = size * 0.5f * static_cast<float>(cos(angle));
-                    glVertex3d(key->projPosition.x + x, convertY + y, 0.0);
+                    triangles.append(MPoint(key->projPosition.x + x, convertY + y, 0.0));
+
+                    for (int v = 0; v < 3; ++v)
+                        triangleColors.append(color);
                 }
-                glEnd();
             }
 
-            // Draw rotation indicators if present
-            if (rAxis.size() > 0)
+            // Rotation indicators if present
+            for (size_t i = 0; i < rAxis.size(); ++i)
             {
-                double lineWidth = size / 5.0;
-                if (lineWidth < 1.0) lineWidth = 1.0;
-                double unit = size * GlobalSettings::BLACK_BACKGROUND_FACTOR / 2.0;
-
-                float x1s[3] = {-unit * 0.8f, unit * 1.5f,  unit * -1.5f};
-                float y1s[3] = {unit * 1.2f,   unit * 0.1f,  unit * 0.1f};
-                float x2s[3] = {unit * 0.8f,   unit * 0.7f,  unit * -0.7f};
-                float y2s[3] = {unit * 1.2f,   unit * -1.2f, unit * -1.2f};
-
-                glLineWidth((float)lineWidth);
-                glBegin(GL_LINES);
-                for (size_t i = 0; i < rAxis.size(); ++i)
-                {
-                    MColor axisColor;
-                    Keyframe::getColorForAxis(rAxis[i], axisColor);
-                    axisColor *= colorMultiplier;
-                    glColor4d(axisColor.r, axisColor.g, axisColor.b, axisColor.a);
-
-                    float p1x = key->projPosition.x + x1s[i];
-                    float p1y = convertY + y1s[i];
-                    float p2x = key->projPosition.x + x2s[i];
-                    float p2y = convertY + y2s[i];
-
-                    glVertex3d(p1x, p1y, 0.0);
-                    glVertex3d(p2x, p2y, 0.0);
-                }
-                glEnd();
+                Keyframe::getColorForAxis(rAxis[i], color);
+                color *= colorMultiplier;
+
+                rotationLines.append(MPoint(key->projPosition.x + x1s[i], convertY + y1s[i], 0.0));
+                rotationLines.append(MPoint(key->projPosition.x + x2s[i], convertY + y2s[i], 0.0));
+                rotationColors.append(color);
+                rotationColors.append(color);
             }
         }
 
+        if (triangles.length() > 0)
+        {
+            packVertices(triangles);
+            packColors(triangleColors);
+            drawScratch(GL_TRIANGLES, true);
+        }
+
+        // Visual enhancement: Multi-layer selected keyframe
+        // Outer glow for better visibility, middle ring and bright white center
+        drawPointList(selected, size * 1.4f, MColor(1.0, 1.0, 0.0, 0.5));
+        drawPointList(selected, size * 1.15f, MColor(1.0, 0.8, 0.0, 0.8));
+        drawPointList(selected, size, MColor(1.0, 1.0, 1.0, 1.0));
+
+        drawLineList(rotationLines, rotationColors, (float)lineWidth);
+
             restore3DProjection();
         }
         catch (...)
@@ -442,7 +543,7 @@ namespace drawUtils
         glPopMatrix();
     }
 
-    void drawKeyFramePoints(KeyframeMap &keyframesCache,
+    void drawKeyFramePoints(KeyframeTable &keyframesCache,
                             const float size,
                             const double colorMultiplier,
                             const int portWidth,
@@ -465,14 +566,14 @@ namespace drawUtils
         std::vector<Keyframe*> keys;
         keys.reserve(keyframesCache.size());
 
-        for (KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); ++keyIt)
+        const std::vector<MVector> &worldPositions = keyframesCache.getWorldPositions();
+        for (size_t k = 0; k < worldPositions.size(); ++k)
         {
-            Keyframe* key = &keyIt->second;
-            if (!key) continue;
+            Keyframe* key = &keyframesCache.at(k);
 
-            projectPoint(key->worldPosition.x,
-                         key->worldPosition.y,
-                         key->worldPosition.z,
+            projectPoint(worldPositions[k].x,
+                         worldPositions[k].y,
+                         worldPositions[k].z,
                          modelMatrix, projMatrix, viewport,
                          &key->projPosition.x,
                          &key->projPosition.y,
@@ -516,7 +617,7 @@ namespace drawUtils
         }
     }
 
-    void drawFrameLabel(double frame, const MVector &framePos, M3dView &view, const double sizeOffset, const MColor &color, const MMatrix &refMatrix)
+    void drawFrameLabel(const MString &label, const MVector &framePos, M3dView &view, const double sizeOffset, const MColor &color, const MMatrix &refMatrix)
     {
         // 使用 view.worldToView & view.viewToWorld 保持原有语义（frame 标签位置计算）
         glColor4d(color.r, color.g, color.b, color.a);
@@ -536,9 +637,6 @@ namespace drawUtils
         point1 += vec1;
         double up = (framePos - point1).length();
 
-        MString frameStr;
-        frameStr = frame;
-
         MPoint textPos = framePos + (cameraUp * up);
 
         // Use OpenGL matrix scaling to achieve real text size control
@@ -558,7 +656,7 @@ namespace drawUtils
         // Translate back to origin for drawText
         glTranslated(-textPos.x, -textPos.y, -textPos.z);
 
-        view.drawText(frameStr, textPos, M3dView::kCenter);
+        view.drawText(label, textPos, M3dView::kCenter);
 
         // Restore the matrix
         glPopMatrix();
@@ -0,0 +1,135 @@
+//
+//  FrameLabelLayer.cpp
+//  MotionPath
+//
+//  Screen space layout of the frame and key number labels of every path for one view.
+//
+
+#include "FrameLabelLayer.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    // about two labels of the default size per cell
+    const int LABEL_CELL_SIZE = 32;
+
+    // the formatted numbers of the scrubbed ranges stay small, this only bounds pathological ranges
+    const size_t MAX_CACHED_TEXTS = 8192;
+}
+
+FrameLabelLayer::FrameLabelLayer()
+{
+    portWidth = 0;
+    portHeight = 0;
+    columns = 0;
+    rows = 0;
+}
+
+void FrameLabelLayer::begin(const int width, const int height)
+{
+    int newColumns = std::max(0, width) / LABEL_CELL_SIZE + 1;
+    int newRows = std::max(0, height) / LABEL_CELL_SIZE + 1;
+
+    if (newColumns != columns || newRows != rows)
+    {
+        columns = newColumns;
+        rows = newRows;
+        cells.assign(columns * rows, std::vector<unsigned int>());
+    }
+    else
+    {
+        // only the cells touched by the previous draw hold anything
+        for (size_t i = 0; i < usedCells.size(); ++i)
+            cells[usedCells[i]].clear();
+    }
+
+    portWidth = width;
+    portHeight = height;
+    rects.clear();
+    usedCells.clear();
+}
+
+void FrameLabelLayer::cellRange(const Rect &rect, int &minColumn, int &minRow, int &maxColumn, int &maxRow) const
+{
+    minColumn = std::max(0, static_cast<int>(std::floor(rect.minX / LABEL_CELL_SIZE)));
+    minRow = std::max(0, static_cast<int>(std::floor(rect.minY / LABEL_CELL_SIZE)));
+    maxColumn = std::min(columns - 1, static_cast<int>(std::floor(rect.maxX / LABEL_CELL_SIZE)));
+    maxRow = std::min(rows - 1, static_cast<int>(std::floor(rect.maxY / LABEL_CELL_SIZE)));
+}
+
+bool FrameLabelLayer::place(const double x, const double y, const double width, const double height)
+{
+    Rect rect;
+    rect.minX = x - width / 2;
+    rect.maxX = x + width / 2;
+    rect.minY = y;
+    rect.maxY = y + height;
+
+    if (rect.maxX < 0 || rect.maxY < 0 || rect.minX > portWidth || rect.minY > portHeight)
+        return false;
+
+    int minColumn, minRow, maxColumn, maxRow;
+    cellRange(rect, minColumn, minRow, maxColumn, maxRow);
+
+    for (int row = minRow; row <= maxRow; ++row)
+    {
+        for (int column = minColumn; column <= maxColumn; ++column)
+        {
+            const std::vector<unsigned int> &cell = cells[row * columns + column];
+            for (size_t i = 0; i < cell.size(); ++i)
+            {
+                const Rect &other = rects[cell[i]];
+                if (rect.minX < other.maxX && other.minX < rect.maxX && rect.minY < other.maxY && other.minY < rect.maxY)
+                    return false;
+            }
+        }
+    }
+
+    unsigned int rectId = static_cast<unsigned int>(rects.size());
+    rects.push_back(rect);
+
+    for (int row = minRow; row <= maxRow; ++row)
+    {
+        for (int column = minColumn; column <= maxColumn; ++column)
+        {
+            unsigned int cellId = row * columns + column;
+            if (cells[cellId].empty())
+                usedCells.push_back(cellId);
+            cells[cellId].push_back(rectId);
+        }
+    }
+
+    return true;
+}
+
+const MString &FrameLabelLayer::text(const double frame)
+{
+    std::map<double, MString>::iterator it = texts.find(frame);
+    if (it != texts.end())
+        return it->second;
+
+    if (texts.size() >= MAX_CACHED_TEXTS)
+        texts.clear();
+
+    MString &frameStr = texts[frame];
+    frameStr = frame;
+    return frameStr;
+}
+
+unsigned int FrameLabelLayer::fontPixelSize(const double sizeOffset)
+{
+    unsigned int fontSize = static_cast<unsigned int>(14.0 * sizeOffset);
+    if (fontSize < 6)
+        fontSize = 6;  // 避免过小
+    if (fontSize > 64)
+        fontSize = 64; // 避免过大导致绘制异常
+    return fontSize;
+}
+
+double FrameLabelLayer::textWidth(const MString &text, const unsigned int fontSize)
+{
+    // digits of the default viewport font are a bit more than half as wide as they are tall
+    return text.length() * fontSize * 0.6;
+}
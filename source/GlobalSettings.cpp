@@ -34,6 +34,16 @@ bool GlobalSettings::enabled = false;
 bool GlobalSettings::alternatingFrames = false;
 bool GlobalSettings::lockedModeInteractive = true;
 bool GlobalSettings::usePivots = false;
+bool GlobalSettings::retainedGeometry = true;
+double GlobalSettings::idleWarmBudget = 4.0;
+int GlobalSettings::cachePrefetchFrames = 24;
+double GlobalSettings::pathPoolBudget = 64.0;
+double GlobalSettings::cacheMemoryBudget = 512.0;
+double GlobalSettings::maxRefreshRate = 60.0;
+double GlobalSettings::pathLodTolerance = 1.0;
+bool GlobalSettings::declutterLabels = true;
+bool GlobalSettings::frustumCulling = true;
+bool GlobalSettings::compiledHierarchy = true;
 int GlobalSettings::strokeMode = 0;
 GlobalSettings::DrawMode GlobalSettings::motionPathDrawMode = GlobalSettings::kWorldSpace;
 
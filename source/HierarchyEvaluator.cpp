@@ -0,0 +1,300 @@
+//
+//  HierarchyEvaluator.cpp
+//  MotionPath
+//
+//  Parent matrix of an object composed from snapshots of its ancestors' channels, evaluated without the Maya API.
+//
+
+#include "HierarchyEvaluator.h"
+
+#include <maya/MDagPath.h>
+#include <maya/MDGContext.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MFnMatrixData.h>
+#include <maya/MPlugArray.h>
+#include <maya/MTime.h>
+
+#include <cmath>
+#include <algorithm>
+
+#define HIERARCHY_TOLERANCE 1e-4
+
+namespace
+{
+    // in the order of HierarchyEvaluator::Channel, three axes each
+    const char *channelNames[] =
+    {
+        "translateX", "translateY", "translateZ",
+        "rotateX", "rotateY", "rotateZ",
+        "scaleX", "scaleY", "scaleZ",
+        "shearXY", "shearXZ", "shearYZ",
+        "rotatePivotX", "rotatePivotY", "rotatePivotZ",
+        "rotatePivotTranslateX", "rotatePivotTranslateY", "rotatePivotTranslateZ",
+        "scalePivotX", "scalePivotY", "scalePivotZ",
+        "scalePivotTranslateX", "scalePivotTranslateY", "scalePivotTranslateZ",
+        "rotateAxisX", "rotateAxisY", "rotateAxisZ",
+        "jointOrientX", "jointOrientY", "jointOrientZ",
+        "inverseScaleX", "inverseScaleY", "inverseScaleZ"
+    };
+
+    // compounds a constraint or a node could drive as a whole, which the children do not report, and the settings
+    const char *compoundNames[] =
+    {
+        "translate", "rotate", "scale", "shear", "rotatePivot", "rotatePivotTranslate",
+        "scalePivot", "scalePivotTranslate", "rotateAxis", "jointOrient", "rotateOrder", "inheritsTransform"
+    };
+
+    bool isDriven(const MPlug &plug)
+    {
+        MPlugArray sources;
+        return plug.connectedTo(sources, true, false) && sources.length() > 0;
+    }
+
+    MMatrix translation(const MVector &t)
+    {
+        MMatrix m;
+        m[3][0] = t.x;
+        m[3][1] = t.y;
+        m[3][2] = t.z;
+        return m;
+    }
+
+    MMatrix scaling(const MVector &s)
+    {
+        MMatrix m;
+        m[0][0] = s.x;
+        m[1][1] = s.y;
+        m[2][2] = s.z;
+        return m;
+    }
+
+    bool matches(const MMatrix &a, const MMatrix &b)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                if (std::fabs(a[r][c] - b[r][c]) > HIERARCHY_TOLERANCE * std::max(1.0, std::fabs(b[r][c])))
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
+void HierarchyEvaluator::clear()
+{
+    valid = false;
+    levels.clear();
+    for (int i = 0; i < 6; ++i)
+        pivots[i].clear();
+}
+
+size_t HierarchyEvaluator::memoryUsage() const
+{
+    size_t bytes = levels.capacity() * sizeof(Level);
+    for (size_t l = 0; l < levels.size(); ++l)
+    {
+        bytes += levels[l].channels.capacity() * sizeof(AnimCurveSnapshot);
+        for (size_t c = 0; c < levels[l].channels.size(); ++c)
+            bytes += levels[l].channels[c].memoryUsage();
+    }
+    for (int i = 0; i < 6; ++i)
+        bytes += pivots[i].memoryUsage();
+    return bytes;
+}
+
+bool HierarchyEvaluator::captureLevel(const MObject &node, Level &level)
+{
+    if (node.apiType() != MFn::kTransform && node.apiType() != MFn::kJoint)
+        return false;
+
+    MFnDependencyNode depNodFn(node);
+    for (unsigned int i = 0; i < sizeof(compoundNames) / sizeof(compoundNames[0]); ++i)
+    {
+        MPlug plug = depNodFn.findPlug(compoundNames[i], false);
+        if (!plug.isNull() && isDriven(plug))
+            return false;
+    }
+
+    level.joint = node.apiType() == MFn::kJoint;
+    level.inheritsTransform = depNodFn.findPlug("inheritsTransform", false).asBool();
+    level.rotateOrder = static_cast<MEulerRotation::RotationOrder>(depNodFn.findPlug("rotateOrder", false).asShort());
+    level.compensateScale = false;
+    level.inverseScaleFromParent = false;
+
+    // Maya 2020 and later, connected it is a matrix network this does not compile
+    MPlug offsetPlug = depNodFn.findPlug("offsetParentMatrix", false);
+    level.hasOffsetParentMatrix = !offsetPlug.isNull();
+    if (level.hasOffsetParentMatrix)
+    {
+        if (isDriven(offsetPlug))
+            return false;
+        MObject data = offsetPlug.asMObject();
+        level.offsetParentMatrix = MFnMatrixData(data).matrix();
+    }
+
+    int numChannels = level.joint ? kNumChannels : kJointOrient;
+    level.channels.resize(numChannels);
+    for (int c = 0; c < numChannels; ++c)
+    {
+        MPlug plug = depNodFn.findPlug(channelNames[c], false);
+        if (plug.isNull())
+            return false;
+
+        // a joint parented under a joint gets the parent scale through inverseScale, read from the next level instead
+        if (c >= kInverseScale)
+        {
+            MPlug inverseScale = depNodFn.findPlug("inverseScale", false);
+            MPlugArray sources;
+            if (inverseScale.connectedTo(sources, true, false) && sources.length() > 0)
+            {
+                if (sources[0].partialName(false, false, false, false, false, true) != "scale")
+                    return false;
+                level.inverseScaleFromParent = true;
+                continue;
+            }
+        }
+
+        if (!level.channels[c].capture(plug))
+            return false;
+    }
+
+    if (level.joint)
+    {
+        MPlug ssc = depNodFn.findPlug("segmentScaleCompensate", false);
+        if (isDriven(ssc))
+            return false;
+        level.compensateScale = ssc.asBool();
+    }
+
+    return true;
+}
+
+bool HierarchyEvaluator::capture(const MObject &object, const MPlug &parentMatrixPlug, const std::vector<double> &checkTimes)
+{
+    clear();
+
+    MDagPath path;
+    if (MDagPath::getAPathTo(object, path) != MS::kSuccess)
+        return false;
+
+    MFnDependencyNode objectFn(object);
+    const char *pivotNames[] = {"rotatePivotX", "rotatePivotY", "rotatePivotZ", "rotatePivotTranslateX", "rotatePivotTranslateY", "rotatePivotTranslateZ"};
+    for (int i = 0; i < 6; ++i)
+    {
+        if (!pivots[i].capture(objectFn.findPlug(pivotNames[i], false)))
+            return false;
+    }
+
+    // the world is the last entry of the path, an ancestor not inheriting ends the chain early
+    path.pop();
+    while (path.length() > 0)
+    {
+        levels.push_back(Level());
+        if (!captureLevel(path.node(), levels.back()))
+        {
+            clear();
+            return false;
+        }
+
+        if (!levels.back().inheritsTransform)
+            break;
+        path.pop();
+    }
+
+    for (size_t l = 0; l < levels.size(); ++l)
+    {
+        // the scale of the parent joint is only known when it is the next level of the chain
+        if (levels[l].inverseScaleFromParent && (l + 1 == levels.size() || !levels[l].inheritsTransform))
+        {
+            clear();
+            return false;
+        }
+    }
+
+    // anything missed above, like a custom transform or an unusual pivot setup, shows up as a different matrix
+    for (size_t i = 0; i < checkTimes.size(); ++i)
+    {
+        MDGContext context(MTime(checkTimes[i], MTime::uiUnit()));
+        MObject data;
+        parentMatrixPlug.getValue(data, context);
+        if (!matches(parentMatrix(checkTimes[i], false), MFnMatrixData(data).matrix()))
+        {
+            clear();
+            return false;
+        }
+    }
+
+    valid = true;
+    return true;
+}
+
+MVector HierarchyEvaluator::Level::vector(const int channel, const double time) const
+{
+    return MVector(value(channel, 0, time), value(channel, 1, time), value(channel, 2, time));
+}
+
+MMatrix HierarchyEvaluator::localMatrix(const unsigned int index, const double time) const
+{
+    const Level &level = levels[index];
+
+    MVector rotate = level.vector(kRotate, time);
+    MMatrix r = MEulerRotation(rotate.x, rotate.y, rotate.z, level.rotateOrder).asMatrix();
+    MVector axis = level.vector(kRotateAxis, time);
+    MMatrix ra = MEulerRotation(axis.x, axis.y, axis.z).asMatrix();
+    MMatrix s = scaling(level.vector(kScale, time));
+    MMatrix t = translation(level.vector(kTranslate, time));
+
+    MMatrix m;
+    if (level.joint)
+    {
+        // S * RO * R * JO * IS * T, the joint pivots do not move it
+        MVector orient = level.vector(kJointOrient, time);
+        MMatrix jo = MEulerRotation(orient.x, orient.y, orient.z).asMatrix();
+
+        MMatrix is;
+        if (level.compensateScale)
+        {
+            MVector inverseScale = level.inverseScaleFromParent ? levels[index + 1].vector(kScale, time) : level.vector(kInverseScale, time);
+            is = scaling(MVector(inverseScale.x != 0 ? 1.0 / inverseScale.x : 1.0,
+                                 inverseScale.y != 0 ? 1.0 / inverseScale.y : 1.0,
+                                 inverseScale.z != 0 ? 1.0 / inverseScale.z : 1.0));
+        }
+
+        m = s * ra * r * jo * is * t;
+    }
+    else
+    {
+        // Sp^-1 * S * Sh * Sp * St * Rp^-1 * Ra * R * Rp * Rt * T
+        MMatrix sh;
+        sh[1][0] = level.value(kShear, 0, time);
+        sh[2][0] = level.value(kShear, 1, time);
+        sh[2][1] = level.value(kShear, 2, time);
+
+        MVector sp = level.vector(kScalePivot, time);
+        MVector rp = level.vector(kRotatePivot, time);
+
+        m = translation(-sp) * s * sh * translation(sp) * translation(level.vector(kScalePivotTranslate, time)) *
+            translation(-rp) * ra * r * translation(rp) * translation(level.vector(kRotatePivotTranslate, time)) * t;
+    }
+
+    if (level.hasOffsetParentMatrix)
+        m = m * level.offsetParentMatrix;
+    return m;
+}
+
+MMatrix HierarchyEvaluator::parentMatrix(const double time, const bool usePivots) const
+{
+    MMatrix m;
+    for (unsigned int l = 0; l < levels.size(); ++l)
+        m = m * localMatrix(l, time);
+
+    if (usePivots)
+    {
+        m = translation(MVector(pivots[0].evaluate(time), pivots[1].evaluate(time), pivots[2].evaluate(time))) * m;
+        m = translation(MVector(pivots[3].evaluate(time), pivots[4].evaluate(time), pivots[5].evaluate(time))) * m;
+    }
+
+    return m;
+}
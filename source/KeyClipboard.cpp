@@ -120,46 +120,27 @@ void KeyCopy::copyKeyTangentStatus(MFnAnimCurve &curve, unsigned int keyId, cons
     curve.setIsWeighted(isWeighted);
 }
 
-void KeyCopy::addKeyFrame(MFnAnimCurve &cx, MFnAnimCurve &cy, MFnAnimCurve &cz,
-                          const MTime &time, const MVector &pos, const bool isBoundary, MAnimCurveChange *change)
+bool KeyCopy::hasKey(const Keyframe::Axis axis) const
 {
-    unsigned int keyID;
-
-    // X
-    if (hasKeyX || isBoundary)
-    {
-        if (!cx.find(time, keyID))
-            keyID = cx.addKey(time, pos.x, tinX, toutX, change);
-        else
-            cx.setValue(keyID, pos.x, change);
-
-        cx.setTangentsLocked(keyID, false, change);
-        cx.setWeightsLocked(keyID, false, change);
-    }
-
-    // Y
-    if (hasKeyY || isBoundary)
-    {
-        if (!cy.find(time, keyID))
-            keyID = cy.addKey(time, pos.y, tinY, toutY, change);
-        else
-            cy.setValue(keyID, pos.y, change);
+    return axis == Keyframe::kAxisX ? hasKeyX : axis == Keyframe::kAxisY ? hasKeyY : hasKeyZ;
+}
 
-        cy.setTangentsLocked(keyID, false, change);
-        cy.setWeightsLocked(keyID, false, change);
-    }
+MFnAnimCurve::TangentType KeyCopy::inTangentType(const Keyframe::Axis axis) const
+{
+    return axis == Keyframe::kAxisX ? tinX : axis == Keyframe::kAxisY ? tinY : tinZ;
+}
 
-    // Z
-    if (hasKeyZ || isBoundary)
-    {
-        if (!cz.find(time, keyID))
-            keyID = cz.addKey(time, pos.z, tinZ, toutZ, change);
-        else
-            cz.setValue(keyID, pos.z, change);
+MFnAnimCurve::TangentType KeyCopy::outTangentType(const Keyframe::Axis axis) const
+{
+    return axis == Keyframe::kAxisX ? toutX : axis == Keyframe::kAxisY ? toutY : toutZ;
+}
 
-        cz.setTangentsLocked(keyID, false, change);
-        cz.setWeightsLocked(keyID, false, change);
-    }
+void KeyCopy::localTangents(const MMatrix &pMatrix, MVector &in, MVector &out, MVector &inWeighted, MVector &outWeighted) const
+{
+    in = (inWorldTangent - worldPos) * pMatrix;
+    out = (outWorldTangent - worldPos) * pMatrix;
+    inWeighted = (inWeightedWorldTangent - worldPos) * pMatrix;
+    outWeighted = (outWeightedWorldTangent - worldPos) * pMatrix;
 }
 
 void KeyCopy::setTangent(MFnAnimCurve &curve,
@@ -192,16 +173,13 @@ void KeyCopy::setTangent(MFnAnimCurve &curve,
 }
 
 void KeyCopy::setTangents(MFnAnimCurve &cx, MFnAnimCurve &cy, MFnAnimCurve &cz,
-                          const MMatrix &pMatrix, const MTime &time, const bool isBoundary,
+                          const MVector &in, const MVector &out, const MVector &inWeighted, const MVector &outWeighted,
+                          const MTime &time, const bool isBoundary,
                           const bool modifyInTangent, const bool modifyOutTangent,
                           const bool breakTangentsX, const bool breakTangentsY, const bool breakTangentsZ,
                           const bool xWasWeighted, const bool yWasWeighted, const bool zWasWeighted, MAnimCurveChange *change)
 {
     unsigned int keyID;
-    MVector in = (inWorldTangent - worldPos) * pMatrix;
-    MVector out = (outWorldTangent - worldPos) * pMatrix;
-    MVector inWeighted = (inWeightedWorldTangent - worldPos) * pMatrix;
-    MVector outWeighted = (outWeightedWorldTangent - worldPos) * pMatrix;
 
     MFnAnimCurve::TangentValue inValue, outValue;
 
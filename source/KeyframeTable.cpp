@@ -0,0 +1,247 @@
+//
+//  KeyframeTable.cpp
+//  MotionPath
+//
+//  The keys of a path in one time sorted table, looked up by time and by id.
+//
+
+#include "KeyframeTable.h"
+
+#include <algorithm>
+
+namespace
+{
+    const size_t WORD_BITS = 64;
+
+    size_t numWords(const size_t numKeys) {return (numKeys + WORD_BITS - 1) / WORD_BITS;}
+
+    // the bits of the last word past the last key stay clear
+    unsigned long long lastWordMask(const size_t numKeys)
+    {
+        size_t used = numKeys % WORD_BITS;
+        return used == 0 ? ~0ull : (1ull << used) - 1;
+    }
+}
+
+void KeyframeTable::clear()
+{
+    // swapping keeps the capacity of both sides, a rebuild every refresh of a drag does not allocate
+    if (!building)
+    {
+        times.swap(staleTimes);
+        selectedBits.swap(staleBits);
+        building = true;
+    }
+
+    times.clear();
+    worldPositions.clear();
+    keys.clear();
+    selectedBits.clear();
+}
+
+int KeyframeTable::indexOf(const double time) const
+{
+    std::vector<double>::const_iterator it = std::lower_bound(times.begin(), times.end(), time);
+    if (it == times.end() || *it != time)
+        return -1;
+    return static_cast<int>(it - times.begin());
+}
+
+KeyframeTable::iterator KeyframeTable::find(const double time)
+{
+    int index = indexOf(time);
+    return index == -1 ? keys.end() : keys.begin() + index;
+}
+
+KeyframeTable::const_iterator KeyframeTable::find(const double time) const
+{
+    int index = indexOf(time);
+    return index == -1 ? keys.end() : keys.begin() + index;
+}
+
+Keyframe *KeyframeTable::findById(const int id)
+{
+    if (id < 0 || id >= static_cast<int>(keys.size()) || keys[id].id != id)
+        return NULL;
+    return &keys[id];
+}
+
+Keyframe &KeyframeTable::findOrInsert(const double time)
+{
+    // the curves list their keys in time order, so most inserts append
+    std::vector<double>::iterator it = std::lower_bound(times.begin(), times.end(), time);
+    size_t index = it - times.begin();
+    if (it != times.end() && *it == time)
+        return keys[index];
+
+    times.insert(it, time);
+    Keyframe key;
+    key.time = time;
+    keys.insert(keys.begin() + index, key);
+    return keys[index];
+}
+
+void KeyframeTable::finalize()
+{
+    worldPositions.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        worldPositions[i] = keys[i].worldPosition;
+
+    selectedBits.assign(numWords(keys.size()), 0);
+    if (building)
+    {
+        // both time arrays are sorted, one merge walk finds the keys that are still there
+        size_t j = 0;
+        for (size_t i = 0; i < staleTimes.size() && j < times.size(); ++i)
+        {
+            if (!((staleBits[i / WORD_BITS] >> (i % WORD_BITS)) & 1))
+                continue;
+
+            while (j < times.size() && times[j] < staleTimes[i])
+                ++j;
+            if (j < times.size() && times[j] == staleTimes[i])
+                selectedBits[j / WORD_BITS] |= 1ull << (j % WORD_BITS);
+        }
+
+        staleTimes.clear();
+        staleBits.clear();
+        building = false;
+    }
+
+    for (size_t i = 0; i < pendingTimes.size(); ++i)
+    {
+        int index = indexOf(pendingTimes[i]);
+        if (index != -1)
+            selectedBits[index / WORD_BITS] |= 1ull << (index % WORD_BITS);
+    }
+    pendingTimes.clear();
+
+    for (size_t i = 0; i < keys.size(); ++i)
+        keys[i].selectedFromTool = isSelected(i);
+}
+
+void KeyframeTable::select(const size_t index, const bool value)
+{
+    if (value)
+        selectedBits[index / WORD_BITS] |= 1ull << (index % WORD_BITS);
+    else
+        selectedBits[index / WORD_BITS] &= ~(1ull << (index % WORD_BITS));
+    keys[index].selectedFromTool = value;
+}
+
+bool KeyframeTable::isTimeSelected(const double time) const
+{
+    int index = building ? -1 : indexOf(time);
+    if (index != -1)
+        return isSelected(index);
+    return std::find(pendingTimes.begin(), pendingTimes.end(), time) != pendingTimes.end();
+}
+
+void KeyframeTable::selectTime(const double time, const bool value)
+{
+    int index = building ? -1 : indexOf(time);
+    if (index != -1)
+    {
+        select(index, value);
+        return;
+    }
+
+    std::vector<double>::iterator it = std::find(pendingTimes.begin(), pendingTimes.end(), time);
+    if (value && it == pendingTimes.end())
+        pendingTimes.push_back(time);
+    else if (!value && it != pendingTimes.end())
+        pendingTimes.erase(it);
+}
+
+void KeyframeTable::selectAll()
+{
+    if (building)
+        return;
+
+    std::fill(selectedBits.begin(), selectedBits.end(), ~0ull);
+    if (!selectedBits.empty())
+        selectedBits.back() &= lastWordMask(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        keys[i].selectedFromTool = true;
+}
+
+void KeyframeTable::invertSelection()
+{
+    pendingTimes.clear();
+    if (building)
+        return;
+
+    for (size_t w = 0; w < selectedBits.size(); ++w)
+        selectedBits[w] = ~selectedBits[w];
+    if (!selectedBits.empty())
+        selectedBits.back() &= lastWordMask(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        keys[i].selectedFromTool = isSelected(i);
+}
+
+void KeyframeTable::deselectAll()
+{
+    pendingTimes.clear();
+    std::fill(selectedBits.begin(), selectedBits.end(), 0ull);
+    std::fill(staleBits.begin(), staleBits.end(), 0ull);
+    for (size_t i = 0; i < keys.size(); ++i)
+        keys[i].selectedFromTool = false;
+}
+
+bool KeyframeTable::hasSelection() const
+{
+    if (!pendingTimes.empty())
+        return true;
+    for (size_t w = 0; w < selectedBits.size(); ++w)
+        if (selectedBits[w])
+            return true;
+    return false;
+}
+
+size_t KeyframeTable::nextSelected(const size_t index) const
+{
+    size_t w = index / WORD_BITS;
+    if (w >= selectedBits.size())
+        return keys.size();
+
+    // the bits below index are masked off in its word, the words after it are skipped while empty
+    unsigned long long word = selectedBits[w] & (~0ull << (index % WORD_BITS));
+    while (!word)
+    {
+        if (++w == selectedBits.size())
+            return keys.size();
+        word = selectedBits[w];
+    }
+
+    size_t bit = 0;
+    while (!((word >> bit) & 1))
+        ++bit;
+    return w * WORD_BITS + bit;
+}
+
+void KeyframeTable::getSelectedTimes(MDoubleArray &result) const
+{
+    result.clear();
+    for (size_t i = nextSelected(0); i < keys.size(); i = nextSelected(i + 1))
+        result.append(times[i]);
+
+    if (pendingTimes.empty())
+        return;
+
+    std::vector<double> sorted(pendingTimes);
+    for (unsigned int i = 0; i < result.length(); ++i)
+        sorted.push_back(result[i]);
+    std::sort(sorted.begin(), sorted.end());
+
+    result.clear();
+    for (size_t i = 0; i < sorted.size(); ++i)
+        result.append(sorted[i]);
+}
+
+size_t KeyframeTable::memoryUsage() const
+{
+    size_t bytes = times.capacity() * sizeof(double) + worldPositions.capacity() * sizeof(MVector) + keys.capacity() * sizeof(Keyframe);
+    bytes += (selectedBits.capacity() + staleBits.capacity()) * sizeof(unsigned long long);
+    bytes += (pendingTimes.capacity() + staleTimes.capacity()) * sizeof(double);
+    return bytes;
+}
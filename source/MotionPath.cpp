@@ -10,18 +10,24 @@
 
 #include <QtWidgets/QApplication> 
 #include <cmath>
+#include <limits>
+#include <algorithm>
 
 #include "MotionPathManager.h"
 #include "GlobalSettings.h"
 #include "MotionPath.h"
 #include "animCurveUtils.h"
 #include "Vp2DrawUtils.h"
+#include "TransformKernel.h"
+#include "PathCacheFile.h"
+#include "PathStats.h"
 
 #include <maya/MPlugArray.h>
 #include <maya/MAnimUtil.h>
 #include <maya/MFnTransform.h>
 #include <maya/MEulerRotation.h>
 #include <maya/MPxTransformationMatrix.h>
+#include <maya/MTimeArray.h>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -33,6 +39,7 @@ extern MotionPathManager mpManager;
 MotionPath::MotionPath(const MObject &object)
 {
     thisObject = object;
+    worldMatrixCallbackId = 0;
 
     MFnDependencyNode depNodFn(object);
     txPlug = depNodFn.findPlug("translateX", false);
@@ -57,8 +64,6 @@ MotionPath::MotionPath(const MObject &object)
     endTime = 0;
     displayStartTime = 0;
     displayEndTime = 0;
-    startTimeCached = 0;
-    endTimeCached = 0;
     selectedFromTool = false;
     colorMultiplier = 1.0;
     
@@ -66,16 +71,29 @@ MotionPath::MotionPath(const MObject &object)
     
     constrained = isConstrained(object);
 	findParentMatrixPlug(object, constrained, pMatrixPlug);
+
     
-    selectedKeyTimes.clear();
-    
-    cacheDone = false;
     worldSpaceCallbackCalled = false;
 
     // 优化A: 初始化缓存追踪字段
     cachedRangeStart = 0;
     cachedRangeEnd = 0;
     pMatrixCacheValid = false;
+    lastUsedGeneration = 0;
+    positionsSwept = false;
+    snapshotsDirty = true;
+    hierarchyDirty = true;
+
+    // 关键帧缓存只在曲线被编辑或依赖的设置变化时重建
+    keyframesDirty = true;
+    positionsDirty = false;
+    liveValuesDrawn = false;
+    drawInterval = 1.0;
+    retainedDraw = false;
+    chunksCulled = false;
+    pathCulled = false;
+    keyframesCachedWithRotation = false;
+    keyframesCachedWhileDrawing = false;
 
     // ✅ 初始化交互时间（避免未定义行为）
     lastInteractionTime = std::chrono::steady_clock::now();
@@ -88,6 +106,53 @@ MotionPath::~MotionPath()
     removeWorldMartrixCallback();
 }
 
+size_t MotionPath::cacheMemoryUsage() const
+{
+    size_t bytes = pMatrixCache.memoryUsage() + drawPositionCache.memoryUsage() + pathGeometry.memoryUsage();
+    bytes += snapshotX.memoryUsage() + snapshotY.memoryUsage() + snapshotZ.memoryUsage();
+    bytes += keyframesCache.memoryUsage() + hierarchy.memoryUsage();
+
+    // map nodes: key, value and the tree links
+    bytes += frameScreenSpacePositions.size() * (sizeof(double) + sizeof(MPoint) + 4 * sizeof(void*));
+    return bytes;
+}
+
+double MotionPath::cacheDistance(const double time) const
+{
+    if (!pMatrixCache.hasWindow())
+        return 0;
+    if (time < pMatrixCache.firstFrame())
+        return pMatrixCache.firstFrame() - time;
+    if (time > pMatrixCache.lastFrame())
+        return time - pMatrixCache.lastFrame();
+    return 0;
+}
+
+void MotionPath::shrinkCaches()
+{
+    pMatrixCache.shrinkToFit();
+    drawPositionCache.shrinkToFit();
+}
+
+void MotionPath::trimCachesToDisplayRange()
+{
+    double windowStart = std::max(displayStartTime, startTime);
+    double windowEnd = std::min(displayEndTime, endTime);
+    if (windowStart > windowEnd)
+        return;
+
+    pMatrixCache.setWindow(windowStart, windowEnd);
+    if (drawPositionCache.hasWindow())
+        drawPositionCache.setWindow(windowStart, windowEnd);
+    if (pMatrixCacheValid)
+    {
+        cachedRangeStart = std::max(cachedRangeStart, windowStart);
+        cachedRangeEnd = std::min(cachedRangeEnd, windowEnd);
+        pMatrixCacheValid = cachedRangeStart <= cachedRangeEnd;
+    }
+    shrinkCaches();
+}
+
 void MotionPath::addWorldMatrixCallback()
 {
     MStatus status;
@@ -118,6 +183,8 @@ void MotionPath::cacheParentMatrixRange()
 
 void MotionPath::cacheParentMatrixRange(double startFrame, double endFrame)
 {
+    pathStats::ScopedTimer timer(pathStats::kCacheParentMatrixRange);
+
     // 优化A: 智能缓存验证 - 避免不必要的重建
     // 如果缓存有效且覆盖请求范围，直接返回
     if (pMatrixCacheValid &&
@@ -144,6 +211,15 @@ void MotionPath::cacheParentMatrixRange(double startFrame, double endFrame)
         if (startFrame < cachedRangeStart) cachedRangeStart = startFrame;
         if (endFrame > cachedRangeEnd) cachedRangeEnd = endFrame;
     }
+    else if (hierarchyValid())
+    {
+        // 🚀 祖先链已编译：不访问 DG，直接并行合成缺失帧
+        cacheCompiledParentMatrices(startFrame, endFrame);
+
+        cachedRangeStart = startFrame;
+        cachedRangeEnd = endFrame;
+        pMatrixCacheValid = true;
+    }
     else
     {
         // 完全重建（首次或缓存失效后）
@@ -161,18 +237,27 @@ void MotionPath::cacheParentMatrixRange(double startFrame, double endFrame)
             std::vector<MVector> rptivots(numFrames);
 
             // ====== 阶段1: 主线程收集原始数据（Maya API 访问）======
+            // 已由管理器逐帧扫描写入的帧直接跳过
+            int numMissing = 0;
+            for (int idx = 0; idx < numFrames; ++idx)
+            {
+                if (!pMatrixCache.contains(startFrame + idx))
+                    frames[numMissing++] = startFrame + idx;
+            }
+            numFrames = numMissing;
+
             for (int idx = 0; idx < numFrames; ++idx)
             {
-                frames[idx] = startFrame + idx;
                 MTime evalTime(frames[idx], MTime::uiUnit());
+                MDGContext context(evalTime);
 
-                // ✅ 主线程安全访问 Maya API
-                parentMatrices[idx] = getMatrixFromPlug(pMatrixPlug, evalTime);
+                // ✅ 主线程安全访问 Maya API（同一帧共用一个 context）
+                parentMatrices[idx] = getMatrixFromPlug(pMatrixPlug, context);
 
                 if (GlobalSettings::usePivots)
                 {
-                    rpivots[idx] = getVectorFromPlugs(evalTime, rpxPlug, rpyPlug, rpzPlug);
-                    rptivots[idx] = getVectorFromPlugs(evalTime, rptxPlug, rptyPlug, rptzPlug);
+                    rpivots[idx] = getVectorFromPlugs(context, rpxPlug, rpyPlug, rpzPlug);
+                    rptivots[idx] = getVectorFromPlugs(context, rptxPlug, rptyPlug, rptzPlug);
                 }
             }
 
@@ -207,7 +292,8 @@ void MotionPath::cacheParentMatrixRange(double startFrame, double endFrame)
             // ====== 阶段3: 主线程写回缓存 ======
             for (int idx = 0; idx < numFrames; ++idx)
             {
-                pMatrixCache[frames[idx]] = finalMatrices[idx];
+                pMatrixCache.set(frames[idx], finalMatrices[idx]);
+                pathGeometry.markDirty(frames[idx]);
             }
         }
         else
@@ -229,79 +315,119 @@ void MotionPath::cacheParentMatrixRange(double startFrame, double endFrame)
     }
 }
 
-void MotionPath::cacheParentMatrixRangeForWorldCallback(MObject &transformNode)
+namespace
 {
-    MFnDependencyNode depNodFn(transformNode);
-    MPlug txP = depNodFn.findPlug("translateX", false);
-    MPlug tyP = depNodFn.findPlug("translateY", false);
-    MPlug tzP = depNodFn.findPlug("translateZ", false);
+    // a live value keyed at the current time while the range is evaluated, so the other frames see the manipulation
+    struct TemporaryKey
+    {
+        MPlug plug;
+        MObject curve;
+        double oldValue, newValue;
+        int newKey, oldKey;
+    };
+}
 
-    MPlug rxP = depNodFn.findPlug("rotateX", false);
-    MPlug ryP = depNodFn.findPlug("rotateY", false);
-    MPlug rzP = depNodFn.findPlug("rotateZ", false);
-    
-    MStatus txStatus, tyStatus, tzStatus, rxStatus, ryStatus, rzStatus, sxStatus, syStatus, szStatus;
-    MFnAnimCurve cTX(txP, &txStatus);
-    MFnAnimCurve cTY(tyP, &tyStatus);
-    MFnAnimCurve cTZ(tzP, &tzStatus);
-    MFnAnimCurve cRX(rxP, &rxStatus);
-    MFnAnimCurve cRY(ryP, &ryStatus);
-    MFnAnimCurve cRZ(rzP, &rzStatus);
-    
+void MotionPath::cacheParentMatrixRangeForWorldCallback(const MObjectArray &transformNodes)
+{
+    const char *attributes[] = {"translateX", "translateY", "translateZ", "rotateX", "rotateY", "rotateZ"};
     MTime currentTime = MAnimControl::currentTime();
-    
-    double newTXValue, newTYValue, newTZValue, newRXValue, newRYValue, newRZValue;
-    double oldTXValue, oldTYValue, oldTZValue, oldRXValue, oldRYValue, oldRZValue;
-    int newKeyTX, newKeyTY, newKeyTZ, newKeyRX, newKeyRY, newKeyRZ;
-    int oldKeyTX, oldKeyTY, oldKeyTZ, oldKeyRX, oldKeyRY, oldKeyRZ;
-    bool txUpdated, tyUpdated, tzUpdated, rxUpdated, ryUpdated, rzUpdated;
-    if (txStatus != MS::kNotFound)
-        txUpdated = animCurveUtils::updateCurve(txP, cTX, currentTime, oldTXValue, newTXValue, newKeyTX, oldKeyTX);
-    if (tyStatus != MS::kNotFound)
-        tyUpdated = animCurveUtils::updateCurve(tyP, cTY, currentTime, oldTYValue, newTYValue, newKeyTY, oldKeyTY);
-    if (tzStatus != MS::kNotFound)
-        tzUpdated = animCurveUtils::updateCurve(tzP, cTZ, currentTime, oldTZValue, newTZValue, newKeyTZ, oldKeyTZ);
-    if (rxStatus != MS::kNotFound)
-        rxUpdated = animCurveUtils::updateCurve(rxP, cRX, currentTime, oldRXValue, newRXValue, newKeyRX, oldKeyRX);
-    if (ryStatus != MS::kNotFound)
-        ryUpdated = animCurveUtils::updateCurve(ryP, cRY, currentTime, oldRYValue, newRYValue, newKeyRY, oldKeyRY);
-    if (rzStatus != MS::kNotFound)
-        rzUpdated = animCurveUtils::updateCurve(rzP, cRZ, currentTime, oldRZValue, newRZValue, newKeyRZ, oldKeyRZ);
-    
-    cacheParentMatrixRange();
-    
-    if (txUpdated && txStatus != MS::kNotFound)
+
+    std::vector<TemporaryKey> keys;
+    for (unsigned int n = 0; n < transformNodes.length(); ++n)
     {
-        animCurveUtils::restoreCurve(cTX, currentTime, oldTXValue, newKeyTX, oldKeyTX);
-        txP.setValue(newTXValue);
+        MFnDependencyNode depNodFn(transformNodes[n]);
+        for (int a = 0; a < 6; ++a)
+        {
+            TemporaryKey key;
+            key.plug = depNodFn.findPlug(attributes[a], false);
+
+            MStatus status;
+            MFnAnimCurve curve(key.plug, &status);
+            if (status == MS::kNotFound)
+                continue;
+
+            if (animCurveUtils::updateCurve(key.plug, curve, currentTime, key.oldValue, key.newValue, key.newKey, key.oldKey))
+            {
+                key.curve = curve.object();
+                keys.push_back(key);
+            }
+        }
     }
-    if (tyUpdated && tyStatus != MS::kNotFound)
+
+    cacheParentMatrixRange();
+
+    for (size_t i = 0; i < keys.size(); ++i)
     {
-        animCurveUtils::restoreCurve(cTY, currentTime, oldTYValue, newKeyTY, oldKeyTY);
-        tyP.setValue(newTYValue);
+        MFnAnimCurve curve(keys[i].curve);
+        animCurveUtils::restoreCurve(curve, currentTime, keys[i].oldValue, keys[i].newKey, keys[i].oldKey);
+        keys[i].plug.setValue(keys[i].newValue);
     }
-    if (tzUpdated && tzStatus != MS::kNotFound )
+
+    // the compiled ancestors copied the temporary keys
+    if (!keys.empty())
+        hierarchyDirty = true;
+}
+
+// 锁定模式：只有静态偏移的祖先变化时，整个缓存区间乘上同一个增量矩阵，拖动时也能即时更新
+// 有动画的祖先仍然要在鼠标松开后整体重建
+void MotionPath::updateParentMatricesForAncestors()
+{
+    if (applyStaticAncestorDelta())
     {
-        animCurveUtils::restoreCurve(cTZ, currentTime, oldTZValue, newKeyTZ, oldKeyTZ);
-        tzP.setValue(newTZValue);
+        setWorldSpaceCallbackCalled(false, MObject());
+        return;
     }
-    
-    if (rxUpdated && rxStatus != MS::kNotFound)
+
+    if (QApplication::mouseButtons() != Qt::LeftButton)
     {
-        animCurveUtils::restoreCurve(cRX, currentTime, oldRXValue, newKeyRX, oldKeyRX);
-        rxP.setValue(newRXValue);
+        // 优化A+D: 清空缓存并标记失效
+        // 后续的cacheParentMatrixRange会智能重建，只计算需要的帧范围
+        clearParentMatrixCache();
+        cacheParentMatrixRangeForWorldCallback(changedAncestors);
+        setWorldSpaceCallbackCalled(false, MObject());
     }
-    if (ryUpdated && ryStatus != MS::kNotFound)
+}
+
+// With the ancestor and everything above it static, its world matrix W is the same on every frame, so
+// P(t) = B(t) * W for the animated part B below it. Then P_new(t) = P_old(t) * P_old(c)^-1 * P_new(c) for the
+// current frame c, the pivots multiply on the left and are not affected.
+bool MotionPath::applyStaticAncestorDelta()
+{
+    bool affected = false;
+    for (unsigned int i = 0; i < changedAncestors.length(); ++i)
     {
-        animCurveUtils::restoreCurve(cRY, currentTime, oldRYValue, newKeyRY, oldKeyRY);
-        ryP.setValue(newRYValue);
+        // the parent matrix does not depend on the object itself, the world matrix of a constrained one does
+        if (changedAncestors[i] == thisObject && !constrained)
+            continue;
+        if (!animCurveUtils::isStaticUpToWorld(changedAncestors[i]))
+            return false;
+        affected = true;
     }
-    if (rzUpdated && rzStatus != MS::kNotFound )
+
+    if (!affected)
+        return true;
+
+    MTime currentTime = MAnimControl::currentTime();
+    const MMatrix *oldMatrix = pMatrixCache.find(currentTime.as(MTime::uiUnit()));
+    if (!oldMatrix)
+        return false;
+
+    MMatrix delta = oldMatrix->inverse() * getPMatrixAtTime(currentTime);
+    pMatrixCache.forEach([&delta](MMatrix &matrix){matrix = matrix * delta;});
+
+    keyframesDirty = true;
+    pathGeometry.markAllDirty();
+    return true;
+}
+
+bool MotionPath::usesAnimCurve(const MObject &curve)
+{
+    for (unsigned int i = 0; i < animCurveObjects.length(); ++i)
     {
-        animCurveUtils::restoreCurve(cRZ, currentTime, oldRZValue, newKeyRZ, oldKeyRZ);
-        rzP.setValue(newRZValue);
+        if (animCurveObjects[i] == curve)
+            return true;
     }
-    
+    return false;
 }
 
 bool MotionPath::getWorldSpaceCallbackCalled()
@@ -311,8 +437,19 @@ bool MotionPath::getWorldSpaceCallbackCalled()
 
 void MotionPath::setWorldSpaceCallbackCalled(const bool value, const MObject &ancestorNode)
 {
-    tempAncestorNode = ancestorNode;
     worldSpaceCallbackCalled = value;
+    if (!value)
+    {
+        changedAncestors.clear();
+        return;
+    }
+
+    hierarchyDirty = true;
+
+    for (unsigned int i = 0; i < changedAncestors.length(); ++i)
+        if (changedAncestors[i] == ancestorNode)
+            return;
+    changedAncestors.append(ancestorNode);
 }
 
 void MotionPath::worldMatrixChangedCallback(MObject& transformNode, MDagMessage::MatrixModifiedFlags& modified, void* data)
@@ -427,6 +564,10 @@ void MotionPath::clearParentMatrixCache()
     pMatrixCache.clear();
     // 优化D: 标记缓存失效
     pMatrixCacheValid = false;
+    hierarchyDirty = true;
+    // keyframe world positions and the retained geometry were computed with the old parent matrices
+    keyframesDirty = true;
+    pathGeometry.markAllDirty();
 }
 
 void MotionPath::findParentMatrixPlug(const MObject &transform, const bool constrained, MPlug &matrixPlug)
@@ -446,12 +587,25 @@ void MotionPath::setTimeRange(double startTime, double endTime)
 {
     this->startTime = startTime;
     this->endTime = endTime;
-
-    cacheDone = false;
 }
 
 void MotionPath::setDisplayTimeRange(double start, double end)
 {
+    // 0. 父矩阵缓存窗口跟随时间窗口滑动，只丢弃移出窗口的帧，其余帧保持有效
+    // 窗口两侧多保留 cachePrefetchFrames 帧，空闲时预热的帧不会在下一次滑动时被丢弃
+    double windowStart = std::max(start, this->startTime);
+    double windowEnd = std::min(end, this->endTime);
+    if (windowStart <= windowEnd)
+    {
+        pMatrixCache.setWindow(std::max(windowStart - GlobalSettings::cachePrefetchFrames, this->startTime), std::min(windowEnd + GlobalSettings::cachePrefetchFrames, this->endTime));
+        if (pMatrixCacheValid)
+        {
+            cachedRangeStart = std::max(cachedRangeStart, windowStart);
+            cachedRangeEnd = std::min(cachedRangeEnd, windowEnd);
+            pMatrixCacheValid = cachedRangeStart <= cachedRangeEnd;
+        }
+    }
+
     // 1. 获取动画曲线状态
     MStatus xStatus, yStatus, zStatus;
     MFnAnimCurve curveX(txPlug, &xStatus);
@@ -484,35 +638,14 @@ void MotionPath::setDisplayTimeRange(double start, double end)
 MMatrix MotionPath::getMatrixFromPlug(const MPlug &matrixPlug, const MTime &t)
 {
 	MDGContext context(t);
-	MObject val;
-	matrixPlug.getValue(val, context);
-	return MFnMatrixData(val).matrix();
+	return getMatrixFromPlug(matrixPlug, context);
 }
 
-void MotionPath::growParentAndPivotMatrixCache(double time, double expansion)
+MMatrix MotionPath::getMatrixFromPlug(const MPlug &matrixPlug, const MDGContext &context)
 {
-	double evalTimeBefore = time - expansion;
-	if(evalTimeBefore < (time - GlobalSettings::framesBack))
-		evalTimeBefore = time - GlobalSettings::framesBack;
-
-	double evalTimeAfter = time + expansion;
-	if(evalTimeAfter > (time + GlobalSettings::framesFront))
-		evalTimeAfter = time + GlobalSettings::framesFront;
-
-	if(evalTimeBefore >= this->startTime)
-	{
-        ensureParentAndPivotMatrixAtTime(evalTimeBefore);
-		startTimeCached = evalTimeBefore;
-	}
-
-	if(evalTimeAfter <= this->endTime)
-	{
-        ensureParentAndPivotMatrixAtTime(evalTimeAfter);
-		endTimeCached = evalTimeAfter;
-	}
-
-	if(startTimeCached == startTime && endTimeCached == endTime)
-		cacheDone = true;
+	MObject val;
+	matrixPlug.getValue(val, context);
+	return MFnMatrixData(val).matrix();
 }
 
 void MotionPath::drawKeyFrames(CameraCache *cachePtr, MMatrix &currentCameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
@@ -535,82 +668,238 @@ void MotionPath::drawKeyFrames(CameraCache *cachePtr, MMatrix &currentCameraMatr
 
 void MotionPath::drawFrames(CameraCache* cachePtr, const MMatrix &currentCameraMatrix, M3dView &view, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
-    MColor curveColor = isWeighted ? GlobalSettings::weightedPathColor : GlobalSettings::pathColor;
-
-    if(this->selectedFromTool)  curveColor *= 1.3;
+    pathStats::ScopedTimer timer(pathStats::kDrawFrames);
 
-    curveColor *= colorMultiplier;
+    // 颜色和采样间隔由 prepareDraw 在主线程决定
+    const MColor &curveColor = drawColor;
+    double sampleInterval = drawInterval;
 
-    ensureParentAndPivotMatrixAtTime(displayStartTime);
+    // 🚀 屏幕空间 LOD：投影误差小于 pathLodTolerance 像素的采样点不画
+    pathLod::ScreenProjection projection;
+    bool simplify = GlobalSettings::pathLodTolerance > 0 && pathLod::getScreenProjection(view, frameContext, projection);
 
-    // ✅ 使用缓存的位置（快速）
-    MVector previousWorldPos = multPosByParentMatrix(getCachedPos(displayStartTime), pMatrixCache[displayStartTime]);
-    if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
+    // 🚀 保留几何：世界空间顶点在刷新之间保存，交给 GPU 做视图变换
+    // 只重写缓存报告为脏的采样点，旋转摄像机时不再重新计算
+    if (retainedDraw)
     {
-        if (!cachePtr) return;
-        cachePtr->ensureMatricesAtTime(displayStartTime);
-        previousWorldPos = MPoint(previousWorldPos) * cachePtr->matrixCache[displayStartTime] * currentCameraMatrix;
+        // 管理器已经在并行阶段写好了顶点，这里只是单独调用 draw() 时的补充
+        buildDrawGeometry();
+
+        // 🚀 旧视口用同一份线段和帧点，交给 drawUtils 的顶点数组，每条路径只有两次 glDrawArrays
+        PathGeometry::Packets packets;
+        if (!simplify)
+        {
+            if (drawManager)
+            {
+                pathGeometry.draw(GlobalSettings::showPath, GlobalSettings::pathSize, GlobalSettings::pathSize * 2, drawManager, chunksCulled ? &visibleChunks : NULL);
+                return;
+            }
+            pathGeometry.getPackets(GlobalSettings::showPath, chunksCulled ? &visibleChunks : NULL, packets);
+        }
+        else
+        {
+            // 简化结果按摄像机缓存，视图和数据都没变时直接复用
+            std::vector<double> sampleTimes(pathGeometry.numSamples());
+            for (unsigned int s = 0; s < pathGeometry.numSamples(); ++s)
+                sampleTimes[s] = pathGeometry.sampleTime(s);
+
+            std::vector<unsigned char> pinned;
+            getPinnedSamples(sampleTimes, pinned);
+
+            MDagPath camera;
+            view.getCamera(camera);
+            if (drawManager)
+            {
+                pathGeometry.drawSimplified(camera.fullPathName().asChar(), projection, GlobalSettings::pathLodTolerance, pinned,
+                                            GlobalSettings::showPath, GlobalSettings::pathSize, GlobalSettings::pathSize * 2, drawManager);
+                return;
+            }
+            pathGeometry.getSimplifiedPackets(camera.fullPathName().asChar(), projection, GlobalSettings::pathLodTolerance, pinned,
+                                              GlobalSettings::showPath, packets);
+        }
+
+        // 旧视口的帧点一直是 pathSize 大小
+        drawUtils::drawPackets(packets, GlobalSettings::pathSize, GlobalSettings::pathSize);
+        return;
     }
 
-    // 🚀 优化C: 增强自适应绘制采样 - 交互时根据帧数动态降低精度提升流畅度
-    // 检测是否在交互中（拖动鼠标）
-    bool isInteracting = (QApplication::mouseButtons() != Qt::NoButton);
-    double adaptiveInterval = GlobalSettings::drawTimeInterval;
+    // 🚀 批量变换：先收集所有采样时间，位置和矩阵一次性交给 transformKernel
+    std::vector<double> sampleTimes;
+    sampleTimes.reserve(static_cast<size_t>((displayEndTime - displayStartTime) / sampleInterval) + 2);
+    sampleTimes.push_back(displayStartTime);
+    for(double i = displayStartTime + sampleInterval; i <= displayEndTime; i += sampleInterval)
+        sampleTimes.push_back(i);
 
-    if (isInteracting)
-    {
-        int numFrames = displayEndTime - displayStartTime;
+    std::vector<MVector> samplePositions;
+    if (!getDrawSpacePositions(sampleTimes, cachePtr, currentCameraMatrix, samplePositions))
+        return;
 
-        // ✅ 根据帧数动态调整采样密度（更激进的优化）
-        if (numFrames > 500)
-            adaptiveInterval = std::max(10.0, GlobalSettings::drawTimeInterval);  // 每10帧采样1次
-        else if (numFrames > 200)
-            adaptiveInterval = std::max(5.0, GlobalSettings::drawTimeInterval);   // 每5帧采样1次
-        else if (numFrames > 100)
-            adaptiveInterval = std::max(2.0, GlobalSettings::drawTimeInterval);   // 每2帧采样1次
-        // 否则使用原始采样密度
+    // 没有保留几何的世界空间路径：包围盒在简化之前按采样点建立，分块和采样时间一一对应
+    if (drawFrustum.isSet() && !chunksCulled)
+    {
+        drawBounds.build(samplePositions);
+        if (!cullAgainstView(drawBounds))
+            return;
     }
 
-	// Use adaptive interval to control path sampling density
-	for(double i = displayStartTime + adaptiveInterval; i <= displayEndTime; i += adaptiveInterval)
-	{
-        ensureParentAndPivotMatrixAtTime(i);
+    // 摄像机空间的位置每帧都会变，这里不缓存，直接简化后绘制
+    // 只简化线段，帧点总是全部绘制：帧间距正是运动路径要显示的东西
+    std::vector<double> lineTimes(sampleTimes);
+    std::vector<MVector> linePositions(samplePositions);
+    if (simplify && samplePositions.size() > 2)
+    {
+        std::vector<double> x(samplePositions.size()), y(samplePositions.size());
+        std::vector<unsigned char> visible(samplePositions.size());
+        for (size_t s = 0; s < samplePositions.size(); ++s)
+            visible[s] = projection.project(MPoint(samplePositions[s]), x[s], y[s]) ? 1 : 0;
 
-		// ✅ 使用缓存的位置（快速）
-		MVector worldPos = multPosByParentMatrix(getCachedPos(i), pMatrixCache[i]);
-        if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
-        {
-            if (!cachePtr) return;
-            cachePtr->ensureMatricesAtTime(i);
-            worldPos = MPoint(worldPos) * cachePtr->matrixCache[i] * currentCameraMatrix;
-        }
+        std::vector<unsigned char> keep;
+        getPinnedSamples(sampleTimes, keep);
+        pathLod::simplify(x, y, visible, GlobalSettings::pathLodTolerance, keep);
 
-        if (GlobalSettings::showPath)
+        size_t kept = 0;
+        for (size_t s = 0; s < samplePositions.size(); ++s)
         {
-            double factor = 1;
-            if (GlobalSettings::alternatingFrames)
-                factor = int(i) % 2 == 1 ? 1.4 : 0.6;
-
-			if (drawManager)
-				VP2DrawUtils::drawLineWithColor(previousWorldPos, worldPos, GlobalSettings::pathSize, curveColor * factor, currentCameraMatrix, drawManager, frameContext);
-			else
-				drawUtils::drawLineWithColor(previousWorldPos, worldPos, GlobalSettings::pathSize, curveColor * factor);
+            if (!keep[s])
+                continue;
+            lineTimes[kept] = sampleTimes[s];
+            linePositions[kept] = samplePositions[s];
+            ++kept;
         }
+        lineTimes.resize(kept);
+        linePositions.resize(kept);
+    }
 
-		if (drawManager)
-			VP2DrawUtils::drawPointWithColor(previousWorldPos, GlobalSettings::pathSize * 2, curveColor, currentCameraMatrix, drawManager, frameContext);
-		else
-			drawUtils::drawPointWithColor(previousWorldPos, GlobalSettings::pathSize, curveColor);
-        previousWorldPos = worldPos;
+	// 🚀 VP2: 整条路径收集后一次提交（一个线段列表 + 一个点列表），不再逐帧调用 draw manager
+	if (drawManager)
+	{
+		if (samplePositions.size() < 2)
+			return;
 
-		if (i == displayEndTime)
+		std::vector<MColor> segmentColors;
+		segmentColors.reserve(linePositions.size());
+		for (size_t s = 1; s < lineTimes.size(); ++s)
 		{
-			if (drawManager)
-				VP2DrawUtils::drawPointWithColor(worldPos, GlobalSettings::pathSize * 2, curveColor, currentCameraMatrix, drawManager, frameContext);
-			else
-				drawUtils::drawPointWithColor(worldPos, GlobalSettings::pathSize, curveColor);
+			double factor = 1;
+			if (GlobalSettings::alternatingFrames)
+				factor = int(lineTimes[s]) % 2 == 1 ? 1.4 : 0.6;
+			segmentColors.push_back(curveColor * factor);
 		}
+
+		if (GlobalSettings::showPath && linePositions.size() > 1)
+			VP2DrawUtils::drawLineStrip(linePositions, segmentColors, GlobalSettings::pathSize, currentCameraMatrix, drawManager, frameContext);
+
+		// 最后一个采样点只有正好落在显示范围结尾时才画点
+		if (sampleTimes.back() != displayEndTime)
+			samplePositions.pop_back();
+		VP2DrawUtils::drawPointList(samplePositions, GlobalSettings::pathSize * 2, curveColor, currentCameraMatrix, drawManager, frameContext);
+		return;
+	}
+
+	// 旧视口同样先收集成一个线段列表和一个点列表，再各用一次顶点数组绘制
+	MPointArray lines, points;
+	MColorArray lineColors;
+	for (size_t s = 1; GlobalSettings::showPath && s < lineTimes.size(); ++s)
+	{
+        if (!isRangeInView(lineTimes[s - 1], lineTimes[s]))
+            continue;
+
+        double factor = 1;
+        if (GlobalSettings::alternatingFrames)
+            factor = int(lineTimes[s]) % 2 == 1 ? 1.4 : 0.6;
+
+		lines.append(MPoint(linePositions[s - 1]));
+		lines.append(MPoint(linePositions[s]));
+		lineColors.append(curveColor * factor);
+		lineColors.append(curveColor * factor);
 	}
+
+	for (size_t s = 1; s < sampleTimes.size(); ++s)
+	{
+        if (!isRangeInView(sampleTimes[s - 1], sampleTimes[s]))
+            continue;
+
+		points.append(MPoint(samplePositions[s - 1]));
+
+		if (sampleTimes[s] == displayEndTime)
+			points.append(MPoint(samplePositions[s]));
+	}
+
+	drawUtils::drawLineList(lines, lineColors, GlobalSettings::pathSize);
+	drawUtils::drawPointList(points, GlobalSettings::pathSize, curveColor);
+}
+
+// LOD 简化时必须保留的采样点：关键帧、显示帧号的帧，交替颜色时还有每个整数帧
+void MotionPath::getPinnedSamples(const std::vector<double> &times, std::vector<unsigned char> &pinned)
+{
+    pinned.assign(times.size(), 0);
+
+    // 当前帧由 drawCurrentFrame 单独绘制，不固定它，时间变化时简化结果才能按视图复用
+    int frameInterval = std::max(1, GlobalSettings::drawFrameInterval);
+
+    for (size_t s = 0; s < times.size(); ++s)
+    {
+        double t = times[s];
+        bool wholeFrame = std::fabs(t - std::floor(t + 0.5)) < 1e-6;
+        double labelOffset = std::fmod(t - displayStartTime, static_cast<double>(frameInterval));
+        bool labelled = std::min(std::fabs(labelOffset), frameInterval - std::fabs(labelOffset)) < 1e-6;
+
+        if (wholeFrame && GlobalSettings::alternatingFrames)
+            pinned[s] = 1;
+        else if (GlobalSettings::showFrameNumbers && labelled)
+            pinned[s] = 1;
+    }
+
+    // 关键帧不一定落在采样时间上，保留离它最近的采样点
+    const std::vector<double> &keyTimes = keyframesCache.getTimes();
+    for (size_t k = 0; k < keyTimes.size(); ++k)
+    {
+        double keyTime = keyTimes[k];
+        if (times.empty() || keyTime < times.front() || keyTime > times.back())
+            continue;
+
+        size_t index = std::lower_bound(times.begin(), times.end(), keyTime) - times.begin();
+        if (index < times.size())
+            pinned[index] = 1;
+        if (index > 0)
+            pinned[index - 1] = 1;
+    }
+}
+
+// 🚀 把一组帧的位置变换到绘制空间（世界空间，或摄像机空间），一次 transformKernel 调用完成
+// 摄像机空间但没有摄像机缓存时返回 false
+bool MotionPath::getDrawSpacePositions(const std::vector<double> &times, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, std::vector<MVector> &positions)
+{
+    bool cameraSpace = GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace;
+    if (cameraSpace && !cachePtr)
+        return false;
+
+    // ✅ 先补全所有矩阵再取指针：FrameCache 扩容会让之前取到的指针失效
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+        ensureParentAndPivotMatrixAtTime(times[i]);
+        if (cameraSpace)
+            cachePtr->ensureMatricesAtTime(times[i]);
+    }
+
+    transformKernel::PositionArray localPositions;
+    localPositions.reserve(times.size());
+    std::vector<const MMatrix*> parentMatrices(times.size());
+    std::vector<const MMatrix*> cameraMatrices(cameraSpace ? times.size() : 0);
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+        localPositions.push_back(getCachedPos(times[i]));
+        parentMatrices[i] = &pMatrixCache.get(times[i]);
+        if (cameraSpace)
+            cameraMatrices[i] = &cachePtr->matrixCache.get(times[i]);
+    }
+
+    positions.resize(times.size());
+    if (times.empty())
+        return true;
+
+    transformKernel::transformPositions(localPositions, &parentMatrices[0], cameraSpace ? &cameraMatrices[0] : NULL, cameraSpace ? &currentCameraMatrix : NULL, &positions[0]);
+    return true;
 }
 
 void MotionPath::expandKeyFramesCache(MFnAnimCurve& curve, const Keyframe::Axis& axisName, bool isTranslate)
@@ -638,7 +927,7 @@ void MotionPath::expandKeyFramesCache(MFnAnimCurve& curve, const Keyframe::Axis&
                 // Fix: Allow rotation keyframes to create new entries in keyframesCache
                 // Previously, rotation keyframes were only added if a translation keyframe already existed
                 // Now, pure rotation keyframes can also be displayed on the motion path
-                Keyframe* keyframePtr = &keyframesCache[keyTimeVal];
+                Keyframe* keyframePtr = &keyframesCache.findOrInsert(keyTimeVal);
 
                 if (isTranslate)
                 {
@@ -690,18 +979,31 @@ MVector MotionPath::getPos(double time)
 }
 
 // ✅ 优化：批量缓存位置数据（减少重复查询）
-// 在每次 draw() 开始时调用，一次性查询所有帧的位置
+// 在每次 draw() 开始时调用，只查询缓存中还没有的帧
+// 位置在刷新之间保留，曲线被编辑时才整体失效（见 prepareDrawCaches）
 // 注意：MPlug 读取必须在主线程，无法并行化（Maya API 限制）
 void MotionPath::cachePositionsForDraw(double startTime, double endTime)
 {
+	pathStats::ScopedTimer timer(pathStats::kCachePositionsForDraw);
+
 	if (constrained) return;  // 受约束的物体不需要缓存位置
 
-	// 清空上一次的临时缓存
-	drawPositionCache.clear();
+	// 滑动窗口，保留仍在范围内的帧（包括两侧预热的帧）
+	drawPositionCache.setWindow(startTime - GlobalSettings::cachePrefetchFrames, endTime + GlobalSettings::cachePrefetchFrames);
+
+	// 🚀 曲线快照可用时不读 plug，多线程直接计算
+	if (snapshotsValid())
+	{
+		samplePositionsFromSnapshots(startTime, endTime);
+		return;
+	}
 
 	// 批量查询位置（主线程，无法并行化）
 	for (double t = startTime; t <= endTime; t += 1.0)
 	{
+		if (drawPositionCache.contains(t))
+			continue;
+
 		MTime evalTime(t, MTime::uiUnit());
 		MDGContext context(evalTime);
 
@@ -711,7 +1013,9 @@ void MotionPath::cachePositionsForDraw(double startTime, double endTime)
 		pos.y = tyPlug.asDouble(context, &status);
 		pos.z = tzPlug.asDouble(context, &status);
 
-		drawPositionCache[t] = pos;
+		drawPositionCache.set(t, pos);
+		pathGeometry.markDirty(t);
+		pathStats::count(pathStats::kPositionEvaluations);
 	}
 }
 
@@ -720,14 +1024,240 @@ void MotionPath::cachePositionsForDraw(double startTime, double endTime)
 MVector MotionPath::getCachedPos(double time)
 {
 	// 尝试从缓存获取
-	auto it = drawPositionCache.find(time);
-	if (it != drawPositionCache.end())
+	const MVector *cached = drawPositionCache.find(time);
+	if (cached)
 	{
-		return it->second;  // 缓存命中（0.01ms）
+		pathStats::count(pathStats::kPositionCacheHits);
+		return *cached + getLiveOffset(time);  // 缓存命中（0.01ms）
 	}
 
 	// 缓存未命中（不应该发生），回退到实时查询
-	return getPos(time);  // 慢（5-8ms）
+	pathStats::count(pathStats::kPositionCacheMisses);
+	return getPos(time) + getLiveOffset(time);  // 慢（5-8ms）
+}
+
+// 🚀 管理器逐帧扫描：MotionPathManager::sweepFrames 为每一帧只创建一个 MDGContext，
+// 所有路径和摄像机共用，结果直接写入各自的缓存
+bool MotionPath::beginFrameSweep(double &start, double &end)
+{
+	positionsSwept = false;
+
+	// 非整数帧的显示范围由 cachePositionsForDraw 自己处理
+	if (displayStartTime != std::floor(displayStartTime) || displayEndTime < displayStartTime)
+		return false;
+
+	start = displayStartTime;
+	end = displayEndTime;
+
+	prepareDrawCaches();
+	drawPositionCache.setWindow(start - GlobalSettings::cachePrefetchFrames, end + GlobalSettings::cachePrefetchFrames);
+
+	// 有曲线快照的路径先并行算好位置，sweepFrame 只需要读父矩阵
+	if (!constrained && snapshotsValid())
+		samplePositionsFromSnapshots(start, end);
+
+	// 祖先链已编译的话父矩阵也并行算好，逐帧扫描就不再拉 DG
+	if (hierarchyValid())
+		cacheCompiledParentMatrices(start, end);
+	return true;
+}
+
+void MotionPath::sweepFrame(const double time, const MDGContext &context)
+{
+	if (time < displayStartTime || time > displayEndTime)
+		return;
+
+	if (!pMatrixCache.contains(time))
+	{
+		pMatrixCache.set(time, hierarchyValid() ? hierarchy.parentMatrix(time, GlobalSettings::usePivots) : getPMatrixAtTime(context));
+		pathGeometry.markDirty(time);
+		pathStats::count(pathStats::kParentMatrixCacheMisses);
+	}
+
+	if (!constrained && !drawPositionCache.contains(time))
+	{
+		drawPositionCache.set(time, getVectorFromPlugs(context, txPlug, tyPlug, tzPlug));
+		pathGeometry.markDirty(time);
+		pathStats::count(pathStats::kPositionEvaluations);
+	}
+}
+
+// 🚀 空闲预热：MotionPathManager::warmCaches 在 Maya 空闲时按时间预算逐帧调用
+// 只填写缓存窗口内（显示范围加两侧预热帧）还缺的帧
+bool MotionPath::warmFrame(const double time, const MDGContext &context)
+{
+	if (time < startTime || time > endTime)
+		return false;
+	if (time < pMatrixCache.firstFrame() || time > pMatrixCache.lastFrame())
+		return false;
+
+	bool warmed = false;
+	if (!pMatrixCache.contains(time))
+	{
+		pMatrixCache.set(time, hierarchyValid() ? hierarchy.parentMatrix(time, GlobalSettings::usePivots) : getPMatrixAtTime(context));
+		pathGeometry.markDirty(time);
+		warmed = true;
+	}
+
+	// 曲线刚被编辑过的话位置在下一次刷新时会整体丢弃，不用预热
+	if (!constrained && !positionsDirty && drawPositionCache.hasWindow() && time >= drawPositionCache.firstFrame() && time <= drawPositionCache.lastFrame() && !drawPositionCache.contains(time))
+	{
+		if (snapshotsValid())
+			drawPositionCache.set(time, MVector(snapshotX.evaluate(time), snapshotY.evaluate(time), snapshotZ.evaluate(time)));
+		else
+			drawPositionCache.set(time, getVectorFromPlugs(context, txPlug, tyPlug, tzPlug));
+		pathGeometry.markDirty(time);
+		warmed = true;
+	}
+
+	return warmed;
+}
+
+// ✅ 未打关键帧的当前值: 只在内存中叠加到采样位置上，绘制不再临时修改动画曲线
+void MotionPath::updateLiveValues()
+{
+	if (constrained)
+	{
+		liveX = liveY = liveZ = animCurveUtils::LiveValue();
+		return;
+	}
+
+	MTime currentTime = MAnimControl::currentTime();
+	animCurveUtils::getLiveValue(txPlug, currentTime, liveX);
+	animCurveUtils::getLiveValue(tyPlug, currentTime, liveY);
+	animCurveUtils::getLiveValue(tzPlug, currentTime, liveZ);
+}
+
+// 每次刷新开始时调用：曲线被编辑过就丢弃保留的位置，未打关键帧的值变化时重写保留的几何
+void MotionPath::prepareDrawCaches()
+{
+	updateLiveValues();
+
+	if (positionsDirty)
+	{
+		drawPositionCache.clear();
+		pathGeometry.markAllDirty();
+		positionsDirty = false;
+		snapshotsDirty = true;
+	}
+
+	updateSnapshots();
+
+	// 叠加值只在读取时加上，所以位置缓存不用失效，只有几何需要重写
+	bool liveActive = liveX.active || liveY.active || liveZ.active;
+	if (liveActive || liveValuesDrawn)
+		pathGeometry.markAllDirty();
+	liveValuesDrawn = liveActive;
+}
+
+// 🚀 曲线快照：只在曲线被编辑后重新拷贝（见 setKeyframesDirty），拷贝时会和 Maya 的求值结果比对
+// 不是直接由时间动画曲线驱动的 plug（约束、混合、动画层、表达式）保持无效，继续从 plug 读取
+void MotionPath::updateSnapshots()
+{
+	if (constrained)
+		return;
+
+	if (snapshotsDirty)
+	{
+		snapshotX.capture(txPlug);
+		snapshotY.capture(tyPlug);
+		snapshotZ.capture(tzPlug);
+		snapshotsDirty = false;
+		return;
+	}
+
+	// 没有连接的轴不会触发曲线编辑回调，每次刷新重新读一次值
+	bool staticChanged = false;
+	if (snapshotX.isStatic() && snapshotX.updateStaticValue(txPlug)) staticChanged = true;
+	if (snapshotY.isStatic() && snapshotY.updateStaticValue(tyPlug)) staticChanged = true;
+	if (snapshotZ.isStatic() && snapshotZ.updateStaticValue(tzPlug)) staticChanged = true;
+
+	if (staticChanged)
+	{
+		drawPositionCache.clear();
+		pathGeometry.markAllDirty();
+	}
+}
+
+// 快照求值不访问 Maya API，可以在工作线程里运行，写回缓存仍在主线程
+void MotionPath::samplePositionsFromSnapshots(const double startTime, const double endTime)
+{
+	std::vector<double> frames;
+	for (double t = startTime; t <= endTime; t += 1.0)
+	{
+		if (!drawPositionCache.contains(t))
+			frames.push_back(t);
+	}
+
+	int numFrames = static_cast<int>(frames.size());
+	std::vector<MVector> positions(numFrames);
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) if (numFrames > 50)
+#endif
+	for (int idx = 0; idx < numFrames; ++idx)
+		positions[idx] = MVector(snapshotX.evaluate(frames[idx]), snapshotY.evaluate(frames[idx]), snapshotZ.evaluate(frames[idx]));
+
+	for (int idx = 0; idx < numFrames; ++idx)
+	{
+		drawPositionCache.set(frames[idx], positions[idx]);
+		pathGeometry.markDirty(frames[idx]);
+	}
+}
+
+// 🚀 编译的层级求值器：祖先全是动画曲线直接驱动的普通变换时，拷贝它们的通道自己合成父矩阵
+// 有约束、表达式或其他连接的祖先（以及约束的物体本身）保持无效，继续从 DG 拉 parentMatrix
+bool MotionPath::hierarchyValid()
+{
+	if (constrained || !GlobalSettings::compiledHierarchy)
+		return false;
+
+	if (hierarchyDirty)
+	{
+		// 捕获时在当前帧和范围两端与 DG 的结果比对
+		std::vector<double> checkTimes;
+		checkTimes.push_back(MAnimControl::currentTime().as(MTime::uiUnit()));
+		checkTimes.push_back(startTime);
+		checkTimes.push_back(endTime);
+		checkTimes.push_back(std::floor((startTime + endTime) * 0.5));
+
+		hierarchy.capture(thisObject, pMatrixPlug, checkTimes);
+		hierarchyDirty = false;
+	}
+
+	return hierarchy.isValid();
+}
+
+void MotionPath::cacheCompiledParentMatrices(const double startTime, const double endTime)
+{
+	std::vector<double> frames;
+	for (double t = startTime; t <= endTime; t += 1.0)
+	{
+		if (!pMatrixCache.contains(t))
+			frames.push_back(t);
+	}
+
+	int numFrames = static_cast<int>(frames.size());
+	std::vector<MMatrix> matrices(numFrames);
+	bool usePivots = GlobalSettings::usePivots;
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) if (numFrames > 50)
+#endif
+	for (int idx = 0; idx < numFrames; ++idx)
+		matrices[idx] = hierarchy.parentMatrix(frames[idx], usePivots);
+
+	for (int idx = 0; idx < numFrames; ++idx)
+	{
+		pMatrixCache.set(frames[idx], matrices[idx]);
+		pathGeometry.markDirty(frames[idx]);
+	}
+	pathStats::count(pathStats::kParentMatrixCacheMisses, numFrames);
+}
+
+MVector MotionPath::getLiveOffset(const double time) const
+{
+	return MVector(liveX.offsetAtTime(time), liveY.offsetAtTime(time), liveZ.offsetAtTime(time));
 }
 
 // ✅ 优化：检测是否应该绘制详细信息（标签、切线）
@@ -771,37 +1301,37 @@ void MotionPath::setShowInOutTangents(const MFnAnimCurve &curveTX, const MFnAnim
     Keyframe *keyFramePtr;
     if (minTimeX >= displayStartTime && minTimeX <= displayEndTime)
     {
-        keyFramePtr = &keyframesCache[minTimeX];
+        keyFramePtr = &keyframesCache.findOrInsert(minTimeX);
         keyFramePtr->showInTangent = showTangent(minTimeX, keyFramePtr->yKeyId, minTimeY, keyFramePtr->zKeyId, minTimeZ);
     }
 
     if (minTimeY >= displayStartTime && minTimeY <= displayEndTime)
     {
-        keyFramePtr = &keyframesCache[minTimeY];
+        keyFramePtr = &keyframesCache.findOrInsert(minTimeY);
         keyFramePtr->showInTangent = showTangent(minTimeY, keyFramePtr->xKeyId, minTimeX, keyFramePtr->zKeyId, minTimeZ);
     }
 
     if (minTimeZ >= displayStartTime && minTimeZ <= displayEndTime)
     {
-        keyFramePtr = &keyframesCache[minTimeZ];
+        keyFramePtr = &keyframesCache.findOrInsert(minTimeZ);
         keyFramePtr->showInTangent = showTangent(minTimeZ, keyFramePtr->xKeyId, minTimeX, keyFramePtr->yKeyId, minTimeY);
     }
 
     if (maxTimeX >= displayStartTime && maxTimeX <= displayEndTime)
     {
-        keyFramePtr = &keyframesCache[maxTimeX];
+        keyFramePtr = &keyframesCache.findOrInsert(maxTimeX);
         keyFramePtr->showOutTangent = showTangent(maxTimeX, keyFramePtr->yKeyId, maxTimeY, keyFramePtr->zKeyId, maxTimeZ);
     }
 
     if (maxTimeY >= displayStartTime && maxTimeY <= displayEndTime)
     {
-        keyFramePtr = &keyframesCache[maxTimeY];
+        keyFramePtr = &keyframesCache.findOrInsert(maxTimeY);
         keyFramePtr->showOutTangent = showTangent(maxTimeY, keyFramePtr->xKeyId, maxTimeX, keyFramePtr->zKeyId, maxTimeZ);
     }
 
     if (maxTimeZ >= displayStartTime && maxTimeZ <= displayEndTime)
     {
-        keyFramePtr = &keyframesCache[maxTimeZ];
+        keyFramePtr = &keyframesCache.findOrInsert(maxTimeZ);
         keyFramePtr->showOutTangent = showTangent(maxTimeZ, keyFramePtr->xKeyId, maxTimeX, keyFramePtr->yKeyId, maxTimeY);
     }
 }
@@ -809,7 +1339,11 @@ void MotionPath::setShowInOutTangents(const MFnAnimCurve &curveTX, const MFnAnim
 MVector MotionPath::getVectorFromPlugs(const MTime &evalTime, const MPlug &x, const MPlug &y, const MPlug &z)
 {
     MDGContext context(evalTime);
+    return getVectorFromPlugs(context, x, y, z);
+}
 
+MVector MotionPath::getVectorFromPlugs(const MDGContext &context, const MPlug &x, const MPlug &y, const MPlug &z)
+{
     MVector pos;
     pos.x = x.asDouble(context);
     pos.y = y.asDouble(context);
@@ -819,18 +1353,24 @@ MVector MotionPath::getVectorFromPlugs(const MTime &evalTime, const MPlug &x, co
 
 MMatrix MotionPath::getPMatrixAtTime(const MTime &evalTime)
 {
-    MMatrix m = getMatrixFromPlug(pMatrixPlug, evalTime);
+    MDGContext context(evalTime);
+    return getPMatrixAtTime(context);
+}
+
+MMatrix MotionPath::getPMatrixAtTime(const MDGContext &context)
+{
+    MMatrix m = getMatrixFromPlug(pMatrixPlug, context);
 
     if (GlobalSettings::usePivots)
     {
-        MVector piv = getVectorFromPlugs(evalTime, rpxPlug, rpyPlug, rpzPlug);
+        MVector piv = getVectorFromPlugs(context, rpxPlug, rpyPlug, rpzPlug);
 		MMatrix pivotMtx;
         pivotMtx[3][0] = piv.x;
         pivotMtx[3][1] = piv.y;
         pivotMtx[3][2] = piv.z;
 		m = pivotMtx * m;
 
-        piv = getVectorFromPlugs(evalTime, rptxPlug, rptyPlug, rptzPlug);
+        piv = getVectorFromPlugs(context, rptxPlug, rptyPlug, rptzPlug);
         pivotMtx[3][0] = piv.x;
         pivotMtx[3][1] = piv.y;
         pivotMtx[3][2] = piv.z;
@@ -842,11 +1382,17 @@ MMatrix MotionPath::getPMatrixAtTime(const MTime &evalTime)
 
 void MotionPath::ensureParentAndPivotMatrixAtTime(const double time)
 {
-    if(pMatrixCache.find(time) == pMatrixCache.end())
+    if(!pMatrixCache.contains(time))
     {
-        MTime evalTime(time, MTime::uiUnit());
-        pMatrixCache[time] = getPMatrixAtTime(evalTime);
+        if (hierarchyValid())
+            pMatrixCache.set(time, hierarchy.parentMatrix(time, GlobalSettings::usePivots));
+        else
+            pMatrixCache.set(time, getPMatrixAtTime(MTime(time, MTime::uiUnit())));
+        pathGeometry.markDirty(time);
+        pathStats::count(pathStats::kParentMatrixCacheMisses);
     }
+    else
+        pathStats::count(pathStats::kParentMatrixCacheHits);
 }
 
 void MotionPath::cacheKeyFrames(MFnAnimCurve& curveTX,
@@ -859,6 +1405,8 @@ void MotionPath::cacheKeyFrames(MFnAnimCurve& curveTX,
     const MMatrix& currentCameraMatrix)
     //                               ^^^^^^^^^^^^^ �Ƴ�����const
 {
+    pathStats::ScopedTimer timer(pathStats::kCacheKeyFrames);
+
     if (isCurveTypeAnimatable(curveTX.animCurveType()))
         expandKeyFramesCache(curveTX, Keyframe::kAxisX, true);
 
@@ -882,14 +1430,11 @@ void MotionPath::cacheKeyFrames(MFnAnimCurve& curveTX,
 
     setShowInOutTangents(curveTX, curveTY, curveTZ);
 
-    int i = 0;
-    for (KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
+    // ids are the indices of the table, so a lookup by id is direct
+    for (size_t k = 0; k < keyframesCache.size(); ++k)
     {
-        Keyframe* key = &keyIt->second;
-        key->id = i;
-
-        if (selectedKeyTimes.find(key->time) != selectedKeyTimes.end())
-            key->selectedFromTool = true;
+        Keyframe* key = &keyframesCache.at(k);
+        key->id = static_cast<int>(k);
 
         // OVERRIDE: ������ڻ���,����ʾ�������������
         if (isDrawing)
@@ -902,16 +1447,16 @@ void MotionPath::cacheKeyFrames(MFnAnimCurve& curveTX,
 
         // ✅ 使用缓存的位置（快速）
         key->position = getCachedPos(key->time);
-        key->worldPosition = multPosByParentMatrix(key->position, pMatrixCache[key->time]);
+        key->worldPosition = multPosByParentMatrix(key->position, pMatrixCache.get(key->time));
         if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
         {
             if (!cachePtr) continue;
             cachePtr->ensureMatricesAtTime(key->time);
-            key->worldPosition = MPoint(key->worldPosition) * cachePtr->matrixCache[key->time] * currentCameraMatrix;
+            key->worldPosition = MPoint(key->worldPosition) * cachePtr->matrixCache.get(key->time) * currentCameraMatrix;
         }
 
-        key->inTangentWorld = multPosByParentMatrix((-key->inTangent) + key->position, pMatrixCache[key->time]);
-        key->outTangentWorld = multPosByParentMatrix(key->outTangent + key->position, pMatrixCache[key->time]);
+        key->inTangentWorld = multPosByParentMatrix((-key->inTangent) + key->position, pMatrixCache.get(key->time));
+        key->outTangentWorld = multPosByParentMatrix(key->outTangent + key->position, pMatrixCache.get(key->time));
 
         if (key->showInTangent)
         {
@@ -925,13 +1470,13 @@ void MotionPath::cacheKeyFrames(MFnAnimCurve& curveTX,
                 MVector inWorldPosition;
                 if (GlobalSettings::motionPathDrawMode == GlobalSettings::kWorldSpace)
                     // ✅ 使用缓存的位置（快速）
-                    inWorldPosition = multPosByParentMatrix(getCachedPos(prevTime), pMatrixCache[prevTime]) - key->worldPosition;
+                    inWorldPosition = multPosByParentMatrix(getCachedPos(prevTime), pMatrixCache.get(prevTime)) - key->worldPosition;
                 else
                 {
                     if (!cachePtr) continue;
                     cachePtr->ensureMatricesAtTime(prevTime, true);
                     // ✅ 使用缓存的位置（快速）
-                    inWorldPosition = MVector(MPoint(multPosByParentMatrix(getCachedPos(prevTime), pMatrixCache[prevTime])) * cachePtr->matrixCache[prevTime] * currentCameraMatrix) - key->worldPosition;
+                    inWorldPosition = MVector(MPoint(multPosByParentMatrix(getCachedPos(prevTime), pMatrixCache.get(prevTime))) * cachePtr->matrixCache.get(prevTime) * currentCameraMatrix) - key->worldPosition;
                 }
 
                 inWorldPosition.normalize();
@@ -951,22 +1496,22 @@ void MotionPath::cacheKeyFrames(MFnAnimCurve& curveTX,
                 MVector outWorldPosition;
                 if (GlobalSettings::motionPathDrawMode == GlobalSettings::kWorldSpace)
                     // ✅ 使用缓存的位置（快速）
-                    outWorldPosition = multPosByParentMatrix(getCachedPos(afterTime), pMatrixCache[afterTime]) - key->worldPosition;
+                    outWorldPosition = multPosByParentMatrix(getCachedPos(afterTime), pMatrixCache.get(afterTime)) - key->worldPosition;
                 else
                 {
                     if (!cachePtr) continue;
                     cachePtr->ensureMatricesAtTime(afterTime, true);
                     // ✅ 使用缓存的位置（快速）
-                    outWorldPosition = MVector(MPoint(multPosByParentMatrix(getCachedPos(afterTime), pMatrixCache[afterTime])) * cachePtr->matrixCache[afterTime] * currentCameraMatrix) - key->worldPosition;
+                    outWorldPosition = MVector(MPoint(multPosByParentMatrix(getCachedPos(afterTime), pMatrixCache.get(afterTime))) * cachePtr->matrixCache.get(afterTime) * currentCameraMatrix) - key->worldPosition;
                 }
 
                 outWorldPosition.normalize();
                 key->outTangentWorldFromCurve = outWorldPosition * key->outTangent.length() + key->worldPosition;
             }
         }
-
-        i += 1;
     }
+
+    keyframesCache.finalize();
 }
 
 void MotionPath::drawTangents(M3dView &view, MMatrix& currentCameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
@@ -978,10 +1523,28 @@ void MotionPath::drawTangents(M3dView &view, MMatrix& currentCameraMatrix, MHWRe
     if ((QApplication::mouseButtons() != Qt::NoButton) && (QApplication::keyboardModifiers() == Qt::AltModifier))
         return;
 
+	// the legacy viewport gathers every handle and draws them with one line list and one point list
+	MPointArray handleLines, handlePoints;
+	MColorArray handleLineColors, handlePointColors;
+
 	MColor tangentColor;
-	for(KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
+	for(KeyframeTable::iterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
 	{
-		Keyframe* key = &keyIt->second;
+		Keyframe* key = &*keyIt;
+
+        // the handles reach out of the chunk of the key, so they are tested on their own
+        if (chunksCulled)
+        {
+            PathBounds::Box handles;
+            handles.expand(MPoint(key->worldPosition));
+            if (key->showInTangent)
+                handles.expand(MPoint(key->inTangentWorldFromCurve));
+            if (key->showOutTangent)
+                handles.expand(MPoint(key->outTangentWorldFromCurve));
+            if (!drawFrustum.intersects(handles))
+                continue;
+        }
+
         if (isWeighted)
             tangentColor = GlobalSettings::weightedPathTangentColor;
         else
@@ -996,8 +1559,12 @@ void MotionPath::drawTangents(M3dView &view, MMatrix& currentCameraMatrix, MHWRe
 			}
 			else
 			{
-				drawUtils::drawLineWithColor(key->worldPosition, key->inTangentWorldFromCurve, 1.0, tangentColor);
-				drawUtils::drawPointWithColor(key->inTangentWorldFromCurve, GlobalSettings::frameSize, tangentColor);
+				handleLines.append(MPoint(key->worldPosition));
+				handleLines.append(MPoint(key->inTangentWorldFromCurve));
+				handleLineColors.append(tangentColor);
+				handleLineColors.append(tangentColor);
+				handlePoints.append(MPoint(key->inTangentWorldFromCurve));
+				handlePointColors.append(tangentColor);
 			}
         }
 
@@ -1010,15 +1577,27 @@ void MotionPath::drawTangents(M3dView &view, MMatrix& currentCameraMatrix, MHWRe
 			}
 			else
 			{
-				drawUtils::drawLineWithColor(key->worldPosition, key->outTangentWorldFromCurve, 1.0, tangentColor);
-				drawUtils::drawPointWithColor(key->outTangentWorldFromCurve, GlobalSettings::frameSize, tangentColor);
+				handleLines.append(MPoint(key->worldPosition));
+				handleLines.append(MPoint(key->outTangentWorldFromCurve));
+				handleLineColors.append(tangentColor);
+				handleLineColors.append(tangentColor);
+				handlePoints.append(MPoint(key->outTangentWorldFromCurve));
+				handlePointColors.append(tangentColor);
 			}
         }
 	}
+
+	if (!drawManager)
+	{
+		drawUtils::drawLineList(handleLines, handleLineColors, 1.0);
+		drawUtils::drawPointList(handlePoints, handlePointColors, GlobalSettings::frameSize);
+	}
 }
 
 void MotionPath::drawFrameLabels(M3dView &view, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
+    pathStats::ScopedTimer timer(pathStats::kDrawFrameLabels);
+
     MColor frameLabelColor = GlobalSettings::frameLabelColor;
     MColor keyframeLabelColor = GlobalSettings::keyframeLabelColor;
     if(this->selectedFromTool) {
@@ -1026,119 +1605,125 @@ void MotionPath::drawFrameLabels(M3dView &view, CameraCache* cachePtr, const MMa
         keyframeLabelColor *= 1.3;
     }
 
+	// 🚀 先收集所有标签的时间，位置一次批量变换后再绘制
+	std::vector<double> labelTimes;
+	std::vector<bool> isKeyLabel;
+
 	// When showing key numbers, we need to check all keyframes regardless of drawFrameInterval
 	// Otherwise keyframes between interval steps will be missed
 	if (GlobalSettings::showKeyFrameNumbers)
 	{
 		// Draw key frame numbers at actual keyframe positions
-		for(KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
+		for(KeyframeTable::iterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
 		{
-			double keyTime = keyIt->first;
+			double keyTime = keyIt->time;
 			if (keyTime < displayStartTime || keyTime > displayEndTime)
 				continue;
 
-			ensureParentAndPivotMatrixAtTime(keyTime);
-			MVector worldPos = multPosByParentMatrix(getPos(keyTime), pMatrixCache[keyTime]);
-			if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
-			{
-				if (!cachePtr) continue;
-				cachePtr->ensureMatricesAtTime(keyTime);
-				worldPos = MPoint(worldPos) * cachePtr->matrixCache[keyTime] * currentCameraMatrix;
-			}
-
-			// Use keyframeLabelSize and keyframeLabelColor for keyframe numbers
-			if (drawManager)
-				VP2DrawUtils::drawFrameLabel(keyTime, worldPos, view, GlobalSettings::keyframeLabelSize, keyframeLabelColor, currentCameraMatrix, drawManager, frameContext);
-			else
-				drawUtils::drawFrameLabel(keyTime, worldPos, view, GlobalSettings::keyframeLabelSize, keyframeLabelColor, currentCameraMatrix);
+			labelTimes.push_back(keyTime);
+			isKeyLabel.push_back(true);
 		}
 	}
 
 	// Draw regular frame numbers at interval steps (only if enabled)
 	if (GlobalSettings::showFrameNumbers)
 	{
-//		// Always show start and end frame numbers, then fill in between with interval
+		// Always show start and end frame numbers, then fill in between with interval
 		int frameInterval = GlobalSettings::drawFrameInterval;
 		if (frameInterval < 1) frameInterval = 1;
-//
-//		// Draw start frame (if not a keyframe or not showing keyframe numbers)
-		bool skipStart = false;
-		if (GlobalSettings::showKeyFrameNumbers && GlobalSettings::showKeyFrames)
-		{
-			skipStart = keyframesCache.find(displayStartTime) != keyframesCache.end();
-		}
-		if (!skipStart)
+
+		// Skip frames that are keyframes when we're showing keyframe numbers
+		bool skipKeys = GlobalSettings::showKeyFrameNumbers && GlobalSettings::showKeyFrames;
+
+		// Draw start frame (if not a keyframe or not showing keyframe numbers)
+		if (!skipKeys || keyframesCache.find(displayStartTime) == keyframesCache.end())
 		{
-			ensureParentAndPivotMatrixAtTime(displayStartTime);
-			MVector worldPos = multPosByParentMatrix(getPos(displayStartTime), pMatrixCache[displayStartTime]);
-			if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
-			{
-				if (cachePtr) {
-					cachePtr->ensureMatricesAtTime(displayStartTime);
-					worldPos = MPoint(worldPos) * cachePtr->matrixCache[displayStartTime] * currentCameraMatrix;
-				}
-			}
-			// Use frameLabelSize and frameLabelColor for regular frame numbers
-			if (drawManager)
-				VP2DrawUtils::drawFrameLabel(displayStartTime, worldPos, view, GlobalSettings::frameLabelSize, frameLabelColor, currentCameraMatrix, drawManager, frameContext);
-			else
-				drawUtils::drawFrameLabel(displayStartTime, worldPos, view, GlobalSettings::frameLabelSize, frameLabelColor, currentCameraMatrix);
+			labelTimes.push_back(displayStartTime);
+			isKeyLabel.push_back(false);
 		}
 
 		// Draw intermediate frames at intervals
 		for(double i = displayStartTime + frameInterval; i < displayEndTime; i += frameInterval)
 		{
-			// Skip if this is a keyframe and we're showing keyframe numbers
-			if (GlobalSettings::showKeyFrameNumbers && GlobalSettings::showKeyFrames)
-			{
-				bool hasKey = keyframesCache.find(i) != keyframesCache.end();
-				if (hasKey)
-					continue;
-			}
-
-			ensureParentAndPivotMatrixAtTime(i);
-			MVector worldPos = multPosByParentMatrix(getPos(i), pMatrixCache[i]);
-			if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
-			{
-				if (cachePtr) {
-					cachePtr->ensureMatricesAtTime(i);
-					worldPos = MPoint(worldPos) * cachePtr->matrixCache[i] * currentCameraMatrix;
-				}
-			}
+			if (skipKeys && keyframesCache.find(i) != keyframesCache.end())
+				continue;
 
-			// Use frameLabelSize and frameLabelColor for regular frame numbers
-			if (drawManager)
-				VP2DrawUtils::drawFrameLabel(i, worldPos, view, GlobalSettings::frameLabelSize, frameLabelColor, currentCameraMatrix, drawManager, frameContext);
-			else
-				drawUtils::drawFrameLabel(i, worldPos, view, GlobalSettings::frameLabelSize, frameLabelColor, currentCameraMatrix);
+			labelTimes.push_back(i);
+			isKeyLabel.push_back(false);
 		}
 
 		// Draw end frame (if not a keyframe or not showing keyframe numbers, and not same as start)
-		if (displayEndTime > displayStartTime)
+		if (displayEndTime > displayStartTime && (!skipKeys || keyframesCache.find(displayEndTime) == keyframesCache.end()))
 		{
+			labelTimes.push_back(displayEndTime);
+			isKeyLabel.push_back(false);
+		}
+	}
 
-			bool skipEnd = false;
-			if (GlobalSettings::showKeyFrameNumbers && GlobalSettings::showKeyFrames)
-			{
-				skipEnd = keyframesCache.find(displayEndTime) != keyframesCache.end();
-			}
-			if (!skipEnd)
+	// 视图外分块上的标签不做变换
+	if (chunksCulled)
+	{
+		size_t kept = 0;
+		for (size_t l = 0; l < labelTimes.size(); ++l)
+		{
+			if (!isRangeInView(labelTimes[l], labelTimes[l]))
+				continue;
+			labelTimes[kept] = labelTimes[l];
+			isKeyLabel[kept] = isKeyLabel[l];
+			++kept;
+		}
+		labelTimes.resize(kept);
+		isKeyLabel.resize(kept);
+	}
+
+	std::vector<MVector> labelPositions;
+	if (labelTimes.empty() || !getDrawSpacePositions(labelTimes, cachePtr, currentCameraMatrix, labelPositions))
+		return;
+
+	// 🚀 标签文字按帧缓存，屏幕上与已绘制标签重叠的直接丢弃（关键帧号先放，优先保留）
+	FrameLabelLayer *labelLayer = mpManager.getLabelLayerPtr();
+	MVector zVec(currentCameraMatrix[2][0], currentCameraMatrix[2][1], currentCameraMatrix[2][2]);
+	MVector cPos(currentCameraMatrix[3][0], currentCameraMatrix[3][1], currentCameraMatrix[3][2]);
+
+	for (size_t l = 0; l < labelTimes.size(); ++l)
+	{
+		// Use keyframeLabelSize and keyframeLabelColor for keyframe numbers, frameLabelSize and frameLabelColor for regular frame numbers
+		double labelSize = isKeyLabel[l] ? GlobalSettings::keyframeLabelSize : GlobalSettings::frameLabelSize;
+		const MColor &labelColor = isKeyLabel[l] ? keyframeLabelColor : frameLabelColor;
+		const MString &labelText = labelLayer->text(labelTimes[l]);
+
+		if (drawManager)
+		{
+			if ((cPos - labelPositions[l]) * zVec <= 0.0001)
+				continue;
+
+			double viewX, viewY;
+			frameContext->worldToViewport(labelPositions[l], viewX, viewY);
+			viewY += GlobalSettings::frameSize * labelSize;
+
+			unsigned int fontSize = FrameLabelLayer::fontPixelSize(labelSize);
+			if (GlobalSettings::declutterLabels && !labelLayer->place(viewX, viewY, FrameLabelLayer::textWidth(labelText, fontSize), fontSize))
+				continue;
+
+			VP2DrawUtils::drawFrameLabel(labelText, viewX, viewY, labelSize, labelColor, drawManager);
+		}
+		else
+		{
+			if (GlobalSettings::declutterLabels)
 			{
-				ensureParentAndPivotMatrixAtTime(displayEndTime);
-				MVector worldPos = multPosByParentMatrix(getPos(displayEndTime), pMatrixCache[displayEndTime]);
-				if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
-				{
-					if (cachePtr) {
-						cachePtr->ensureMatricesAtTime(displayEndTime);
-						worldPos = MPoint(worldPos) * cachePtr->matrixCache[displayEndTime] * currentCameraMatrix;
-					}
-				}
-				// Use frameLabelSize and frameLabelColor for regular frame numbers
-				if (drawManager)
-					VP2DrawUtils::drawFrameLabel(displayEndTime, worldPos, view, GlobalSettings::frameLabelSize, frameLabelColor, currentCameraMatrix, drawManager, frameContext);
-				else
-					drawUtils::drawFrameLabel(displayEndTime, worldPos, view, GlobalSettings::frameLabelSize, frameLabelColor, currentCameraMatrix);
+				if ((cPos - labelPositions[l]) * zVec <= 0.0001)
+					continue;
+
+				short viewX, viewY;
+				view.worldToView(labelPositions[l], viewX, viewY);
+
+				// the legacy text is scaled from the default font size
+				unsigned int fontSize = static_cast<unsigned int>(std::max(0.5, std::min(labelSize, 10.0)) * 14.0);
+				if (!labelLayer->place(viewX, viewY + GlobalSettings::frameSize, FrameLabelLayer::textWidth(labelText, fontSize), fontSize))
+					continue;
 			}
+
+			drawUtils::drawFrameLabel(labelText, labelPositions[l], view, labelSize, labelColor, currentCameraMatrix);
 		}
 	}
 }
@@ -1153,12 +1738,12 @@ void MotionPath::drawCurrentFrame(CameraCache* cachePtr, const MMatrix &currentC
 
     ensureParentAndPivotMatrixAtTime(currentTimeValue);
 
-    MVector worldPos = multPosByParentMatrix(getPos(currentTimeValue), this->pMatrixCache[currentTimeValue]);
+    MVector worldPos = multPosByParentMatrix(getCachedPos(currentTimeValue), this->pMatrixCache.get(currentTimeValue));
     if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
     {
         if (!cachePtr) return;
         cachePtr->ensureMatricesAtTime(currentTimeValue);
-        worldPos = MPoint(worldPos) * cachePtr->matrixCache[currentTimeValue] * currentCameraMatrix;
+        worldPos = MPoint(worldPos) * cachePtr->matrixCache.get(currentTimeValue) * currentCameraMatrix;
     }
 
 	if (drawManager)
@@ -1167,21 +1752,64 @@ void MotionPath::drawCurrentFrame(CameraCache* cachePtr, const MMatrix &currentC
 		drawUtils::drawPointWithColor(worldPos, GlobalSettings::frameSize * GlobalSettings::CURRENT_FRAME_SIZE_MULTIPLIER, frameColor);
 }
 
-void MotionPath::drawPath(M3dView &view, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, const bool selecting, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
+bool MotionPath::cullAgainstView(const PathBounds &bounds)
 {
-    // ✅ 总是绘制主路径（核心功能）
-    drawFrames(cachePtr, GlobalSettings::cameraMatrix, view, drawManager, frameContext);
+    chunksCulled = true;
+    pathCulled = !drawFrustum.cull(bounds, visibleChunks);
+    return !pathCulled;
+}
+
+// true when a chunk holding a sample between the two times is in the view
+bool MotionPath::isRangeInView(const double fromTime, const double toTime) const
+{
+    if (!chunksCulled || visibleChunks.empty() || drawInterval <= 0)
+        return true;
+
+    int last = static_cast<int>(visibleChunks.size()) - 1;
+    int first = static_cast<int>(std::floor((fromTime - displayStartTime) / drawInterval + 1e-6)) / static_cast<int>(PathBounds::kChunkSize);
+    int end = static_cast<int>(std::floor((toTime - displayStartTime) / drawInterval + 1e-6)) / static_cast<int>(PathBounds::kChunkSize);
+    first = std::max(0, std::min(first, last));
+    end = std::max(first, std::min(end, last));
 
-    if (!selecting)
+    for (int c = first; c <= end; ++c)
+        if (visibleChunks[c])
+            return true;
+    return false;
+}
+
+void MotionPath::drawPath(M3dView &view, CameraCache* cachePtr, const MMatrix &currentCameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
+{
+    // 🚀 视锥剔除：世界空间下整条路径或 64 个采样一组的分块在视图外时，后面的线段、标签和切线都跳过
+    // 保留几何的包围盒随顶点一起更新，没有保留几何时由 drawFrames 用这一次的采样点建立
+    drawFrustum = ViewFrustum();
+    chunksCulled = false;
+    pathCulled = false;
+    if (GlobalSettings::frustumCulling && GlobalSettings::motionPathDrawMode == GlobalSettings::kWorldSpace)
     {
-        // ✅ 总是绘制当前帧
-        drawCurrentFrame(cachePtr, GlobalSettings::cameraMatrix, view, drawManager, frameContext);
+        pathLod::ScreenProjection projection;
+        if (pathLod::getScreenProjection(view, frameContext, projection))
+            drawFrustum.set(projection.viewProjection);
 
-        // ✅ 延迟绘制帧号标签（交互时跳过以提升性能）
-        if (shouldDrawDetails() && (GlobalSettings::showKeyFrameNumbers || GlobalSettings::showFrameNumbers))
-            drawFrameLabels(view, cachePtr, GlobalSettings::cameraMatrix, drawManager, frameContext);
+        if (retainedDraw && drawFrustum.isSet())
+        {
+            buildDrawGeometry();
+            if (!cullAgainstView(pathGeometry.getBounds()))
+                return;
+        }
     }
 
+    // ✅ 总是绘制主路径（核心功能）
+    drawFrames(cachePtr, GlobalSettings::cameraMatrix, view, drawManager, frameContext);
+    if (pathCulled)
+        return;
+
+    // ✅ 总是绘制当前帧
+    drawCurrentFrame(cachePtr, GlobalSettings::cameraMatrix, view, drawManager, frameContext);
+
+    // ✅ 延迟绘制帧号标签（交互时跳过以提升性能）
+    if (shouldDrawDetails() && (GlobalSettings::showKeyFrameNumbers || GlobalSettings::showFrameNumbers))
+        drawFrameLabels(view, cachePtr, GlobalSettings::cameraMatrix, drawManager, frameContext);
+
     if (GlobalSettings::showKeyFrames && keyframesCache.size() > 0)
     {
         // ✅ 延迟绘制切线（交互时跳过以提升性能）
@@ -1196,35 +1824,50 @@ void MotionPath::drawPath(M3dView &view, CameraCache* cachePtr, const MMatrix &c
 
 void MotionPath::draw(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
-    MTime currentTime = MAnimControl::currentTime();
+    if (!prepareDraw(cachePtr, drawManager))
+        return;
 
-    MStatus xStatus, yStatus, zStatus;
-	MFnAnimCurve curveX(txPlug, &xStatus);
-	MFnAnimCurve curveY(tyPlug, &yStatus);
-	MFnAnimCurve curveZ(tzPlug, &zStatus);
-    MFnAnimCurve curveRotX(rxPlug);
-	MFnAnimCurve curveRotY(ryPlug);
-	MFnAnimCurve curveRotZ(rzPlug);
+    buildDrawGeometry();
+    submitDraw(view, cachePtr, drawManager, frameContext);
+}
 
-    //storing values to keep the curve appear like it was edited in real time (won't happen if autoKeyFrame is off)
-    double newXValue, newYValue, newZValue;
-    double oldXValue, oldYValue, oldZValue;
-    int newKeyX, newKeyY, newKeyZ;
-    int oldKeyX, oldKeyY, oldKeyZ;
-    bool xUpdated=false, yUpdated=false, zUpdated=false;
+void MotionPath::submitDraw(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
+{
+    drawPath(view, cachePtr, preparedCameraMatrix, drawManager, frameContext);
+}
 
-    //Refreshing the parent matrix cache if we need to do so
-    if (GlobalSettings::lockedMode && GlobalSettings::lockedModeInteractive && getWorldSpaceCallbackCalled())
+// 🚀 保留几何的顶点：只用 prepareDraw 已经缓存好的位置和父矩阵，不调用 Maya API
+// 每条路径只写自己的数据，管理器可以把多条路径放进一个并行循环里
+void MotionPath::buildDrawGeometry()
+{
+    if (!retainedDraw || !pathGeometry.needsUpdate())
+        return;
+
+    for (unsigned int s = 0; s < pathGeometry.numSamples(); ++s)
     {
-        if (QApplication::mouseButtons() != Qt::LeftButton)
-        {
-            // 优化A+D: 清空缓存并标记失效
-            // 后续的cacheParentMatrixRange会智能重建，只计算需要的帧范围
-            clearParentMatrixCache();
-            cacheParentMatrixRangeForWorldCallback(tempAncestorNode);
-            setWorldSpaceCallbackCalled(false, MObject());
-        }
+        if (!pathGeometry.isSampleDirty(s))
+            continue;
+
+        double t = pathGeometry.sampleTime(s);
+        pathGeometry.setSample(s, multPosByParentMatrix(getCachedPos(t), pMatrixCache.get(t)));
     }
+    pathGeometry.clearDirty();
+}
+
+// 主线程部分：所有需要 Maya API 的查询（缓存、关键帧、Qt 鼠标状态）都在这里完成
+// 摄像机空间没有摄像机缓存时返回 false，这一次不绘制
+bool MotionPath::prepareDraw(CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager)
+{
+    prepareWorldData();
+    return prepareView(cachePtr);
+}
+
+// 🚀 世界空间的数据和摄像机无关：同一次刷新里多个面板只计算一次（见 MotionPathManager::beginRefreshTick）
+void MotionPath::prepareWorldData()
+{
+    //Refreshing the parent matrix cache if we need to do so
+    if (GlobalSettings::lockedMode && GlobalSettings::lockedModeInteractive && getWorldSpaceCallbackCalled())
+        updateParentMatricesForAncestors();
 
     // 🚀 优化B: 提前批量预计算 - 确保缓存覆盖绘制范围
     // 这样 drawFrames 循环中的 ensureParentAndPivotMatrixAtTime 都会命中缓存
@@ -1232,61 +1875,127 @@ void MotionPath::draw(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawMa
 
     // ✅ 优化C: 批量缓存位置数据（减少重复查询）
     // 在这次 draw() 中，所有函数都从缓存读取，避免重复查询
-    cachePositionsForDraw(displayStartTime, displayEndTime);
-
-    MMatrix currentCameraMatrix;
-    if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
+    // 如果管理器的逐帧扫描已经采样过本次刷新的位置，就不再重复查询
+    if (positionsSwept)
+        positionsSwept = false;
+    else
     {
-        if (!cachePtr) return;
-        double currentTime = MAnimControl::currentTime().as(MTime::uiUnit());
-        currentCameraMatrix = cachePtr->matrixCache[currentTime].inverse();
+        prepareDrawCaches();
+        cachePositionsForDraw(displayStartTime, displayEndTime);
     }
 
     if (!constrained)
     {
-        xUpdated = animCurveUtils::updateCurve(txPlug, curveX, currentTime, oldXValue, newXValue, newKeyX, oldKeyX);
-        yUpdated = animCurveUtils::updateCurve(tyPlug, curveY, currentTime, oldYValue, newYValue, newKeyY, oldKeyY);
-        zUpdated = animCurveUtils::updateCurve(tzPlug, curveZ, currentTime, oldZValue, newZValue, newKeyZ, oldKeyZ);
-        
+        MFnAnimCurve curveX(txPlug);
+        MFnAnimCurve curveY(tyPlug);
+        MFnAnimCurve curveZ(tzPlug);
         isWeighted = curveX.isWeighted() || curveY.isWeighted() || curveZ.isWeighted();
-        
-        keyframesCache.clear();
-
-        cacheKeyFrames(curveX, curveY, curveZ, curveRotX, curveRotY, curveRotZ, cachePtr, currentCameraMatrix);
     }
-    
-    drawPath(view, cachePtr, currentCameraMatrix, false, drawManager, frameContext);
-     
-    //restoring the previous values if a keyframe was not actually set by the user
-    if (xUpdated && xStatus != MS::kNotFound)
+
+    // camera space 的关键帧位置依赖当前相机，由 prepareView 逐个面板重建
+    if (GlobalSettings::motionPathDrawMode == GlobalSettings::kWorldSpace)
+        updateKeyframes(NULL, MMatrix());
+
+    drawColor = isWeighted ? GlobalSettings::weightedPathColor : GlobalSettings::pathColor;
+    if(this->selectedFromTool)  drawColor *= 1.3;
+    drawColor *= colorMultiplier;
+
+    // 采样间隔固定，远处和密集的部分由 drawFrames 里的屏幕空间简化（LOD）处理，点击鼠标时路径形状不再跳变
+    drawInterval = GlobalSettings::drawTimeInterval;
+
+    // 旧视口也用保留几何，顶点数组和 VP2 共用同一份数据
+    retainedDraw = GlobalSettings::retainedGeometry && GlobalSettings::motionPathDrawMode == GlobalSettings::kWorldSpace;
+    if (retainedDraw)
     {
-        animCurveUtils::restoreCurve(curveX, currentTime, oldXValue, newKeyX, oldKeyX);
-        this->txPlug.setValue(newXValue);
+        pathGeometry.setLayout(displayStartTime, displayEndTime, drawInterval, drawColor, GlobalSettings::alternatingFrames);
+
+        // ✅ 脏采样点用到的矩阵和位置先在主线程补齐，buildDrawGeometry 里只剩纯计算
+        for (unsigned int s = 0; pathGeometry.needsUpdate() && s < pathGeometry.numSamples(); ++s)
+        {
+            if (!pathGeometry.isSampleDirty(s))
+                continue;
+
+            double t = pathGeometry.sampleTime(s);
+            ensureParentAndPivotMatrixAtTime(t);
+            if (!constrained && !drawPositionCache.contains(t))
+                drawPositionCache.set(t, getPos(t));
+        }
     }
-    if (yUpdated && yStatus != MS::kNotFound)
+}
+
+// 每个面板的部分：摄像机矩阵，摄像机空间下还有关键帧位置
+bool MotionPath::prepareView(CameraCache* cachePtr)
+{
+    MMatrix &currentCameraMatrix = preparedCameraMatrix;
+    currentCameraMatrix = MMatrix();
+    if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
     {
-        animCurveUtils::restoreCurve(curveY, currentTime, oldYValue, newKeyY, oldKeyY);
-        this->tyPlug.setValue(newYValue);
+        if (!cachePtr) return false;
+        double currentTime = MAnimControl::currentTime().as(MTime::uiUnit());
+        currentCameraMatrix = cachePtr->matrixCache.get(currentTime).inverse();
+
+        updateKeyframes(cachePtr, currentCameraMatrix);
     }
-    if (zUpdated && zStatus != MS::kNotFound )
+
+    return true;
+}
+
+bool MotionPath::hasWorldChanges() const
+{
+    if (positionsDirty || (retainedDraw && pathGeometry.needsUpdate()))
+        return true;
+    if (GlobalSettings::lockedMode && GlobalSettings::lockedModeInteractive && worldSpaceCallbackCalled)
+        return true;
+    // 约束路径不读曲线，这两个标记不会被清掉
+    return !constrained && (keyframesDirty || snapshotsDirty);
+}
+
+void MotionPath::updateKeyframes(CameraCache* cachePtr, const MMatrix &currentCameraMatrix)
+{
+    if (constrained)
+        return;
+
+    // 🚀 增量关键帧缓存: 曲线没有被编辑时直接复用上一次的 KeyframeTable
+    // camera space 的关键帧位置依赖当前相机, 所以仍然每次重建
+    bool liveValue = liveX.active || liveY.active || liveZ.active;
+    bool rebuildKeys = keyframesDirty || liveValue ||
+                       GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace ||
+                       keyframesCachedWithRotation != GlobalSettings::showRotationKeyFrames ||
+                       keyframesCachedWhileDrawing != isDrawing;
+
+    if (!rebuildKeys)
+        return;
+
+    MFnAnimCurve curveX(txPlug);
+    MFnAnimCurve curveY(tyPlug);
+    MFnAnimCurve curveZ(tzPlug);
+    MFnAnimCurve curveRotX(rxPlug);
+    MFnAnimCurve curveRotY(ryPlug);
+    MFnAnimCurve curveRotZ(rzPlug);
+
+    keyframesCache.clear();
+
+    cacheKeyFrames(curveX, curveY, curveZ, curveRotX, curveRotY, curveRotZ, cachePtr, currentCameraMatrix);
+
+    animCurveObjects.clear();
+    MFnAnimCurve *curves[6] = {&curveX, &curveY, &curveZ, &curveRotX, &curveRotY, &curveRotZ};
+    for (int c = 0; c < 6; ++c)
     {
-        animCurveUtils::restoreCurve(curveZ, currentTime, oldZValue, newKeyZ, oldKeyZ);
-        this->tzPlug.setValue(newZValue);
+        MObject curveObject = curves[c]->object();
+        if (!curveObject.isNull())
+            animCurveObjects.append(curveObject);
     }
-    
 
+    keyframesCachedWithRotation = GlobalSettings::showRotationKeyFrames;
+    keyframesCachedWhileDrawing = isDrawing;
+    // key positions carry the live value overlay, rebuild again once it changes or goes away
+    keyframesDirty = liveValue;
 }
 
 double MotionPath::getTimeFromKeyId(const int id)
 {
-	for(KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
-	{
-		Keyframe* key = &keyIt->second;
-		if(key->id == id)
-			return key->time;
-	}
-    
-	return 0.0;
+	Keyframe* key = keyframesCache.findById(id);
+	return key ? key->time : 0.0;
 }
 
 int MotionPath::getNumKeyFrames()
@@ -1300,9 +2009,9 @@ void MotionPath::getBoundariesForTime(const double time, double *minBoundary, do
     bool maxFound = false;
     double min, max;
     
-    for(KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
+    for(KeyframeTable::iterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
 	{
-		Keyframe* key = &keyIt->second;
+		Keyframe* key = &*keyIt;
         if (key->time == time)
             continue;
         
@@ -1347,6 +2056,8 @@ void MotionPath::deleteKeyFramesBetweenTimes(const double startTime, const doubl
 
 void MotionPath::deleteAllKeyFramesAfterTime(const double time, MAnimCurveChange *change)
 {
+    setKeyframesDirty();
+
     MFnAnimCurve curveX(txPlug);
 	MFnAnimCurve curveY(tyPlug);
 	MFnAnimCurve curveZ(tzPlug);
@@ -1367,6 +2078,8 @@ void MotionPath::deleteAllKeyFramesAfterTime(const double time, MAnimCurveChange
 
 void MotionPath::deleteAllKeyFramesInRange(const double startTime, const double endTime, MAnimCurveChange *change)
 {
+    setKeyframesDirty();
+
     MFnAnimCurve curveX(txPlug);
     MFnAnimCurve curveY(tyPlug);
     MFnAnimCurve curveZ(tzPlug);
@@ -1387,10 +2100,10 @@ void MotionPath::deleteAllKeyFramesInRange(const double startTime, const double
 
 void MotionPath::getKeyWorldPosition(const double keyTime, MVector &keyWorldPosition)
 {
-    KeyframeMapIterator keyIt = keyframesCache.find(keyTime);
+    KeyframeTable::iterator keyIt = keyframesCache.find(keyTime);
 	if(keyIt != keyframesCache.end())
 	{
-		Keyframe* key = &keyIt->second;
+		Keyframe* key = &*keyIt;
         keyWorldPosition = key->worldPosition;
        
 	}
@@ -1398,6 +2111,8 @@ void MotionPath::getKeyWorldPosition(const double keyTime, MVector &keyWorldPosi
 
 void MotionPath::deleteKeyFrameWithId(const int id, MAnimCurveChange *change)
 {
+    setKeyframesDirty();
+
     MFnAnimCurve curveX(txPlug);
 	MFnAnimCurve curveY(tyPlug);
 	MFnAnimCurve curveZ(tzPlug);
@@ -1405,34 +2120,31 @@ void MotionPath::deleteKeyFrameWithId(const int id, MAnimCurveChange *change)
     MFnAnimCurve curveRY(ryPlug);
     MFnAnimCurve curveRZ(rzPlug);
 
-    for(KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
-	{
-		Keyframe* key = &keyIt->second;
-		if(key->id == id)
-        {
-            // Delete translation keyframes
-            if (key->xKeyId != -1)
-                curveX.remove(key->xKeyId, change);
-            if (key->yKeyId != -1)
-                curveY.remove(key->yKeyId, change);
-            if (key->zKeyId != -1)
-                curveZ.remove(key->zKeyId, change);
-
-            // Delete rotation keyframes
-            if (key->xRotKeyId != -1)
-                curveRX.remove(key->xRotKeyId, change);
-            if (key->yRotKeyId != -1)
-                curveRY.remove(key->yRotKeyId, change);
-            if (key->zRotKeyId != -1)
-                curveRZ.remove(key->zRotKeyId, change);
+    Keyframe* key = keyframesCache.findById(id);
+    if (!key)
+        return;
 
-            return;
-        }
-	}
+    // Delete translation keyframes
+    if (key->xKeyId != -1)
+        curveX.remove(key->xKeyId, change);
+    if (key->yKeyId != -1)
+        curveY.remove(key->yKeyId, change);
+    if (key->zKeyId != -1)
+        curveZ.remove(key->zKeyId, change);
+
+    // Delete rotation keyframes
+    if (key->xRotKeyId != -1)
+        curveRX.remove(key->xRotKeyId, change);
+    if (key->yRotKeyId != -1)
+        curveRY.remove(key->yRotKeyId, change);
+    if (key->zRotKeyId != -1)
+        curveRZ.remove(key->zRotKeyId, change);
 }
 
 void MotionPath::deleteKeyFrameAtTime(const double time, MAnimCurveChange *change, const bool useCache)
 {
+    setKeyframesDirty();
+
     MFnAnimCurve curveX(txPlug);
     MFnAnimCurve curveY(tyPlug);
     MFnAnimCurve curveZ(tzPlug);
@@ -1468,10 +2180,10 @@ void MotionPath::deleteKeyFrameAtTime(const double time, MAnimCurveChange *chang
         return;
     }
 
-    KeyframeMapIterator keyIt = keyframesCache.find(time);
+    KeyframeTable::iterator keyIt = keyframesCache.find(time);
 	if(keyIt != keyframesCache.end())
 	{
-		Keyframe* key = &keyIt->second;
+		Keyframe* key = &*keyIt;
 
         // Delete translation keyframes
         if (key->xKeyId != -1)
@@ -1493,6 +2205,8 @@ void MotionPath::deleteKeyFrameAtTime(const double time, MAnimCurveChange *chang
 
 void MotionPath::addKeyFrameAtTime(const double time, MAnimCurveChange *change, MVector *position, const bool useCache)
 {
+    setKeyframesDirty();
+
     MFnAnimCurve curveX(txPlug);
 	MFnAnimCurve curveY(tyPlug);
 	MFnAnimCurve curveZ(tzPlug);
@@ -1503,11 +2217,11 @@ void MotionPath::addKeyFrameAtTime(const double time, MAnimCurveChange *change,
     else
     {
         ensureParentAndPivotMatrixAtTime(time);
-        pos = multPosByParentMatrix(*position, pMatrixCache[time].inverse());
+        pos = multPosByParentMatrix(*position, pMatrixCache.get(time).inverse());
     }
     
     MTime mtime(time, MTime::uiUnit());
-    KeyframeMapIterator keyIt = keyframesCache.find(time);
+    KeyframeTable::iterator keyIt = keyframesCache.find(time);
 	if(keyIt == keyframesCache.end() || !useCache)
     {
         curveX.addKeyframe(mtime, pos.x, change);
@@ -1516,7 +2230,7 @@ void MotionPath::addKeyFrameAtTime(const double time, MAnimCurveChange *change,
     }
     else
     {
-        Keyframe* key = &keyIt->second;
+        Keyframe* key = &*keyIt;
         if (key->xKeyId != -1)
             curveX.setValue(key->xKeyId, pos.x, change);
         else
@@ -1532,16 +2246,97 @@ void MotionPath::addKeyFrameAtTime(const double time, MAnimCurveChange *change,
     }
 }
 
+// 🚀 批量添加关键帧：每条曲线只创建一次函数集、只调用一次 addKeys，局部位置预先用缓存的父矩阵算好
+void MotionPath::addKeyFramesAtTimes(const MDoubleArray &times, const MVectorArray &worldPositions, MAnimCurveChange *change)
+{
+    unsigned int count = std::min(times.length(), worldPositions.length());
+    if (count == 0)
+        return;
+
+    setKeyframesDirty();
+
+    // addKeys 需要递增的时间，同一时间给了多次时后面的位置生效
+    std::map<double, MVector> localPositions;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        ensureParentAndPivotMatrixAtTime(times[i]);
+        localPositions[times[i]] = multPosByParentMatrix(worldPositions[i], pMatrixCache.get(times[i]).inverse());
+    }
+
+    MFnAnimCurve curveX(txPlug);
+	MFnAnimCurve curveY(tyPlug);
+	MFnAnimCurve curveZ(tzPlug);
+    MFnAnimCurve *curves[3] = {&curveX, &curveY, &curveZ};
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        MTimeArray newTimes;
+        MDoubleArray newValues;
+        for (std::map<double, MVector>::const_iterator it = localPositions.begin(); it != localPositions.end(); ++it)
+        {
+            // 已有关键帧的时间只改值，其余的一次性加入
+            MTime mtime(it->first, MTime::uiUnit());
+            unsigned int keyId;
+            if (curves[axis]->find(mtime, keyId))
+                curves[axis]->setValue(keyId, it->second[axis], change);
+            else
+            {
+                newTimes.append(mtime);
+                newValues.append(it->second[axis]);
+            }
+        }
+
+        if (newTimes.length() > 0)
+            curves[axis]->addKeys(&newTimes, &newValues, MFnAnimCurve::kTangentGlobal, MFnAnimCurve::kTangentGlobal, true, change);
+    }
+}
+
+void MotionPath::deleteKeyFramesAtTimes(const MDoubleArray &times, MAnimCurveChange *change)
+{
+    if (times.length() == 0)
+        return;
+
+    setKeyframesDirty();
+
+    MFnAnimCurve curveX(txPlug);
+    MFnAnimCurve curveY(tyPlug);
+    MFnAnimCurve curveZ(tzPlug);
+    MFnAnimCurve curveRX(rxPlug);
+    MFnAnimCurve curveRY(ryPlug);
+    MFnAnimCurve curveRZ(rzPlug);
+    MFnAnimCurve *curves[6] = {&curveX, &curveY, &curveZ, &curveRX, &curveRY, &curveRZ};
+
+    std::vector<unsigned int> keyIds;
+    for (int c = 0; c < 6; ++c)
+    {
+        keyIds.clear();
+        for (unsigned int i = 0; i < times.length(); ++i)
+        {
+            unsigned int keyId;
+            if (curves[c]->find(MTime(times[i], MTime::uiUnit()), keyId))
+                keyIds.push_back(keyId);
+        }
+
+        // 删除一个关键帧会让后面的索引前移，所以从最大的索引开始删
+        std::sort(keyIds.begin(), keyIds.end());
+        keyIds.erase(std::unique(keyIds.begin(), keyIds.end()), keyIds.end());
+        for (size_t i = keyIds.size(); i > 0; --i)
+            curves[c]->remove(keyIds[i - 1], change);
+    }
+}
+
 void MotionPath::setFrameWorldPosition(const MVector &position, const double time, MAnimCurveChange *change)
 {
-    KeyframeMapIterator keyIt = keyframesCache.find(time);
+    setKeyframesDirty();
+
+    KeyframeTable::iterator keyIt = keyframesCache.find(time);
 	if(keyIt == keyframesCache.end())
         return;
     
-	Keyframe* key = &keyIt->second;
+	Keyframe* key = &*keyIt;
     
     ensureParentAndPivotMatrixAtTime(time);
-	MVector lPos = multPosByParentMatrix(position, pMatrixCache[time].inverse());
+	MVector lPos = multPosByParentMatrix(position, pMatrixCache.get(time).inverse());
     
 	MFnAnimCurve curveX(txPlug);
 	MFnAnimCurve curveY(tyPlug);
@@ -1555,39 +2350,104 @@ void MotionPath::setFrameWorldPosition(const MVector &position, const double tim
         curveZ.setValue(key->zKeyId, lPos.z, change);
 }
 
-void MotionPath::offsetWorldPosition(const MVector &offset, const double time, MAnimCurveChange *change)
+// 🚀 批量拖动编辑：每条曲线只创建一次函数集，父矩阵的逆每个关键帧只算一次
+// 拖动过程中不写 undo，松开鼠标时 commitKeyEdits 为每个关键帧只记录一次（拖动前的值 -> 最终值）
+void MotionPath::offsetSelectedKeys(const MVector &offset, CameraCache *cachePtr)
 {
-    KeyframeMapIterator keyIt = keyframesCache.find(time);
-	if(keyIt == keyframesCache.end())
+    if (!keyframesCache.hasSelection())
         return;
-    
-	Keyframe* key = &keyIt->second;
-    
-    ensureParentAndPivotMatrixAtTime(time);
-    MVector lOffset = offset * pMatrixCache[time].inverse();
-    
+
+    keyframesDirty = true;
+
     MFnAnimCurve curveX(txPlug);
 	MFnAnimCurve curveY(tyPlug);
 	MFnAnimCurve curveZ(tzPlug);
+    MFnAnimCurve *curves[3] = {&curveX, &curveY, &curveZ};
 
-    MTime mtime(time, MTime::uiUnit());
-    
-    double val;
-    if (key->xKeyId != -1)
-    {
-        val = curveX.evaluate(mtime);
-        curveX.setValue(key->xKeyId, val + offset.x, change);
-    }
-    if (key->yKeyId != -1)
+    // walks the selection bits, nothing is allocated after the first event of a drag
+    for (size_t k = keyframesCache.nextSelected(0); k < keyframesCache.size(); k = keyframesCache.nextSelected(k + 1))
     {
-        val = curveY.evaluate(mtime);
-        curveY.setValue(key->yKeyId, val + offset.y, change);
+        const Keyframe &key = keyframesCache.at(k);
+        double time = key.time;
+        int keyIds[3] = {key.xKeyId, key.yKeyId, key.zKeyId};
+
+        // 第一次移动这个关键帧时记下原始值
+        std::map<double, KeyEdit>::iterator editIt = keyEdits.find(time);
+        if (editIt == keyEdits.end())
+        {
+            KeyEdit edit;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                edit.keyId[axis] = keyIds[axis];
+                edit.originalValue[axis] = keyIds[axis] != -1 ? curves[axis]->value(keyIds[axis]) : 0.0;
+            }
+            keyEdits[time] = edit;
+        }
+
+        MVector worldOffset = cachePtr ? offset * cachePtr->matrixCache.get(time).inverse() : offset;
+
+        // 世界空间偏移转换到父空间，曲线上存的是局部平移
+        ensureParentAndPivotMatrixAtTime(time);
+        MVector localOffset = worldOffset * pMatrixCache.get(time).inverse();
+
+        // 移动一个关键帧会改变它两侧各两个关键帧之间的曲线（相邻关键帧的自动切线也会变）
+        // 第一个和最后一个关键帧还会影响无限延伸部分
+        double rangeStart = time, rangeEnd = time;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (keyIds[axis] == -1)
+                continue;
+
+            curves[axis]->setValue(keyIds[axis], curves[axis]->value(keyIds[axis]) + localOffset[axis], NULL);
+
+            unsigned int id = static_cast<unsigned int>(keyIds[axis]);
+            unsigned int numKeys = curves[axis]->numKeys();
+            rangeStart = std::min(rangeStart, id >= 2 ? curves[axis]->time(id - 2).as(MTime::uiUnit()) : -std::numeric_limits<double>::infinity());
+            rangeEnd = std::max(rangeEnd, id + 2 < numKeys ? curves[axis]->time(id + 2).as(MTime::uiUnit()) : std::numeric_limits<double>::infinity());
+        }
+
+        invalidatePositions(rangeStart, rangeEnd);
     }
-    if (key->zKeyId != -1)
+}
+
+void MotionPath::invalidatePositions(const double start, const double end)
+{
+    drawPositionCache.eraseRange(start, end);
+    pathGeometry.markRangeDirty(start, end);
+
+    // 曲线变了，快照需要重新拷贝
+    snapshotsDirty = true;
+}
+
+void MotionPath::commitKeyEdits(MAnimCurveChange *change)
+{
+    if (keyEdits.empty())
+        return;
+
+    MFnAnimCurve curveX(txPlug);
+	MFnAnimCurve curveY(tyPlug);
+	MFnAnimCurve curveZ(tzPlug);
+    MFnAnimCurve *curves[3] = {&curveX, &curveY, &curveZ};
+
+    for (std::map<double, KeyEdit>::const_iterator editIt = keyEdits.begin(); editIt != keyEdits.end(); ++editIt)
     {
-        val = curveZ.evaluate(mtime);
-        curveZ.setValue(key->zKeyId, val + offset.z, change);
+        const KeyEdit &edit = editIt->second;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (edit.keyId[axis] == -1)
+                continue;
+
+            // 先恢复原值，再带着 change 设回最终值，undo 只看到一次修改
+            double finalValue = curves[axis]->value(edit.keyId[axis]);
+            curves[axis]->setValue(edit.keyId[axis], edit.originalValue[axis], NULL);
+            curves[axis]->setValue(edit.keyId[axis], finalValue, change);
+        }
     }
+
+    // ✅ 提交的 MAnimCurveChange 会在 keyEdits 清空之后触发 animCurveEditedCallback，路径在那时整体重建一次
+    // 拖动过程中的增量失效只省下了拖动中的重建，松开鼠标时的这一次不省
+    keyEdits.clear();
+    setKeyframesDirty();
 }
 
 void MotionPath::copyKeyFrameFromToOnCurve(MFnAnimCurve& curve, int keyId, double value, double time, MAnimCurveChange* change)
@@ -1638,11 +2498,13 @@ void MotionPath::copyKeyFrameFromToOnCurve(MFnAnimCurve& curve, int keyId, doubl
 
 void MotionPath::copyKeyFrameFromTo(const double from, const double to, const MVector &cachedPosition, MAnimCurveChange *change)
 {
-    KeyframeMapIterator keyIt = keyframesCache.find(from);
+    setKeyframesDirty();
+
+    KeyframeTable::iterator keyIt = keyframesCache.find(from);
 	if(keyIt == keyframesCache.end())
         return;
     
-    Keyframe* key = &keyIt->second;
+    Keyframe* key = &*keyIt;
     
     if (key->xKeyId != -1)
     {
@@ -1664,18 +2526,20 @@ void MotionPath::copyKeyFrameFromTo(const double from, const double to, const MV
 
 void MotionPath::setTangentWorldPosition(const MVector &position, const double time, Keyframe::Tangent tangentId, const MMatrix &toWorldMatrix, MAnimCurveChange *change)
 {
+    setKeyframesDirty();
+
 
-    KeyframeMapIterator keyIt = keyframesCache.find(time);
+    KeyframeTable::iterator keyIt = keyframesCache.find(time);
 	if(keyIt == keyframesCache.end())
         return;
     
-	Keyframe* key = &keyIt->second;
+	Keyframe* key = &*keyIt;
     
     MVector localPosition;
     
     if (isWeighted)
     {
-        localPosition = (position - key->worldPosition) * pMatrixCache[time].inverse();
+        localPosition = (position - key->worldPosition) * pMatrixCache.get(time).inverse();
     }
     else
     {
@@ -1699,7 +2563,7 @@ void MotionPath::setTangentWorldPosition(const MVector &position, const double t
         else
             tangentVector = key->outTangentWorld - MVector(MPoint(key->worldPosition) * toWorldMatrix);
         
-        localPosition = tangentVector.rotateBy(rotation) * pMatrixCache[time].inverse();
+        localPosition = tangentVector.rotateBy(rotation) * pMatrixCache.get(time).inverse();
         localPosition *= lenMultiplier;
     }
     
@@ -1765,10 +2629,10 @@ void MotionPath::setTangentValue(float value, int key, MFnAnimCurve& curve, Keyf
 
 void MotionPath::getTangentHandleWorldPosition(const double keyTime, const Keyframe::Tangent &tangentName, MVector &tangentWorldPosition)
 {
-    KeyframeMapIterator keyIt = keyframesCache.find(keyTime);
+    KeyframeTable::iterator keyIt = keyframesCache.find(keyTime);
 	if(keyIt != keyframesCache.end())
 	{
-		Keyframe* key = &keyIt->second;
+		Keyframe* key = &*keyIt;
 
         if(tangentName == Keyframe::kInTangent)
             tangentWorldPosition = key->inTangentWorldFromCurve;
@@ -1777,87 +2641,51 @@ void MotionPath::getTangentHandleWorldPosition(const double keyTime, const Keyfr
 	}
 }
 
-void MotionPath::drawTangentsForSelection(M3dView &view, CameraCache *cachePtr)
-{
-    for(KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
-    {
-        Keyframe* key = &keyIt->second;
-        
-        view.pushName(key->id);
-        
-        if (key->showInTangent)
-        {
-            view.pushName((int)Keyframe::kInTangent);
-            drawUtils::drawPoint(key->inTangentWorldFromCurve, GlobalSettings::frameSize);
-            view.popName();
-        }
-        
-        if (key->showOutTangent)
-        {
-            view.pushName((int)Keyframe::kOutTangent);
-            drawUtils::drawPoint(key->outTangentWorldFromCurve, GlobalSettings::frameSize);
-            view.popName();
-        }
-        
-        view.popName();
-    }
-}
-
 MVector MotionPath::getWorldPositionAtTime(const double time)
 {
     ensureParentAndPivotMatrixAtTime(time);
-    return multPosByParentMatrix(getPos(time), pMatrixCache[time]);
+    return multPosByParentMatrix(getPos(time), pMatrixCache.get(time));
 }
 
-void MotionPath::drawKeysForSelection(M3dView &view, CameraCache* cachePtr)
+void MotionPath::addHitTargets(ScreenHitIndex &hitIndex, const int pathId, M3dView &view, CameraCache *cachePtr, const MMatrix &currentCameraMatrix)
 {
+	short x, y;
+	const std::vector<MVector> &keyPositions = keyframesCache.getWorldPositions();
+	for (size_t i = 0; i < keyframesCache.size(); ++i)
+	{
+		const Keyframe &k = keyframesCache.at(i);
 
-    for(KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
-    {
-        Keyframe* key = &keyIt->second;
-        
-        view.pushName(key->id);
-        drawUtils::drawPoint(key->worldPosition, GlobalSettings::frameSize * 1.2);
-        view.popName();
-    }
-
-}
+		view.worldToView(keyPositions[i], x, y);
+		hitIndex.add(ScreenHitIndex::kKey, pathId, k.id, k.time, x, y);
 
-void MotionPath::drawFramesForSelection(M3dView &view, CameraCache* cachePtr)
-{
-    MVector pos;
-    for(double i = displayStartTime; i <= displayEndTime; i += 1.0)
-    {
-        ensureParentAndPivotMatrixAtTime(i);
-        
-        view.pushName(static_cast<int>(i));
-        pos = multPosByParentMatrix(getPos(i), pMatrixCache[i]);
-        drawUtils::drawPoint(pos, GlobalSettings::frameSize);
-        view.popName();
-    }
+		// only the handles that are drawn can be picked
+		if (k.showInTangent)
+		{
+			view.worldToView(k.inTangentWorldFromCurve, x, y);
+			hitIndex.add(ScreenHitIndex::kInTangent, pathId, k.id, k.time, x, y);
+		}
 
-}
+		if (k.showOutTangent)
+		{
+			view.worldToView(k.outTangentWorldFromCurve, x, y);
+			hitIndex.add(ScreenHitIndex::kOutTangent, pathId, k.id, k.time, x, y);
+		}
+	}
 
-void MotionPath::getFramePositions(std::vector<std::pair<int, MVector>> &vec)
-{
+	// ✅ 帧位置来自绘制时已经填好的缓存，不再重新查询 plug
+	std::vector<double> frameTimes;
 	for (double i = displayStartTime; i <= displayEndTime; i += 1.0)
-	{
-		ensureParentAndPivotMatrixAtTime(i);
-		vec.push_back(std::pair<int, MVector>(i, multPosByParentMatrix(getPos(i), pMatrixCache[i])));
-	}
-}
+		frameTimes.push_back(i);
 
-void MotionPath::drawCurvesForSelection(M3dView &view, CameraCache* cachePtr)
-{
-    MMatrix currentCameraMatrix;
-    if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
-    {
-        if (!cachePtr) return;
-        double currentTime = MAnimControl::currentTime().as(MTime::uiUnit());
-        currentCameraMatrix = cachePtr->matrixCache[currentTime].inverse();
-    }
+	std::vector<MVector> framePositions;
+	if (!getDrawSpacePositions(frameTimes, cachePtr, currentCameraMatrix, framePositions))
+		return;
 
-    drawPath(view, cachePtr, currentCameraMatrix, true);
+	for (size_t i = 0; i < frameTimes.size(); ++i)
+	{
+		view.worldToView(MPoint(framePositions[i]), x, y);
+		hitIndex.add(ScreenHitIndex::kFrame, pathId, -1, frameTimes[i], x, y);
+	}
 }
 
 int MotionPath::getMinTime(MFnAnimCurve &curveX, MFnAnimCurve &curveY, MFnAnimCurve &curveZ)
@@ -1904,15 +2732,18 @@ BufferPath MotionPath::createBufferPath()
     
     //stora tutto il range e poi storati i keyframes se ce ne sono e stop
     
-    std::vector<MVector> frames;
-    frames.clear();
+    // ✅ 位置按 float 紧凑存储：每帧 x, y, z
+    std::vector<float> frames;
     if (constrained)
     {
-        frames.reserve(int(GlobalSettings::endTime - GlobalSettings::startTime) + 1);
+        frames.reserve(3 * (int(GlobalSettings::endTime - GlobalSettings::startTime) + 1));
         for (double i = GlobalSettings::startTime; i <= GlobalSettings::endTime; ++i)
         {
             ensureParentAndPivotMatrixAtTime(i);
-            frames.push_back(MVector(pMatrixCache[i](3, 0), pMatrixCache[i](3, 1), pMatrixCache[i](3, 2)));
+            const MMatrix &m = pMatrixCache.get(i);
+            frames.push_back(static_cast<float>(m(3, 0)));
+            frames.push_back(static_cast<float>(m(3, 1)));
+            frames.push_back(static_cast<float>(m(3, 2)));
         }
         
         bp.setMinTime(GlobalSettings::startTime);
@@ -1932,7 +2763,7 @@ BufferPath MotionPath::createBufferPath()
         if (maxTime < GlobalSettings::endTime)
             maxTime = static_cast<int>(GlobalSettings::endTime);
         
-        frames.reserve(maxTime - minTime + 1);
+        frames.reserve(3 * (maxTime - minTime + 1));
         for (double i = minTime; i <= maxTime; ++i)
         {
             ensureParentAndPivotMatrixAtTime(i);
@@ -1942,8 +2773,10 @@ BufferPath MotionPath::createBufferPath()
             float y = yStatus == MS::kNotFound ? tyPlug.asDouble() :curveTY.evaluate(mtime);
             float z = zStatus == MS::kNotFound ? tzPlug.asDouble() :curveTZ.evaluate(mtime);
             
-            MVector vec(x, y, z);
-            frames.push_back(multPosByParentMatrix(vec, pMatrixCache[i]));
+            MVector vec = multPosByParentMatrix(MVector(x, y, z), pMatrixCache.get(i));
+            frames.push_back(static_cast<float>(vec.x));
+            frames.push_back(static_cast<float>(vec.y));
+            frames.push_back(static_cast<float>(vec.z));
         }
         
         // parse each curve and add keyframes
@@ -1952,38 +2785,85 @@ BufferPath MotionPath::createBufferPath()
         expandeBufferPathKeyFrames(curveTY, keyFrames);
         expandeBufferPathKeyFrames(curveTZ, keyFrames);
         
+        // the map only merges the key times of the three curves, it is flattened to a sorted index
+        std::vector<double> keyTimes;
+        std::vector<float> keyPositions;
+        keyTimes.reserve(keyFrames.size());
+        keyPositions.reserve(3 * keyFrames.size());
         for(BPKeyframeIterator keyIt = keyFrames.begin(); keyIt != keyFrames.end(); ++keyIt)
         {
-            double time = keyIt->first;
+            double time = keyIt->time;
             ensureParentAndPivotMatrixAtTime(time);
-            keyIt->second = multPosByParentMatrix(getPos(time), pMatrixCache[time]);
+            MVector pos = multPosByParentMatrix(getPos(time), pMatrixCache.get(time));
+            keyTimes.push_back(time);
+            keyPositions.push_back(static_cast<float>(pos.x));
+            keyPositions.push_back(static_cast<float>(pos.y));
+            keyPositions.push_back(static_cast<float>(pos.z));
         }
         
-        bp.setKeyFrames(keyFrames);
+        bp.setKeyFrames(std::move(keyTimes), std::move(keyPositions));
         bp.setMinTime(minTime);
     }
     
-    bp.setFrames(frames);
+    bp.setFrames(std::move(frames));
 
     // Set object name for identification
     MFnDependencyNode depNodeFn(thisObject);
     bp.setObjectName(depNodeFn.name());
+    bp.setSourceHash(getSourceHash());
 
     return bp;
 }
 
+uint64_t MotionPath::getSourceHash()
+{
+    MFnDependencyNode depNodeFn(thisObject);
+    MString name = depNodeFn.name();
+    uint64_t result = pathCacheFile::hash(name.asChar(), name.length());
+
+    double range[2] = {GlobalSettings::startTime, GlobalSettings::endTime};
+    result = pathCacheFile::hash(range, sizeof(range), result);
+
+    MPlug plugs[3] = {txPlug, tyPlug, tzPlug};
+    for (int p = 0; p < 3; ++p)
+    {
+        MStatus status;
+        MFnAnimCurve curve(plugs[p], &status);
+        if (!status)
+        {
+            double value = plugs[p].asDouble();
+            result = pathCacheFile::hash(&value, sizeof(value), result);
+            continue;
+        }
+
+        for (unsigned int i = 0; i < curve.numKeys(); ++i)
+        {
+            double key[2] = {curve.time(i).as(MTime::uiUnit()), curve.value(i)};
+            float tangents[4];
+            curve.getTangent(i, tangents[0], tangents[1], true);
+            curve.getTangent(i, tangents[2], tangents[3], false);
+            result = pathCacheFile::hash(key, sizeof(key), result);
+            result = pathCacheFile::hash(tangents, sizeof(tangents), result);
+        }
+    }
+
+    // parents and constraints are not hashed, their matrix at both ends of the range catches most changes
+    double ends[2] = {GlobalSettings::startTime, GlobalSettings::endTime};
+    for (int e = 0; e < 2; ++e)
+    {
+        ensureParentAndPivotMatrixAtTime(ends[e]);
+        double matrix[4][4];
+        pMatrixCache.get(ends[e]).get(matrix);
+        result = pathCacheFile::hash(matrix, sizeof(matrix), result);
+    }
+
+    return result;
+}
+
 MDoubleArray MotionPath::getSelectedKeys()
 {
     MDoubleArray a;
-    if (selectedKeyTimes.size() == 0)
-        return a;
-    
-    std::vector<double> times(selectedKeyTimes.size());
-    std::copy(selectedKeyTimes.begin(), selectedKeyTimes.end(), times.begin());
-    std::sort (times.begin(), times.end());
-
-    for(int i = 0; i < times.size(); ++i)
-        a.append(times[i]);
+    keyframesCache.getSelectedTimes(a);
     return a;
 }
 
@@ -1991,13 +2871,9 @@ MDoubleArray MotionPath::getKeys()
 {
     MDoubleArray a;
     
-    std::vector<double> times;
-    times.reserve(keyframesCache.size());
-    for (KeyframeMapIterator it=keyframesCache.begin() ; it != keyframesCache.end(); ++it )
-        times.push_back(it->first);
-    std::sort (times.begin(), times.end());
-    
-    for(int i = 0; i < times.size(); ++i)
+    // the table is already in time order
+    const std::vector<double> &times = keyframesCache.getTimes();
+    for(size_t i = 0; i < times.size(); ++i)
         a.append(times[i]);
     return a;
 }
@@ -2178,9 +3054,11 @@ void MotionPath::storeSelectedKeysInClipboard()
 	MFnAnimCurve curveY(tyPlug, &yStatus);
 	MFnAnimCurve curveZ(tzPlug, &zStatus);
     
-    std::vector<double> times(selectedKeyTimes.size());
-    std::copy(selectedKeyTimes.begin(), selectedKeyTimes.end(), times.begin());
-    std::sort (times.begin(), times.end());
+    MDoubleArray selected;
+    keyframesCache.getSelectedTimes(selected);
+    std::vector<double> times(selected.length());
+    for (unsigned int i = 0; i < selected.length(); ++i)
+        times[i] = selected[i];
     
     KeyClipboard &clipboard = KeyClipboard::getClipboard();
     clipboard.clearClipboard();
@@ -2214,10 +3092,10 @@ void MotionPath::storeSelectedKeysInClipboard()
     unsigned int tsize = times.size();
     for (int i = 0; i < tsize; ++i)
     {
-        KeyframeMapIterator keyIt = keyframesCache.find(times[i]);
+        KeyframeTable::iterator keyIt = keyframesCache.find(times[i]);
         if(keyIt != keyframesCache.end())
         {
-            Keyframe* key = &keyIt->second;
+            Keyframe* key = &*keyIt;
             
             KeyCopy kc;
             kc.deltaTime = times[i] - times[0];
@@ -2260,10 +3138,10 @@ void MotionPath::storeSelectedKeysInClipboard()
         KeyCopy *kc = clipboard.keyCopyAt(i);
         if (kc == NULL) continue;
         
-        KeyframeMapIterator keyIt = keyframesCache.find(times[0] + kc->deltaTime);
+        KeyframeTable::iterator keyIt = keyframesCache.find(times[0] + kc->deltaTime);
         if(keyIt != keyframesCache.end())
         {
-            Keyframe* key = &keyIt->second;
+            Keyframe* key = &*keyIt;
             
             MTime currentTime(times[0] + kc->deltaTime, MTime::uiUnit());
             unsigned int xKeyID = -1, yKeyID = -1, zKeyID = -1;
@@ -2283,8 +3161,8 @@ void MotionPath::storeSelectedKeysInClipboard()
             curveY.setIsWeighted(true);
             MVector inTangent = evaluateTangentForClipboard(curveX, curveY, curveZ, xKeyID, yKeyID, zKeyID, true);
             MVector outTangent = evaluateTangentForClipboard(curveX, curveY, curveZ, xKeyID, yKeyID, zKeyID, false);
-            kc->inWeightedWorldTangent = multPosByParentMatrix(-inTangent + key->position, pMatrixCache[key->time]);
-            kc->outWeightedWorldTangent = multPosByParentMatrix(outTangent + key->position, pMatrixCache[key->time]);
+            kc->inWeightedWorldTangent = multPosByParentMatrix(-inTangent + key->position, pMatrixCache.get(key->time));
+            kc->outWeightedWorldTangent = multPosByParentMatrix(outTangent + key->position, pMatrixCache.get(key->time));
             
             //storing the non weighted tangent
             curveX.setIsWeighted(false);
@@ -2292,8 +3170,8 @@ void MotionPath::storeSelectedKeysInClipboard()
             curveY.setIsWeighted(false);
             inTangent = evaluateTangentForClipboard(curveX, curveY, curveZ, xKeyID, yKeyID, zKeyID, true);
             outTangent = evaluateTangentForClipboard(curveX, curveY, curveZ, xKeyID, yKeyID, zKeyID, false);
-            kc->inWorldTangent = multPosByParentMatrix(-inTangent + key->position, pMatrixCache[key->time]);
-            kc->outWorldTangent = multPosByParentMatrix(outTangent + key->position, pMatrixCache[key->time]);
+            kc->inWorldTangent = multPosByParentMatrix(-inTangent + key->position, pMatrixCache.get(key->time));
+            kc->outWorldTangent = multPosByParentMatrix(outTangent + key->position, pMatrixCache.get(key->time));
             
             //setting back the curves to their original states and restoring their values in case they are weighted
             curveX.setIsWeighted(clipboard.isXWeighed());
@@ -2340,20 +3218,116 @@ bool breakTangentsForKeyCopy(const MFnAnimCurve &curve, const double time, const
     return curve.numKeys() > 0 && curve.time(0).as(MTime::uiUnit()) < time && (curve.time(curve.numKeys() - 1).as(MTime::uiUnit()) > time || !lastKey);
 }
 
-void MotionPath::pasteKeys(const double time, const bool offset)
+// 🚀 粘贴分三步：cachePasteMatrices 在主线程读 DG 并填充父矩阵缓存，
+// preparePaste 只读缓存，可以对多个目标并行计算局部位置和切线，commitPaste 再按曲线批量写入
+void MotionPath::cachePasteMatrices(PasteTarget &target)
 {
     KeyClipboard &clipboard = KeyClipboard::getClipboard();
     int size = clipboard.getSize();
-    
-    MVector offsetVec(0,0,0);
-    if (offset)
-        offsetVec = multPosByParentMatrix(getPos(time), pMatrixCache[time]);
+    target.keys.clear();
+    if (size == 0)
+        return;
+
+    ensureParentAndPivotMatrixAtTime(target.time);
+    if (target.offset)
+        target.offsetPosition = multPosByParentMatrix(getPos(target.time), pMatrixCache.get(target.time));
+
+    for (int i = 0; i < size; ++i)
+        ensureParentAndPivotMatrixAtTime(target.time + clipboard.keyCopyAt(i)->deltaTime);
+}
+
+void MotionPath::preparePaste(PasteTarget &target) const
+{
+    KeyClipboard &clipboard = KeyClipboard::getClipboard();
+    int size = clipboard.getSize();
+    target.keys.resize(size);
+
+    for (int i = 0; i < size; ++i)
+    {
+        const KeyCopy *kc = clipboard.keyCopyAt(i);
+        PastedKey &key = target.keys[i];
+        key.time = target.time + kc->deltaTime;
+        key.boundary = i == 0 || i == size - 1;
+
+        MVector pos = kc->worldPos;
+        if (target.offset)
+        {
+            if (i == 0)
+                pos = target.offsetPosition;
+            else
+                pos = target.offsetPosition + kc->worldPos - clipboard.keyCopyAt(0)->worldPos;
+        }
+
+        MMatrix inverse = pMatrixCache.get(key.time).inverse();
+        key.position = multPosByParentMatrix(pos, inverse);
+        kc->localTangents(inverse, key.in, key.out, key.inWeighted, key.outWeighted);
+    }
+}
+
+// 新的关键帧一次 addKeys 加入，已经存在的（范围起点上的）只改值
+// on boundary keys set keyframes only if there is keyframes before the first key or after the last key
+void addPastedKeys(MFnAnimCurve &curve, const Keyframe::Axis axis, const std::vector<PastedKey> &keys, KeyClipboard &clipboard, MAnimCurveChange *change)
+{
+    MTimeArray newTimes;
+    MDoubleArray newValues;
+    std::vector<unsigned char> added(keys.size(), 0);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (!clipboard.keyCopyAt(static_cast<int>(i))->hasKey(axis) && !keys[i].boundary)
+            continue;
+
+        MTime mtime(keys[i].time, MTime::uiUnit());
+        unsigned int keyID;
+        if (curve.find(mtime, keyID))
+            curve.setValue(keyID, keys[i].position[axis], change);
+        else
+        {
+            newTimes.append(mtime);
+            newValues.append(keys[i].position[axis]);
+            added[i] = 1;
+        }
+    }
+
+    if (newTimes.length() > 0)
+        curve.addKeys(&newTimes, &newValues, MFnAnimCurve::kTangentGlobal, MFnAnimCurve::kTangentGlobal, true, change);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        KeyCopy *kc = clipboard.keyCopyAt(static_cast<int>(i));
+        if (!kc->hasKey(axis) && !keys[i].boundary)
+            continue;
+
+        unsigned int keyID;
+        if (!curve.find(MTime(keys[i].time, MTime::uiUnit()), keyID))
+            continue;
+
+        if (added[i])
+        {
+            curve.setInTangentType(keyID, kc->inTangentType(axis), change);
+            curve.setOutTangentType(keyID, kc->outTangentType(axis), change);
+        }
+        curve.setTangentsLocked(keyID, false, change);
+        curve.setWeightsLocked(keyID, false, change);
+    }
+}
+
+void MotionPath::commitPaste(const PasteTarget &target)
+{
+    if (target.keys.empty())
+        return;
+
+    setKeyframesDirty();
+
+    KeyClipboard &clipboard = KeyClipboard::getClipboard();
+    int size = static_cast<int>(target.keys.size());
+    MAnimCurveChange *change = mpManager.getAnimCurveChangePtr();
     
     MStatus status;
     MFnAnimCurve curveX(txPlug, &status);
     if (status == MS::kNotFound)
     {
-        mpManager.startDGUndoRecording();
+        if (mpManager.getDGModifierPtr() == NULL)
+            mpManager.startDGUndoRecording();
         curveX.create(txPlug, mpManager.getDGModifierPtr());
     }
     
@@ -2371,91 +3345,41 @@ void MotionPath::pasteKeys(const double time, const bool offset)
             mpManager.startDGUndoRecording();
         curveZ.create(tzPlug, mpManager.getDGModifierPtr());
     }
-   
-    mpManager.startAnimUndoRecording();
     
     if (clipboard.isXWeighed())
-        curveX.setIsWeighted(true, mpManager.getAnimCurveChangePtr());
+        curveX.setIsWeighted(true, change);
     if (clipboard.isYWeighed())
-        curveY.setIsWeighted(true, mpManager.getAnimCurveChangePtr());
+        curveY.setIsWeighted(true, change);
     if (clipboard.isZWeighed())
-        curveZ.setIsWeighted(true, mpManager.getAnimCurveChangePtr());
+        curveZ.setIsWeighted(true, change);
     
-    deleteKeyFramesBetweenTimes(time, time + clipboard.keyCopyAt(size - 1)->deltaTime, curveX, mpManager.getAnimCurveChangePtr());
-    deleteKeyFramesBetweenTimes(time, time + clipboard.keyCopyAt(size - 1)->deltaTime, curveY, mpManager.getAnimCurveChangePtr());
-    deleteKeyFramesBetweenTimes(time, time + clipboard.keyCopyAt(size - 1)->deltaTime, curveZ, mpManager.getAnimCurveChangePtr());
+    double lastTime = target.keys.back().time;
+    deleteKeyFramesBetweenTimes(target.time, lastTime, curveX, change);
+    deleteKeyFramesBetweenTimes(target.time, lastTime, curveY, change);
+    deleteKeyFramesBetweenTimes(target.time, lastTime, curveZ, change);
     
     //creating keyframes
-    //on boundary keys set keyframes and break tangents only if there is keyframes before the first key or after the last key
-    for (int i = 0; i < size; ++i)
-    {
-        KeyCopy *kc = clipboard.keyCopyAt(i);
-        if (kc == NULL) continue;
-        
-        double t = time + kc->deltaTime;
-        ensureParentAndPivotMatrixAtTime(t);
-        MTime mtime(t, MTime::uiUnit());
-
-        MVector pos = kc->worldPos;
-        if (offset)
-        {
-            if (i == 0)
-                pos = offsetVec;
-            else
-                pos = offsetVec + kc->worldPos - clipboard.keyCopyAt(0)->worldPos;
-        }
-        
-        pos = multPosByParentMatrix(pos, pMatrixCache[t].inverse());
-        bool boundaryKey = i == 0 || i == size - 1;
-        
-        kc->addKeyFrame(curveX, curveY, curveZ, mtime, pos, boundaryKey, mpManager.getAnimCurveChangePtr());
-    }
+    addPastedKeys(curveX, Keyframe::kAxisX, target.keys, clipboard, change);
+    addPastedKeys(curveY, Keyframe::kAxisY, target.keys, clipboard, change);
+    addPastedKeys(curveZ, Keyframe::kAxisZ, target.keys, clipboard, change);
     
     //setting tangents
     //on boundary keys set out tangents for first frame and in tangents only for the last keyframe
     for (int i = 0; i < size; ++i)
     {
         KeyCopy *kc = clipboard.keyCopyAt(i);
-        if (kc == NULL) continue;
-        
-        double t = time + kc->deltaTime;
-        MTime mtime(t, MTime::uiUnit());
+        const PastedKey &key = target.keys[i];
+        MTime mtime(key.time, MTime::uiUnit());
         
-        bool boundaryKey = i == 0  || i == size - 1;
         bool modifyInTangent = i != 0;
         bool modifyOutTangent = i != size - 1;
 
-        bool breakTangentsX = breakTangentsForKeyCopy(curveX, t, i == size - 1);
-        bool breakTangentsY = breakTangentsForKeyCopy(curveY, t, i == size - 1);
-        bool breakTangentsZ = breakTangentsForKeyCopy(curveZ, t, i == size - 1);
+        bool breakTangentsX = breakTangentsForKeyCopy(curveX, key.time, i == size - 1);
+        bool breakTangentsY = breakTangentsForKeyCopy(curveY, key.time, i == size - 1);
+        bool breakTangentsZ = breakTangentsForKeyCopy(curveZ, key.time, i == size - 1);
         
         //break tangents at boundaries only if there are keyframes before/after these
-        kc->setTangents(curveX, curveY, curveZ, pMatrixCache[t].inverse(), mtime, boundaryKey, modifyInTangent, modifyOutTangent, breakTangentsX, breakTangentsY, breakTangentsZ, clipboard.isXWeighed(), clipboard.isYWeighed(), clipboard.isZWeighed(), mpManager.getAnimCurveChangePtr());
-    }
-    
-    mpManager.stopDGAndAnimUndoRecording();
-}
-
-void MotionPath::selectAllKeys()
-{
-    for(KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
-	{
-		Keyframe* key = &keyIt->second;
-        key->selectedFromTool = true;
-        selectedKeyTimes.insert(key->time);
-    }
-}
-
-void MotionPath::invertKeysSelection()
-{
-    selectedKeyTimes.clear();
-    
-    for(KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
-	{
-		Keyframe* key = &keyIt->second;
-        key->selectedFromTool = !key->selectedFromTool;
-        if (key->selectedFromTool)
-            selectedKeyTimes.insert(key->time);
+        kc->setTangents(curveX, curveY, curveZ, key.in, key.out, key.inWeighted, key.outWeighted, mtime, key.boundary, modifyInTangent, modifyOutTangent, breakTangentsX, breakTangentsY, breakTangentsZ, clipboard.isXWeighed(), clipboard.isYWeighed(), clipboard.isZWeighed(), change);
     }
 }
 
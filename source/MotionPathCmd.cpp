@@ -1,6 +1,7 @@
 #include <maya/MPointArray.h>
 #include <maya/MFnNurbsCurve.h>
 #include "MotionPathCmd.h"
+#include "PathStats.h"
 
 extern MotionPathManager mpManager;
 
@@ -135,6 +136,54 @@ MColor getColorFromArg(const MArgDatabase &argData, const char *flagName)
  *     Default: False
  *     Example: cmds.tcMotionPathCmd(usePivots=True)
  *
+ * -rg / -retainedGeometry <boolean>
+ *     Keep world space path vertices between Viewport 2.0 refreshes.
+ *     Only frames whose cached data changed are rebuilt, orbiting the camera reuses them.
+ *     Camera space paths and the legacy viewport are always rebuilt.
+ *     Default: True
+ *     Example: cmds.tcMotionPathCmd(retainedGeometry=False)
+ *
+ * -lod / -lodTolerance <double>
+ *     Screen space simplification of the drawn path line, in pixels.
+ *     Line vertices closer than this to the simplified line are skipped, keys and labelled frames
+ *     are always kept. Every frame marker is still drawn. 0 draws every sample.
+ *     Default: 1.0
+ *     Example: cmds.tcMotionPathCmd(lodTolerance=2.0)
+ *
+ * -dcl / -declutterLabels <boolean>
+ *     Skip frame and key number labels that would overlap a label already drawn in the view.
+ *     Key numbers are placed before frame numbers so they win on dense paths.
+ *     Default: True
+ *     Example: cmds.tcMotionPathCmd(declutterLabels=False)
+ *
+ * -fc / -frustumCulling <boolean>
+ *     Skip paths, and 64 frame chunks of paths, that are outside the view before drawing them.
+ *     World space only, camera space paths are always drawn whole.
+ *     Default: True
+ *     Example: cmds.tcMotionPathCmd(frustumCulling=False)
+ *
+ * -ch / -compiledHierarchy <boolean>
+ *     Compose the parent matrices of paths whose ancestors are plain transforms or joints keyed directly,
+ *     without evaluating the ancestors through the DG on every frame. Any ancestor with a constraint,
+ *     expression or other input, or a composed matrix that does not match Maya, falls back to the DG.
+ *     Default: True
+ *     Example: cmds.tcMotionPathCmd(compiledHierarchy=False)
+ *
+ * -ppb / -pathPoolBudget <double>
+ *     Megabytes of cached data kept for paths that left the selection.
+ *     Reselecting one of them reuses its caches, the least recently deselected are dropped first.
+ *     0 frees a path as soon as it is deselected.
+ *     Default: 64
+ *     Example: cmds.tcMotionPathCmd(pathPoolBudget=128)
+ *
+ * -cmb / -cacheMemoryBudget <double>
+ *     Megabytes of cached data of all paths, pooled paths and cameras together.
+ *     Over budget, pooled paths and cameras not drawn recently are evicted first, furthest from the current frame first,
+ *     then the frames prefetched around the display range of the selected paths. Buffer paths are counted, never evicted.
+ *     0 disables the budget.
+ *     Default: 512
+ *     Example: cmds.tcMotionPathCmd(cacheMemoryBudget=256)
+ *
  * =============================================================================
  * SIZE FLAGS
  * =============================================================================
@@ -260,6 +309,16 @@ MColor getColorFromArg(const MArgDatabase &argData, const char *flagName)
  *     Convert a buffer path to a NURBS curve in the scene.
  *     Example: cmds.tcMotionPathCmd(convertBufferPath=0)
  *
+ * -sbf / -saveBufferPaths <string>
+ *     Write every buffer path to a binary path cache file.
+ *     The file holds the world positions of each frame, the key times and a hash of the source animation.
+ *     Example: cmds.tcMotionPathCmd(saveBufferPaths="/shots/sh010/reference.tcmp")
+ *
+ * -lbf / -loadBufferPaths <string>
+ *     Add the buffer paths stored in a path cache file, nothing is evaluated.
+ *     Warns when a displayed object's animation no longer matches its cached path.
+ *     Example: cmds.tcMotionPathCmd(loadBufferPaths="/shots/sh010/reference.tcmp")
+ *
  * =============================================================================
  * LOCKED MODE FLAGS
  * =============================================================================
@@ -283,6 +342,36 @@ MColor getColorFromArg(const MArgDatabase &argData, const char *flagName)
  *     Example: cmds.tcMotionPathCmd(refreshLockedSelection=True)
  *
  * =============================================================================
+ * STATISTICS FLAGS
+ * =============================================================================
+ *
+ * -qst / -queryStats
+ *     Return the timers and cache counters of the caching and drawing hot paths, one string per entry.
+ *     Each timed section reports its calls, total time, the last refresh and the slowest refresh.
+ *     Each counter reports its total, the last refresh and the highest refresh.
+ *     High sweepFrames, cacheParentMatrixRange, cachePositionsForDraw or positionEvaluations point at the DG,
+ *     high drawFrames or drawFrameLabels at the drawing. sharedPanelDraws counts the panels of a refresh
+ *     drawn from the world space data prepareWorldData computed for the first one.
+ *     Example: cmds.tcMotionPathCmd(queryStats=True)
+ *
+ * -rst / -resetStats
+ *     Clear all timers and counters.
+ *     Example: cmds.tcMotionPathCmd(resetStats=True)
+ *
+ * -pwd / -prepareWorldData <boolean>
+ *     Debugging and benchmarking only, registered in batch and mayapy sessions with TC_MOTIONPATH_HEADLESS
+ *     set, not in the interactive UI. Runs the world space work the first panel of a refresh does for every
+ *     displayed path: the frame sweep, the parent matrix and position caches, cacheKeyFrames and the retained
+ *     vertices. With True the curves count as edited first, so the keyframes and positions are rebuilt.
+ *     See bench/motionPathBench.py.
+ *     Example: cmds.tcMotionPathCmd(prepareWorldData=True)
+ *
+ * -qcm / -queryCacheMemory
+ *     Return the cache memory in bytes, one string per entry: the total with the budget,
+ *     then every path, pooled path, camera and buffer path.
+ *     Example: cmds.tcMotionPathCmd(queryCacheMemory=True)
+ *
+ * =============================================================================
  * INTERNAL/UNDO FLAGS (typically not called directly by users)
  * =============================================================================
  *
@@ -326,6 +415,13 @@ MSyntax MotionPathCmd::syntaxCreator()
     // Display style
     syntax.addFlag("-alf", "-alternatingFrames", MSyntax::kBoolean);
     syntax.addFlag("-up", "-usePivots", MSyntax::kBoolean);
+    syntax.addFlag("-rg", "-retainedGeometry", MSyntax::kBoolean);
+    syntax.addFlag("-lod", "-lodTolerance", MSyntax::kDouble);
+    syntax.addFlag("-dcl", "-declutterLabels", MSyntax::kBoolean);
+    syntax.addFlag("-fc", "-frustumCulling", MSyntax::kBoolean);
+    syntax.addFlag("-ch", "-compiledHierarchy", MSyntax::kBoolean);
+    syntax.addFlag("-ppb", "-pathPoolBudget", MSyntax::kDouble);
+    syntax.addFlag("-cmb", "-cacheMemoryBudget", MSyntax::kDouble);
 
     // Buffer paths
     syntax.addFlag("-abp", "-addBufferPaths", MSyntax::kNoArg);
@@ -333,11 +429,21 @@ MSyntax MotionPathCmd::syntaxCreator()
     syntax.addFlag("-dbi", "-deleteBufferPathAtIndex", MSyntax::kLong);
     syntax.addFlag("-sbp", "-selectBufferPathAtIndex", MSyntax::kLong);
     syntax.addFlag("-dbp", "-deselectBufferPathAtIndex", MSyntax::kLong);
+    syntax.addFlag("-sbf", "-saveBufferPaths", MSyntax::kString);
+    syntax.addFlag("-lbf", "-loadBufferPaths", MSyntax::kString);
 
     // Buffer path queries
     syntax.addFlag("-qbpc", "-queryBufferPathCount", MSyntax::kNoArg);
     syntax.addFlag("-qbpn", "-queryBufferPathName", MSyntax::kLong);
 
+    // Statistics
+    syntax.addFlag("-qst", "-queryStats", MSyntax::kNoArg);
+    syntax.addFlag("-rst", "-resetStats", MSyntax::kNoArg);
+    // the headless benchmark reaches the draw time caching through it, nothing draws in batch mode
+    if (MGlobal::mayaState() == MGlobal::kBatch || MGlobal::mayaState() == MGlobal::kLibraryApp)
+        syntax.addFlag("-pwd", "-prepareWorldData", MSyntax::kBoolean);
+    syntax.addFlag("-qcm", "-queryCacheMemory", MSyntax::kNoArg);
+
     // Size settings
     syntax.addFlag("-fs", "-frameSize", MSyntax::kDouble);
     syntax.addFlag("-ps", "-pathSize", MSyntax::kDouble);
@@ -491,6 +597,62 @@ MStatus MotionPathCmd::doIt(const MArgList& args)
         mpManager.clearParentMatrixCaches();
         mpManager.refreshDisplayTimeRange();
     }
+    else if (argData.isFlagSet("-retainedGeometry"))
+    {
+        bool retainedGeometry;
+        argData.getFlagArgument("-retainedGeometry", 0, retainedGeometry);
+        GlobalSettings::retainedGeometry = retainedGeometry;
+    }
+    else if (argData.isFlagSet("-lodTolerance"))
+    {
+        double lodTolerance;
+        argData.getFlagArgument("-lodTolerance", 0, lodTolerance);
+
+        if (lodTolerance < 0)
+            lodTolerance = 0;
+
+        GlobalSettings::pathLodTolerance = lodTolerance;
+    }
+    else if (argData.isFlagSet("-declutterLabels"))
+    {
+        bool declutterLabels;
+        argData.getFlagArgument("-declutterLabels", 0, declutterLabels);
+        GlobalSettings::declutterLabels = declutterLabels;
+    }
+    else if (argData.isFlagSet("-frustumCulling"))
+    {
+        bool frustumCulling;
+        argData.getFlagArgument("-frustumCulling", 0, frustumCulling);
+        GlobalSettings::frustumCulling = frustumCulling;
+    }
+    else if (argData.isFlagSet("-compiledHierarchy"))
+    {
+        bool compiledHierarchy;
+        argData.getFlagArgument("-compiledHierarchy", 0, compiledHierarchy);
+        GlobalSettings::compiledHierarchy = compiledHierarchy;
+    }
+    else if (argData.isFlagSet("-pathPoolBudget"))
+    {
+        double pathPoolBudget;
+        argData.getFlagArgument("-pathPoolBudget", 0, pathPoolBudget);
+
+        if (pathPoolBudget < 0)
+            pathPoolBudget = 0;
+        
+        GlobalSettings::pathPoolBudget = pathPoolBudget;
+        mpManager.trimPathPool();
+    }
+    else if (argData.isFlagSet("-cacheMemoryBudget"))
+    {
+        double cacheMemoryBudget;
+        argData.getFlagArgument("-cacheMemoryBudget", 0, cacheMemoryBudget);
+
+        if (cacheMemoryBudget < 0)
+            cacheMemoryBudget = 0;
+        
+        GlobalSettings::cacheMemoryBudget = cacheMemoryBudget;
+        mpManager.enforceCacheBudget();
+    }
     else if (argData.isFlagSet("-pathSize"))
     {
         double pathSize;
@@ -557,7 +719,7 @@ MStatus MotionPathCmd::doIt(const MArgList& args)
             GlobalSettings::motionPathDrawMode = (GlobalSettings::DrawMode) drawMode;
 
             // Trigger viewport refresh when draw mode changes
-            MGlobal::executeCommandOnIdle("refresh");
+            mpManager.getRefreshCoordinatorPtr()->refreshOnIdle(true);
         }
     }
     else if (argData.isFlagSet("-frameInterval"))
@@ -641,12 +803,58 @@ MStatus MotionPathCmd::doIt(const MArgList& args)
         argData.getFlagArgument("-deselectBufferPathAtIndex", 0, index);
         mpManager.setSelectStateForBufferPathAtIndex(index, false);
     }
+    else if (argData.isFlagSet("-saveBufferPaths"))
+    {
+        MString fileName, error;
+        argData.getFlagArgument("-saveBufferPaths", 0, fileName);
+        if (!mpManager.saveBufferPaths(fileName, error))
+        {
+            MGlobal::displayError("tcMotionPathCmd: " + error);
+            return MS::kFailure;
+        }
+    }
+    else if (argData.isFlagSet("-loadBufferPaths"))
+    {
+        MString fileName, error;
+        argData.getFlagArgument("-loadBufferPaths", 0, fileName);
+        if (!mpManager.loadBufferPaths(fileName, error))
+        {
+            MGlobal::displayError("tcMotionPathCmd: " + error);
+            return MS::kFailure;
+        }
+    }
     else if (argData.isFlagSet("-queryBufferPathCount"))
     {
         int count = mpManager.getBufferPathCount();
         setResult(count);
         return MS::kSuccess;
     }
+    else if (argData.isFlagSet("-queryStats"))
+    {
+        MStringArray stats;
+        pathStats::query(stats);
+        setResult(stats);
+        return MS::kSuccess;
+    }
+    else if (argData.isFlagSet("-resetStats"))
+    {
+        pathStats::reset();
+        return MS::kSuccess;
+    }
+    else if (argData.isFlagSet("-prepareWorldData"))
+    {
+        bool keysEdited;
+        argData.getFlagArgument("-prepareWorldData", 0, keysEdited);
+        mpManager.prepareWorldData(keysEdited);
+        return MS::kSuccess;
+    }
+    else if (argData.isFlagSet("-queryCacheMemory"))
+    {
+        MStringArray memory;
+        mpManager.queryCacheMemory(memory);
+        setResult(memory);
+        return MS::kSuccess;
+    }
     else if (argData.isFlagSet("-queryBufferPathName"))
     {
         int index;
@@ -819,8 +1027,7 @@ void MotionPathCmd::restoreKeySelection(const std::vector<MDoubleArray> &sel)
 
 bool MotionPathCmd::createCurveFromBufferPath(BufferPath *bp)
 {
-    const std::vector<MVector>* points = bp->getFrames();
-    if (points == NULL) return false;
+    if (bp == NULL) return false;
 
     // Build curve name from object name with "_Buffer_Path" suffix
     MString curveName = bp->getObjectName();
@@ -831,14 +1038,14 @@ bool MotionPathCmd::createCurveFromBufferPath(BufferPath *bp)
     // Build MEL command with proper naming
     MString cmd = "curve -d 1 -name \"" + curveName + "\" ";
     MString cvsStr = "";
-    for (unsigned int i = 0; i < points->size(); ++i)
+    for (int i = 0; i < bp->getFrameCount(); ++i)
     {
-        MVector v = points->at(i);
+        MVector v = bp->getFrame(i);
         cvsStr += MString("-p ") + v.x + " " + v.y + " " + v.z + " ";
     }
 
     MString knotsStr = "";
-    for (unsigned int i = 0; i < points->size(); i++)
+    for (int i = 0; i < bp->getFrameCount(); i++)
         knotsStr += MString("-k ") + ((double) i) + " ";
 
     MDGModifier *dg = mpManager.getDGModifierPtr();
@@ -175,11 +175,7 @@ bool MotionPathDrawContext::doPressCommon(MEvent &event, const bool old)
 
     
 	CameraCache * cachePtr = mpManager.MotionPathManager::getCameraCachePtrFromView(activeView);
-	int selectedCurveId;
-	if (!old)
-		selectedCurveId = contextUtils::processCurveHits(initialX, initialY, GlobalSettings::cameraMatrix, activeView, cachePtr, mpManager);
-	else
-		selectedCurveId = contextUtils::processCurveHits(activeView, cachePtr, mpManager);
+	int selectedCurveId = contextUtils::processCurveHits(initialX, initialY, GlobalSettings::cameraMatrix, activeView, cachePtr, mpManager);
 
     if (selectedCurveId != -1)
     {
@@ -189,10 +185,7 @@ bool MotionPathDrawContext::doPressCommon(MEvent &event, const bool old)
             selectedMotionPathPtr->setSelectedFromTool(true);
                 
             MIntArray ids;
-			if (!old)
-				contextUtils::processKeyFrameHits(initialX, initialY, selectedMotionPathPtr, activeView, GlobalSettings::cameraMatrix, cachePtr, ids);
-			else
-				contextUtils::processKeyFrameHits(selectedMotionPathPtr, activeView, cachePtr, ids);
+			contextUtils::processKeyFrameHits(initialX, initialY, selectedMotionPathPtr, activeView, GlobalSettings::cameraMatrix, cachePtr, ids, mpManager);
             if (ids.length() > 0)
             {
                 selectedKeyId = ids[ids.length() - 1];
@@ -499,78 +492,6 @@ int MotionPathDrawContext::getStrokeDirection(MVector directionalVector, const M
     return dot1 > dot2 ? -1: 1;
 }
 
-MVector MotionPathDrawContext::getClosestPointOnPolyLine(const MVector &q)
-{
-    const int count = strokePoints.length();
-    double finalT = 0;
-    int index = 0;
-
-    MVector b = strokePoints[0], dbq = b - q;
-    double dist = (dbq.x*dbq.x + dbq.y*dbq.y);
-    for (size_t i = 1; i < count; ++i)
-    {
-        const MVector a = b, daq = dbq;
-
-        b = strokePoints[i];
-        dbq = b - q;
-        
-        const MVector dab = a - b;
-        const double inv_sqrlen = 1./(dab.x*dab.x + dab.y*dab.y),
-                              t = (dab.x*daq.x + dab.y*daq.y) * inv_sqrlen;
-        if (t<0.)
-            continue;
-        double current_dist;
-        if (t<=1.)
-            current_dist = (dab.x*dbq.y - dab.y*dbq.x) * (dab.x*dbq.y - dab.y*dbq.x) * inv_sqrlen;
-        else//t>1.
-            current_dist = (dbq.x*dbq.x + dbq.y*dbq.y);
-        
-        if (current_dist<dist)
-        {
-            dist = current_dist;
-            finalT = t > 1 ? 1: t;
-            index = i;
-        }
-    }
-    
-    if (finalT == 0 && index == 0)
-        return strokePoints[0];
-    else
-        return strokePoints[index] * finalT + strokePoints[index-1] * (1-finalT);
-}
-
-MVector MotionPathDrawContext::getSpreadPointOnPolyLine(const int i, const int pointSize, const double strokeLenght, const std::vector<double> &segmentLenghts)
-{
-    if (i == pointSize-1)
-    {
-        if (strokePoints.length() == 0)
-            return MVector::zero;
-        return strokePoints[strokePoints.length() - 1];
-    }
-    else
-    {
-        //we do +1 as the first key is not evaluated, and with pointSize there no -1
-        float tl = (((float)i+1) / ((float)pointSize)) * strokeLenght;
-        
-        int currentSegmentIndex = 0;
-        double currentSegmentLenght = 0;
-        for (int j = 0; j < strokePoints.length() - 1; ++j)
-        {
-            if (tl > currentSegmentLenght && tl < currentSegmentLenght + segmentLenghts[j])
-            {
-                currentSegmentIndex = j;
-                break;
-            }
-            else
-                currentSegmentLenght += segmentLenghts[j];
-        }
-
-        float t = (tl - currentSegmentLenght) / (segmentLenghts[currentSegmentIndex]);
-        return strokePoints[currentSegmentIndex+1] * t + strokePoints[currentSegmentIndex] * (1 - t);
-    }
-
-}
-
 bool MotionPathDrawContext::doReleaseCommon(MEvent &event, const bool old)
 {
     if (selectedMotionPathPtr)
@@ -656,26 +577,23 @@ bool MotionPathDrawContext::doReleaseCommon(MEvent &event, const bool old)
                     if (pointSize > 0)
                     {
                         //we delete the key frames so maya will recalculate the tangents when adding the keyframes back
-                        for (int i = cache.size() - 1; i > -1 ; --i)
-                            selectedMotionPathPtr->deleteKeyFrameAtTime(cache[i].time, mpManager.getAnimCurveChangePtr(), false);
+                        MDoubleArray strokeTimes;
+                        for (int i = 0; i < pointSize; ++i)
+                            strokeTimes.append(cache[i].time);
+                        selectedMotionPathPtr->deleteKeyFramesAtTimes(strokeTimes, mpManager.getAnimCurveChangePtr());
                         
-                        //get the stroke lenght
-                        double strokeLenght = 0;
-                        std::vector<double> segmentLenghts;
-                        segmentLenghts.resize(strokeNum);
-                        for (int i = 1; i < strokeNum; ++i)
-                        {
-                            segmentLenghts[i-1] = (strokePoints[i] - strokePoints[i - 1]).length();
-                            strokeLenght += segmentLenghts[i-1];
-                        }
+                        // arc length table and segment grid of the stroke, built once for all the keys
+                        strokeGeometry.set(strokePoints);
                         
-                        // match each key using the right mode (closest or spread)
+                        // match each key using the right mode (closest or spread), the keys are added back in one go
+                        MDoubleArray newTimes;
+                        MVectorArray newPositions;
                         for (int i = 0; i < pointSize ; ++i)
                         {
                             if (GlobalSettings::strokeMode == 0) //closest
-                                cache[i].screenPosition = getClosestPointOnPolyLine(cache[i].originalScreenPosition);
+                                cache[i].screenPosition = strokeGeometry.closestPoint(cache[i].originalScreenPosition);
                             else // spread
-                                cache[i].screenPosition = getSpreadPointOnPolyLine(i, pointSize, strokeLenght, segmentLenghts);
+                                cache[i].screenPosition = strokeGeometry.spreadPoint(i, pointSize);
 
                             MVector newPosition = contextUtils::getWorldPositionFromProjPoint(cache[i].originalWorldPosition, cache[i].originalScreenPosition.x, cache[i].originalScreenPosition.y, cache[i].screenPosition.x, cache[i].screenPosition.y, activeView, cameraPosition);
                             
@@ -683,12 +601,17 @@ bool MotionPathDrawContext::doReleaseCommon(MEvent &event, const bool old)
                             {
                                 MPoint worldPos = newPosition;
                                 if (!contextUtils::worldCameraSpaceToWorldSpace(worldPos, activeView, cache[i].time, inverseCameraMatrix, mpManager))
+                                {
+                                    selectedMotionPathPtr->addKeyFramesAtTimes(newTimes, newPositions, mpManager.getAnimCurveChangePtr());
                                     return false;
+                                }
                                 newPosition = worldPos;
                             }
                             
-                            selectedMotionPathPtr->addKeyFrameAtTime(cache[i].time, mpManager.getAnimCurveChangePtr(), &newPosition, false);
+                            newTimes.append(cache[i].time);
+                            newPositions.append(newPosition);
                         }
+                        selectedMotionPathPtr->addKeyFramesAtTimes(newTimes, newPositions, mpManager.getAnimCurveChangePtr());
                     }
                 }
             }
@@ -725,8 +648,6 @@ bool MotionPathDrawContext::doReleaseCommon(MEvent &event, const bool old)
                     return true;
                 }
 
-                double pathLength = calculatePathLength(strokePoints);
-
                 // Calculate range to clear: (selectedTime, selectedTime + keyframeCount * frameInterval]
                 // Exclude start keyframe, include end position
                 double rangeEnd = selectedTime + (keyframeCount * frameInterval);
@@ -742,6 +663,8 @@ bool MotionPathDrawContext::doReleaseCommon(MEvent &event, const bool old)
                 // Sample keyframes along the path (skip start point)
                 // Use direct index sampling to follow curve shape naturally
                 // totalPoints already validated above (>= 2)
+                MDoubleArray keyTimes;
+                MVectorArray keyPositions;
                 for (int i = 0; i < keyframeCount; ++i)
                 {
                     // Calculate point index (skip first point at index 0)
@@ -775,13 +698,13 @@ bool MotionPathDrawContext::doReleaseCommon(MEvent &event, const bool old)
                         worldPos = worldPosPoint;
                     }
 
-                    // Add keyframe (useCache=false for batch operation)
-                    selectedMotionPathPtr->addKeyFrameAtTime(keyTime, mpManager.getAnimCurveChangePtr(), &worldPos, false);
-
-                    if (i == 0 || i == keyframeCount - 1)
-                        MGlobal::displayInfo(MString("[MotionPath] Added keyframe at time ") + keyTime);
+                    keyTimes.append(keyTime);
+                    keyPositions.append(worldPos);
                 }
 
+                // one addKeys per curve for the whole stroke
+                selectedMotionPathPtr->addKeyFramesAtTimes(keyTimes, keyPositions, mpManager.getAnimCurveChangePtr());
+
                 MGlobal::displayInfo(MString("[MotionPath] Successfully added ") + keyframeCount + " keyframes");
 
                 // Update end drawing time
@@ -909,44 +832,3 @@ void MotionPathDrawContext::drawPreviewPath()
     glDisable(GL_LINE_SMOOTH);
     glDisable(GL_BLEND);
 }
-
-// Helper function: Calculate total length of polyline path
-double MotionPathDrawContext::calculatePathLength(const MVectorArray &points)
-{
-    double length = 0.0;
-    for (unsigned int i = 1; i < points.length(); ++i)
-    {
-        length += (points[i] - points[i-1]).length();
-    }
-    return length;
-}
-
-// Helper function: Sample point at normalized position t (0.0-1.0) along polyline path
-MVector MotionPathDrawContext::samplePointOnPath(double t, const MVectorArray &points, double totalLength)
-{
-    if (points.length() == 0)
-        return MVector::zero;
-    if (t <= 0.0 || points.length() == 1)
-        return points[0];
-    if (t >= 1.0)
-        return points[points.length() - 1];
-
-    double targetLength = t * totalLength;
-    double currentLength = 0.0;
-
-    for (unsigned int i = 1; i < points.length(); ++i)
-    {
-        double segmentLength = (points[i] - points[i-1]).length();
-
-        if (currentLength + segmentLength >= targetLength)
-        {
-            // Interpolate within this segment
-            double localT = (targetLength - currentLength) / segmentLength;
-            return points[i-1] * (1.0 - localT) + points[i] * localT;
-        }
-
-        currentLength += segmentLength;
-    }
-
-    return points[points.length() - 1];
-}
@@ -3,6 +3,12 @@
 #include "GlobalSettings.h"
 #include "ContextUtils.h"
 
+#include <algorithm>
+
+#ifdef __APPLE__
+    #include <ApplicationServices/ApplicationServices.h>
+#endif
+
 extern MotionPathManager mpManager;
 
 // Static variable initialization for circle rendering optimization
@@ -120,7 +126,7 @@ void MotionPathEditContext::toolOnSetup( MEvent& event )
 	glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 
 	// set the help text in the maya help boxs
-	setHelpString("Left-Click: Select/Move; Shift+Left-Click: Add to selection; CTRL+Left-Click: Toggle selection; CTRL+Left-Click-Drag: Move Selection on the XY plane; CTRL+Middle-Click-Drag: Move Along Y Axis; Right-Click on path/frame/key: show menu");
+	setHelpString("Left-Click: Select/Move; Shift+Left-Click: Add to selection; CTRL+Left-Click: Toggle selection; CTRL+Left-Click-Drag: Move Selection on the XY plane; CTRL+Middle-Click-Drag: Move Along Y Axis; Left-Click-Drag on empty space: Marquee select keys; Middle-Click-Drag on empty space: Lasso select keys; Right-Click on path/frame/key: show menu");
 
     M3dView view = M3dView::active3dView();
 	view.refresh(true, true);
@@ -183,6 +189,7 @@ bool MotionPathEditContext::doPressCommon(MEvent &event, const bool old)
     // Caps OFF → Edit mode (single-point operations)
     selectedMotionPathPtr = NULL;
     startedRecording = false;
+    lassoPoints.clear();
 
     event.getPosition(initialX, initialY);
     activeView = M3dView::active3dView();
@@ -192,11 +199,7 @@ bool MotionPathEditContext::doPressCommon(MEvent &event, const bool old)
     
     CameraCache * cachePtr = mpManager.MotionPathManager::getCameraCachePtrFromView(activeView);
     
-	int selectedCurveId;
-	if (!old)
-		selectedCurveId = contextUtils::processCurveHits(initialX, initialY, GlobalSettings::cameraMatrix, activeView, cachePtr, mpManager);
-	else
-		selectedCurveId = contextUtils::processCurveHits(activeView, cachePtr, mpManager);
+	int selectedCurveId = contextUtils::processCurveHits(initialX, initialY, GlobalSettings::cameraMatrix, activeView, cachePtr, mpManager);
 
     if (selectedCurveId != -1)
     {
@@ -216,10 +219,7 @@ bool MotionPathEditContext::doPressCommon(MEvent &event, const bool old)
             
             MIntArray selectedKeys;
 
-			if (!old)
-				contextUtils::processKeyFrameHits(initialX, initialY, selectedMotionPathPtr, activeView, GlobalSettings::cameraMatrix, cachePtr, selectedKeys);
-			else
-				contextUtils::processKeyFrameHits(selectedMotionPathPtr, activeView, cachePtr, selectedKeys);
+			contextUtils::processKeyFrameHits(initialX, initialY, selectedMotionPathPtr, activeView, GlobalSettings::cameraMatrix, cachePtr, selectedKeys, mpManager);
 
             if (selectedKeys.length() == 0)
             {
@@ -228,10 +228,7 @@ bool MotionPathEditContext::doPressCommon(MEvent &event, const bool old)
                 {
                     int selectedKeyId;
 
-					if (!old)
-						contextUtils::processTangentHits(initialX, initialY, selectedMotionPathPtr, activeView, GlobalSettings::cameraMatrix, cachePtr, selectedKeyId, selectedTangent);
-					else
-						contextUtils::processTangentHits(selectedMotionPathPtr, activeView, cachePtr, selectedKeyId, selectedTangent);
+					contextUtils::processTangentHits(initialX, initialY, selectedMotionPathPtr, activeView, GlobalSettings::cameraMatrix, cachePtr, selectedKeyId, selectedTangent, mpManager);
 
                     //move tangent
                     if (selectedTangent != -1)
@@ -292,6 +289,10 @@ bool MotionPathEditContext::doPressCommon(MEvent &event, const bool old)
     else
     {
         contextUtils::refreshSelectionMethod(event, listAdjustment);
+
+        // the middle mouse draws a lasso instead of the marquee
+        if (event.mouseButton() == MEvent::kMiddleMouse)
+            lassoPoints.append(MVector(initialX, initialY, 0));
         
         if (old)
             fsDrawn = false;
@@ -356,16 +357,8 @@ void MotionPathEditContext::doDragCommon(MEvent &event, const bool old)
             offset = offset * inverseCameraMatrix;
         }
     
-        for (int i = 0; i < mpManager.getMotionPathsCount(); i++)
-        {
-            MotionPath *motionPath = mpManager.getMotionPathPtr(i);
-            if (motionPath)
-            {
-                MDoubleArray selectedTimes = motionPath->getSelectedKeys();
-                for (int j = 0; j < static_cast<int>(selectedTimes.length()); j++)
-                    motionPath->offsetWorldPosition(GlobalSettings::motionPathDrawMode == GlobalSettings::kWorldSpace ? offset : offset * cachePtr->matrixCache[selectedTimes[j]].inverse(), selectedTimes[j], mpManager.getAnimCurveChangePtr());
-            }
-        }
+        // one batched edit for all the selected keys, the undo is recorded once on release
+        mpManager.offsetSelectedKeys(offset, GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace ? cachePtr : NULL);
         
         lastWorldPosition = newPosition;
     }
@@ -379,8 +372,8 @@ void MotionPathEditContext::doDragCommon(MEvent &event, const bool old)
             CameraCache * cachePtr = mpManager.MotionPathManager::getCameraCachePtrFromView(activeView);
             if (!cachePtr)
                 return;
-            //newPosition = MVector(MPoint(newPosition) * inverseCameraMatrix * cachePtr->matrixCache[lastSelectedTime].inverse());
-            toWorldMatrix = inverseCameraMatrix * cachePtr->matrixCache[lastSelectedTime].inverse();
+            //newPosition = MVector(MPoint(newPosition) * inverseCameraMatrix * cachePtr->matrixCache.get(lastSelectedTime).inverse());
+            toWorldMatrix = inverseCameraMatrix * cachePtr->matrixCache.get(lastSelectedTime).inverse();
         }
         else
             toWorldMatrix.setToIdentity();
@@ -389,8 +382,8 @@ void MotionPathEditContext::doDragCommon(MEvent &event, const bool old)
 
     }
 
-    // 保留刷新以提供实时视觉反馈（功能优先于优化）
-    view.refresh(true, true);
+    // 只刷新正在拖动的视图，最多每个显示帧一次；松开鼠标时再刷新所有视图
+    mpManager.getRefreshCoordinatorPtr()->refresh(false, true);
 }
 
 MStatus MotionPathEditContext::doDrag(MEvent &event)
@@ -446,6 +439,16 @@ MStatus MotionPathEditContext::doDrag(MEvent &event)
             }
         }
     }
+    else if (lassoPoints.length() > 0)
+    {
+        event.getPosition( finalX, finalY );
+        lassoPoints.append(MVector(finalX, finalY, 0));
+
+        // the segments drawn so far stay, only the new one is added
+        activeView.beginXorDrawing();
+        contextUtils::drawLassoGL(lassoPoints, lassoPoints.length() - 2);
+        activeView.endXorDrawing();
+    }
     else
     {
         activeView.beginXorDrawing();
@@ -543,8 +546,14 @@ MStatus MotionPathEditContext::doDrag(MEvent & event, MHWRender::MUIDrawManager&
     {
         //  Get the marquee's new end position.
         event.getPosition( finalX, finalY );
-        // Draw the marquee at its new position.
-        contextUtils::drawMarquee(drawMgr, initialX, initialY, finalX, finalY);
+        if (lassoPoints.length() > 0)
+        {
+            lassoPoints.append(MVector(finalX, finalY, 0));
+            contextUtils::drawLasso(drawMgr, lassoPoints);
+        }
+        else
+            // Draw the marquee at its new position.
+            contextUtils::drawMarquee(drawMgr, initialX, initialY, finalX, finalY);
     }
     return MS::kSuccess;
 }
@@ -566,7 +575,11 @@ void MotionPathEditContext::doReleaseCommon(MEvent &event, const bool old)
     if (selectedMotionPathPtr)
     {
         if(startedRecording && (currentMode == kFrameEditMode || currentMode == kTangentEditMode || currentMode == kShiftKeyMode))
+        {
+            if (currentMode == kFrameEditMode)
+                mpManager.commitKeyEdits();
             mpManager.stopDGAndAnimUndoRecording();
+        }
         
         selectedMotionPathPtr->setSelectedFromTool(false);
         selectedMotionPathPtr = NULL;
@@ -575,6 +588,8 @@ void MotionPathEditContext::doReleaseCommon(MEvent &event, const bool old)
         alongPreferredAxis = false;
         prefEditAxis = -1;
         
+        // the full refresh below covers a drag refresh still waiting for idle
+        mpManager.getRefreshCoordinatorPtr()->cancel();
         M3dView view = M3dView::active3dView();
 		view.refresh(true, true);
     }
@@ -582,14 +597,34 @@ void MotionPathEditContext::doReleaseCommon(MEvent &event, const bool old)
     {
         event.getPosition( finalX, finalY );
         
-        if (fsDrawn && old)
+        if (old && lassoPoints.length() > 0)
+        {
+            activeView.beginXorDrawing();
+            contextUtils::drawLassoGL(lassoPoints, 0);
+            activeView.endXorDrawing();
+        }
+        else if (fsDrawn && old)
         {
             activeView.beginXorDrawing();
             contextUtils::drawMarqueeGL(initialX, initialY, finalX, finalY);
             activeView.endXorDrawing();
         }
         
-        contextUtils::applySelection(initialX, initialY, finalX, finalY, listAdjustment);
+        // keys inside the region win, objects are only selected when it holds none
+        if (!contextUtils::applyKeySelection(initialX, initialY, finalX, finalY, lassoPoints, listAdjustment, activeView, mpManager, regionHits))
+        {
+            // there is no lasso pick of objects here, the box around the lasso is used
+            short x0 = initialX, y0 = initialY, x1 = finalX, y1 = finalY;
+            for (unsigned int i = 0; i < lassoPoints.length(); ++i)
+            {
+                x0 = std::min(x0, static_cast<short>(lassoPoints[i].x));
+                y0 = std::min(y0, static_cast<short>(lassoPoints[i].y));
+                x1 = std::max(x1, static_cast<short>(lassoPoints[i].x));
+                y1 = std::max(y1, static_cast<short>(lassoPoints[i].y));
+            }
+            contextUtils::applySelection(x0, y0, x1, y1, listAdjustment);
+        }
+        lassoPoints.clear();
     }
 }
 
@@ -649,11 +684,7 @@ bool MotionPathEditContext::handleDrawModePress(MEvent &event, const bool old)
     // Middle mouse button removed - use Edit mode right-click menu
 
     CameraCache * cachePtr = mpManager.MotionPathManager::getCameraCachePtrFromView(activeView);
-    int selectedCurveId;
-    if (!old)
-        selectedCurveId = contextUtils::processCurveHits(initialX, initialY, GlobalSettings::cameraMatrix, activeView, cachePtr, mpManager);
-    else
-        selectedCurveId = contextUtils::processCurveHits(activeView, cachePtr, mpManager);
+    int selectedCurveId = contextUtils::processCurveHits(initialX, initialY, GlobalSettings::cameraMatrix, activeView, cachePtr, mpManager);
 
     if (selectedCurveId != -1)
     {
@@ -663,10 +694,7 @@ bool MotionPathEditContext::handleDrawModePress(MEvent &event, const bool old)
             selectedMotionPathPtr->setSelectedFromTool(true);
 
             MIntArray ids;
-            if (!old)
-                contextUtils::processKeyFrameHits(initialX, initialY, selectedMotionPathPtr, activeView, GlobalSettings::cameraMatrix, cachePtr, ids);
-            else
-                contextUtils::processKeyFrameHits(selectedMotionPathPtr, activeView, cachePtr, ids);
+            contextUtils::processKeyFrameHits(initialX, initialY, selectedMotionPathPtr, activeView, GlobalSettings::cameraMatrix, cachePtr, ids, mpManager);
             if (ids.length() > 0)
             {
                 drawSelectedKeyId = ids[ids.length() - 1];
@@ -850,26 +878,23 @@ bool MotionPathEditContext::handleDrawModeRelease(MEvent &event, const bool old)
                     if (pointSize > 0)
                     {
                         // Delete keyframes to recalculate tangents
-                        for (int i = static_cast<int>(cache.size()) - 1; i > -1 ; --i)
-                            selectedMotionPathPtr->deleteKeyFrameAtTime(cache[i].time, mpManager.getAnimCurveChangePtr(), false);
-
-                        // Get stroke length
-                        double strokeLenght = 0;
-                        std::vector<double> segmentLenghts;
-                        segmentLenghts.resize(strokeNum);
-                        for (int i = 1; i < strokeNum; ++i)
-                        {
-                            segmentLenghts[i-1] = (drawStrokePoints[i] - drawStrokePoints[i - 1]).length();
-                            strokeLenght += segmentLenghts[i-1];
-                        }
+                        MDoubleArray strokeTimes;
+                        for (int i = 0; i < pointSize; ++i)
+                            strokeTimes.append(cache[i].time);
+                        selectedMotionPathPtr->deleteKeyFramesAtTimes(strokeTimes, mpManager.getAnimCurveChangePtr());
+
+                        // Arc length table and segment grid of the stroke, built once for all the keys
+                        strokeGeometry.set(drawStrokePoints);
 
-                        // Match each key using the right mode (closest or spread)
+                        // Match each key using the right mode (closest or spread), the keys are added back in one go
+                        MDoubleArray newTimes;
+                        MVectorArray newPositions;
                         for (int i = 0; i < pointSize ; ++i)
                         {
                             if (GlobalSettings::strokeMode == 0) // closest
-                                cache[i].screenPosition = getClosestPointOnPolyLine(cache[i].originalScreenPosition);
+                                cache[i].screenPosition = strokeGeometry.closestPoint(cache[i].originalScreenPosition);
                             else // spread
-                                cache[i].screenPosition = getSpreadPointOnPolyLine(i, pointSize, strokeLenght, segmentLenghts);
+                                cache[i].screenPosition = strokeGeometry.spreadPoint(i, pointSize);
 
                             MVector newPosition = contextUtils::getWorldPositionFromProjPoint(
                                 cache[i].originalWorldPosition,
@@ -885,8 +910,10 @@ bool MotionPathEditContext::handleDrawModeRelease(MEvent &event, const bool old)
                                 newPosition = worldPos;
                             }
 
-                            selectedMotionPathPtr->addKeyFrameAtTime(cache[i].time, mpManager.getAnimCurveChangePtr(), &newPosition, false);
+                            newTimes.append(cache[i].time);
+                            newPositions.append(newPosition);
                         }
+                        selectedMotionPathPtr->addKeyFramesAtTimes(newTimes, newPositions, mpManager.getAnimCurveChangePtr());
                     }
                 }
             }
@@ -930,7 +957,9 @@ bool MotionPathEditContext::handleDrawModeRelease(MEvent &event, const bool old)
                 // Delete existing keyframes in range
                 selectedMotionPathPtr->deleteAllKeyFramesInRange(drawSelectedTime, rangeEnd, mpManager.getAnimCurveChangePtr());
 
-                // Sample and add keyframes
+                // Sample the keyframes, then add them with one addKeys per curve
+                MDoubleArray keyTimes;
+                MVectorArray keyPositions;
                 for (int i = 0; i < keyframeCount; ++i)
                 {
                     int pointIndex = (int)((double)(i + 1) * (totalPoints - 1) / (keyframeCount + 1));
@@ -955,8 +984,10 @@ bool MotionPathEditContext::handleDrawModeRelease(MEvent &event, const bool old)
                         worldPos = worldPosPoint;
                     }
 
-                    selectedMotionPathPtr->addKeyFrameAtTime(keyTime, mpManager.getAnimCurveChangePtr(), &worldPos, false);
+                    keyTimes.append(keyTime);
+                    keyPositions.append(worldPos);
                 }
+                selectedMotionPathPtr->addKeyFramesAtTimes(keyTimes, keyPositions, mpManager.getAnimCurveChangePtr());
 
                 // 移除热路径日志以提升性能（优化11）
                 // 用户可通过UI Toast提示看到"✓ 已添加 N 个关键帧"
@@ -1100,126 +1131,3 @@ int MotionPathEditContext::getStrokeDirection(MVector directionalVector, const M
 
     return dot1 > dot2 ? -1: 1;
 }
-
-MVector MotionPathEditContext::getClosestPointOnPolyLine(const MVector &q)
-{
-    const int count = drawStrokePoints.length();
-    double finalT = 0;
-    int index = 0;
-
-    MVector b = drawStrokePoints[0], dbq = b - q;
-    double dist = (dbq.x*dbq.x + dbq.y*dbq.y);
-    for (size_t i = 1; i < count; ++i)
-    {
-        const MVector a = b, daq = dbq;
-
-        b = drawStrokePoints[i];
-        dbq = b - q;
-
-        const MVector dab = a - b;
-        double sqrlen = dab.x*dab.x + dab.y*dab.y;
-        if (sqrlen < 1e-10)  // Points are identical, skip this segment
-            continue;
-        const double inv_sqrlen = 1.0 / sqrlen;
-        const double t = (dab.x*daq.x + dab.y*daq.y) * inv_sqrlen;
-        if (t<0.)
-            continue;
-        double current_dist;
-        if (t<=1.)
-            current_dist = (dab.x*dbq.y - dab.y*dbq.x) * (dab.x*dbq.y - dab.y*dbq.x) * inv_sqrlen;
-        else//t>1.
-            current_dist = (dbq.x*dbq.x + dbq.y*dbq.y);
-
-        if (current_dist<dist)
-        {
-            dist = current_dist;
-            finalT = t > 1 ? 1: t;
-            index = i;
-        }
-    }
-
-    if (finalT == 0 && index == 0)
-        return drawStrokePoints[0];
-    else
-        return drawStrokePoints[index] * finalT + drawStrokePoints[index-1] * (1-finalT);
-}
-
-MVector MotionPathEditContext::getSpreadPointOnPolyLine(const int i, const int pointSize, const double strokeLenght, const std::vector<double> &segmentLenghts)
-{
-    if (i == pointSize-1)
-    {
-        if (drawStrokePoints.length() == 0)
-            return MVector::zero;
-        return drawStrokePoints[drawStrokePoints.length() - 1];
-    }
-    else
-    {
-        //we do +1 as the first key is not evaluated, and with pointSize there no -1
-        float tl = (((float)i+1) / ((float)pointSize)) * strokeLenght;
-
-        int currentSegmentIndex = 0;
-        double currentSegmentLenght = 0;
-        bool found = false;
-        for (int j = 0; j < static_cast<int>(drawStrokePoints.length()) - 1; ++j)
-        {
-            if (tl > currentSegmentLenght && tl < currentSegmentLenght + segmentLenghts[j])
-            {
-                currentSegmentIndex = j;
-                found = true;
-                break;
-            }
-            else
-                currentSegmentLenght += segmentLenghts[j];
-        }
-
-        // If not found, use the last segment
-        if (!found && drawStrokePoints.length() >= 2)
-            currentSegmentIndex = static_cast<int>(drawStrokePoints.length()) - 2;
-
-        // Check for zero-length segment
-        if (segmentLenghts[currentSegmentIndex] < 1e-6)
-            return drawStrokePoints[currentSegmentIndex];
-
-        float t = (tl - currentSegmentLenght) / (segmentLenghts[currentSegmentIndex]);
-        return drawStrokePoints[currentSegmentIndex+1] * t + drawStrokePoints[currentSegmentIndex] * (1 - t);
-    }
-}
-
-double MotionPathEditContext::calculatePathLength(const MVectorArray &points)
-{
-    double length = 0.0;
-    for (unsigned int i = 1; i < points.length(); ++i)
-    {
-        length += (points[i] - points[i-1]).length();
-    }
-    return length;
-}
-
-MVector MotionPathEditContext::samplePointOnPath(double t, const MVectorArray &points, double totalLength)
-{
-    if (points.length() == 0)
-        return MVector::zero;
-    if (t <= 0.0 || points.length() == 1)
-        return points[0];
-    if (t >= 1.0)
-        return points[points.length() - 1];
-
-    double targetLength = t * totalLength;
-    double currentLength = 0.0;
-
-    for (unsigned int i = 1; i < points.length(); ++i)
-    {
-        double segmentLength = (points[i] - points[i-1]).length();
-
-        if (currentLength + segmentLength >= targetLength)
-        {
-            // Interpolate within this segment
-            double segmentT = (targetLength - currentLength) / segmentLength;
-            return points[i-1] * (1.0 - segmentT) + points[i] * segmentT;
-        }
-
-        currentLength += segmentLength;
-    }
-
-    return points[points.length() - 1];
-}
@@ -49,16 +49,9 @@ void ContextMenuWidget::refreshSelection(const QPoint point)
 	QPoint p = view.widget()->mapFromGlobal(point);
 	double y = view.widget()->height() - p.y() - 1;
 
-    // NOTE: The rendererString() method is obsolete. Viewport 2.0 is the default in Maya 2025.
-    // The logic is simplified to always use the modern hit-testing path.
-    bool new_ = true;
-    
     CameraCache *cachePtr = mpManager.getCameraCachePtrFromView(view);
     
-	if (new_)
-		selectedCurveId = contextUtils::processCurveHits(p.x(), y, GlobalSettings::cameraMatrix, view, cachePtr, mpManager);
-	else
-		selectedCurveId = contextUtils::processCurveHits(view, cachePtr, mpManager);
+	selectedCurveId = contextUtils::processCurveHits(p.x(), y, GlobalSettings::cameraMatrix, view, cachePtr, mpManager);
     if (selectedCurveId == -1)
         return;
     
@@ -67,20 +60,14 @@ void ContextMenuWidget::refreshSelection(const QPoint point)
 	if (!motionPathPtr)
 		return;
 
-	if (new_)
-		contextUtils::processKeyFrameHits(p.x(), y, motionPathPtr, view, GlobalSettings::cameraMatrix, cachePtr, selectedKeys);
-	else
-		contextUtils::processKeyFrameHits(motionPathPtr, view, cachePtr, selectedKeys);
+	contextUtils::processKeyFrameHits(p.x(), y, motionPathPtr, view, GlobalSettings::cameraMatrix, cachePtr, selectedKeys, mpManager);
     if (selectedKeys.length() > 0)
     {
         keyframe = true;
         return;
     }
     
-	if (new_)
-		frame = contextUtils::processFramesHits(p.x(), y, motionPathPtr, view, GlobalSettings::cameraMatrix, cachePtr, frameTime);
-	else
-		frame = contextUtils::processFramesHits(motionPathPtr, view, cachePtr, frameTime);
+	frame = contextUtils::processFramesHits(p.x(), y, motionPathPtr, view, GlobalSettings::cameraMatrix, cachePtr, frameTime, mpManager);
 
 }
 
@@ -130,7 +117,7 @@ bool ContextMenuWidget::eventFilter(QObject *o, QEvent *event)
             invertKeySelectionAction->setData(QVariant("invertKeySelectionAction"));
             
             MotionPath *motionPathPtr = mpManager.getMotionPathPtr(selectedCurveId);
-            bool keySelection = motionPathPtr->getSelectedKeys().length() > 0;
+            bool keySelection = motionPathPtr->hasSelectedKeys();
             bool hasCopiedKeys = KeyClipboard::getClipboard().getSize() > 0;
             
             copyAction->setEnabled(keySelection);
@@ -177,31 +164,31 @@ void ContextMenuWidget::menuAction(QAction* action)
     if (cmd == "offsetPaste")
     {
         if (motionPathPtr->getNumKeyFrames() == 0 && frameTime == maxTimeUI)
-            motionPathPtr->pasteKeys(currentTimeUI, true);
+            mpManager.pasteKeys(currentTimeUI, true);
         else
-            motionPathPtr->pasteKeys(keyframe ? motionPathPtr->getTimeFromKeyId(selectedKeys[0]) : frameTime, true);
+            mpManager.pasteKeys(keyframe ? motionPathPtr->getTimeFromKeyId(selectedKeys[0]) : frameTime, true);
 
         return;
     }
 
     if (cmd == "offsetPasteAtCurrentTime")
     {
-        motionPathPtr->pasteKeys(currentTimeUI, true);
+        mpManager.pasteKeys(currentTimeUI, true);
         return;
     }
 
     if (cmd == "paste")
     {
         if (motionPathPtr->getNumKeyFrames() == 0 && frameTime == maxTimeUI)
-            motionPathPtr->pasteKeys(currentTimeUI, false);
+            mpManager.pasteKeys(currentTimeUI, false);
         else
-            motionPathPtr->pasteKeys(keyframe ? motionPathPtr->getTimeFromKeyId(selectedKeys[0]) : frameTime, false);
+            mpManager.pasteKeys(keyframe ? motionPathPtr->getTimeFromKeyId(selectedKeys[0]) : frameTime, false);
         return;
     }
 
     if (cmd == "pasteAtCurrentTime")
     {
-        motionPathPtr->pasteKeys(currentTimeUI, false);
+        mpManager.pasteKeys(currentTimeUI, false);
         return;
     }
 
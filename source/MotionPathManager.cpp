@@ -13,14 +13,44 @@
 #include <maya/MGLFunctionTable.h>
 #include <maya/MViewport2Renderer.h>
 #include <maya/MDrawContext.h>
+#include <maya/MDGContext.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "MotionPathManager.h"
 #include "GlobalSettings.h"
+#include "PathCacheFile.h"
+#include "PathStats.h"
+
+extern MotionPathManager mpManager;
 
 MotionPathManager::MotionPathManager()
 {
     animCurveChangePtr = NULL;
-    cacheDone = true;
+    drawGeneration = 0;
+    
+    warming = false;
+    warmCenter = 0;
+    lastWarmTime = 0;
+    warmDirection = 1;
+    warmDistance = 0;
+    
+    scrubStep = 0;
+    scrubTime = 0;
+    lastTimeChange = std::chrono::steady_clock::now();
+    prefetchGeneration = 0;
+    
+    tickOpen = false;
+    tickTime = 0;
+    tickGeneration = 0;
+    tickIdleCallbackSet = false;
 
     pathArray.clear();
     selectionObjects.clear();
@@ -227,7 +257,7 @@ void MotionPathManager::viewCameraChanged(const MString &str, MObject &node, voi
         mpManager->refreshCameraCallbackForPanel(str, camera);
 
         // Trigger viewport refresh when camera changes in camera space mode
-        MGlobal::executeCommandOnIdle("refresh");
+        mpManager->refreshCoordinator.refreshOnIdle(true);
     }
 }
 
@@ -280,10 +310,12 @@ void MotionPathManager::cameraWorldMatrixChangedCallback(MObject& transformNode,
         }
     #endif
 
-    cachePtr->cacheCamera();
+    // every panel on this camera calls in, the first one updates the shared cache and the others find it current
+    if (!cachePtr->worldMatrixChanged())
+        return;
 
     // Trigger viewport refresh when camera matrix changes in camera space mode
-    MGlobal::executeCommandOnIdle("refresh");
+    mpManager.getRefreshCoordinatorPtr()->refreshOnIdle(true);
 }
 
 CameraCache *MotionPathManager::getCameraCachePtrFromView(M3dView &view)
@@ -297,19 +329,191 @@ CameraCache *MotionPathManager::getCameraCachePtrFromView(M3dView &view)
     if (it == cameraCache.end())
         return NULL;
    
+    it->second.setLastUsed(drawGeneration);
     return &it->second;
 }
 
+ScreenHitIndex *MotionPathManager::getHitIndex(M3dView &view)
+{
+    MDagPath camera;
+    view.getCamera(camera);
+    MMatrix cameraMatrix = camera.inclusiveMatrix();
+    int portWidth = view.portWidth();
+    int portHeight = view.portHeight();
+
+    ScreenHitIndex &hitIndex = hitIndices[std::string(camera.fullPathName().asChar())];
+    if (hitIndex.isValid(drawGeneration, cameraMatrix, portWidth, portHeight))
+        return &hitIndex;
+
+    CameraCache *cachePtr = getCameraCachePtrFromView(view);
+
+    // keys are picked with a radius of 1.5 frame sizes, tangents and frames with one frame size (diameters)
+    hitIndex.begin(drawGeneration, cameraMatrix, portWidth, portHeight, GlobalSettings::frameSize * 1.5 / 2);
+    for (int i = 0; i < pathArray.size(); ++i)
+        pathArray[i]->addHitTargets(hitIndex, i, view, cachePtr, cameraMatrix);
+    hitIndex.finalize();
+
+    return &hitIndex;
+}
+
 void MotionPathManager::drawBufferPaths(M3dView &view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
 	for (int i = 0; i < bufferPathArray.size(); ++i)
 		bufferPathArray[i].draw(view, cachePtr, drawManager, frameContext);
 }
 
+void MotionPathManager::sweepFrames()
+{
+    pathStats::ScopedTimer timer(pathStats::kSweepFrames);
+    
+    bool hasRange = false;
+    double sweepStart = 0, sweepEnd = 0;
+    double start, end;
+    
+    std::vector<MotionPath*> paths;
+    paths.reserve(pathArray.size());
+    for (unsigned int i = 0; i < pathArray.size(); ++i)
+    {
+        if (!pathArray[i]->beginFrameSweep(start, end))
+            continue;
+        
+        paths.push_back(pathArray[i].get());
+        sweepStart = hasRange ? std::min(sweepStart, start) : start;
+        sweepEnd = hasRange ? std::max(sweepEnd, end) : end;
+        hasRange = true;
+    }
+    
+    std::vector<CameraCache*> cameras;
+    if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
+    {
+        for (CameraCacheMapIterator it = cameraCache.begin(); it != cameraCache.end(); ++it)
+        {
+            if (!it->second.beginFrameSweep(start, end))
+                continue;
+            
+            cameras.push_back(&it->second);
+            sweepStart = hasRange ? std::min(sweepStart, start) : start;
+            sweepEnd = hasRange ? std::max(sweepEnd, end) : end;
+            hasRange = true;
+        }
+    }
+    
+    if (hasRange)
+    {
+        //one context per frame, shared by all the paths and cameras so maya evaluates each frame only once
+        for (double t = sweepStart; t <= sweepEnd; ++t)
+        {
+            MTime evalTime(t, MTime::uiUnit());
+            MDGContext context(evalTime);
+            
+            for (unsigned int i = 0; i < paths.size(); ++i)
+                paths[i]->sweepFrame(t, context);
+            
+            for (unsigned int i = 0; i < cameras.size(); ++i)
+                cameras[i]->sweepFrame(t, context);
+        }
+    }
+    
+    for (unsigned int i = 0; i < paths.size(); ++i)
+        paths[i]->endFrameSweep();
+    
+    for (unsigned int i = 0; i < cameras.size(); ++i)
+        cameras[i]->endFrameSweep();
+}
+
+// With several model panels open Maya draws each of them in turn within one refresh, and only the camera
+// differs between them. The sweep, the caches, the keyframes and the retained vertices are prepared for the
+// first panel, the others only do the camera dependent part in drawPaths.
+void MotionPathManager::beginRefreshTick(const MString &panelName)
+{
+    double time = MAnimControl::currentTime().as(MTime::uiUnit());
+    bool changed = !tickOpen || time != tickTime || tickGeneration != drawGeneration;
+    for (unsigned int i = 0; !changed && i < pathArray.size(); ++i)
+        changed = pathArray[i]->hasWorldChanges();
+    
+    if (!changed && tickPanels.insert(panelName.asChar()).second)
+    {
+        pathStats::count(pathStats::kSharedPanelDraws);
+        return;
+    }
+    
+    prepareWorldData();
+    
+    tickTime = time;
+    tickGeneration = drawGeneration;
+    tickPanels.clear();
+    tickPanels.insert(panelName.asChar());
+    
+    // the refresh is over once Maya goes idle, without the idle event every panel prepares its own
+    if (!tickIdleCallbackSet)
+    {
+        MStatus status;
+        tickIdleCallbackId = MEventMessage::addEventCallback("idle", tickIdleCallback, this, &status);
+        tickIdleCallbackSet = status == MS::kSuccess;
+    }
+    tickOpen = tickIdleCallbackSet;
+}
+
+void MotionPathManager::prepareWorldData(const bool keysEdited)
+{
+    pathStats::ScopedTimer timer(pathStats::kPrepareWorldData);
+    
+    if (keysEdited)
+    {
+        for (int i = 0; i < pathArray.size(); ++i)
+            pathArray[i]->setKeyframesDirty();
+    }
+    
+    sweepFrames();
+    ++drawGeneration;
+    
+    // Maya queries stay on the main thread, path by path
+	for (int i = 0; i < pathArray.size(); ++i)
+    {
+        pathArray[i]->setLastUsed(drawGeneration);
+        pathArray[i]->prepareWorldData();
+    }
+    
+    // every path only writes its own geometry, so the vertex generation runs one path per thread
+    int numPaths = static_cast<int>(pathArray.size());
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (numPaths > 1)
+#endif
+    for (int i = 0; i < numPaths; ++i)
+        pathArray[i]->buildDrawGeometry();
+}
+
+void MotionPathManager::endRefreshTick()
+{
+    tickOpen = false;
+    if (!tickIdleCallbackSet)
+        return;
+    
+    MMessage::removeCallback(tickIdleCallbackId);
+    tickIdleCallbackSet = false;
+}
+
+void MotionPathManager::tickIdleCallback(void *data)
+{
+    MotionPathManager* mpManager = (MotionPathManager*) data;
+    if (!mpManager)
+        return;
+    
+    // every panel of the refresh is drawn, the frames the next one needs are evaluated now
+    mpManager->endRefreshTick();
+    mpManager->prefetchLeadingEdge();
+}
+
 void MotionPathManager::drawPaths(M3dView view, CameraCache* cachePtr, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
+    labelLayer.begin(view.portWidth(), view.portHeight());
+    
+    // the world space data is ready, see beginRefreshTick; the draw manager is only fed from the main thread
 	for (int i = 0; i < pathArray.size(); ++i)
-		pathArray[i].draw(view, cachePtr, drawManager, frameContext);
+    {
+        if (pathArray[i]->prepareView(cachePtr))
+            pathArray[i]->submitDraw(view, cachePtr, drawManager, frameContext);
+    }
 }
 
 void MotionPathManager::viewPostRenderCallback(const MString& panelName, void* data)
@@ -358,10 +562,15 @@ void MotionPathManager::viewPostRenderCallback(const MString& panelName, void* d
 				return;
 			}
 			
+			// the legacy viewport counterpart of addUIDrawables
+			pathStats::RefreshScope refreshScope;
+			pathStats::ScopedTimer timer(pathStats::kAddUIDrawables);
+			
 			view.beginGL();
 
-			glPushAttrib(GL_ALL_ATTRIB_BITS);
-            glPushClientAttrib(GL_CLIENT_ALL_ATTRIB_BITS);
+			// only the state drawUtils touches, saving every attribute group cost more than the batched draws
+			glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_LINE_BIT | GL_POINT_BIT | GL_COLOR_BUFFER_BIT | GL_TRANSFORM_BIT);
+            glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
 			glPushMatrix();
 
 			// Exception safety: Use try-catch to ensure GL state is always restored
@@ -371,11 +580,9 @@ void MotionPathManager::viewPostRenderCallback(const MString& panelName, void* d
 				glDisable(GL_LIGHTING);
 				glDisable(GL_DEPTH_TEST);
 
-				for (int i = 0; i < mpManager->bufferPathArray.size(); ++i)
-					mpManager->bufferPathArray[i].draw(view, cachePtr);
-
-				for(int i = 0; i < mpManager->pathArray.size(); ++i)
-					mpManager->pathArray[i].draw(view, cachePtr);
+				mpManager->beginRefreshTick(panelName);
+				mpManager->drawBufferPaths(view, cachePtr);
+				mpManager->drawPaths(view, cachePtr);
 			}
 			catch (...)
 			{
@@ -427,26 +634,32 @@ void MotionPathManager::removePanelCallback(const RegisteredPanel &panel)
 
 void MotionPathManager::cleanupViewports()
 {
+    stopCacheWarming();
+    endRefreshTick();
+    refreshCoordinator.cancel();
+    
     for (unsigned int i = 0; i < registeredPanels.size(); ++i)
         removePanelCallback(registeredPanels[i]);
     
     registeredPanels.clear();
     pathArray.clear();
+    pathPool.clear();
     selectionObjects.clear();
     bufferPathArray.clear();
     cameraCache.clear();
+    hitIndices.clear();
 }
 
 void MotionPathManager::createMotionPathWorldCallback()
 {
     for(int i = 0; i < pathArray.size(); i++)
-        pathArray[i].addWorldMatrixCallback();
+        pathArray[i]->addWorldMatrixCallback();
 }
 
 void MotionPathManager::destroyMotionPathWorldCallback()
 {
     for(int i = 0; i < pathArray.size(); i++)
-        pathArray[i].removeWorldMartrixCallback();
+        pathArray[i]->removeWorldMartrixCallback();
 }
 
 void MotionPathManager::addCallbacks()
@@ -465,6 +678,9 @@ void MotionPathManager::addCallbacks()
     
     id = MModelMessage::addCallback(MModelMessage::kActiveListModified, selectionChangeCallback, this);
     this->cbIDs.append(id);
+    
+    id = MAnimMessage::addAnimCurveEditedCallback(animCurveEditedCallback, this);
+    this->cbIDs.append(id);
 }
 
 void MotionPathManager::sceneOpenedCallback(void *data)
@@ -479,6 +695,10 @@ void MotionPathManager::sceneOpenedCallback(void *data)
 
 void MotionPathManager::removeCallbacks()
 {
+    stopCacheWarming();
+    endRefreshTick();
+    refreshCoordinator.cancel();
+    
     for (unsigned int i = 0; i < this->cbIDs.length(); ++i)
     {
         MStatus status = MMessage::removeCallback(this->cbIDs[i]);
@@ -539,9 +759,9 @@ void MotionPathManager::highlightSelection(const MObjectArray &objArray)
     for (int i = 0; i < selectionObjects.length(); i++)
     {
         if (isContainedInMObjectArray(objArray, selectionObjects[i]))
-            pathArray[i].setColorMultiplier(1.0);
+            pathArray[i]->setColorMultiplier(1.0);
         else
-            pathArray[i].setColorMultiplier(0.4);
+            pathArray[i]->setColorMultiplier(0.4);
     }
 }
 
@@ -577,7 +797,10 @@ void MotionPathManager::timeChangeEvent(MTime &currentTime,  void* data)
 {
     MotionPathManager* mpManager = (MotionPathManager*) data;
 	if(mpManager)
+	{
+		mpManager->trackScrub(currentTime.as(MTime::uiUnit()));
 		mpManager->refreshDisplayTimeRange();
+	}
 
 
 }
@@ -589,12 +812,73 @@ void MotionPathManager::commandEvent(const MString &message, MCommandMessage::Me
 	{
 		if(message.indexW("setKeyframe") > -1)
 		{
+			// a new curve may have been created, the edited curve callback doesn't know about it yet
+			mpManager->invalidateRefreshTick();
+			for(int i = 0; i < mpManager->pathArray.size(); i++)
+				mpManager->pathArray[i]->setKeyframesDirty();
+			for (std::list<PooledPath>::iterator it = mpManager->pathPool.begin(); it != mpManager->pathPool.end(); ++it)
+				it->path->setKeyframesDirty();
+            
 			// will cause a refresh once maya is done with updating the curves
-			MGlobal::executeCommandOnIdle("refresh");
+			mpManager->refreshCoordinator.refreshOnIdle(true);
 		}
 	}
 }
 
+void MotionPathManager::animCurveEditedCallback(MObjectArray &editedCurves, void *data)
+{
+    MotionPathManager* mpManager = (MotionPathManager*) data;
+	if(!mpManager)
+		return;
+    mpManager->invalidateRefreshTick();
+    
+    // only the paths driven by one of the edited curves rebuild their keyframes
+    // a path moved by a batched key edit already invalidated the frames the edit reaches
+    for(int i = 0; i < mpManager->pathArray.size(); i++)
+    {
+        if (mpManager->pathArray[i]->isEditingKeys())
+            continue;
+        
+        for (unsigned int j = 0; j < editedCurves.length(); ++j)
+        {
+            if (mpManager->pathArray[i]->usesAnimCurve(editedCurves[j]))
+            {
+                mpManager->pathArray[i]->setKeyframesDirty();
+                break;
+            }
+        }
+    }
+    
+    // pooled paths keep their caches, so they have to hear about the edits too
+    for (std::list<PooledPath>::iterator it = mpManager->pathPool.begin(); it != mpManager->pathPool.end(); ++it)
+    {
+        for (unsigned int j = 0; j < editedCurves.length(); ++j)
+        {
+            if (it->path->usesAnimCurve(editedCurves[j]))
+            {
+                it->path->setKeyframesDirty();
+                break;
+            }
+        }
+    }
+    
+    // the camera matrices are filled again frame by frame as the draw asks for them
+    if (GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace)
+    {
+        for (CameraCacheMapIterator it = mpManager->cameraCache.begin(); it != mpManager->cameraCache.end(); ++it)
+        {
+            for (unsigned int j = 0; j < editedCurves.length(); ++j)
+            {
+                if (it->second.isDrivenByCurve(editedCurves[j]))
+                {
+                    it->second.invalidate();
+                    break;
+                }
+            }
+        }
+    }
+}
+
 void MotionPathManager::getDagPath(const MString &name, MDagPath &dp)
 {
     MSelectionList sList;
@@ -619,80 +903,388 @@ void MotionPathManager::refreshDisplayTimeRange()
     // 2. No frame numbers appear beyond actual keyframes
     // 3. Start/end labels don't overlap when range is too small
 
-    if(!cacheDone)
-		cacheDone = expandParentMatrixAndPivotCache(currentFrame);
-
 	for(int i = 0; i < pathArray.size(); i++)
-		pathArray[i].setDisplayTimeRange(startFrame, endFrame);
+		pathArray[i]->setDisplayTimeRange(startFrame, endFrame);
+	invalidateRefreshTick();
+
+	enforceCacheBudget();
+	scheduleCacheWarming(currentFrame);
 }
 
 void MotionPathManager::clearParentMatrixCaches()
 {
+    invalidateRefreshTick();
     for(int i = 0; i < pathArray.size(); i++)
-		pathArray[i].clearParentMatrixCache();
+		pathArray[i]->clearParentMatrixCache();
+    for (std::list<PooledPath>::iterator it = pathPool.begin(); it != pathPool.end(); ++it)
+        it->path->clearParentMatrixCache();
+}
+
+std::unique_ptr<MotionPath> MotionPathManager::takePooledPath(const MObject &object)
+{
+    for (std::list<PooledPath>::iterator it = pathPool.begin(); it != pathPool.end(); ++it)
+    {
+        if (it->handle.isValid() && it->handle.object() == object)
+        {
+            std::unique_ptr<MotionPath> path = std::move(it->path);
+            pathPool.erase(it);
+            
+            // a new path starts without selected keys, a reselected one does too
+            path->deselectAllKeys();
+            return path;
+        }
+    }
+    
+    return std::unique_ptr<MotionPath>();
+}
+
+void MotionPathManager::trimPathPool()
+{
+    size_t budget = static_cast<size_t>(GlobalSettings::pathPoolBudget * 1024.0 * 1024.0);
+    size_t used = 0;
+    
+    std::list<PooledPath>::iterator it = pathPool.begin();
+    while (it != pathPool.end())
+    {
+        // deleted nodes
+        if (!it->handle.isValid())
+        {
+            it = pathPool.erase(it);
+            continue;
+        }
+        
+        used += it->path->cacheMemoryUsage();
+        if (used > budget)
+        {
+            pathPool.erase(it, pathPool.end());
+            break;
+        }
+        ++it;
+    }
 }
 
-bool MotionPathManager::expandParentMatrixAndPivotCache(const double currentTimeValue)
+namespace
 {
-    double timeout = 2.0;
-	time_t startTime = time(NULL);
+    MString byteCount(const size_t bytes)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(bytes));
+        return MString(buffer);
+    }
     
-	double nUpdqates = GlobalSettings::framesFront;
-	if(GlobalSettings::framesBack > GlobalSettings::framesFront)
-		nUpdqates = GlobalSettings::framesBack;
+    MString nodeName(const MObject &node)
+    {
+        MDagPath dagPath;
+        if (MDagPath::getAPathTo(node, dagPath) == MS::kSuccess)
+            return dagPath.partialPathName();
+        return MString("<deleted>");
+    }
+}
+
+void MotionPathManager::enforceCacheBudget()
+{
+    if (GlobalSettings::cacheMemoryBudget <= 0)
+        return;
     
-	bool cacheCompleted = true;
+    size_t budget = static_cast<size_t>(GlobalSettings::cacheMemoryBudget * 1024.0 * 1024.0);
     
-	for(double i = 0; i <= nUpdqates; i++)
-	{
-		time_t currentTime = time(NULL);
-		double secs = difftime(currentTime, startTime);
+    // 1. storage grown for a wide range and never used again is free to give back
+    size_t used = 0;
+    for (unsigned int i = 0; i < pathArray.size(); ++i)
+    {
+        pathArray[i]->shrinkCaches();
+        used += pathArray[i]->cacheMemoryUsage();
+    }
+    for (std::list<PooledPath>::iterator it = pathPool.begin(); it != pathPool.end(); ++it)
+    {
+        it->path->shrinkCaches();
+        used += it->path->cacheMemoryUsage();
+    }
+    for (CameraCacheMapIterator it = cameraCache.begin(); it != cameraCache.end(); ++it)
+    {
+        it->second.matrixCache.shrinkToFit();
+        used += it->second.memoryUsage();
+    }
+    for (unsigned int i = 0; i < bufferPathArray.size(); ++i)
+        used += bufferPathArray[i].memoryUsage();
+    
+    if (used <= budget)
+        return;
+    
+    double currentFrame = MAnimControl::currentTime().as(MTime::uiUnit());
+    
+    // 2. pooled paths and cameras no panel looked through in the last refresh
+    std::vector<EvictionCandidate> candidates;
+    for (std::list<PooledPath>::iterator it = pathPool.begin(); it != pathPool.end(); ++it)
+    {
+        EvictionCandidate candidate;
+        candidate.score = (drawGeneration - it->path->getLastUsed()) + it->path->cacheDistance(currentFrame);
+        candidate.pooled = it;
+        candidate.camera = NULL;
+        candidate.path = NULL;
+        candidates.push_back(candidate);
+    }
+    for (CameraCacheMapIterator it = cameraCache.begin(); it != cameraCache.end(); ++it)
+    {
+        // the cache of a view is looked up just before its draw starts a new generation
+        if (drawGeneration - it->second.getLastUsed() <= 1 || it->second.memoryUsage() == 0)
+            continue;
         
-		if(secs < timeout)
-		{
-			cacheCompleted = true;
+        EvictionCandidate candidate;
+        candidate.score = drawGeneration - it->second.getLastUsed();
+        candidate.pooled = pathPool.end();
+        candidate.camera = &it->second;
+        candidate.path = NULL;
+        candidates.push_back(candidate);
+    }
+    
+    // 3. the prefetched frames of the selected paths, the display range itself is never evicted
+    for (unsigned int i = 0; i < pathArray.size(); ++i)
+    {
+        EvictionCandidate candidate;
+        candidate.score = -1.0 / (1.0 + pathArray[i]->cacheMemoryUsage());
+        candidate.pooled = pathPool.end();
+        candidate.camera = NULL;
+        candidate.path = pathArray[i].get();
+        candidates.push_back(candidate);
+    }
+    
+    std::stable_sort(candidates.begin(), candidates.end());
+    
+    for (unsigned int i = 0; i < candidates.size() && used > budget; ++i)
+    {
+        EvictionCandidate &candidate = candidates[i];
+        if (candidate.pooled != pathPool.end())
+        {
+            used -= std::min(used, candidate.pooled->path->cacheMemoryUsage());
+            pathPool.erase(candidate.pooled);
+        }
+        else if (candidate.camera)
+        {
+            used -= std::min(used, candidate.camera->memoryUsage());
+            candidate.camera->invalidate();
+        }
+        else
+        {
+            size_t before = candidate.path->cacheMemoryUsage();
+            candidate.path->trimCachesToDisplayRange();
+            used -= std::min(used, before - std::min(before, candidate.path->cacheMemoryUsage()));
+        }
+    }
+}
+
+void MotionPathManager::queryCacheMemory(MStringArray &result)
+{
+    size_t total = 0;
+    MStringArray lines;
+    
+    for (unsigned int i = 0; i < pathArray.size(); ++i)
+    {
+        size_t bytes = pathArray[i]->cacheMemoryUsage();
+        total += bytes;
+        lines.append("path " + nodeName(pathArray[i]->object()) + " bytes=" + byteCount(bytes));
+    }
+    
+    for (std::list<PooledPath>::iterator it = pathPool.begin(); it != pathPool.end(); ++it)
+    {
+        size_t bytes = it->path->cacheMemoryUsage();
+        total += bytes;
+        lines.append("pooledPath " + (it->handle.isValid() ? nodeName(it->handle.object()) : MString("<deleted>")) + " bytes=" + byteCount(bytes));
+    }
+    
+    for (CameraCacheMapIterator it = cameraCache.begin(); it != cameraCache.end(); ++it)
+    {
+        size_t bytes = it->second.memoryUsage();
+        total += bytes;
+        lines.append("camera " + MString(it->first.c_str()) + " bytes=" + byteCount(bytes));
+    }
+    
+    for (unsigned int i = 0; i < bufferPathArray.size(); ++i)
+    {
+        size_t bytes = bufferPathArray[i].memoryUsage();
+        total += bytes;
+        lines.append("bufferPath " + bufferPathArray[i].getObjectName() + " bytes=" + byteCount(bytes));
+    }
+    
+    size_t budget = static_cast<size_t>(GlobalSettings::cacheMemoryBudget * 1024.0 * 1024.0);
+    result.append("total bytes=" + byteCount(total) + " budget=" + byteCount(budget));
+    for (unsigned int i = 0; i < lines.length(); ++i)
+        result.append(lines[i]);
+}
+
+void MotionPathManager::scheduleCacheWarming(const double currentTimeValue)
+{
+    if (pathArray.empty())
+    {
+        stopCacheWarming();
+        return;
+    }
+    
+    // a time or selection change restarts the warming from the new current time, following the scrub direction
+    if (currentTimeValue != lastWarmTime)
+        warmDirection = currentTimeValue > lastWarmTime ? 1 : -1;
+    lastWarmTime = currentTimeValue;
+    warmCenter = std::floor(currentTimeValue + 0.5);
+    warmDistance = 0;
+    
+    if (warming)
+        return;
+    
+    MStatus status;
+    idleCallbackId = MEventMessage::addEventCallback("idle", idleCallback, this, &status);
+    warming = status == MS::kSuccess;
+}
+
+void MotionPathManager::stopCacheWarming()
+{
+    if (!warming)
+        return;
+    
+    MMessage::removeCallback(idleCallbackId);
+    warming = false;
+}
+
+void MotionPathManager::idleCallback(void *data)
+{
+    MotionPathManager* mpManager = (MotionPathManager*) data;
+    if (mpManager && !mpManager->warmCaches())
+        mpManager->stopCacheWarming();
+}
+
+bool MotionPathManager::warmCaches()
+{
+    std::chrono::steady_clock::time_point sliceStart = std::chrono::steady_clock::now();
+    
+    // the warmed range is the display range plus the prefetch frames on the side we are scrubbing towards
+    int framesAfter = static_cast<int>(GlobalSettings::framesFront) + (warmDirection > 0 ? GlobalSettings::cachePrefetchFrames : 0);
+    int framesBefore = static_cast<int>(GlobalSettings::framesBack) + (warmDirection < 0 ? GlobalSettings::cachePrefetchFrames : 0);
+    int maxDistance = std::max(framesAfter, framesBefore);
+    
+    bool cameraSpace = GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace;
+    
+    while (warmDistance <= maxDistance)
+    {
+        double candidates[2] = {warmCenter + warmDistance * warmDirection, warmCenter - warmDistance * warmDirection};
+        int numCandidates = warmDistance == 0 ? 1 : 2;
+        ++warmDistance;
+        
+        for (int c = 0; c < numCandidates; ++c)
+        {
+            double time = candidates[c];
+            if (time > warmCenter + framesAfter || time < warmCenter - framesBefore)
+                continue;
+            if (time < GlobalSettings::startTime || time > GlobalSettings::endTime)
+                continue;
             
-			for(int j = 0; j < pathArray.size(); j++)
-			{
-				if(!pathArray[j].isCacheDone())
-				{
-					pathArray[j].growParentAndPivotMatrixCache(currentTimeValue, i);
-					cacheCompleted = false;
-				}
-			}
-		}
-		else
-			break;
-	}
+            MTime evalTime(time, MTime::uiUnit());
+            MDGContext context(evalTime);
+            
+            for (unsigned int i = 0; i < pathArray.size(); ++i)
+                pathArray[i]->warmFrame(time, context);
+            
+            if (cameraSpace)
+            {
+                for (CameraCacheMapIterator it = cameraCache.begin(); it != cameraCache.end(); ++it)
+                    it->second.warmFrame(time, context);
+            }
+        }
+        
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sliceStart).count();
+        if (elapsed >= GlobalSettings::idleWarmBudget)
+            return warmDistance <= maxDistance;
+    }
     
-	return cacheCompleted;
+    return false;
 }
 
-void MotionPathManager::setTimeRange(const double start, const double end)
+void MotionPathManager::trackScrub(const double time)
 {
-	GlobalSettings::startTime = start;
-	GlobalSettings::endTime = end <= start ? start + 1.0: end;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - lastTimeChange).count();
     
-	for(int i = 0; i < pathArray.size(); i++)
-		pathArray[i].setTimeRange(GlobalSettings::startTime, GlobalSettings::endTime);
+    // a pause starts a new scrub, the first step of it is taken as it is
+    double step = time - scrubTime;
+    if (seconds > 0.5 || scrubStep == 0 || step * scrubStep < 0)
+        scrubStep = step;
+    else
+        scrubStep = 0.5 * (scrubStep + step);
     
-	cacheDone = false;
+    scrubTime = time;
+    lastTimeChange = now;
 }
 
-void MotionPathManager::drawCurvesForSelection(M3dView &view, CameraCache *cachePtr)
+// The display range moves by scrubStep frames per time change, so the next two time changes bring in about
+// twice that many frames on the leading side. They land in the prefetched part of the cache windows, the
+// back buffer of the path: the next setDisplayTimeRange slides the windows over them and the draw only
+// writes their samples into the retained geometry instead of pulling the DG for them.
+void MotionPathManager::prefetchLeadingEdge()
 {
-    for(int i = 0; i < pathArray.size(); i++)
-	{
-		view.pushName(i);
-		pathArray[i].drawCurvesForSelection(view, cachePtr);
-		view.popName();
-	}
+    // once per refresh, not once per panel
+    if (prefetchGeneration == drawGeneration)
+        return;
+    prefetchGeneration = drawGeneration;
+    
+    if (scrubStep == 0 || pathArray.empty() || GlobalSettings::cachePrefetchFrames <= 0)
+        return;
+    
+    double sinceTimeChange = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastTimeChange).count();
+    if (!MAnimControl::isPlaying() && sinceTimeChange > 0.5)
+        return;
+    
+    pathStats::ScopedTimer timer(pathStats::kPrefetchLeadingEdge);
+    std::chrono::steady_clock::time_point sliceStart = std::chrono::steady_clock::now();
+    
+    int direction = scrubStep > 0 ? 1 : -1;
+    int numFrames = std::min(GlobalSettings::cachePrefetchFrames, static_cast<int>(std::ceil(std::fabs(scrubStep) * 2)));
+    double currentFrame = std::floor(MAnimControl::currentTime().as(MTime::uiUnit()) + 0.5);
+    double edge = direction > 0 ? currentFrame + GlobalSettings::framesFront : currentFrame - GlobalSettings::framesBack;
+    
+    bool cameraSpace = GlobalSettings::motionPathDrawMode == GlobalSettings::kCameraSpace;
+    
+    for (int i = 1; i <= numFrames; ++i)
+    {
+        double time = edge + i * direction;
+        if (time < GlobalSettings::startTime || time > GlobalSettings::endTime)
+            break;
+        
+        MTime evalTime(time, MTime::uiUnit());
+        MDGContext context(evalTime);
+        
+        bool prefetched = false;
+        for (unsigned int p = 0; p < pathArray.size(); ++p)
+            prefetched = pathArray[p]->warmFrame(time, context) || prefetched;
+        
+        if (cameraSpace)
+        {
+            for (CameraCacheMapIterator it = cameraCache.begin(); it != cameraCache.end(); ++it)
+                prefetched = it->second.warmFrame(time, context) || prefetched;
+        }
+        
+        if (prefetched)
+            pathStats::count(pathStats::kPrefetchedFrames);
+        
+        // the same budget as an idle slice, what is left over the idle warming picks up in the scrub direction
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sliceStart).count();
+        if (elapsed >= GlobalSettings::idleWarmBudget)
+            break;
+    }
+}
+
+void MotionPathManager::setTimeRange(const double start, const double end)
+{
+	GlobalSettings::startTime = start;
+	GlobalSettings::endTime = end <= start ? start + 1.0: end;
+    
+	for(int i = 0; i < pathArray.size(); i++)
+		pathArray[i]->setTimeRange(GlobalSettings::startTime, GlobalSettings::endTime);
+    for (std::list<PooledPath>::iterator it = pathPool.begin(); it != pathPool.end(); ++it)
+        it->path->setTimeRange(GlobalSettings::startTime, GlobalSettings::endTime);
 }
 
 MotionPath* MotionPathManager::getMotionPathPtr(const int id)
 {
 	if(id >= 0 && id < pathArray.size())
-		return &pathArray[id];
+		return pathArray[id].get();
     
 	return NULL;
 }
@@ -709,11 +1301,12 @@ int MotionPathManager::isMObjectContained(const MObject &obj, const MObjectArray
 void MotionPathManager::setSelectionList(const MObjectArray &list)
 {
     //we keep track the old objects cause we don't want to destroy old MotionPaths if still in use
-    std::vector<MotionPath> oldPathArray = pathArray;
+    std::vector<std::unique_ptr<MotionPath> > oldPathArray;
+    oldPathArray.swap(pathArray);
     MObjectArray oldSelectionObjects (selectionObjects);
     
-    pathArray.clear();
     selectionObjects.clear();
+    ++drawGeneration;
     
     for (unsigned int i = 0; i < list.length(); ++i)
     {
@@ -722,21 +1315,39 @@ void MotionPathManager::setSelectionList(const MObjectArray &list)
             if (MotionPath::hasAnimationLayers(list[i]))
                 MGlobal::displayWarning("Motion Path does not support animation layers. The path won't be displayed in real time.");
             
+            std::unique_ptr<MotionPath> path;
             int index = isMObjectContained(list[i], oldSelectionObjects);
+            if (index != -1)
+                path = std::move(oldPathArray[index]);
             
-            if (index == -1)
-            {
-                MotionPath m =  MotionPath(list[i]);
-                pathArray.push_back(m);
-            }
-            else
-                pathArray.push_back(oldPathArray[index]);
-
+            // deselected a moment ago, its caches are still warm
+            if (!path)
+                path = takePooledPath(list[i]);
+            
+            if (!path)
+                path.reset(new MotionPath(list[i]));
+            
+            pathArray.push_back(std::move(path));
             selectionObjects.append(list[i]);
         }
     }
     
-    cacheDone = false;
+    // paths leaving the selection go to the front of the pool
+    for (unsigned int i = 0; i < oldPathArray.size(); ++i)
+    {
+        if (!oldPathArray[i])
+            continue;
+        
+        oldPathArray[i]->removeWorldMartrixCallback();
+        
+        PooledPath pooled;
+        pooled.handle = MObjectHandle(oldSelectionObjects[i]);
+        pooled.path = std::move(oldPathArray[i]);
+        pathPool.push_front(std::move(pooled));
+    }
+    
+    trimPathPool();
+    enforceCacheBudget();
 }
 
 MStringArray MotionPathManager::getSelectionList()
@@ -753,8 +1364,34 @@ MStringArray MotionPathManager::getSelectionList()
 
 void MotionPathManager::addBufferPaths()
 {
+    bufferPathArray.reserve(bufferPathArray.size() + pathArray.size());
     for (unsigned int i = 0; i < pathArray.size(); ++i)
-        bufferPathArray.push_back(pathArray[i].createBufferPath());
+        bufferPathArray.push_back(pathArray[i]->createBufferPath());
+}
+
+bool MotionPathManager::saveBufferPaths(const MString &fileName, MString &error)
+{
+    return pathCacheFile::write(fileName, bufferPathArray, error);
+}
+
+bool MotionPathManager::loadBufferPaths(const MString &fileName, MString &error)
+{
+    size_t firstLoaded = bufferPathArray.size();
+    if (!pathCacheFile::read(fileName, bufferPathArray, error))
+        return false;
+    
+    // a loaded path of a displayed object whose curves or range changed since it was saved is kept, but reported
+    for (size_t i = firstLoaded; i < bufferPathArray.size(); ++i)
+    {
+        const BufferPath &bp = bufferPathArray[i];
+        for (size_t p = 0; p < pathArray.size(); ++p)
+        {
+            MFnDependencyNode depNodeFn(pathArray[p]->object());
+            if (depNodeFn.name() == bp.getObjectName() && pathArray[p]->getSourceHash() != bp.getSourceHash())
+                MGlobal::displayWarning("tcMotionPathCmd: the cached path of " + bp.getObjectName() + " no longer matches its animation.");
+        }
+    }
+    return true;
 }
 
 void MotionPathManager::deleteAllBufferPaths()
@@ -799,6 +1436,46 @@ void MotionPathManager::stopDGAndAnimUndoRecording()
     animCurveChangePtr = NULL;
 }
 
+void MotionPathManager::offsetSelectedKeys(const MVector &offset, CameraCache *cachePtr)
+{
+    for (unsigned int i = 0; i < pathArray.size(); ++i)
+        pathArray[i]->offsetSelectedKeys(offset, cachePtr);
+}
+
+void MotionPathManager::commitKeyEdits()
+{
+    for (unsigned int i = 0; i < pathArray.size(); ++i)
+        pathArray[i]->commitKeyEdits(animCurveChangePtr);
+}
+
+void MotionPathManager::pasteKeys(const double time, const bool offset)
+{
+    if (KeyClipboard::getClipboard().getSize() == 0 || pathArray.empty())
+        return;
+
+    // the DG is only read here, on the main thread
+    int numPaths = static_cast<int>(pathArray.size());
+    std::vector<MotionPath::PasteTarget> targets(numPaths);
+    for (int i = 0; i < numPaths; ++i)
+    {
+        targets[i].time = time;
+        targets[i].offset = offset;
+        pathArray[i]->cachePasteMatrices(targets[i]);
+    }
+
+    // local positions and tangents of every target from the cached matrices
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (numPaths > 1)
+#endif
+    for (int i = 0; i < numPaths; ++i)
+        pathArray[i]->preparePaste(targets[i]);
+
+    startAnimUndoRecording();
+    for (int i = 0; i < numPaths; ++i)
+        pathArray[i]->commitPaste(targets[i]);
+    stopDGAndAnimUndoRecording();
+}
+
 void MotionPathManager::storePreviousKeySelection()
 {
     getCurrentKeySelection(previousKeySelection);
@@ -816,6 +1493,6 @@ void MotionPathManager::getCurrentKeySelection(std::vector<MDoubleArray> &sel)
     sel.reserve(pathArray.size());
     
     for (int i=0; i < pathArray.size(); ++i)
-        sel.push_back(pathArray[i].getSelectedKeys());
+        sel.push_back(pathArray[i]->getSelectedKeys());
 }
 
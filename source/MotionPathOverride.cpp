@@ -1,5 +1,6 @@
 #include "MotionPathOverride.h"
 #include "MotionPathManager.h"
+#include "PathStats.h"
 
 #include <maya/M3dView.h>
 
@@ -72,6 +73,9 @@ void MotionPathUserOperation::addUIDrawables(
 	MHWRender::MUIDrawManager& drawManager,
 	const MHWRender::MFrameContext& frameContext)
 {
+	pathStats::RefreshScope refreshScope;
+	pathStats::ScopedTimer timer(pathStats::kAddUIDrawables);
+
 	M3dView view;
 	if (mPanelName.length() && (M3dView::getM3dViewFromModelPanel(mPanelName, view)))
 	{
@@ -106,6 +110,7 @@ void MotionPathUserOperation::addUIDrawables(
 
 		drawManager.beginDrawInXray();
 
+		mpManager.beginRefreshTick(mPanelName);
 		mpManager.drawBufferPaths(view, cachePtr, &drawManager, &frameContext);
 		mpManager.drawPaths(view, cachePtr, &drawManager, &frameContext);
 		
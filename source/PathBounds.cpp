@@ -0,0 +1,184 @@
+//
+//  PathBounds.cpp
+//  MotionPath
+//
+//  Per chunk bounding boxes of a sampled path and the view frustum they are culled against.
+//
+
+#include "PathBounds.h"
+
+#include <algorithm>
+
+void PathBounds::Box::expand(const MPoint &point)
+{
+    if (!valid)
+    {
+        min = max = point;
+        valid = true;
+        return;
+    }
+
+    min.x = std::min(min.x, point.x);
+    min.y = std::min(min.y, point.y);
+    min.z = std::min(min.z, point.z);
+    max.x = std::max(max.x, point.x);
+    max.y = std::max(max.y, point.y);
+    max.z = std::max(max.z, point.z);
+}
+
+void PathBounds::Box::expand(const Box &box)
+{
+    if (!box.valid)
+        return;
+
+    expand(box.min);
+    expand(box.max);
+}
+
+void PathBounds::resize(const unsigned int samples)
+{
+    numSamples = samples;
+    unsigned int count = samples > 0 ? (samples - 1) / kChunkSize + 1 : 0;
+    chunks.assign(count, Box());
+    chunkDirty.assign(count, 1);
+    dirtyCount = count;
+    total = Box();
+}
+
+void PathBounds::markDirty(const unsigned int sample)
+{
+    if (sample >= numSamples)
+        return;
+
+    unsigned int chunk = chunkOf(sample);
+    if (!chunkDirty[chunk])
+    {
+        chunkDirty[chunk] = 1;
+        ++dirtyCount;
+    }
+
+    // the first sample of a chunk closes the previous one
+    if (chunk > 0 && sample == chunk * kChunkSize && !chunkDirty[chunk - 1])
+    {
+        chunkDirty[chunk - 1] = 1;
+        ++dirtyCount;
+    }
+}
+
+void PathBounds::markAllDirty()
+{
+    std::fill(chunkDirty.begin(), chunkDirty.end(), 1);
+    dirtyCount = static_cast<unsigned int>(chunkDirty.size());
+}
+
+void PathBounds::update(const MPointArray &samples)
+{
+    if (samples.length() != numSamples)
+        resize(samples.length());
+    if (dirtyCount == 0)
+        return;
+
+    for (unsigned int c = 0; c < chunks.size(); ++c)
+    {
+        if (!chunkDirty[c])
+            continue;
+
+        Box box;
+        unsigned int last = std::min((c + 1) * kChunkSize, numSamples - 1);
+        for (unsigned int s = c * kChunkSize; s <= last; ++s)
+            box.expand(samples[s]);
+
+        chunks[c] = box;
+        chunkDirty[c] = 0;
+    }
+    dirtyCount = 0;
+
+    total = Box();
+    for (unsigned int c = 0; c < chunks.size(); ++c)
+        total.expand(chunks[c]);
+}
+
+void PathBounds::build(const std::vector<MVector> &positions)
+{
+    resize(static_cast<unsigned int>(positions.size()));
+
+    for (unsigned int c = 0; c < chunks.size(); ++c)
+    {
+        unsigned int last = std::min((c + 1) * kChunkSize, numSamples - 1);
+        for (unsigned int s = c * kChunkSize; s <= last; ++s)
+            chunks[c].expand(MPoint(positions[s]));
+
+        total.expand(chunks[c]);
+    }
+
+    std::fill(chunkDirty.begin(), chunkDirty.end(), 0);
+    dirtyCount = 0;
+}
+
+ViewFrustum::ViewFrustum(): hasPlanes(false)
+{
+}
+
+void ViewFrustum::set(const MMatrix &m)
+{
+    // clip = p * m, so every clip coordinate is p dotted with a column of m
+    for (int j = 0; j < 4; ++j)
+    {
+        planes[0][j] = m[j][3] + m[j][0];   // left
+        planes[1][j] = m[j][3] - m[j][0];   // right
+        planes[2][j] = m[j][3] + m[j][1];   // bottom
+        planes[3][j] = m[j][3] - m[j][1];   // top
+        planes[4][j] = m[j][3] + m[j][2];   // near
+        planes[5][j] = m[j][3] - m[j][2];   // far
+    }
+    hasPlanes = true;
+}
+
+bool ViewFrustum::intersects(const PathBounds::Box &box) const
+{
+    if (!hasPlanes)
+        return true;
+    if (!box.valid)
+        return false;
+
+    // the box is outside when even its corner furthest along the plane normal is behind the plane
+    for (int p = 0; p < 6; ++p)
+    {
+        const double *plane = planes[p];
+        double x = plane[0] >= 0 ? box.max.x : box.min.x;
+        double y = plane[1] >= 0 ? box.max.y : box.min.y;
+        double z = plane[2] >= 0 ? box.max.z : box.min.z;
+        if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0)
+            return false;
+    }
+    return true;
+}
+
+bool ViewFrustum::intersects(const MPoint &a, const MPoint &b) const
+{
+    PathBounds::Box box;
+    box.expand(a);
+    box.expand(b);
+    return intersects(box);
+}
+
+bool ViewFrustum::cull(const PathBounds &bounds, std::vector<unsigned char> &visible) const
+{
+    visible.assign(bounds.numChunks(), 1);
+    if (!hasPlanes)
+        return bounds.numChunks() > 0;
+
+    if (!intersects(bounds.bounds()))
+    {
+        std::fill(visible.begin(), visible.end(), 0);
+        return false;
+    }
+
+    bool any = false;
+    for (unsigned int c = 0; c < bounds.numChunks(); ++c)
+    {
+        visible[c] = intersects(bounds.chunk(c)) ? 1 : 0;
+        any = any || visible[c];
+    }
+    return any;
+}
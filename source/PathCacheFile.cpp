@@ -0,0 +1,243 @@
+//
+//  PathCacheFile.cpp
+//  MotionPath
+//
+//  Binary file of buffer paths, so reference paths survive a scene reopen and can be shared.
+//
+
+#include "PlatformFixes.h"
+#include "PathCacheFile.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace
+{
+    const char MAGIC[8] = {'T', 'C', 'M', 'P', 'A', 'T', 'H', 0};
+
+    size_t padded(const size_t size)
+    {
+        return (size + 7) & ~static_cast<size_t>(7);
+    }
+
+    // size of the file on disk, the counts of the headers are checked against it before anything is allocated
+    bool fileSize(const char *fileName, uint64_t &size)
+    {
+#ifdef _WIN32
+        struct _stat64 fileStat;
+        if (_stat64(fileName, &fileStat) != 0)
+            return false;
+#else
+        struct stat fileStat;
+        if (stat(fileName, &fileStat) != 0)
+            return false;
+#endif
+        size = static_cast<uint64_t>(fileStat.st_size);
+        return true;
+    }
+
+    // reads size bytes and skips the padding up to the next 8 byte boundary
+    bool readBlock(FILE *file, void *data, const size_t size)
+    {
+        char padding[8];
+        if (size > 0 && fread(data, 1, size, file) != size)
+            return false;
+
+        size_t paddingSize = padded(size) - size;
+        return paddingSize == 0 || fread(padding, 1, paddingSize, file) == paddingSize;
+    }
+
+    // finite, ascending and on the range of the frames, BufferPath::drawKeyFrames binary searches them
+    bool validKeyTimes(const std::vector<double> &keyTimes, const double minTime, const uint32_t frameCount)
+    {
+        double maxTime = minTime + static_cast<double>(frameCount);
+        for (size_t k = 0; k < keyTimes.size(); ++k)
+        {
+            if (!std::isfinite(keyTimes[k]) || keyTimes[k] < minTime || keyTimes[k] >= maxTime)
+                return false;
+            if (k > 0 && keyTimes[k] <= keyTimes[k - 1])
+                return false;
+        }
+        return true;
+    }
+
+    bool writeBlock(FILE *file, const void *data, const size_t size)
+    {
+        static const char zeros[8] = {0};
+        if (size > 0 && fwrite(data, 1, size, file) != size)
+            return false;
+
+        size_t padding = padded(size) - size;
+        return padding == 0 || fwrite(zeros, 1, padding, file) == padding;
+    }
+}
+
+uint64_t pathCacheFile::hash(const void *data, const size_t size, const uint64_t seed)
+{
+    uint64_t result = seed;
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        result ^= bytes[i];
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+bool pathCacheFile::write(const MString &fileName, const std::vector<BufferPath> &paths, MString &error)
+{
+    FILE *file = fopen(fileName.asChar(), "wb");
+    if (!file)
+    {
+        error = "could not open " + fileName + " for writing.";
+        return false;
+    }
+
+    FileHeader fileHeader;
+    std::memcpy(fileHeader.magic, MAGIC, sizeof(MAGIC));
+    fileHeader.version = VERSION;
+    fileHeader.pathCount = static_cast<uint32_t>(paths.size());
+    bool ok = writeBlock(file, &fileHeader, sizeof(fileHeader));
+
+    for (size_t i = 0; ok && i < paths.size(); ++i)
+    {
+        const BufferPath &path = paths[i];
+        MString name = path.getObjectName();
+
+        PathHeader pathHeader;
+        pathHeader.minTime = path.getMinTime();
+        pathHeader.frameCount = static_cast<uint32_t>(path.getFrameCount());
+        pathHeader.keyCount = static_cast<uint32_t>(path.getKeyCount());
+        pathHeader.sourceHash = path.getSourceHash();
+        pathHeader.nameLength = name.length();
+        pathHeader.reserved = 0;
+
+        std::vector<float> keyPositions(3 * pathHeader.keyCount);
+        for (uint32_t k = 0; k < pathHeader.keyCount; ++k)
+        {
+            MVector key = path.getKey(k);
+            keyPositions[3 * k] = static_cast<float>(key.x);
+            keyPositions[3 * k + 1] = static_cast<float>(key.y);
+            keyPositions[3 * k + 2] = static_cast<float>(key.z);
+        }
+
+        const std::vector<float> &frames = path.getFramePositions();
+        const std::vector<double> &keyTimes = path.getKeyTimes();
+
+        ok = writeBlock(file, &pathHeader, sizeof(pathHeader)) &&
+             writeBlock(file, name.asChar(), pathHeader.nameLength) &&
+             writeBlock(file, frames.empty() ? NULL : &frames[0], frames.size() * sizeof(float)) &&
+             writeBlock(file, keyTimes.empty() ? NULL : &keyTimes[0], keyTimes.size() * sizeof(double)) &&
+             writeBlock(file, keyPositions.empty() ? NULL : &keyPositions[0], keyPositions.size() * sizeof(float));
+    }
+
+    if (fclose(file) != 0)
+        ok = false;
+
+    if (!ok)
+        error = "could not write " + fileName + ".";
+    return ok;
+}
+
+bool pathCacheFile::read(const MString &fileName, std::vector<BufferPath> &paths, MString &error)
+{
+    uint64_t size = 0;
+    FILE *file = fileSize(fileName.asChar(), size) ? fopen(fileName.asChar(), "rb") : NULL;
+    if (!file)
+    {
+        error = "could not open " + fileName + ".";
+        return false;
+    }
+
+    FileHeader fileHeader;
+    if (size < sizeof(fileHeader) || !readBlock(file, &fileHeader, sizeof(fileHeader)) ||
+        std::memcmp(fileHeader.magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        fclose(file);
+        error = fileName + " is not a motion path cache.";
+        return false;
+    }
+
+    if (fileHeader.version != VERSION)
+    {
+        fclose(file);
+        error = fileName + " was written by an unsupported version.";
+        return false;
+    }
+
+    // every record holds at least its header, a larger count is a damaged file
+    if (fileHeader.pathCount > size / sizeof(PathHeader))
+    {
+        fclose(file);
+        error = fileName + " is truncated.";
+        return false;
+    }
+
+    std::vector<BufferPath> loaded(fileHeader.pathCount);
+    uint64_t offset = padded(sizeof(fileHeader));
+    uint32_t readCount = 0;
+    bool damaged = false;
+    for (uint32_t i = 0; i < fileHeader.pathCount; ++i)
+    {
+        PathHeader pathHeader;
+        if (offset + sizeof(pathHeader) > size || !readBlock(file, &pathHeader, sizeof(pathHeader)))
+            break;
+        offset += padded(sizeof(pathHeader));
+
+        // the blocks have to fit in what is left of the file before they are allocated
+        uint64_t frameBytes = 3 * static_cast<uint64_t>(pathHeader.frameCount) * sizeof(float);
+        uint64_t keyTimeBytes = static_cast<uint64_t>(pathHeader.keyCount) * sizeof(double);
+        uint64_t keyPositionBytes = 3 * static_cast<uint64_t>(pathHeader.keyCount) * sizeof(float);
+        uint64_t endOffset = offset + padded(pathHeader.nameLength) + padded(frameBytes) + padded(keyTimeBytes) + padded(keyPositionBytes);
+        if (endOffset > size)
+            break;
+
+        std::vector<char> name(pathHeader.nameLength);
+        std::vector<float> frames(3 * static_cast<size_t>(pathHeader.frameCount));
+        std::vector<double> keyTimes(pathHeader.keyCount);
+        std::vector<float> keyPositions(3 * static_cast<size_t>(pathHeader.keyCount));
+        if (!readBlock(file, name.empty() ? NULL : &name[0], name.size()) ||
+            !readBlock(file, frames.empty() ? NULL : &frames[0], frames.size() * sizeof(float)) ||
+            !readBlock(file, keyTimes.empty() ? NULL : &keyTimes[0], keyTimes.size() * sizeof(double)) ||
+            !readBlock(file, keyPositions.empty() ? NULL : &keyPositions[0], keyPositions.size() * sizeof(float)))
+            break;
+
+        if (!std::isfinite(pathHeader.minTime) || !validKeyTimes(keyTimes, pathHeader.minTime, pathHeader.frameCount))
+        {
+            damaged = true;
+            break;
+        }
+
+        BufferPath &path = loaded[i];
+        path.setMinTime(pathHeader.minTime);
+        path.setFrames(std::move(frames));
+        path.setKeyFrames(std::move(keyTimes), std::move(keyPositions));
+        path.setSourceHash(pathHeader.sourceHash);
+        path.setObjectName(name.empty() ? MString() : MString(&name[0], pathHeader.nameLength));
+
+        offset = endOffset;
+        ++readCount;
+    }
+    fclose(file);
+
+    if (damaged)
+    {
+        error = fileName + " is damaged, the key times of a path are not in order or outside its frames.";
+        return false;
+    }
+
+    if (readCount != fileHeader.pathCount)
+    {
+        error = fileName + " is truncated.";
+        return false;
+    }
+
+    paths.reserve(paths.size() + loaded.size());
+    for (size_t i = 0; i < loaded.size(); ++i)
+        paths.push_back(std::move(loaded[i]));
+    return true;
+}
@@ -0,0 +1,352 @@
+//
+//  PathGeometry.cpp
+//  MotionPath
+//
+//  World space path vertices retained between viewport refreshes.
+//
+
+#include "PathGeometry.h"
+
+#include <cmath>
+#include <algorithm>
+
+PathGeometry::PathGeometry()
+{
+    start = 0;
+    end = 0;
+    interval = 1;
+    alternating = false;
+    hasLayout = false;
+    dirtyCount = 0;
+    version = 0;
+}
+
+bool PathGeometry::sampleIndex(const double time, unsigned int &index) const
+{
+    if (!hasLayout || samples.length() == 0)
+        return false;
+
+    double position = (time - start) / interval;
+    double rounded = std::floor(position + 0.5);
+    if (std::fabs(position - rounded) > 1e-6 || rounded < 0 || rounded >= samples.length())
+        return false;
+
+    index = static_cast<unsigned int>(rounded);
+    return true;
+}
+
+void PathGeometry::setLayout(const double newStart, const double newEnd, const double newInterval, const MColor &newColor, const bool newAlternating)
+{
+    unsigned int count = 0;
+    if (newInterval > 0.0 && newEnd >= newStart)
+        count = static_cast<unsigned int>(std::floor((newEnd - newStart) / newInterval + 1e-6)) + 1;
+
+    bool layoutChanged = !hasLayout || newStart != start || newEnd != end || newInterval != interval || count != samples.length();
+    if (!layoutChanged)
+    {
+        if (newColor != color || newAlternating != alternating)
+        {
+            color = newColor;
+            alternating = newAlternating;
+            updateColors();
+        }
+        return;
+    }
+
+    //when the window slides by whole samples the clean samples are moved instead of being recomputed
+    bool keepSamples = false;
+    int offset = 0;
+    if (hasLayout && newInterval == interval && samples.length() > 0)
+    {
+        double shift = (newStart - start) / interval;
+        double rounded = std::floor(shift + 0.5);
+        if (std::fabs(shift - rounded) < 1e-6)
+        {
+            keepSamples = true;
+            offset = static_cast<int>(rounded);
+        }
+    }
+
+    MPointArray oldSamples;
+    std::vector<unsigned char> oldDirty;
+    if (keepSamples)
+    {
+        oldSamples = samples;
+        oldDirty = sampleDirty;
+    }
+
+    start = newStart;
+    end = newEnd;
+    interval = newInterval;
+    color = newColor;
+    alternating = newAlternating;
+    hasLayout = true;
+
+    ++version;
+    samples.setLength(count);
+    sampleDirty.assign(count, 1);
+    dirtyCount = count;
+    bounds.resize(count);
+
+    bool lastOnEnd = count > 0 && std::fabs(sampleTime(count - 1) - end) < 1e-6;
+    framePoints.setLength(lastOnEnd ? count : (count > 0 ? count - 1 : 0));
+    linePoints.setLength(count > 1 ? 2 * (count - 1) : 0);
+    lineColors.setLength(linePoints.length());
+
+    if (keepSamples)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            int oldIndex = static_cast<int>(i) + offset;
+            if (oldIndex < 0 || oldIndex >= static_cast<int>(oldSamples.length()) || oldDirty[oldIndex])
+                continue;
+
+            writeSample(i, oldSamples[oldIndex]);
+            sampleDirty[i] = 0;
+            --dirtyCount;
+        }
+    }
+
+    updateColors();
+}
+
+void PathGeometry::markDirty(const double time)
+{
+    unsigned int index;
+    if (!sampleIndex(time, index) || sampleDirty[index])
+        return;
+
+    sampleDirty[index] = 1;
+    ++dirtyCount;
+}
+
+void PathGeometry::markAllDirty()
+{
+    std::fill(sampleDirty.begin(), sampleDirty.end(), 1);
+    dirtyCount = static_cast<unsigned int>(sampleDirty.size());
+}
+
+void PathGeometry::markRangeDirty(const double rangeStart, const double rangeEnd)
+{
+    for (unsigned int i = 0; i < sampleDirty.size(); ++i)
+    {
+        double t = sampleTime(i);
+        if (t < rangeStart || t > rangeEnd || sampleDirty[i])
+            continue;
+
+        sampleDirty[i] = 1;
+        ++dirtyCount;
+    }
+}
+
+void PathGeometry::clearDirty()
+{
+    std::fill(sampleDirty.begin(), sampleDirty.end(), 0);
+    dirtyCount = 0;
+    bounds.update(samples);
+}
+
+void PathGeometry::setSample(const unsigned int index, const MVector &worldPosition)
+{
+    writeSample(index, MPoint(worldPosition));
+}
+
+void PathGeometry::writeSample(const unsigned int index, const MPoint &position)
+{
+    ++version;
+    samples[index] = position;
+    bounds.markDirty(index);
+    if (index < framePoints.length())
+        framePoints[index] = position;
+
+    //a sample ends the segment before it and starts the one after it
+    if (index > 0)
+        linePoints[2 * (index - 1) + 1] = position;
+    if (index + 1 < samples.length())
+        linePoints[2 * index] = position;
+}
+
+void PathGeometry::updateColors()
+{
+    ++version;
+    for (unsigned int i = 0; i + 1 < samples.length(); ++i)
+    {
+        double factor = 1;
+        if (alternating)
+            factor = int(sampleTime(i + 1)) % 2 == 1 ? 1.4 : 0.6;
+
+        MColor segmentColor = color * factor;
+        lineColors[2 * i] = segmentColor;
+        lineColors[2 * i + 1] = segmentColor;
+    }
+}
+
+size_t PathGeometry::memoryUsage() const
+{
+    size_t points = samples.length() + framePoints.length() + linePoints.length();
+    size_t bytes = points * sizeof(MPoint) + lineColors.length() * sizeof(MColor) + sampleDirty.capacity();
+
+    for (std::map<std::string, SimplifiedView>::const_iterator it = simplifiedViews.begin(); it != simplifiedViews.end(); ++it)
+    {
+        const SimplifiedView &simplified = it->second;
+        bytes += simplified.linePoints.length() * sizeof(MPoint);
+        bytes += simplified.lineColors.length() * sizeof(MColor) + simplified.pinned.capacity();
+    }
+    return bytes;
+}
+
+void PathGeometry::getPackets(const bool showPath, const std::vector<unsigned char> *visibleChunks, Packets &packets) const
+{
+    packets.linePoints = NULL;
+    packets.lineColors = NULL;
+    packets.framePoints = NULL;
+    packets.frameColor = color;
+    if (samples.length() == 0)
+        return;
+
+    // only part of the path is in the view: the vertices of the visible chunks are copied out for this draw
+    if (visibleChunks && visibleChunks->size() == bounds.numChunks() && std::find(visibleChunks->begin(), visibleChunks->end(), 0) != visibleChunks->end())
+    {
+        packets.visibleLines.clear();
+        packets.visibleColors.clear();
+        packets.visibleFrames.clear();
+        for (unsigned int c = 0; c < visibleChunks->size(); ++c)
+        {
+            if (!(*visibleChunks)[c])
+                continue;
+
+            unsigned int first = c * PathBounds::kChunkSize;
+            unsigned int last = std::min(first + PathBounds::kChunkSize, samples.length() - 1);
+            for (unsigned int s = first; showPath && s < last; ++s)
+            {
+                packets.visibleLines.append(linePoints[2 * s]);
+                packets.visibleLines.append(linePoints[2 * s + 1]);
+                packets.visibleColors.append(lineColors[2 * s]);
+                packets.visibleColors.append(lineColors[2 * s + 1]);
+            }
+
+            for (unsigned int s = first; s < first + PathBounds::kChunkSize && s < framePoints.length(); ++s)
+                packets.visibleFrames.append(framePoints[s]);
+        }
+
+        packets.linePoints = &packets.visibleLines;
+        packets.lineColors = &packets.visibleColors;
+        packets.framePoints = &packets.visibleFrames;
+        return;
+    }
+
+    if (showPath)
+    {
+        packets.linePoints = &linePoints;
+        packets.lineColors = &lineColors;
+    }
+    packets.framePoints = &framePoints;
+}
+
+void PathGeometry::submit(const Packets &packets, const float lineWidth, const float pointSize, MHWRender::MUIDrawManager* drawManager)
+{
+    if (packets.linePoints && packets.linePoints->length() > 0)
+    {
+        drawManager->setLineWidth(lineWidth);
+        drawManager->mesh(MHWRender::MUIDrawManager::kLines, *packets.linePoints, NULL, packets.lineColors);
+    }
+
+    if (packets.framePoints && packets.framePoints->length() > 0)
+    {
+        drawManager->setColor(packets.frameColor);
+        drawManager->setPointSize(pointSize);
+        drawManager->mesh(MHWRender::MUIDrawManager::kPoints, *packets.framePoints);
+    }
+}
+
+void PathGeometry::draw(const bool showPath, const float lineWidth, const float pointSize, MHWRender::MUIDrawManager* drawManager, const std::vector<unsigned char> *visibleChunks) const
+{
+    if (!drawManager || samples.length() == 0)
+        return;
+
+    Packets packets;
+    getPackets(showPath, visibleChunks, packets);
+    submit(packets, lineWidth, pointSize, drawManager);
+}
+
+void PathGeometry::simplify(SimplifiedView &simplified) const
+{
+    unsigned int count = samples.length();
+    std::vector<double> x(count), y(count);
+    std::vector<unsigned char> visible(count);
+    for (unsigned int i = 0; i < count; ++i)
+        visible[i] = simplified.projection.project(samples[i], x[i], y[i]) ? 1 : 0;
+
+    std::vector<unsigned char> keep(simplified.pinned);
+    keep.resize(count, 0);
+    pathLod::simplify(x, y, visible, simplified.tolerance, keep);
+
+    simplified.linePoints.clear();
+    simplified.lineColors.clear();
+
+    int previous = -1;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (!keep[i])
+            continue;
+
+        // a merged segment takes the color of the last original segment it covers
+        if (previous != -1)
+        {
+            simplified.linePoints.append(samples[previous]);
+            simplified.linePoints.append(samples[i]);
+            simplified.lineColors.append(lineColors[2 * (i - 1)]);
+            simplified.lineColors.append(lineColors[2 * (i - 1)]);
+        }
+        previous = static_cast<int>(i);
+    }
+}
+
+void PathGeometry::getSimplifiedPackets(const std::string &viewName, const pathLod::ScreenProjection &projection, const double tolerance, const std::vector<unsigned char> &pinned,
+                                        const bool showPath, Packets &packets)
+{
+    packets.linePoints = NULL;
+    packets.lineColors = NULL;
+    packets.framePoints = NULL;
+    packets.frameColor = color;
+    if (samples.length() == 0)
+        return;
+
+    // a view not drawn since the samples changed is from a closed panel or a camera no longer looked
+    // through, or would be simplified again anyway
+    for (std::map<std::string, SimplifiedView>::iterator it = simplifiedViews.begin(); it != simplifiedViews.end();)
+    {
+        if (it->second.version != version && it->first != viewName)
+            simplifiedViews.erase(it++);
+        else
+            ++it;
+    }
+
+    SimplifiedView &simplified = simplifiedViews[viewName];
+    if (simplified.version != version || simplified.tolerance != tolerance || !(simplified.projection == projection) || simplified.pinned != pinned)
+    {
+        simplified.projection = projection;
+        simplified.tolerance = tolerance;
+        simplified.version = version;
+        simplified.pinned = pinned;
+        simplify(simplified);
+    }
+
+    if (showPath)
+    {
+        packets.linePoints = &simplified.linePoints;
+        packets.lineColors = &simplified.lineColors;
+    }
+    packets.framePoints = &framePoints;
+}
+
+void PathGeometry::drawSimplified(const std::string &viewName, const pathLod::ScreenProjection &projection, const double tolerance, const std::vector<unsigned char> &pinned,
+                                  const bool showPath, const float lineWidth, const float pointSize, MHWRender::MUIDrawManager* drawManager)
+{
+    if (!drawManager || samples.length() == 0)
+        return;
+
+    Packets packets;
+    getSimplifiedPackets(viewName, projection, tolerance, pinned, showPath, packets);
+    submit(packets, lineWidth, pointSize, drawManager);
+}
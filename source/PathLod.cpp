@@ -0,0 +1,129 @@
+//
+//  PathLod.cpp
+//  MotionPath
+//
+//  Screen space simplification of the sampled path polyline.
+//
+
+#include "PathLod.h"
+
+#include <cmath>
+#include <utility>
+
+bool pathLod::ScreenProjection::project(const MPoint &point, double &x, double &y) const
+{
+	MPoint clip = MPoint(point.x, point.y, point.z, 1.0) * viewProjection;
+	if (clip.w <= 1e-9)
+		return false;
+
+	x = (clip.x / clip.w * 0.5 + 0.5) * width;
+	y = (clip.y / clip.w * 0.5 + 0.5) * height;
+	return true;
+}
+
+bool pathLod::getScreenProjection(M3dView &view, const MHWRender::MFrameContext* frameContext, ScreenProjection &projection)
+{
+	if (frameContext)
+	{
+		MStatus status;
+		projection.viewProjection = frameContext->getMatrix(MHWRender::MFrameContext::kViewProjMtx, &status);
+		if (status != MS::kSuccess)
+			return false;
+
+		int originX, originY;
+		if (frameContext->getViewportDimensions(originX, originY, projection.width, projection.height) != MS::kSuccess)
+			return false;
+	}
+	else
+	{
+		MMatrix modelView, projectionMatrix;
+		if (view.modelViewMatrix(modelView) != MS::kSuccess || view.projectionMatrix(projectionMatrix) != MS::kSuccess)
+			return false;
+
+		projection.viewProjection = modelView * projectionMatrix;
+		projection.width = view.portWidth();
+		projection.height = view.portHeight();
+	}
+
+	return projection.width > 0 && projection.height > 0;
+}
+
+namespace
+{
+	// squared pixel distance of point p from the segment a-b
+	double segmentDistanceSquared(const double px, const double py, const double ax, const double ay, const double bx, const double by)
+	{
+		double dx = bx - ax, dy = by - ay;
+		double lengthSquared = dx * dx + dy * dy;
+		double t = lengthSquared > 0.0 ? ((px - ax) * dx + (py - ay) * dy) / lengthSquared : 0.0;
+		if (t < 0.0) t = 0.0;
+		if (t > 1.0) t = 1.0;
+
+		double cx = ax + t * dx - px, cy = ay + t * dy - py;
+		return cx * cx + cy * cy;
+	}
+}
+
+void pathLod::simplify(const std::vector<double> &x, const std::vector<double> &y, const std::vector<unsigned char> &visible, const double tolerance, std::vector<unsigned char> &keep)
+{
+	size_t count = x.size();
+	keep.resize(count, 0);
+	if (count == 0)
+		return;
+
+	keep[0] = 1;
+	keep[count - 1] = 1;
+	// points behind the camera have no meaningful screen error, they and their neighbours stay
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (visible[i])
+			continue;
+
+		keep[i] = 1;
+		if (i > 0) keep[i - 1] = 1;
+		if (i + 1 < count) keep[i + 1] = 1;
+	}
+
+	double toleranceSquared = tolerance * tolerance;
+
+	// the pinned points split the polyline, every span between two of them is simplified on its own
+	std::vector<std::pair<size_t, size_t> > spans;
+	size_t anchor = 0;
+	for (size_t i = 1; i < count; ++i)
+	{
+		if (!keep[i])
+			continue;
+
+		if (i - anchor > 1)
+			spans.push_back(std::make_pair(anchor, i));
+		anchor = i;
+	}
+
+	while (!spans.empty())
+	{
+		std::pair<size_t, size_t> span = spans.back();
+		spans.pop_back();
+
+		size_t first = span.first, last = span.second;
+		size_t farthest = first;
+		double maxDistance = 0.0;
+		for (size_t i = first + 1; i < last; ++i)
+		{
+			double d = segmentDistanceSquared(x[i], y[i], x[first], y[first], x[last], y[last]);
+			if (d > maxDistance)
+			{
+				maxDistance = d;
+				farthest = i;
+			}
+		}
+
+		if (maxDistance <= toleranceSquared)
+			continue;
+
+		keep[farthest] = 1;
+		if (farthest - first > 1)
+			spans.push_back(std::make_pair(first, farthest));
+		if (last - farthest > 1)
+			spans.push_back(std::make_pair(farthest, last));
+	}
+}
@@ -0,0 +1,169 @@
+//
+//  PathStats.cpp
+//  MotionPath
+//
+//  Timers and counters of the caching and drawing hot paths, queried with tcMotionPathCmd -queryStats.
+//
+
+#include "PathStats.h"
+
+#include <maya/MString.h>
+
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    const char *sectionNames[pathStats::kNumSections] =
+    {
+        "addUIDrawables",
+        "drawFrames",
+        "drawFrameLabels",
+        "cacheParentMatrixRange",
+        "cachePositionsForDraw",
+        "cacheKeyFrames",
+        "cacheCamera",
+        "sweepFrames",
+        "hitTest",
+        "prefetchLeadingEdge",
+        "prepareWorldData"
+    };
+
+    const char *counterNames[pathStats::kNumCounters] =
+    {
+        "positionCacheHits",
+        "positionCacheMisses",
+        "positionEvaluations",
+        "parentMatrixCacheHits",
+        "parentMatrixCacheMisses",
+        "prefetchedFrames",
+        "sharedPanelDraws"
+    };
+
+    struct SectionStats
+    {
+        unsigned long long calls;
+        double total;               // seconds, all the fields below too
+        double refresh;
+        double lastRefresh;
+        double maxRefresh;
+    };
+
+    struct CounterStats
+    {
+        std::atomic<unsigned long long> refresh;
+        unsigned long long total;
+        unsigned long long lastRefresh;
+        unsigned long long maxRefresh;
+    };
+
+    SectionStats sections[pathStats::kNumSections];
+    CounterStats counters[pathStats::kNumCounters];
+    unsigned long long refreshes = 0;
+
+    MString milliseconds(const double seconds)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.3fms", seconds * 1000.0);
+        return MString(buffer);
+    }
+
+    MString number(const unsigned long long value)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%llu", value);
+        return MString(buffer);
+    }
+}
+
+pathStats::ScopedTimer::ScopedTimer(const Section section):
+    section(section),
+    start(std::chrono::steady_clock::now())
+{
+}
+
+pathStats::ScopedTimer::~ScopedTimer()
+{
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    SectionStats &stats = sections[section];
+    ++stats.calls;
+    stats.refresh += elapsed;
+}
+
+pathStats::RefreshScope::~RefreshScope()
+{
+    ++refreshes;
+
+    for (int i = 0; i < kNumSections; ++i)
+    {
+        SectionStats &stats = sections[i];
+        stats.total += stats.refresh;
+        stats.lastRefresh = stats.refresh;
+        stats.maxRefresh = std::max(stats.maxRefresh, stats.refresh);
+        stats.refresh = 0;
+    }
+
+    for (int i = 0; i < kNumCounters; ++i)
+    {
+        CounterStats &stats = counters[i];
+        unsigned long long refresh = stats.refresh.exchange(0);
+        stats.total += refresh;
+        stats.lastRefresh = refresh;
+        stats.maxRefresh = std::max(stats.maxRefresh, refresh);
+    }
+}
+
+void pathStats::count(const Counter counter, const unsigned int amount)
+{
+    counters[counter].refresh.fetch_add(amount, std::memory_order_relaxed);
+}
+
+void pathStats::query(MStringArray &result)
+{
+    result.append("refreshes " + number(refreshes));
+
+    // work done outside a refresh, by tools and commands, is only in the totals
+    for (int i = 0; i < kNumSections; ++i)
+    {
+        const SectionStats &stats = sections[i];
+        result.append(MString(sectionNames[i]) +
+                      " calls=" + number(stats.calls) +
+                      " total=" + milliseconds(stats.total + stats.refresh) +
+                      " lastRefresh=" + milliseconds(stats.lastRefresh) +
+                      " maxRefresh=" + milliseconds(stats.maxRefresh));
+    }
+
+    for (int i = 0; i < kNumCounters; ++i)
+    {
+        const CounterStats &stats = counters[i];
+        result.append(MString(counterNames[i]) +
+                      " total=" + number(stats.total + stats.refresh.load()) +
+                      " lastRefresh=" + number(stats.lastRefresh) +
+                      " maxRefresh=" + number(stats.maxRefresh));
+    }
+}
+
+void pathStats::reset()
+{
+    refreshes = 0;
+
+    for (int i = 0; i < kNumSections; ++i)
+    {
+        SectionStats &stats = sections[i];
+        stats.calls = 0;
+        stats.total = 0;
+        stats.refresh = 0;
+        stats.lastRefresh = 0;
+        stats.maxRefresh = 0;
+    }
+
+    for (int i = 0; i < kNumCounters; ++i)
+    {
+        CounterStats &stats = counters[i];
+        stats.refresh = 0;
+        stats.total = 0;
+        stats.lastRefresh = 0;
+        stats.maxRefresh = 0;
+    }
+}
@@ -8,6 +8,8 @@ This plugin hooks to maya's postRenderCallback in order to draw the curves in op
 #include <maya/MFnPlugin.h>
 #include <maya/MGlobal.h>
 
+#include <cstdlib>
+
 #include "MotionPathCmd.h"
 #include "MotionPathManager.h"
 #include "MotionPathEditContext.h"
@@ -17,6 +19,13 @@ This plugin hooks to maya's postRenderCallback in order to draw the curves in op
 
 MotionPathManager mpManager;
 
+// TC_MOTIONPATH_HEADLESS=1 registers only tcMotionPathCmd in batch and mayapy sessions, see bench/motionPathBench.py
+static bool headlessCommandRequested()
+{
+	const char *value = getenv("TC_MOTIONPATH_HEADLESS");
+	return value && value[0] != 0 && value[0] != '0';
+}
+
 
 MStatus initializePlugin(MObject obj)
 {
@@ -26,6 +35,15 @@ MStatus initializePlugin(MObject obj)
 
 	if ((MGlobal::mayaState() == MGlobal::kBatch) || (MGlobal::mayaState() == MGlobal::kLibraryApp))
 	{
+		// the benchmark driver needs the command to build and cache paths without a viewport
+		if (headlessCommandRequested())
+		{
+			status = plugin.registerCommand("tcMotionPathCmd", MotionPathCmd::creator, MotionPathCmd::syntaxCreator);
+			if (!status)
+				MGlobal::displayError("Error registering tcMotionPathCmd");
+			return status;
+		}
+
 		MGlobal::displayInfo("Batch mode - tcMotionpath disabled");
 		return status;
 	}
@@ -177,6 +195,12 @@ MStatus uninitializePlugin(MObject obj)
 
 	if ((MGlobal::mayaState() == MGlobal::kBatch) || (MGlobal::mayaState() == MGlobal::kLibraryApp))
 	{
+		if (headlessCommandRequested())
+		{
+			mpManager.removeCallbacks();
+			return plugin.deregisterCommand("tcMotionPathCmd");
+		}
+
 		MGlobal::displayInfo("Batch mode - tcMotionpath disabled");
 		return status;
 	}
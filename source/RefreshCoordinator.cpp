@@ -0,0 +1,99 @@
+//
+//  RefreshCoordinator.cpp
+//  MotionPath
+//
+//  Viewport refresh requests coalesced to the display rate.
+//
+
+#include "RefreshCoordinator.h"
+#include "GlobalSettings.h"
+
+#include <maya/M3dView.h>
+#include <maya/MEventMessage.h>
+
+RefreshCoordinator::RefreshCoordinator()
+{
+    pending = false;
+    pendingAllViews = false;
+    pendingForce = false;
+    idleCallbackId = 0;
+}
+
+RefreshCoordinator::~RefreshCoordinator()
+{
+    cancel();
+}
+
+bool RefreshCoordinator::frameElapsed() const
+{
+    if (GlobalSettings::maxRefreshRate <= 0)
+        return true;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastRefresh).count();
+    return elapsed >= 1.0 / GlobalSettings::maxRefreshRate;
+}
+
+void RefreshCoordinator::refresh(const bool allViews, const bool force)
+{
+    if (frameElapsed())
+    {
+        // whatever was waiting is covered by this refresh as well
+        refreshNow(allViews || (pending && pendingAllViews), force || (pending && pendingForce));
+        cancel();
+        return;
+    }
+
+    schedule(allViews, force);
+}
+
+void RefreshCoordinator::refreshOnIdle(const bool allViews, const bool force)
+{
+    schedule(allViews, force);
+}
+
+void RefreshCoordinator::schedule(const bool allViews, const bool force)
+{
+    if (pending)
+    {
+        pendingAllViews = pendingAllViews || allViews;
+        pendingForce = pendingForce || force;
+        return;
+    }
+
+    MStatus status;
+    idleCallbackId = MEventMessage::addEventCallback("idle", idleCallback, this, &status);
+    if (status != MS::kSuccess)
+        return;
+
+    pending = true;
+    pendingAllViews = allViews;
+    pendingForce = force;
+}
+
+void RefreshCoordinator::cancel()
+{
+    if (!pending)
+        return;
+
+    MMessage::removeCallback(idleCallbackId);
+    idleCallbackId = 0;
+    pending = false;
+}
+
+void RefreshCoordinator::refreshNow(const bool allViews, const bool force)
+{
+    M3dView::active3dView().refresh(allViews, force);
+    lastRefresh = std::chrono::steady_clock::now();
+}
+
+void RefreshCoordinator::idleCallback(void *data)
+{
+    RefreshCoordinator *coordinator = (RefreshCoordinator *) data;
+    if (!coordinator || !coordinator->pending || !coordinator->frameElapsed())
+        return;
+
+    bool allViews = coordinator->pendingAllViews;
+    bool force = coordinator->pendingForce;
+    coordinator->cancel();
+    coordinator->refreshNow(allViews, force);
+}
@@ -0,0 +1,303 @@
+//
+//  ScreenHitIndex.cpp
+//  MotionPath
+//
+//  Uniform screen space grid of the projected keys, tangent handles and frames used for picking.
+//
+
+#include "ScreenHitIndex.h"
+
+#include <cmath>
+#include <algorithm>
+
+ScreenHitIndex::ScreenHitIndex()
+{
+    drawGeneration = 0;
+    portWidth = 0;
+    portHeight = 0;
+    built = false;
+    cellSize = 1;
+    columns = 0;
+    rows = 0;
+}
+
+bool ScreenHitIndex::isValid(const unsigned int generation, const MMatrix &camera, const int width, const int height) const
+{
+    return built && generation == drawGeneration && width == portWidth && height == portHeight && camera == cameraMatrix;
+}
+
+void ScreenHitIndex::begin(const unsigned int generation, const MMatrix &camera, const int width, const int height, const double maxRadius)
+{
+    drawGeneration = generation;
+    cameraMatrix = camera;
+    portWidth = width;
+    portHeight = height;
+    built = false;
+
+    // every target within the pick radius of a click is in the 3x3 cells around it
+    cellSize = std::max(4, static_cast<int>(std::ceil(maxRadius)));
+
+    // one cell of margin on each side for targets just outside the viewport
+    columns = std::max(0, width) / cellSize + 3;
+    rows = std::max(0, height) / cellSize + 3;
+
+    targets.clear();
+    cellStart.clear();
+    cellTargets.clear();
+}
+
+void ScreenHitIndex::add(const TargetType type, const int pathId, const int id, const double time, const short x, const short y)
+{
+    int column, row;
+    if (!cellOf(x, y, column, row))
+        return;
+
+    Target target;
+    target.x = x;
+    target.y = y;
+    target.type = type;
+    target.pathId = pathId;
+    target.id = id;
+    target.time = time;
+    targets.push_back(target);
+}
+
+bool ScreenHitIndex::cellOf(const short x, const short y, int &column, int &row) const
+{
+    column = (x + cellSize) / cellSize;
+    row = (y + cellSize) / cellSize;
+    if (x < -cellSize || y < -cellSize)
+        return false;
+
+    return column < columns && row < rows;
+}
+
+void ScreenHitIndex::finalize()
+{
+    // counting sort of the targets by cell
+    cellStart.assign(columns * rows + 1, 0);
+    std::vector<unsigned int> targetCell(targets.size());
+    for (unsigned int i = 0; i < targets.size(); ++i)
+    {
+        int column, row;
+        cellOf(targets[i].x, targets[i].y, column, row);
+        targetCell[i] = row * columns + column;
+        ++cellStart[targetCell[i] + 1];
+    }
+
+    for (unsigned int c = 1; c < cellStart.size(); ++c)
+        cellStart[c] += cellStart[c - 1];
+
+    std::vector<unsigned int> fill(cellStart.begin(), cellStart.end() - 1);
+    cellTargets.resize(targets.size());
+    for (unsigned int i = 0; i < targets.size(); ++i)
+        cellTargets[fill[targetCell[i]]++] = i;
+
+    built = true;
+}
+
+template <typename Visitor>
+void ScreenHitIndex::visitNeighbours(const short mx, const short my, Visitor &visitor) const
+{
+    if (!built || columns == 0 || rows == 0)
+        return;
+
+    int column = (mx + cellSize) / cellSize;
+    int row = (my + cellSize) / cellSize;
+
+    for (int r = std::max(0, row - 1); r <= std::min(rows - 1, row + 1); ++r)
+    {
+        for (int c = std::max(0, column - 1); c <= std::min(columns - 1, column + 1); ++c)
+        {
+            unsigned int cell = r * columns + c;
+            for (unsigned int i = cellStart[cell]; i < cellStart[cell + 1]; ++i)
+                visitor(targets[cellTargets[i]]);
+        }
+    }
+}
+
+template <typename Visitor>
+void ScreenHitIndex::visitRect(const int minX, const int minY, const int maxX, const int maxY, Visitor &visitor) const
+{
+    if (!built || columns == 0 || rows == 0)
+        return;
+
+    int column0 = std::max(0, (minX + cellSize) / cellSize), column1 = std::min(columns - 1, (maxX + cellSize) / cellSize);
+    int row0 = std::max(0, (minY + cellSize) / cellSize), row1 = std::min(rows - 1, (maxY + cellSize) / cellSize);
+
+    for (int r = row0; r <= row1; ++r)
+    {
+        for (int c = column0; c <= column1; ++c)
+        {
+            unsigned int cell = r * columns + c;
+            for (unsigned int i = cellStart[cell]; i < cellStart[cell + 1]; ++i)
+                visitor(targets[cellTargets[i]]);
+        }
+    }
+}
+
+namespace
+{
+    inline double squaredDistance(const short mx, const short my, const ScreenHitIndex::Target &target)
+    {
+        double dx = mx - target.x;
+        double dy = my - target.y;
+        return dx * dx + dy * dy;
+    }
+
+    struct PickVisitor
+    {
+        short mx, my;
+        unsigned int typeMask;
+        int pathId;
+        double radiusSquared;
+        bool latest;
+        const ScreenHitIndex::Target *best;
+
+        void operator()(const ScreenHitIndex::Target &target)
+        {
+            if (!(typeMask & (1u << target.type)))
+                return;
+            if (pathId != -1 && target.pathId != pathId)
+                return;
+            if (squaredDistance(mx, my, target) >= radiusSquared)
+                return;
+
+            if (!best)
+                best = &target;
+            else if (latest)
+            {
+                if (target.time > best->time || (target.time == best->time && target.type > best->type))
+                    best = &target;
+            }
+            else if (target.time < best->time || (target.time == best->time && target.type < best->type))
+                best = &target;
+        }
+    };
+
+    struct PathVisitor
+    {
+        short mx, my;
+        double radiiSquared[ScreenHitIndex::kNumTargetTypes];
+        int pathId;
+
+        void operator()(const ScreenHitIndex::Target &target)
+        {
+            if (pathId != -1 && target.pathId >= pathId)
+                return;
+            if (squaredDistance(mx, my, target) < radiiSquared[target.type])
+                pathId = target.pathId;
+        }
+    };
+}
+
+namespace
+{
+    struct RectVisitor
+    {
+        int minX, minY, maxX, maxY;
+        unsigned int typeMask;
+        std::vector<ScreenHitIndex::Target> *result;
+
+        void operator()(const ScreenHitIndex::Target &target)
+        {
+            if ((typeMask & (1u << target.type)) && target.x >= minX && target.x <= maxX && target.y >= minY && target.y <= maxY)
+                result->push_back(target);
+        }
+    };
+
+    struct LassoVisitor
+    {
+        const MVectorArray *lasso;
+        unsigned int typeMask;
+        std::vector<ScreenHitIndex::Target> *result;
+
+        // even odd rule, a crossing is counted for every edge that straddles the horizontal line through the target
+        bool inside(const double x, const double y) const
+        {
+            bool in = false;
+            unsigned int count = lasso->length();
+            for (unsigned int i = 0, j = count - 1; i < count; j = i++)
+            {
+                const MVector &a = (*lasso)[i], &b = (*lasso)[j];
+                if ((a.y > y) != (b.y > y) && x < (b.x - a.x) * (y - a.y) / (b.y - a.y) + a.x)
+                    in = !in;
+            }
+            return in;
+        }
+
+        void operator()(const ScreenHitIndex::Target &target)
+        {
+            if ((typeMask & (1u << target.type)) && inside(target.x, target.y))
+                result->push_back(target);
+        }
+    };
+}
+
+void ScreenHitIndex::collectInRect(const short x0, const short y0, const short x1, const short y1, const unsigned int typeMask, std::vector<Target> &result) const
+{
+    RectVisitor visitor;
+    visitor.minX = std::min(x0, x1);
+    visitor.minY = std::min(y0, y1);
+    visitor.maxX = std::max(x0, x1);
+    visitor.maxY = std::max(y0, y1);
+    visitor.typeMask = typeMask;
+    visitor.result = &result;
+
+    visitRect(visitor.minX, visitor.minY, visitor.maxX, visitor.maxY, visitor);
+}
+
+void ScreenHitIndex::collectInLasso(const MVectorArray &lasso, const unsigned int typeMask, std::vector<Target> &result) const
+{
+    if (lasso.length() < 3)
+        return;
+
+    double minX = lasso[0].x, minY = lasso[0].y, maxX = minX, maxY = minY;
+    for (unsigned int i = 1; i < lasso.length(); ++i)
+    {
+        minX = std::min(minX, lasso[i].x);
+        minY = std::min(minY, lasso[i].y);
+        maxX = std::max(maxX, lasso[i].x);
+        maxY = std::max(maxY, lasso[i].y);
+    }
+
+    LassoVisitor visitor;
+    visitor.lasso = &lasso;
+    visitor.typeMask = typeMask;
+    visitor.result = &result;
+
+    visitRect(static_cast<int>(std::floor(minX)), static_cast<int>(std::floor(minY)), static_cast<int>(std::ceil(maxX)), static_cast<int>(std::ceil(maxY)), visitor);
+}
+
+bool ScreenHitIndex::pick(const short mx, const short my, const unsigned int typeMask, const int pathId, const double radius, const bool latest, Target &result) const
+{
+    PickVisitor visitor;
+    visitor.mx = mx;
+    visitor.my = my;
+    visitor.typeMask = typeMask;
+    visitor.pathId = pathId;
+    visitor.radiusSquared = radius * radius;
+    visitor.latest = latest;
+    visitor.best = NULL;
+
+    visitNeighbours(mx, my, visitor);
+
+    if (!visitor.best)
+        return false;
+
+    result = *visitor.best;
+    return true;
+}
+
+int ScreenHitIndex::pickPath(const short mx, const short my, const double *radii) const
+{
+    PathVisitor visitor;
+    visitor.mx = mx;
+    visitor.my = my;
+    for (int t = 0; t < kNumTargetTypes; ++t)
+        visitor.radiiSquared[t] = radii[t] * radii[t];
+    visitor.pathId = -1;
+
+    visitNeighbours(mx, my, visitor);
+    return visitor.pathId;
+}
@@ -0,0 +1,199 @@
+//
+//  StrokeGeometry.cpp
+//  MotionPath
+//
+//  Arc length and closest point queries on a screen space stroke, shared by the draw and edit contexts.
+//
+
+#include "StrokeGeometry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // keeps a long stroke across a large view from allocating a huge mostly empty grid
+    const int MAX_GRID_SIDE = 256;
+}
+
+void StrokeGeometry::clear()
+{
+    points.clear();
+    lengths.clear();
+    cellStart.clear();
+    cellSegments.clear();
+    columns = 0;
+    rows = 0;
+}
+
+void StrokeGeometry::set(const MVectorArray &strokePoints)
+{
+    clear();
+
+    unsigned int count = strokePoints.length();
+    points.reserve(count);
+    lengths.reserve(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        MVector point(strokePoints[i].x, strokePoints[i].y, 0);
+        lengths.push_back(i == 0 ? 0 : lengths.back() + (point - points.back()).length());
+        points.push_back(point);
+    }
+
+    if (count < 2)
+        return;
+
+    double maxX = points[0].x, maxY = points[0].y;
+    minX = maxX;
+    minY = maxY;
+    for (unsigned int i = 1; i < count; ++i)
+    {
+        minX = std::min(minX, points[i].x);
+        minY = std::min(minY, points[i].y);
+        maxX = std::max(maxX, points[i].x);
+        maxY = std::max(maxY, points[i].y);
+    }
+
+    // about one segment per cell, never smaller than the average segment so a segment touches few cells
+    unsigned int segments = count - 1;
+    double width = std::max(maxX - minX, 1.0), height = std::max(maxY - minY, 1.0);
+    cellSize = std::max(std::sqrt(width * height / segments), length() / segments);
+    cellSize = std::max(cellSize, std::max(width, height) / MAX_GRID_SIDE);
+    cellSize = std::max(cellSize, 1.0);
+    columns = static_cast<int>(width / cellSize) + 1;
+    rows = static_cast<int>(height / cellSize) + 1;
+
+    // two passes, count the segments of every cell and then fill them in
+    cellStart.assign(columns * rows + 1, 0);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        std::vector<unsigned int> fill;
+        if (pass == 1)
+        {
+            for (size_t c = 1; c < cellStart.size(); ++c)
+                cellStart[c] += cellStart[c - 1];
+            cellSegments.resize(cellStart.back());
+            fill.assign(cellStart.begin(), cellStart.end() - 1);
+        }
+
+        for (unsigned int s = 0; s < segments; ++s)
+        {
+            const MVector &a = points[s], &b = points[s + 1];
+            int x0 = static_cast<int>((std::min(a.x, b.x) - minX) / cellSize);
+            int x1 = std::min(static_cast<int>((std::max(a.x, b.x) - minX) / cellSize), columns - 1);
+            int y0 = static_cast<int>((std::min(a.y, b.y) - minY) / cellSize);
+            int y1 = std::min(static_cast<int>((std::max(a.y, b.y) - minY) / cellSize), rows - 1);
+
+            for (int y = y0; y <= y1; ++y)
+            {
+                for (int x = x0; x <= x1; ++x)
+                {
+                    int cell = y * columns + x;
+                    if (pass == 0)
+                        ++cellStart[cell + 1];
+                    else
+                        cellSegments[fill[cell]++] = s;
+                }
+            }
+        }
+    }
+}
+
+MVector StrokeGeometry::pointAtLength(const double distance) const
+{
+    if (points.empty())
+        return MVector::zero;
+    if (distance <= 0 || points.size() == 1)
+        return points.front();
+    if (distance >= length())
+        return points.back();
+
+    size_t i = std::upper_bound(lengths.begin(), lengths.end(), distance) - lengths.begin();
+    double segmentLength = lengths[i] - lengths[i - 1];
+    if (segmentLength < 1e-6)
+        return points[i - 1];
+
+    double t = (distance - lengths[i - 1]) / segmentLength;
+    return points[i - 1] * (1 - t) + points[i] * t;
+}
+
+MVector StrokeGeometry::spreadPoint(const int i, const int count) const
+{
+    if (points.empty())
+        return MVector::zero;
+    if (i >= count - 1)
+        return points.back();
+
+    //we do +1 as the first key is not evaluated, and with count there no -1
+    return pointAtLength((i + 1.0) / count * length());
+}
+
+void StrokeGeometry::closestOnSegment(const unsigned int segment, const MVector &q, double &bestDistance, unsigned int &bestSegment, double &bestT) const
+{
+    const MVector &a = points[segment];
+    MVector ab = points[segment + 1] - a;
+    double sqrLength = ab.x * ab.x + ab.y * ab.y;
+
+    double t = 0;
+    if (sqrLength > 1e-10)
+        t = std::max(0.0, std::min(1.0, ((q.x - a.x) * ab.x + (q.y - a.y) * ab.y) / sqrLength));
+
+    double dx = a.x + ab.x * t - q.x, dy = a.y + ab.y * t - q.y;
+    double distance = dx * dx + dy * dy;
+
+    // ties go to the earliest segment, as a walk along the stroke would find them
+    if (distance < bestDistance || (distance == bestDistance && segment < bestSegment))
+    {
+        bestDistance = distance;
+        bestSegment = segment;
+        bestT = t;
+    }
+}
+
+MVector StrokeGeometry::closestPoint(const MVector &q) const
+{
+    if (points.size() < 2)
+        return points.empty() ? MVector::zero : points.front();
+
+    int cx = static_cast<int>(std::max(0.0, std::min(std::floor((q.x - minX) / cellSize), columns - 1.0)));
+    int cy = static_cast<int>(std::max(0.0, std::min(std::floor((q.y - minY) / cellSize), rows - 1.0)));
+
+    const double infinity = std::numeric_limits<double>::max();
+    double bestDistance = infinity, bestT = 0;
+    unsigned int bestSegment = 0;
+
+    // rings of cells around the query, until no segment outside the visited square can be closer
+    for (int r = 0; ; ++r)
+    {
+        for (int y = std::max(0, cy - r); y <= std::min(rows - 1, cy + r); ++y)
+        {
+            bool edgeRow = y == cy - r || y == cy + r;
+            for (int x = std::max(0, cx - r); x <= std::min(columns - 1, cx + r); ++x)
+            {
+                if (!edgeRow && x != cx - r && x != cx + r)
+                    continue;
+
+                int cell = y * columns + x;
+                for (unsigned int i = cellStart[cell]; i < cellStart[cell + 1]; ++i)
+                    closestOnSegment(cellSegments[i], q, bestDistance, bestSegment, bestT);
+            }
+        }
+
+        // sides of the square on the grid border have nothing beyond them
+        double bound = infinity;
+        if (cx - r > 0)
+            bound = std::min(bound, q.x - (minX + (cx - r) * cellSize));
+        if (cx + r < columns - 1)
+            bound = std::min(bound, minX + (cx + r + 1) * cellSize - q.x);
+        if (cy - r > 0)
+            bound = std::min(bound, q.y - (minY + (cy - r) * cellSize));
+        if (cy + r < rows - 1)
+            bound = std::min(bound, minY + (cy + r + 1) * cellSize - q.y);
+
+        if (bound == infinity || (bestDistance != infinity && bestDistance <= bound * bound))
+            break;
+    }
+
+    return points[bestSegment] * (1 - bestT) + points[bestSegment + 1] * bestT;
+}
@@ -0,0 +1,103 @@
+//
+//  TransformKernel.cpp
+//  MotionPath
+//
+//  Batch transform of path samples into world or camera space.
+//
+
+#include "TransformKernel.h"
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define TRANSFORM_KERNEL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define TRANSFORM_KERNEL_SSE2
+#endif
+
+namespace
+{
+#if defined(TRANSFORM_KERNEL_AVX)
+	// one row of the matrix fits a 256 bit register: p' = x * row0 + y * row1 + z * row2 + row3
+	inline __m256d transformRow(const __m256d p, const MMatrix &m)
+	{
+		// broadcast x, y and z across the register without going through memory
+		__m256d lo = _mm256_permute2f128_pd(p, p, 0x00);
+		__m256d hi = _mm256_permute2f128_pd(p, p, 0x11);
+		__m256d x = _mm256_permute_pd(lo, 0x0);
+		__m256d y = _mm256_permute_pd(lo, 0xF);
+		__m256d z = _mm256_permute_pd(hi, 0x0);
+
+		__m256d r = _mm256_loadu_pd(m.matrix[3]);
+		r = _mm256_add_pd(r, _mm256_mul_pd(x, _mm256_loadu_pd(m.matrix[0])));
+		r = _mm256_add_pd(r, _mm256_mul_pd(y, _mm256_loadu_pd(m.matrix[1])));
+		r = _mm256_add_pd(r, _mm256_mul_pd(z, _mm256_loadu_pd(m.matrix[2])));
+		return r;
+	}
+#elif defined(TRANSFORM_KERNEL_SSE2)
+	// same as above split in two 128 bit halves, xy and zw
+	inline void transformRow(double *p, const MMatrix &m)
+	{
+		__m128d x = _mm_set1_pd(p[0]);
+		__m128d y = _mm_set1_pd(p[1]);
+		__m128d z = _mm_set1_pd(p[2]);
+
+		__m128d lo = _mm_loadu_pd(&m.matrix[3][0]);
+		__m128d hi = _mm_loadu_pd(&m.matrix[3][2]);
+		lo = _mm_add_pd(lo, _mm_mul_pd(x, _mm_loadu_pd(&m.matrix[0][0])));
+		hi = _mm_add_pd(hi, _mm_mul_pd(x, _mm_loadu_pd(&m.matrix[0][2])));
+		lo = _mm_add_pd(lo, _mm_mul_pd(y, _mm_loadu_pd(&m.matrix[1][0])));
+		hi = _mm_add_pd(hi, _mm_mul_pd(y, _mm_loadu_pd(&m.matrix[1][2])));
+		lo = _mm_add_pd(lo, _mm_mul_pd(z, _mm_loadu_pd(&m.matrix[2][0])));
+		hi = _mm_add_pd(hi, _mm_mul_pd(z, _mm_loadu_pd(&m.matrix[2][2])));
+
+		_mm_storeu_pd(&p[0], lo);
+		_mm_storeu_pd(&p[2], hi);
+	}
+#else
+	inline void transformRow(double *p, const MMatrix &m)
+	{
+		double x = p[0], y = p[1], z = p[2];
+		p[0] = x * m.matrix[0][0] + y * m.matrix[1][0] + z * m.matrix[2][0] + m.matrix[3][0];
+		p[1] = x * m.matrix[0][1] + y * m.matrix[1][1] + z * m.matrix[2][1] + m.matrix[3][1];
+		p[2] = x * m.matrix[0][2] + y * m.matrix[1][2] + z * m.matrix[2][2] + m.matrix[3][2];
+	}
+#endif
+}
+
+void transformKernel::transformPositions(const PositionArray &positions, const MMatrix *const *firstMatrices, const MMatrix *const *secondMatrices, const MMatrix *sharedMatrix, MVector *out)
+{
+	const size_t count = positions.size();
+	const double *xs = positions.x.data();
+	const double *ys = positions.y.data();
+	const double *zs = positions.z.data();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+#if defined(TRANSFORM_KERNEL_AVX)
+		__m256d p = _mm256_set_pd(1.0, zs[i], ys[i], xs[i]);
+		p = transformRow(p, *firstMatrices[i]);
+		if (secondMatrices)
+			p = transformRow(p, *secondMatrices[i]);
+		if (sharedMatrix)
+			p = transformRow(p, *sharedMatrix);
+
+		double v[4];
+		_mm256_storeu_pd(v, p);
+		out[i].x = v[0];
+		out[i].y = v[1];
+		out[i].z = v[2];
+#else
+		double v[4] = {xs[i], ys[i], zs[i], 1.0};
+		transformRow(v, *firstMatrices[i]);
+		if (secondMatrices)
+			transformRow(v, *secondMatrices[i]);
+		if (sharedMatrix)
+			transformRow(v, *sharedMatrix);
+
+		out[i].x = v[0];
+		out[i].y = v[1];
+		out[i].z = v[2];
+#endif
+	}
+}
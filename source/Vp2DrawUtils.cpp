@@ -7,10 +7,18 @@
 //
 
 #include "Vp2DrawUtils.h"
+#include "FrameLabelLayer.h"
 #include <maya/MPointArray.h>
+#include <maya/MColorArray.h>
+
+#include <cmath>
 
 #define PI 3.1415
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 void VP2DrawUtils::drawLineStipple(const MVector &origin, const MVector &target, float lineWidth, const MColor &color, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
 	MVector zVec(cameraMatrix[2][0], cameraMatrix[2][1], cameraMatrix[2][2]);
@@ -70,6 +78,100 @@ void VP2DrawUtils::drawPointWithColor(const MVector &point, float size, const MC
 	VP2DrawUtils::drawPoint(point, size, cameraMatrix, drawManager, frameContext);
 }
 
+void VP2DrawUtils::drawLineStrip(const std::vector<MVector> &points, const std::vector<MColor> &segmentColors, float lineWidth, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
+{
+	if (points.size() < 2)
+		return;
+
+	MVector zVec(cameraMatrix[2][0], cameraMatrix[2][1], cameraMatrix[2][2]);
+	MVector cPos(cameraMatrix[3][0], cameraMatrix[3][1], cameraMatrix[3][2]);
+
+	// segments are emitted as separate lines so every one keeps its own flat color
+	MPointArray positions;
+	MColorArray colors;
+	positions.setLength(static_cast<unsigned int>((points.size() - 1) * 2));
+	colors.setLength(positions.length());
+
+	unsigned int count = 0;
+	double x1, y1, x2, y2;
+	frameContext->worldToViewport(points[0], x1, y1);
+	for (size_t i = 1; i < points.size(); ++i)
+	{
+		frameContext->worldToViewport(points[i], x2, y2);
+
+		// same behind-the-camera test drawLine does on the segment origin
+		if ((cPos - points[i - 1]) * zVec > 0.0001)
+		{
+			const MColor &color = i - 1 < segmentColors.size() ? segmentColors[i - 1] : segmentColors.back();
+			positions.set(count, x1, y1);
+			colors.set(color, count++);
+			positions.set(count, x2, y2);
+			colors.set(color, count++);
+		}
+
+		x1 = x2;
+		y1 = y2;
+	}
+
+	if (count == 0)
+		return;
+
+	positions.setLength(count);
+	colors.setLength(count);
+
+	drawManager->setLineWidth(lineWidth);
+	drawManager->mesh2d(MHWRender::MUIDrawManager::kLines, positions, &colors);
+}
+
+
+void VP2DrawUtils::drawPointList(const std::vector<MVector> &points, float size, const MColor &color, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
+{
+	if (points.empty())
+		return;
+
+	MVector zVec(cameraMatrix[2][0], cameraMatrix[2][1], cameraMatrix[2][2]);
+	MVector cPos(cameraMatrix[3][0], cameraMatrix[3][1], cameraMatrix[3][2]);
+
+	// kPoints draws square points, so every point is a screen space disc of the same size circle2d gives drawPoint,
+	// a fan of triangles in one triangle list. A few pixels wide the segments can't be told from a circle
+	const unsigned int segments = 12;
+	double radius = size / 2;
+	double ringX[segments + 1], ringY[segments + 1];
+	for (unsigned int k = 0; k <= segments; ++k)
+	{
+		double angle = 2.0 * M_PI * (k % segments) / segments;
+		ringX[k] = radius * cos(angle);
+		ringY[k] = radius * sin(angle);
+	}
+
+	MPointArray positions;
+	positions.setLength(static_cast<unsigned int>(points.size()) * segments * 3);
+
+	unsigned int count = 0;
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		if ((cPos - points[i]) * zVec <= 0.0001)
+			continue;
+
+		double x, y;
+		frameContext->worldToViewport(points[i], x, y);
+		for (unsigned int k = 0; k < segments; ++k)
+		{
+			positions.set(count++, x, y);
+			positions.set(count++, x + ringX[k], y + ringY[k]);
+			positions.set(count++, x + ringX[k + 1], y + ringY[k + 1]);
+		}
+	}
+
+	if (count == 0)
+		return;
+
+	positions.setLength(count);
+
+	drawManager->setColor(color);
+	drawManager->mesh2d(MHWRender::MUIDrawManager::kTriangles, positions);
+}
+
 void VP2DrawUtils::drawKeyFrames(std::vector<Keyframe *> keys, const float size, const double colorMultiplier, const int portWidth, const int portHeight, const bool showRotationKeyframes, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
 	for (unsigned int ki = 0; ki < keys.size(); ++ki)
@@ -202,21 +304,20 @@ void VP2DrawUtils::drawKeyFrames(std::vector<Keyframe *> keys, const float size,
 	}
 }
 
-void VP2DrawUtils::drawKeyFramePoints(KeyframeMap &keyframesCache, const float size, const double colorMultiplier, const int portWidth, const int portHeight, const bool showRotationKeyframes, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
+void VP2DrawUtils::drawKeyFramePoints(KeyframeTable &keyframesCache, const float size, const double colorMultiplier, const int portWidth, const int portHeight, const bool showRotationKeyframes, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
 {
 	std::vector<Keyframe *> keys;
 	keys.reserve(keyframesCache.size());
 
-	for (KeyframeMapIterator keyIt = keyframesCache.begin(); keyIt != keyframesCache.end(); keyIt++)
+	// only the packed positions are read until a key is known to be in front of the camera
+	MVector zVec(cameraMatrix[2][0], cameraMatrix[2][1], cameraMatrix[2][2]);
+	MVector cPos(cameraMatrix[3][0], cameraMatrix[3][1], cameraMatrix[3][2]);
+	const std::vector<MVector> &worldPositions = keyframesCache.getWorldPositions();
+	for (size_t k = 0; k < worldPositions.size(); k++)
 	{
-		Keyframe* key = &keyIt->second;
-		if (!key)
-			continue;
-		MVector zVec(cameraMatrix[2][0], cameraMatrix[2][1], cameraMatrix[2][2]);
-		MVector cPos(cameraMatrix[3][0], cameraMatrix[3][1], cameraMatrix[3][2]);
-		if ((cPos - key->worldPosition) * zVec  <= 0.0001)
+		if ((cPos - worldPositions[k]) * zVec  <= 0.0001)
 			continue;
-		keys.push_back(key);
+		keys.push_back(&keyframesCache.at(k));
 	}
 
 	drawKeyFrames(keys, size, colorMultiplier, portWidth, portHeight, showRotationKeyframes, cameraMatrix, drawManager, frameContext);
@@ -227,28 +328,11 @@ void VP2DrawUtils::convertWorldSpaceToCameraSpace(CameraCache* cachePtr, std::ma
 	
 }
 
-void VP2DrawUtils::drawFrameLabel(double frame, const MVector &framePos, M3dView &view, const double sizeOffset, const MColor &color, const MMatrix &cameraMatrix, MHWRender::MUIDrawManager* drawManager, const MHWRender::MFrameContext* frameContext)
+void VP2DrawUtils::drawFrameLabel(const MString &label, const double viewX, const double viewY, const double sizeOffset, const MColor &color, MHWRender::MUIDrawManager* drawManager)
 {
-	MVector zVec(cameraMatrix[2][0], cameraMatrix[2][1], cameraMatrix[2][2]);
-	MVector cPos(cameraMatrix[3][0], cameraMatrix[3][1], cameraMatrix[3][2]);
-	if ((cPos - framePos) * zVec  <= 0.0001)
-		return;
-
-    unsigned int fontPixelSize = static_cast<unsigned int>(14.0 * sizeOffset);
-    if (fontPixelSize < 6)
-        fontPixelSize = 6;  // 避免过小
-    if (fontPixelSize > 64)
-        fontPixelSize = 64; // 避免过大导致绘制异常
-
-    drawManager->setFontSize(fontPixelSize);
+    drawManager->setFontSize(FrameLabelLayer::fontPixelSize(sizeOffset));
     drawManager->setColor(color);
 
-	double viewX, viewY;
-	frameContext->worldToViewport(framePos, viewX, viewY);
-
-	MString frameStr;
-	frameStr = frame;
-
-	drawManager->text(MPoint(viewX, viewY + (GlobalSettings::frameSize * sizeOffset)), frameStr, MHWRender::MUIDrawManager::kCenter);
+	drawManager->text(MPoint(viewX, viewY), label, MHWRender::MUIDrawManager::kCenter);
 }
 
@@ -8,6 +8,8 @@
 
 #include "animCurveUtils.h"
 
+#include <maya/MFnDagNode.h>
+
 
 bool animCurveUtils::updateCurve(const MPlug &plug, MFnAnimCurve &curve, const MTime &currentTime, double &oldValue, double &newValue, int &newKeyId, int &oldKeyId)
 {
@@ -44,3 +46,93 @@ void animCurveUtils::restoreCurve(MFnAnimCurve &curve, const MTime &currentTime,
 		curve.setValue(oldKeyId, oldValue);
 }
 
+
+bool animCurveUtils::getLiveValue(const MPlug &plug, const MTime &currentTime, LiveValue &live)
+{
+    live = LiveValue();
+    
+    MStatus status;
+    MFnAnimCurve curve(plug, &status);
+    if (status != MS::kSuccess)
+        return false;
+    
+    double curveValue;
+    curve.evaluate(currentTime, curveValue);
+    double plugValue = plug.asDouble();
+    if (plugValue == curveValue)
+        return false;
+    
+    live.active = true;
+    live.time = currentTime.as(MTime::uiUnit());
+    live.offset = plugValue - curveValue;
+    
+    for (unsigned int i = 0; i < curve.numKeys(); ++i)
+    {
+        double keyTime = curve.time(i).as(MTime::uiUnit());
+        if (keyTime < live.time)
+        {
+            live.prevKeyTime = keyTime;
+            live.hasPrevKey = true;
+        }
+        else if (keyTime > live.time)
+        {
+            live.nextKeyTime = keyTime;
+            live.hasNextKey = true;
+            break;
+        }
+    }
+    
+    return true;
+}
+
+double animCurveUtils::LiveValue::offsetAtTime(const double t) const
+{
+    if (!active)
+        return 0.0;
+    
+    //without a key on one side the curve extrapolates flat from the live value, like a real key would
+    double weight = 1.0;
+    if (t < time && hasPrevKey)
+        weight = t <= prevKeyTime ? 0.0 : (t - prevKeyTime) / (time - prevKeyTime);
+    else if (t > time && hasNextKey)
+        weight = t >= nextKeyTime ? 0.0 : (nextKeyTime - t) / (nextKeyTime - time);
+    
+    return offset * weight;
+}
+
+// no incoming connection on any of the attributes that build the local matrix: no keys, constraints or expressions
+static bool isTransformStatic(const MObject &transform)
+{
+    const char *attributes[] = {"translate", "rotate", "scale", "shear", "rotatePivot", "rotatePivotTranslate",
+        "scalePivot", "scalePivotTranslate", "rotateAxis", "rotateOrder", "jointOrient", "inheritsTransform", "offsetParentMatrix"};
+
+    MFnDependencyNode depNodFn(transform);
+    for (int a = 0; a < 13; ++a)
+    {
+        MStatus status;
+        MPlug plug = depNodFn.findPlug(attributes[a], false, &status);
+        if (status != MS::kSuccess)
+            continue;
+
+        if (plug.isDestination())
+            return false;
+        for (unsigned int c = 0; plug.isCompound() && c < plug.numChildren(); ++c)
+            if (plug.child(c).isDestination())
+                return false;
+    }
+    return true;
+}
+
+bool animCurveUtils::isStaticUpToWorld(const MObject &transform)
+{
+    MObject node = transform;
+    while (!node.isNull() && !node.hasFn(MFn::kWorld))
+    {
+        if (!isTransformStatic(node))
+            return false;
+
+        MFnDagNode dagNodeFn(node);
+        node = dagNodeFn.parentCount() > 0 ? dagNodeFn.parent(0) : MObject();
+    }
+    return true;
+}